@@ -43,17 +43,21 @@ public:
             if (!hmd->PoseIsValid(unTrackedDevice))
                 continue;
 
-            const Matrix4 &mat = hmd->DevicePose(unTrackedDevice);
+            const Matrix4 mat = hmd->DevicePose(unTrackedDevice).ToMatrix4();
 
-            Vector4 center = mat * Vector4(0, 0, 0, 1);
+            // center, the X/Y/Z axis ends, then the pointer line
+            static const float s_xs[6] = {0, 0.05f, 0, 0, 0, 0};
+            static const float s_ys[6] = {0, 0, 0.05f, 0, 0, 0};
+            static const float s_zs[6] = {0, 0, 0, 0.05f, -0.02f, -39.f};
+            Vector3 points[6];
+            transformPoints(mat, s_xs, s_ys, s_zs, &points[0].x, sizeof(Vector3), 6);
+            const Vector3 &center = points[0];
 
             for (int i = 0; i < 3; ++i)
             {
                 Vector3 color(0, 0, 0);
-                Vector4 point(0, 0, 0, 1);
-                point[i] += 0.05f; // offset in X, Y, Z
-                color[i] = 1.0;    // R, G, B
-                point = mat * point;
+                color[i] = 1.0; // R, G, B
+                const Vector3 &point = points[1 + i];
                 vertdataarray.push_back(center.x);
                 vertdataarray.push_back(center.y);
                 vertdataarray.push_back(center.z);
@@ -73,8 +77,8 @@ public:
                 m_uiControllerVertcount += 2;
             }
 
-            Vector4 start = mat * Vector4(0, 0, -0.02f, 1);
-            Vector4 end = mat * Vector4(0, 0, -39.f, 1);
+            const Vector3 &start = points[4];
+            const Vector3 &end = points[5];
             Vector3 color(.92f, .92f, .71f);
 
             vertdataarray.push_back(start.x);
@@ -0,0 +1,966 @@
+#include "BlockCompress.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+typedef unsigned char UINT8;
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BC_X86 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define BC_NEON 1
+#include <arm_neon.h>
+#endif
+
+const char *GetBCFormatName(BCFormat format)
+{
+    switch (format)
+    {
+    case BCFormat::BC1:
+        return "bc1";
+    case BCFormat::BC3:
+        return "bc3";
+    case BCFormat::BC7:
+        return "bc7";
+    }
+    return "unknown";
+}
+
+const char *GetBCQualityName(BCQuality quality)
+{
+    return quality == BCQuality::Fast ? "fast" : "quality";
+}
+
+size_t GetBCBlockBytes(BCFormat format)
+{
+    return format == BCFormat::BC1 ? 8 : 16;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: per channel min / max of the 16 texels of a block
+//-----------------------------------------------------------------------------
+static void BlockMinMax(const UINT8 *pTexels, UINT8 *pMin, UINT8 *pMax)
+{
+#if BC_X86
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(pTexels + 0));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(pTexels + 16));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(pTexels + 32));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(pTexels + 48));
+    __m128i mn = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+    __m128i mx = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+    // fold the four texels of each row vector together
+    mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(1, 0, 3, 2)));
+    mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(1, 0, 3, 2)));
+    mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(2, 3, 0, 1)));
+    mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(2, 3, 0, 1)));
+    uint32_t nMin = (uint32_t)_mm_cvtsi128_si32(mn);
+    uint32_t nMax = (uint32_t)_mm_cvtsi128_si32(mx);
+    memcpy(pMin, &nMin, 4);
+    memcpy(pMax, &nMax, 4);
+#elif BC_NEON
+    uint8x16_t mn = vminq_u8(vminq_u8(vld1q_u8(pTexels), vld1q_u8(pTexels + 16)),
+                             vminq_u8(vld1q_u8(pTexels + 32), vld1q_u8(pTexels + 48)));
+    uint8x16_t mx = vmaxq_u8(vmaxq_u8(vld1q_u8(pTexels), vld1q_u8(pTexels + 16)),
+                             vmaxq_u8(vld1q_u8(pTexels + 32), vld1q_u8(pTexels + 48)));
+    mn = vminq_u8(mn, vextq_u8(mn, mn, 8));
+    mx = vmaxq_u8(mx, vextq_u8(mx, mx, 8));
+    mn = vminq_u8(mn, vextq_u8(mn, mn, 4));
+    mx = vmaxq_u8(mx, vextq_u8(mx, mx, 4));
+    vst1q_lane_u32((uint32_t *)pMin, vreinterpretq_u32_u8(mn), 0);
+    vst1q_lane_u32((uint32_t *)pMax, vreinterpretq_u32_u8(mx), 0);
+#else
+    for (int c = 0; c < 4; c++)
+    {
+        pMin[c] = pMax[c] = pTexels[c];
+    }
+    for (int i = 1; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            pMin[c] = std::min(pMin[c], pTexels[i * 4 + c]);
+            pMax[c] = std::max(pMax[c], pTexels[i * 4 + c]);
+        }
+    }
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: nearest palette entry for every texel over the first nChannels
+//          channels. Returns the summed squared error.
+//-----------------------------------------------------------------------------
+static float SelectIndices(const float (*pTexels)[4], const int *pTexelList, int nTexels,
+                           const float (*pPalette)[4], int nPalette, int nChannels, UINT8 *pIndices)
+{
+#if BC_X86
+    // four texels per vector, one channel per array; the palette is broadcast
+    alignas(16) float texels[4][16];
+    for (int n = 0; n < 16; n++)
+    {
+        const float *t = pTexels[pTexelList ? pTexelList[std::min(n, nTexels - 1)] : std::min(n, nTexels - 1)];
+        for (int c = 0; c < 4; c++)
+        {
+            texels[c][n] = t[c];
+        }
+    }
+    float fError = 0.0f;
+    for (int g = 0; g < (nTexels + 3) / 4; g++)
+    {
+        __m128 best = _mm_set1_ps(3.4e38f);
+        __m128 bestIndex = _mm_setzero_ps();
+        for (int i = 0; i < nPalette; i++)
+        {
+            __m128 dist = _mm_setzero_ps();
+            for (int c = 0; c < nChannels; c++)
+            {
+                __m128 d = _mm_sub_ps(_mm_load_ps(&texels[c][g * 4]), _mm_set1_ps(pPalette[i][c]));
+                dist = _mm_add_ps(dist, _mm_mul_ps(d, d));
+            }
+            // strictly closer, so ties keep the lowest index like the scalar path
+            __m128 bCloser = _mm_cmplt_ps(dist, best);
+            best = _mm_min_ps(dist, best);
+            bestIndex = _mm_or_ps(_mm_and_ps(bCloser, _mm_set1_ps((float)i)), _mm_andnot_ps(bCloser, bestIndex));
+        }
+        alignas(16) float lanes[4];
+        alignas(16) int32_t laneIndex[4];
+        _mm_store_ps(lanes, best);
+        _mm_store_si128((__m128i *)laneIndex, _mm_cvttps_epi32(bestIndex));
+        for (int l = 0; l < 4 && g * 4 + l < nTexels; l++)
+        {
+            int n = g * 4 + l;
+            pIndices[pTexelList ? pTexelList[n] : n] = (UINT8)laneIndex[l];
+            fError += lanes[l];
+        }
+    }
+    return fError;
+#else
+    float fError = 0.0f;
+    for (int n = 0; n < nTexels; n++)
+    {
+        int nTexel = pTexelList ? pTexelList[n] : n;
+        const float *t = pTexels[nTexel];
+        float best = 3.4e38f;
+        int nBest = 0;
+        for (int i = 0; i < nPalette; i++)
+        {
+            float dist = 0.0f;
+            for (int c = 0; c < nChannels; c++)
+            {
+                float d = pPalette[i][c] - t[c];
+                dist += d * d;
+            }
+            if (dist < best)
+            {
+                best = dist;
+                nBest = i;
+            }
+        }
+        pIndices[nTexel] = (UINT8)nBest;
+        fError += best;
+    }
+    return fError;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: endpoints along the bounding box diagonal, flipping channels that
+//          fall while the widest channel rises. Inset by 1/16 of the range
+//          since the extremes are rarely hit exactly.
+//-----------------------------------------------------------------------------
+static void BoxEndpoints(const UINT8 *pTexels, const float (*t)[4], const int *pTexelList, int nTexels,
+                         int nChannels, float *pE0, float *pE1)
+{
+    UINT8 mn[4], mx[4];
+    if (nTexels == 16)
+    {
+        BlockMinMax(pTexels, mn, mx);
+    }
+    else
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            mn[c] = 255;
+            mx[c] = 0;
+        }
+        for (int n = 0; n < nTexels; n++)
+        {
+            const UINT8 *p = pTexels + pTexelList[n] * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                mn[c] = std::min(mn[c], p[c]);
+                mx[c] = std::max(mx[c], p[c]);
+            }
+        }
+    }
+
+    int nWidest = 0;
+    float mean[4] = {};
+    for (int c = 0; c < nChannels; c++)
+    {
+        if (mx[c] - mn[c] > mx[nWidest] - mn[nWidest])
+            nWidest = c;
+        for (int n = 0; n < nTexels; n++)
+        {
+            mean[c] += t[pTexelList ? pTexelList[n] : n][c];
+        }
+        mean[c] /= nTexels;
+    }
+    for (int c = 0; c < nChannels; c++)
+    {
+        float inset = (mx[c] - mn[c]) / 16.0f;
+        pE0[c] = mn[c] + inset;
+        pE1[c] = mx[c] - inset;
+        if (c == nWidest)
+            continue;
+        float cov = 0.0f;
+        for (int n = 0; n < nTexels; n++)
+        {
+            const float *p = t[pTexelList ? pTexelList[n] : n];
+            cov += (p[nWidest] - mean[nWidest]) * (p[c] - mean[c]);
+        }
+        if (cov < 0.0f)
+            std::swap(pE0[c], pE1[c]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: endpoints at the extremes of the texels projected on their
+//          principal axis (power iteration on the covariance matrix)
+//-----------------------------------------------------------------------------
+static void PrincipalAxisEndpoints(const float (*t)[4], const int *pTexelList, int nTexels, int nChannels,
+                                   float *pE0, float *pE1)
+{
+    float mean[4] = {};
+    for (int n = 0; n < nTexels; n++)
+    {
+        for (int c = 0; c < nChannels; c++)
+        {
+            mean[c] += t[pTexelList ? pTexelList[n] : n][c];
+        }
+    }
+    for (int c = 0; c < nChannels; c++)
+    {
+        mean[c] /= nTexels;
+    }
+
+    float cov[4][4] = {};
+    for (int n = 0; n < nTexels; n++)
+    {
+        const float *p = t[pTexelList ? pTexelList[n] : n];
+        for (int i = 0; i < nChannels; i++)
+        {
+            for (int j = i; j < nChannels; j++)
+            {
+                cov[i][j] += (p[i] - mean[i]) * (p[j] - mean[j]);
+            }
+        }
+    }
+    // start from the row of the widest channel, it is rarely orthogonal to the answer
+    int nWidest = 0;
+    for (int i = 0; i < nChannels; i++)
+    {
+        for (int j = 0; j < i; j++)
+        {
+            cov[i][j] = cov[j][i];
+        }
+        if (cov[i][i] > cov[nWidest][nWidest])
+            nWidest = i;
+    }
+    float axis[4] = {};
+    for (int c = 0; c < nChannels; c++)
+    {
+        axis[c] = cov[nWidest][c];
+    }
+    for (int nIteration = 0; nIteration < 8; nIteration++)
+    {
+        float next[4] = {};
+        float fMax = 0.0f;
+        for (int i = 0; i < nChannels; i++)
+        {
+            for (int j = 0; j < nChannels; j++)
+            {
+                next[i] += cov[i][j] * axis[j];
+            }
+            fMax = std::max(fMax, fabsf(next[i]));
+        }
+        if (fMax == 0.0f)
+            break;
+        for (int c = 0; c < nChannels; c++)
+        {
+            axis[c] = next[c] / fMax;
+        }
+    }
+
+    float fLength = 0.0f;
+    for (int c = 0; c < nChannels; c++)
+    {
+        fLength += axis[c] * axis[c];
+    }
+    if (fLength == 0.0f)
+    {
+        // flat block
+        for (int c = 0; c < nChannels; c++)
+        {
+            pE0[c] = pE1[c] = mean[c];
+        }
+        return;
+    }
+    fLength = sqrtf(fLength);
+    float fMin = 3.4e38f, fMax = -3.4e38f;
+    for (int n = 0; n < nTexels; n++)
+    {
+        const float *p = t[pTexelList ? pTexelList[n] : n];
+        float fDot = 0.0f;
+        for (int c = 0; c < nChannels; c++)
+        {
+            fDot += (p[c] - mean[c]) * axis[c];
+        }
+        fMin = std::min(fMin, fDot / fLength);
+        fMax = std::max(fMax, fDot / fLength);
+    }
+    for (int c = 0; c < nChannels; c++)
+    {
+        pE0[c] = std::min(std::max(mean[c] + fMin * axis[c] / fLength, 0.0f), 255.0f);
+        pE1[c] = std::min(std::max(mean[c] + fMax * axis[c] / fLength, 0.0f), 255.0f);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: least squares endpoints for fixed indices, where texel n is
+//          approximated by (1 - w[n]) * e0 + w[n] * e1. False if the system
+//          is singular (every texel on one index).
+//-----------------------------------------------------------------------------
+static bool FitEndpoints(const float (*t)[4], const int *pTexelList, int nTexels, const float *pWeights,
+                         int nChannels, float *pE0, float *pE1)
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int n = 0; n < nTexels; n++)
+    {
+        int nTexel = pTexelList ? pTexelList[n] : n;
+        float b = pWeights[nTexel];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < nChannels; c++)
+        {
+            ax[c] += a * t[nTexel][c];
+            bx[c] += b * t[nTexel][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f)
+        return false;
+    for (int c = 0; c < nChannels; c++)
+    {
+        pE0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / det, 0.0f), 255.0f);
+        pE1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / det, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+static void LoadTexelsFloat(const UINT8 *pTexels, float (*t)[4])
+{
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            t[i][c] = pTexels[i * 4 + c];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// BC1 color
+//-----------------------------------------------------------------------------
+static uint16_t Pack565(const float *pColor)
+{
+    int r = std::min(std::max((int)(pColor[0] * (31.0f / 255.0f) + 0.5f), 0), 31);
+    int g = std::min(std::max((int)(pColor[1] * (63.0f / 255.0f) + 0.5f), 0), 63);
+    int b = std::min(std::max((int)(pColor[2] * (31.0f / 255.0f) + 0.5f), 0), 31);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(uint16_t nColor, int *pRGB)
+{
+    int r = nColor >> 11, g = (nColor >> 5) & 63, b = nColor & 31;
+    pRGB[0] = (r << 3) | (r >> 2);
+    pRGB[1] = (g << 2) | (g >> 4);
+    pRGB[2] = (b << 3) | (b >> 2);
+}
+
+// Decoded palette; returns 4 in four color mode, 3 when entry 3 is transparent black
+static int GetBC1Palette(uint16_t c0, uint16_t c1, bool bForceFourColor, int (*pPalette)[4])
+{
+    int e0[3], e1[3];
+    Unpack565(c0, e0);
+    Unpack565(c1, e1);
+    bool bFourColor = bForceFourColor || c0 > c1;
+    for (int c = 0; c < 3; c++)
+    {
+        pPalette[0][c] = e0[c];
+        pPalette[1][c] = e1[c];
+        if (bFourColor)
+        {
+            pPalette[2][c] = (2 * e0[c] + e1[c]) / 3;
+            pPalette[3][c] = (e0[c] + 2 * e1[c]) / 3;
+        }
+        else
+        {
+            pPalette[2][c] = (e0[c] + e1[c]) / 2;
+            pPalette[3][c] = 0;
+        }
+    }
+    pPalette[0][3] = pPalette[1][3] = pPalette[2][3] = 255;
+    pPalette[3][3] = bFourColor ? 255 : 0;
+    return bFourColor ? 4 : 3;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: BC1 color block. bAllowTransparent lets texels with alpha < 128
+//          use the transparent entry (BC1); BC3 always decodes four colors.
+//-----------------------------------------------------------------------------
+static void EncodeColorBlock(const UINT8 *pTexels, bool bAllowTransparent, BCQuality quality, UINT8 *pBlock)
+{
+    float t[16][4];
+    LoadTexelsFloat(pTexels, t);
+
+    int opaque[16];
+    int nOpaque = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        if (!bAllowTransparent || pTexels[i * 4 + 3] >= 128)
+            opaque[nOpaque++] = i;
+    }
+    const bool bTransparent = nOpaque < 16;
+
+    uint16_t bestC0 = 0, bestC1 = 0xffff;
+    UINT8 bestIndices[16];
+    memset(bestIndices, 3, sizeof(bestIndices));
+    if (nOpaque > 0)
+    {
+        float e0[4], e1[4];
+        if (quality == BCQuality::Fast)
+            BoxEndpoints(pTexels, t, bTransparent ? opaque : nullptr, nOpaque, 3, e0, e1);
+        else
+            PrincipalAxisEndpoints(t, bTransparent ? opaque : nullptr, nOpaque, 3, e0, e1);
+
+        float fBestError = 3.4e38f;
+        const int nPasses = quality == BCQuality::Fast ? 1 : 3;
+        for (int nPass = 0; nPass < nPasses; nPass++)
+        {
+            uint16_t c0 = Pack565(e0), c1 = Pack565(e1);
+            // four color mode needs c0 > c1, three color mode c0 <= c1
+            if (bTransparent ? c0 > c1 : c0 < c1)
+            {
+                std::swap(c0, c1);
+                for (int c = 0; c < 3; c++)
+                    std::swap(e0[c], e1[c]);
+            }
+
+            int palette[4][4];
+            int nColors = GetBC1Palette(c0, c1, !bAllowTransparent, palette);
+            float paletteF[4][4];
+            for (int i = 0; i < 4; i++)
+            {
+                for (int c = 0; c < 4; c++)
+                    paletteF[i][c] = (float)palette[i][c];
+            }
+
+            UINT8 indices[16];
+            memset(indices, 3, sizeof(indices));
+            float fError = SelectIndices(t, bTransparent ? opaque : nullptr, nOpaque, paletteF, nColors, 3, indices);
+            if (fError < fBestError)
+            {
+                fBestError = fError;
+                bestC0 = c0;
+                bestC1 = c1;
+                memcpy(bestIndices, indices, sizeof(indices));
+            }
+            if (fError == 0.0f || nPass + 1 == nPasses)
+                break;
+
+            // fraction of the way from e0 to e1 for each index
+            static const float s_fourColor[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+            static const float s_threeColor[4] = {0.0f, 1.0f, 0.5f, 0.0f};
+            float weights[16];
+            for (int i = 0; i < 16; i++)
+            {
+                weights[i] = (nColors == 4 ? s_fourColor : s_threeColor)[indices[i]];
+            }
+            if (!FitEndpoints(t, bTransparent ? opaque : nullptr, nOpaque, weights, 3, e0, e1))
+                break;
+        }
+    }
+
+    uint32_t nIndexBits = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        nIndexBits |= (uint32_t)bestIndices[i] << (i * 2);
+    }
+    pBlock[0] = (UINT8)bestC0;
+    pBlock[1] = (UINT8)(bestC0 >> 8);
+    pBlock[2] = (UINT8)bestC1;
+    pBlock[3] = (UINT8)(bestC1 >> 8);
+    memcpy(pBlock + 4, &nIndexBits, 4);
+}
+
+static void DecodeColorBlock(const UINT8 *pBlock, bool bForceFourColor, UINT8 *pTexels)
+{
+    uint16_t c0 = (uint16_t)(pBlock[0] | (pBlock[1] << 8));
+    uint16_t c1 = (uint16_t)(pBlock[2] | (pBlock[3] << 8));
+    int palette[4][4];
+    GetBC1Palette(c0, c1, bForceFourColor, palette);
+    uint32_t nIndexBits;
+    memcpy(&nIndexBits, pBlock + 4, 4);
+    for (int i = 0; i < 16; i++)
+    {
+        const int *p = palette[(nIndexBits >> (i * 2)) & 3];
+        for (int c = 0; c < 4; c++)
+        {
+            pTexels[i * 4 + c] = (UINT8)p[c];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// BC3 alpha (the BC4 block)
+//-----------------------------------------------------------------------------
+static void GetAlphaPalette(int a0, int a1, int *pPalette)
+{
+    pPalette[0] = a0;
+    pPalette[1] = a1;
+    if (a0 > a1)
+    {
+        for (int i = 1; i < 7; i++)
+            pPalette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    }
+    else
+    {
+        for (int i = 1; i < 5; i++)
+            pPalette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        pPalette[6] = 0;
+        pPalette[7] = 255;
+    }
+}
+
+static int SelectAlphaIndices(const UINT8 *pTexels, int a0, int a1, UINT8 *pIndices)
+{
+    int palette[8];
+    GetAlphaPalette(a0, a1, palette);
+    int nError = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int a = pTexels[i * 4 + 3];
+        int nBest = 0, nBestError = 1 << 30;
+        for (int j = 0; j < 8; j++)
+        {
+            int d = (palette[j] - a) * (palette[j] - a);
+            if (d < nBestError)
+            {
+                nBestError = d;
+                nBest = j;
+            }
+        }
+        pIndices[i] = (UINT8)nBest;
+        nError += nBestError;
+    }
+    return nError;
+}
+
+static void EncodeAlphaBlock(const UINT8 *pTexels, BCQuality quality, UINT8 *pBlock)
+{
+    UINT8 mn[4], mx[4];
+    BlockMinMax(pTexels, mn, mx);
+
+    // eight interpolated values between max and min
+    int a0 = mx[3], a1 = mn[3];
+    UINT8 indices[16];
+    int nError = SelectAlphaIndices(pTexels, a0, a1, indices);
+
+    // six values between the inner extremes, with 0 and 255 exact
+    if (quality == BCQuality::Quality && nError > 0)
+    {
+        int nInnerMin = 255, nInnerMax = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int a = pTexels[i * 4 + 3];
+            if (a != 0 && a != 255)
+            {
+                nInnerMin = std::min(nInnerMin, a);
+                nInnerMax = std::max(nInnerMax, a);
+            }
+        }
+        if (nInnerMin > nInnerMax)
+            nInnerMin = nInnerMax = 0;
+        UINT8 innerIndices[16];
+        int nInnerError = SelectAlphaIndices(pTexels, nInnerMin, nInnerMax, innerIndices);
+        if (nInnerError < nError)
+        {
+            a0 = nInnerMin;
+            a1 = nInnerMax;
+            memcpy(indices, innerIndices, sizeof(indices));
+        }
+    }
+
+    uint64_t nIndexBits = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        nIndexBits |= (uint64_t)indices[i] << (i * 3);
+    }
+    pBlock[0] = (UINT8)a0;
+    pBlock[1] = (UINT8)a1;
+    for (int i = 0; i < 6; i++)
+    {
+        pBlock[2 + i] = (UINT8)(nIndexBits >> (i * 8));
+    }
+}
+
+static void DecodeAlphaBlock(const UINT8 *pBlock, UINT8 *pTexels)
+{
+    int palette[8];
+    GetAlphaPalette(pBlock[0], pBlock[1], palette);
+    uint64_t nIndexBits = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        nIndexBits |= (uint64_t)pBlock[2 + i] << (i * 8);
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        pTexels[i * 4 + 3] = (UINT8)palette[(nIndexBits >> (i * 3)) & 7];
+    }
+}
+
+//-----------------------------------------------------------------------------
+// BC7 mode 6: 7 bit RGBA endpoints plus one p-bit each, 16 entry palette
+//-----------------------------------------------------------------------------
+static const int s_bc7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct BitWriter
+{
+    uint64_t bits[2] = {0, 0};
+    int nPos = 0;
+
+    void Write(uint32_t nValue, int nBits)
+    {
+        for (int i = 0; i < nBits; i++, nPos++)
+        {
+            bits[nPos >> 6] |= (uint64_t)((nValue >> i) & 1) << (nPos & 63);
+        }
+    }
+};
+
+struct BitReader
+{
+    uint64_t bits[2];
+    int nPos = 0;
+
+    explicit BitReader(const UINT8 *pBlock) { memcpy(bits, pBlock, 16); }
+
+    uint32_t Read(int nBits)
+    {
+        uint32_t nValue = 0;
+        for (int i = 0; i < nBits; i++, nPos++)
+        {
+            nValue |= (uint32_t)((bits[nPos >> 6] >> (nPos & 63)) & 1) << i;
+        }
+        return nValue;
+    }
+};
+
+// 8 bit endpoint from a 7 bit value and its p-bit
+static int QuantizeMode6(float fValue, int nPBit)
+{
+    int q = (int)floorf((fValue - nPBit) * 0.5f + 0.5f);
+    return (std::min(std::max(q, 0), 127) << 1) | nPBit;
+}
+
+static float EvaluateMode6(const float (*t)[4], const float *e0, const float *e1, int p0, int p1,
+                           int *pQ0, int *pQ1, UINT8 *pIndices)
+{
+    float palette[16][4];
+    for (int c = 0; c < 4; c++)
+    {
+        pQ0[c] = QuantizeMode6(e0[c], p0);
+        pQ1[c] = QuantizeMode6(e1[c], p1);
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            palette[i][c] = (float)(((64 - s_bc7Weights4[i]) * pQ0[c] + s_bc7Weights4[i] * pQ1[c] + 32) >> 6);
+        }
+    }
+    return SelectIndices(t, nullptr, 16, palette, 16, 4, pIndices);
+}
+
+static void EncodeBlockBC7(const UINT8 *pTexels, BCQuality quality, UINT8 *pBlock)
+{
+    float t[16][4];
+    LoadTexelsFloat(pTexels, t);
+
+    float e0[4], e1[4];
+    if (quality == BCQuality::Fast)
+        BoxEndpoints(pTexels, t, nullptr, 16, 4, e0, e1);
+    else
+        PrincipalAxisEndpoints(t, nullptr, 16, 4, e0, e1);
+
+    // opaque blocks must stay exactly 255, which takes a p-bit of 1 on both ends
+    UINT8 mn[4], mx[4];
+    BlockMinMax(pTexels, mn, mx);
+    const bool bOpaque = mn[3] == 255;
+
+    float fBestError = 3.4e38f;
+    int bestQ0[4] = {}, bestQ1[4] = {};
+    UINT8 bestIndices[16] = {};
+    const int nPasses = quality == BCQuality::Fast ? 1 : 3;
+    for (int nPass = 0; nPass < nPasses; nPass++)
+    {
+        int q0[4], q1[4];
+        UINT8 indices[16];
+        float fError;
+        if (quality == BCQuality::Fast)
+        {
+            // p-bit that best fits each endpoint on its own
+            int p[2];
+            const float *ends[2] = {e0, e1};
+            for (int e = 0; e < 2; e++)
+            {
+                float fErr[2] = {0.0f, 0.0f};
+                for (int nPBit = 0; nPBit < 2; nPBit++)
+                {
+                    for (int c = 0; c < 4; c++)
+                    {
+                        float d = QuantizeMode6(ends[e][c], nPBit) - ends[e][c];
+                        fErr[nPBit] += d * d;
+                    }
+                }
+                p[e] = bOpaque || fErr[1] < fErr[0] ? 1 : 0;
+            }
+            fError = EvaluateMode6(t, e0, e1, p[0], p[1], q0, q1, indices);
+        }
+        else
+        {
+            // every p-bit combination against the whole block
+            fError = 3.4e38f;
+            for (int nCombo = bOpaque ? 3 : 0; nCombo < 4; nCombo++)
+            {
+                int c0[4], c1[4];
+                UINT8 comboIndices[16];
+                float fComboError = EvaluateMode6(t, e0, e1, nCombo & 1, nCombo >> 1, c0, c1, comboIndices);
+                if (fComboError < fError)
+                {
+                    fError = fComboError;
+                    memcpy(q0, c0, sizeof(q0));
+                    memcpy(q1, c1, sizeof(q1));
+                    memcpy(indices, comboIndices, sizeof(indices));
+                }
+            }
+        }
+        if (fError < fBestError)
+        {
+            fBestError = fError;
+            memcpy(bestQ0, q0, sizeof(q0));
+            memcpy(bestQ1, q1, sizeof(q1));
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if (fError == 0.0f || nPass + 1 == nPasses)
+            break;
+
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+        {
+            weights[i] = s_bc7Weights4[indices[i]] / 64.0f;
+        }
+        if (!FitEndpoints(t, nullptr, 16, weights, 4, e0, e1))
+            break;
+        if (bOpaque)
+            e0[3] = e1[3] = 255.0f;
+    }
+
+    // the anchor texel stores 3 index bits, so its top bit must be clear
+    if (bestIndices[0] & 8)
+    {
+        std::swap(bestQ0, bestQ1);
+        for (int i = 0; i < 16; i++)
+        {
+            bestIndices[i] = (UINT8)(15 - bestIndices[i]);
+        }
+    }
+
+    BitWriter writer;
+    writer.Write(1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        writer.Write(bestQ0[c] >> 1, 7);
+        writer.Write(bestQ1[c] >> 1, 7);
+    }
+    writer.Write(bestQ0[0] & 1, 1);
+    writer.Write(bestQ1[0] & 1, 1);
+    for (int i = 0; i < 16; i++)
+    {
+        writer.Write(bestIndices[i], i == 0 ? 3 : 4);
+    }
+    memcpy(pBlock, writer.bits, 16);
+}
+
+static void DecodeBlockBC7(const UINT8 *pBlock, UINT8 *pTexels)
+{
+    if ((pBlock[0] & 0x7f) != (1 << 6))
+    {
+        memset(pTexels, 0, 64);
+        return;
+    }
+
+    BitReader reader(pBlock);
+    reader.Read(7);
+    int q0[4], q1[4];
+    for (int c = 0; c < 4; c++)
+    {
+        q0[c] = reader.Read(7) << 1;
+        q1[c] = reader.Read(7) << 1;
+    }
+    int p0 = reader.Read(1), p1 = reader.Read(1);
+    for (int c = 0; c < 4; c++)
+    {
+        q0[c] |= p0;
+        q1[c] |= p1;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        int w = s_bc7Weights4[reader.Read(i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; c++)
+        {
+            pTexels[i * 4 + c] = (UINT8)(((64 - w) * q0[c] + w * q1[c] + 32) >> 6);
+        }
+    }
+}
+
+void EncodeBlockBC(const UINT8 *pTexels, BCFormat format, BCQuality quality, UINT8 *pBlock)
+{
+    switch (format)
+    {
+    case BCFormat::BC1:
+        EncodeColorBlock(pTexels, true, quality, pBlock);
+        break;
+    case BCFormat::BC3:
+        EncodeAlphaBlock(pTexels, quality, pBlock);
+        EncodeColorBlock(pTexels, false, quality, pBlock + 8);
+        break;
+    case BCFormat::BC7:
+        EncodeBlockBC7(pTexels, quality, pBlock);
+        break;
+    }
+}
+
+void DecodeBlockBC(const UINT8 *pBlock, BCFormat format, UINT8 *pTexels)
+{
+    switch (format)
+    {
+    case BCFormat::BC1:
+        DecodeColorBlock(pBlock, false, pTexels);
+        break;
+    case BCFormat::BC3:
+        DecodeColorBlock(pBlock + 8, true, pTexels);
+        DecodeAlphaBlock(pBlock, pTexels);
+        break;
+    case BCFormat::BC7:
+        DecodeBlockBC7(pBlock, pTexels);
+        break;
+    }
+}
+
+// 4x4 texels at block (bx, by), clamped to the image
+static void LoadBlock(const UINT8 *pSrc, int nWidth, int nHeight, size_t nPitch, int bx, int by, UINT8 *pTexels)
+{
+    for (int y = 0; y < 4; y++)
+    {
+        const UINT8 *pRow = pSrc + std::min(by * 4 + y, nHeight - 1) * nPitch;
+        if (bx * 4 + 4 <= nWidth)
+        {
+            memcpy(pTexels + y * 16, pRow + bx * 16, 16);
+            continue;
+        }
+        for (int x = 0; x < 4; x++)
+        {
+            memcpy(pTexels + y * 16 + x * 4, pRow + std::min(bx * 4 + x, nWidth - 1) * 4, 4);
+        }
+    }
+}
+
+static void EncodeBlockRows(const UINT8 *pSrc, int nWidth, int nHeight, size_t nSrcPitch,
+                            UINT8 *pDst, size_t nDstPitch, BCFormat format, BCQuality quality, int by0, int by1)
+{
+    const int nBlocksWide = (nWidth + 3) / 4;
+    const size_t nBlockBytes = GetBCBlockBytes(format);
+    UINT8 texels[64];
+    for (int by = by0; by < by1; by++)
+    {
+        UINT8 *pBlock = pDst + by * nDstPitch;
+        for (int bx = 0; bx < nBlocksWide; bx++, pBlock += nBlockBytes)
+        {
+            LoadBlock(pSrc, nWidth, nHeight, nSrcPitch, bx, by, texels);
+            EncodeBlockBC(texels, format, quality, pBlock);
+        }
+    }
+}
+
+void EncodeImageBC(const UINT8 *pSrc, int nWidth, int nHeight, size_t nSrcPitch,
+                   UINT8 *pDst, size_t nDstPitch, BCFormat format, BCQuality quality, WorkerPool *pWorkers)
+{
+    const int nBlocksHigh = (nHeight + 3) / 4;
+    if (!pWorkers || pWorkers->ThreadCount() <= 1 || nBlocksHigh < 2)
+    {
+        EncodeBlockRows(pSrc, nWidth, nHeight, nSrcPitch, pDst, nDstPitch, format, quality, 0, nBlocksHigh);
+        return;
+    }
+
+    // several bands per thread so uneven blocks balance out
+    const int nBands = std::min(nBlocksHigh, pWorkers->ThreadCount() * 4);
+    pWorkers->ParallelFor(nBands, [&](int nBand) {
+        int by0 = (int)((int64_t)nBlocksHigh * nBand / nBands);
+        int by1 = (int)((int64_t)nBlocksHigh * (nBand + 1) / nBands);
+        EncodeBlockRows(pSrc, nWidth, nHeight, nSrcPitch, pDst, nDstPitch, format, quality, by0, by1);
+    });
+}
+
+void DecodeImageBC(const UINT8 *pSrc, int nWidth, int nHeight, size_t nSrcPitch, BCFormat format,
+                   UINT8 *pDst, size_t nDstPitch)
+{
+    const size_t nBlockBytes = GetBCBlockBytes(format);
+    UINT8 texels[64];
+    for (int by = 0; by < (nHeight + 3) / 4; by++)
+    {
+        for (int bx = 0; bx < (nWidth + 3) / 4; bx++)
+        {
+            DecodeBlockBC(pSrc + by * nSrcPitch + bx * nBlockBytes, format, texels);
+            for (int y = 0; y < 4 && by * 4 + y < nHeight; y++)
+            {
+                int nCount = std::min(4, nWidth - bx * 4);
+                memcpy(pDst + (by * 4 + y) * nDstPitch + bx * 16, texels + y * 16, nCount * 4);
+            }
+        }
+    }
+}
+
+size_t ComputeMipChainLayoutBC(int nWidth, int nHeight, BCFormat format, MipLevelLayout *pLevels)
+{
+    int nLevels = GetMipChainLevelCount(nWidth, nHeight);
+    size_t nOffset = 0;
+    for (int i = 0; i < nLevels; i++)
+    {
+        MipLevelLayout &level = pLevels[i];
+        level.nOffset = (nOffset + MIP_PLACEMENT_ALIGNMENT - 1) & ~(MIP_PLACEMENT_ALIGNMENT - 1);
+        level.nWidth = nWidth;
+        level.nHeight = nHeight;
+        size_t nRowBytes = (size_t)((nWidth + 3) / 4) * GetBCBlockBytes(format);
+        level.nRowPitch = (nRowBytes + MIP_ROW_PITCH_ALIGNMENT - 1) & ~(MIP_ROW_PITCH_ALIGNMENT - 1);
+        nOffset = level.nOffset + level.nRowPitch * ((nHeight + 3) / 4);
+
+        nWidth = std::max(nWidth / 2, 1);
+        nHeight = std::max(nHeight / 2, 1);
+    }
+    return nOffset;
+}
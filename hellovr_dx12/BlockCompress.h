@@ -0,0 +1,54 @@
+#pragma once
+#include "GenMipMapRGBA.h"
+#include <stddef.h>
+
+// Block compressed formats, 4x4 texels per block
+enum class BCFormat
+{
+    BC1, // RGB + 1 bit alpha, 8 bytes
+    BC3, // RGB + interpolated alpha, 16 bytes
+    BC7, // RGBA, 16 bytes (mode 6)
+};
+
+enum class BCQuality
+{
+    Fast,    // bounding box endpoints, one index pass
+    Quality, // principal axis endpoints refined by least squares
+};
+
+const char *GetBCFormatName(BCFormat format);
+const char *GetBCQualityName(BCQuality quality);
+
+// 8 for BC1, 16 for BC3 and BC7
+size_t GetBCBlockBytes(BCFormat format);
+
+//-----------------------------------------------------------------------------
+// Purpose: Encode / decode a single block of 16 RGBA8 texels in row order.
+//          BC1 switches to its 3 color + transparent mode when a texel has
+//          alpha below 128. The BC7 encoder writes mode 6 (one subset, RGBA
+//          endpoints with p-bits, 4 bit indices) and the decoder reads the
+//          same mode; other BC7 modes decode to transparent black.
+//-----------------------------------------------------------------------------
+void EncodeBlockBC(const unsigned char *pTexels, BCFormat format, BCQuality quality, unsigned char *pBlock);
+void DecodeBlockBC(const unsigned char *pBlock, BCFormat format, unsigned char *pTexels);
+
+//-----------------------------------------------------------------------------
+// Purpose: Encode an RGBA8 image. Blocks past the right/bottom edge replicate
+//          the last column/row. nDstPitch is the byte distance between block
+//          rows, like the RowPitch of a D3D12 footprint. With pWorkers the
+//          block rows are split into bands that run in parallel.
+//-----------------------------------------------------------------------------
+void EncodeImageBC(const unsigned char *pSrc, int nWidth, int nHeight, size_t nSrcPitch,
+                   unsigned char *pDst, size_t nDstPitch, BCFormat format, BCQuality quality,
+                   class WorkerPool *pWorkers = nullptr);
+
+// Decode back to RGBA8, for round trip tests
+void DecodeImageBC(const unsigned char *pSrc, int nWidth, int nHeight, size_t nSrcPitch, BCFormat format,
+                   unsigned char *pDst, size_t nDstPitch);
+
+//-----------------------------------------------------------------------------
+// Purpose: ComputeMipChainLayoutRGBA for a block compressed chain. nRowPitch
+//          is the pitch of one row of blocks; nWidth / nHeight stay in texels.
+//          Returns the arena size in bytes.
+//-----------------------------------------------------------------------------
+size_t ComputeMipChainLayoutBC(int nWidth, int nHeight, BCFormat format, MipLevelLayout *pLevels);
@@ -12,16 +12,21 @@
 #include "Axis.h"
 #include "CompanionWindow.h"
 #include "Texture.h"
+#include "WorkerPool.h"
 
 using Microsoft::WRL::ComPtr;
 
 
-CMainApplication::CMainApplication(int msaa, float flSuperSampleScale, int iSceneVolumeInit)
-    : m_pipeline(new Pipeline(msaa)), m_texture(new Texture),
+CMainApplication::CMainApplication(int msaa, float flSuperSampleScale, int iSceneVolumeInit, int nWorkerThreads, const MipFilterOptions &mipFilter,
+                                   size_t nTextureStreamBudget, PoseModel posePrediction,
+                                   CubeMode cubeMode, float flCubeSpacing, bool bCullCubes, bool bOcclusionCulling)
+    : m_pipeline(new Pipeline(msaa)), m_texture(new Texture(mipFilter)),
       m_sdl(new SDLApplication),
-      m_hmd(new HMD), m_d3d(new DeviceRTV),
+      m_hmd(new HMD(posePrediction)), m_d3d(new DeviceRTV),
       m_cbv(new CBV),
-      m_models(new Models), m_axis(new Axis), m_cubes(new Cubes(iSceneVolumeInit)), m_companionWindow(new CompanionWindow(msaa, flSuperSampleScale)),
+      m_models(new Models(mipFilter)), m_axis(new Axis), m_cubes(new Cubes(iSceneVolumeInit, cubeMode, flCubeSpacing, bCullCubes, bOcclusionCulling)), m_companionWindow(new CompanionWindow(msaa, flSuperSampleScale)),
+      m_workers(new WorkerPool(nWorkerThreads)),
+      m_streamer(nTextureStreamBudget ? new TextureStreamer(nTextureStreamBudget) : nullptr),
       m_bShowCubes(true)
 {
 }
@@ -115,10 +120,10 @@ bool CMainApplication::Initialize(bool bDebugD3D12)
             return false;
         }
 
-        m_texture->SetupTexturemaps(m_d3d->Device(), pCommandList, m_cbv->CpuHandle(SRV_TEXTURE_MAP));
+        m_texture->SetupTexturemaps(m_d3d->Device(), pCommandList, m_cbv->CpuHandle(SRV_TEXTURE_MAP), m_workers.get(), m_streamer.get());
         if (m_hmd->Hmd())
         {
-            m_cubes->SetupScene(m_d3d->Device());
+            m_cubes->SetupScene(m_d3d->Device(), m_workers.get());
         }
         m_hmd->SetupCameras();
 
@@ -135,7 +140,13 @@ bool CMainApplication::Initialize(bool bDebugD3D12)
                                                     m_cbv->CpuHandle(SRV_RIGHT_EYE),
                                                     m_d3d->DSVHandle(RTVIndex_t::RTV_RIGHT_EYE));
 
-            m_models->SetupRenderModels(m_hmd.get(), m_d3d->Device(), m_cbv->Heap(), pCommandList);
+            m_models->SetupRenderModels(m_hmd.get(), m_d3d->Device(), m_cbv->Heap(), m_workers.get(), m_streamer.get());
+        }
+
+        // Only the small mips go in before the first frame, the rest stream in RunMainLoop
+        if (m_streamer)
+        {
+            m_streamer->UploadTails(pCommandList.Get());
         }
 
         // Do any work that was queued up during loading
@@ -194,6 +205,13 @@ void CMainApplication::RunMainLoop()
         bQuit = HandleInput(frame.m_pCommandList);
         frame.m_pCommandAllocator->Reset();
         frame.m_pCommandList->Reset(frame.m_pCommandAllocator.Get(), m_pipeline->SceneState().Get());
+        // Render models that finished loading upload on this frame's list
+        m_models->Update(frame.m_pCommandList);
+        if (m_streamer)
+        {
+            // RenderFrame syncs, so the previous frame no longer reads the SRVs this rewrites
+            m_streamer->Update(frame.m_pCommandList.Get());
+        }
         RenderFrame(frame.m_pCommandList, frame.m_pSwapChainRenderTarget);
     }
 }
@@ -207,12 +225,13 @@ void CMainApplication::ProcessVREvent(const vr::VREvent_t &event, const ComPtr<I
     {
     case vr::VREvent_TrackedDeviceActivated:
     {
-        m_models->SetupRenderModelForTrackedDevice(m_hmd.get(), m_d3d->Device(), m_cbv->Heap(), pCommandList, event.trackedDeviceIndex);
+        m_models->SetupRenderModelForTrackedDevice(m_hmd.get(), event.trackedDeviceIndex);
         dprintf("Device %u attached. Setting up render model.\n", event.trackedDeviceIndex);
     }
     break;
     case vr::VREvent_TrackedDeviceDeactivated:
     {
+        m_models->ReleaseRenderModelForTrackedDevice(event.trackedDeviceIndex);
         dprintf("Device %u detached.\n", event.trackedDeviceIndex);
     }
     break;
@@ -237,6 +256,11 @@ void CMainApplication::RenderFrame(const ComPtr<ID3D12GraphicsCommandList> &pCom
         pCommandList->SetGraphicsRootSignature(m_pipeline->RootSignature().Get());
         pCommandList->SetDescriptorHeaps(1, m_cbv->Heap().GetAddressOf());
 
+        m_hmd->PredictPoses();
+        if (m_bShowCubes)
+        {
+            m_cubes->BeginCull(m_hmd->GetCurrentViewProjectionMatrix(vr::Eye_Left), m_hmd->GetCurrentViewProjectionMatrix(vr::Eye_Right), m_workers.get());
+        }
         m_axis->UpdateControllerAxes(m_hmd.get(), m_d3d->Device());
 
         {
@@ -325,12 +349,8 @@ void CMainApplication::RenderScene(vr::Hmd_Eye nEye, const ComPtr<ID3D12Graphics
 {
     if (m_bShowCubes)
     {
-        // setup
-        pCommandList->SetPipelineState(m_pipeline->SceneState().Get());
-        // update constant buffer
+        // update constant buffer, the axis lines use it too
         m_cbv->Set(pCommandList, nEye, m_hmd->GetCurrentViewProjectionMatrix(nEye));
-        // draw
-        m_cubes->Draw(pCommandList);
     }
 
     bool bIsInputAvailable = m_hmd->Hmd()->IsInputAvailable();
@@ -356,8 +376,29 @@ void CMainApplication::RenderScene(vr::Hmd_Eye nEye, const ComPtr<ID3D12Graphics
         if (!bIsInputAvailable && m_hmd->Hmd()->GetTrackedDeviceClass(unTrackedDevice) == vr::TrackedDeviceClass_Controller)
             continue;
 
-        Matrix4 matMVP = m_hmd->GetCurrentViewProjectionMatrix(nEye) * m_hmd->DevicePose(unTrackedDevice);
+        Matrix4 matMVP = m_hmd->GetCurrentViewProjectionMatrix(nEye) * m_hmd->DevicePose(unTrackedDevice).ToMatrix4();
 
         m_models->Draw(pCommandList, nEye, unTrackedDevice, matMVP);
     }
+
+    if (m_bShowCubes)
+    {
+        // last, the cubes' cull runs on a worker while the rest is recorded
+        switch (m_cubes->Mode())
+        {
+        case CubeMode::Instanced:
+            pCommandList->SetPipelineState(m_pipeline->SceneInstancedState().Get());
+            break;
+        case CubeMode::Baked:
+            pCommandList->SetPipelineState(m_pipeline->SceneState().Get());
+            break;
+        case CubeMode::Meshed:
+            pCommandList->SetPipelineState(m_pipeline->SceneMeshedState().Get());
+            break;
+        }
+        // the render models bind their own tables
+        m_cbv->Set(pCommandList, nEye, m_hmd->GetCurrentViewProjectionMatrix(nEye));
+        // draw
+        m_cubes->Draw(pCommandList);
+    }
 }
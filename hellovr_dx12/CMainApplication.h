@@ -4,6 +4,9 @@
 #include <d3d12.h>
 #include <openvr.h>
 #include <memory>
+#include "CubeVolume.h"
+#include "GenMipMapRGBA.h"
+#include "PosePrediction.h"
 
 class CMainApplication
 {
@@ -13,6 +16,8 @@ class CMainApplication
     std::unique_ptr<class SDLApplication> m_sdl;
     std::unique_ptr<class HMD> m_hmd;
     std::unique_ptr<class DeviceRTV> m_d3d;
+    // outlives the textures registered with it, null when not streaming
+    std::unique_ptr<class TextureStreamer> m_streamer;
     std::unique_ptr<class Cubes> m_cubes;
     std::unique_ptr<class Models> m_models;
     std::unique_ptr<class Axis> m_axis;
@@ -20,10 +25,13 @@ class CMainApplication
     std::unique_ptr<class CompanionWindow> m_companionWindow;
     std::unique_ptr<class Pipeline> m_pipeline;
     std::unique_ptr<class Texture> m_texture;
+    std::unique_ptr<class WorkerPool> m_workers;
     bool m_bShowCubes = false;
 
 public:
-    CMainApplication(int msaa, float flSuperSampleScale, int volume);
+    CMainApplication(int msaa, float flSuperSampleScale, int volume, int nWorkerThreads, const MipFilterOptions &mipFilter,
+                     size_t nTextureStreamBudget = 0, PoseModel posePrediction = PoseModel::Hold,
+                     CubeMode cubeMode = CubeMode::Instanced, float flCubeSpacing = 4.0f, bool bCullCubes = true, bool bOcclusionCulling = true);
     virtual ~CMainApplication();
     bool Initialize(bool bDebugD3D12);
     void RunMainLoop();
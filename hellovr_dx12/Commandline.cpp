@@ -39,5 +39,110 @@ CommandLine::CommandLine(int argc, char *argv[])
             m_iSceneVolumeInit = atoi(argv[i + 1]);
             i++;
         }
+        else if (!_stricmp(argv[i], "-bakedcubes"))
+        {
+            m_cubeMode = CubeMode::Baked;
+        }
+        else if (!_stricmp(argv[i], "-meshedcubes"))
+        {
+            m_cubeMode = CubeMode::Meshed;
+        }
+        else if (!_stricmp(argv[i], "-cubespacing") && (argc > i + 1) && (*argv[i + 1] != '-'))
+        {
+            m_flCubeSpacing = (float)atof(argv[i + 1]);
+            i++;
+        }
+        else if (!_stricmp(argv[i], "-nocull"))
+        {
+            m_bCullCubes = false;
+        }
+        else if (!_stricmp(argv[i], "-noocclusion"))
+        {
+            m_bOcclusionCulling = false;
+        }
+        else if (!_stricmp(argv[i], "-mipfilter") && (argc > i + 1) && (*argv[i + 1] != '-'))
+        {
+            if (!_stricmp(argv[i + 1], "kaiser"))
+            {
+                m_mipFilter.filter = MipFilter::Kaiser;
+            }
+            else if (!_stricmp(argv[i + 1], "lanczos3"))
+            {
+                m_mipFilter.filter = MipFilter::Lanczos3;
+            }
+            else
+            {
+                m_mipFilter.filter = MipFilter::Box;
+            }
+            i++;
+        }
+        else if (!_stricmp(argv[i], "-srgbmips"))
+        {
+            m_mipFilter.bSRGB = true;
+        }
+        else if (!_stricmp(argv[i], "-premultipliedmips"))
+        {
+            m_mipFilter.bPremultipliedAlpha = true;
+        }
+        else if (!_stricmp(argv[i], "-cooktextures"))
+        {
+            m_bCookTextures = true;
+        }
+        else if (!_stricmp(argv[i], "-cookformat") && (argc > i + 1) && (*argv[i + 1] != '-'))
+        {
+            if (!_stricmp(argv[i + 1], "bc1"))
+            {
+                m_cookFormat = CookedFormat::BC1;
+            }
+            else if (!_stricmp(argv[i + 1], "bc3"))
+            {
+                m_cookFormat = CookedFormat::BC3;
+            }
+            else if (!_stricmp(argv[i + 1], "bc7"))
+            {
+                m_cookFormat = CookedFormat::BC7;
+            }
+            else
+            {
+                m_cookFormat = CookedFormat::RGBA8;
+            }
+            i++;
+        }
+        else if (!_stricmp(argv[i], "-cookquality") && (argc > i + 1) && (*argv[i + 1] != '-'))
+        {
+            m_cookQuality = !_stricmp(argv[i + 1], "quality") ? BCQuality::Quality : BCQuality::Fast;
+            i++;
+        }
+        else if (!_stricmp(argv[i], "-streamtextures"))
+        {
+            int nKilobytes = 1024;
+            if ((argc > i + 1) && (*argv[i + 1] != '-'))
+            {
+                nKilobytes = atoi(argv[i + 1]);
+                i++;
+            }
+            m_nTextureStreamBudget = (size_t)(nKilobytes > 0 ? nKilobytes : 1) * 1024;
+        }
+        else if (!_stricmp(argv[i], "-poseprediction") && (argc > i + 1) && (*argv[i + 1] != '-'))
+        {
+            if (!_stricmp(argv[i + 1], "velocity"))
+            {
+                m_posePrediction = PoseModel::ConstantVelocity;
+            }
+            else if (!_stricmp(argv[i + 1], "acceleration"))
+            {
+                m_posePrediction = PoseModel::ConstantAcceleration;
+            }
+            else
+            {
+                m_posePrediction = PoseModel::Hold;
+            }
+            i++;
+        }
+        else if (!_stricmp(argv[i], "-threads") && (argc > i + 1) && (*argv[i + 1] != '-'))
+        {
+            m_nWorkerThreads = atoi(argv[i + 1]);
+            i++;
+        }
     }
 }
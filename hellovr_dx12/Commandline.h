@@ -1,4 +1,8 @@
 #pragma once
+#include "CookedTexture.h"
+#include "CubeVolume.h"
+#include "GenMipMapRGBA.h"
+#include "PosePrediction.h"
 
 struct CommandLine
 {
@@ -13,4 +17,25 @@ struct CommandLine
     float m_flSuperSampleScale = 1.0f;
     // if you want something other than the default 20x20x20
     int m_iSceneVolumeInit = 20;
+    // bake every cube's triangles or mesh their visible faces instead of drawing one cube instanced (use -bakedcubes, -meshedcubes)
+    CubeMode m_cubeMode = CubeMode::Instanced;
+    // cubes from one corner to the next, 1 packs them solid (use -cubespacing)
+    float m_flCubeSpacing = 4.0f;
+    // draw every instanced cube instead of only the chunks in view (use -nocull)
+    bool m_bCullCubes = true;
+    // keep drawing chunks hidden behind the nearest cubes (use -noocclusion)
+    bool m_bOcclusionCulling = true;
+    // threads for texture loading work, 0 is one per core (use -threads)
+    int m_nWorkerThreads = 0;
+    // texture mip filtering (use -mipfilter box|kaiser|lanczos3, -srgbmips, -premultipliedmips)
+    MipFilterOptions m_mipFilter;
+    // write cooked textures for the current mip options and exit (use -cooktextures)
+    bool m_bCookTextures = false;
+    // cooked texture format and encoder preset (use -cookformat rgba8|bc1|bc3|bc7, -cookquality fast|quality)
+    CookedFormat m_cookFormat = CookedFormat::RGBA8;
+    BCQuality m_cookQuality = BCQuality::Fast;
+    // bytes of texture detail mips uploaded per frame after the tail, 0 uploads everything while loading (use -streamtextures [KB])
+    size_t m_nTextureStreamBudget = 0;
+    // extrapolate tracked poses to photon time (use -poseprediction none|velocity|acceleration)
+    PoseModel m_posePrediction = PoseModel::Hold;
 };
@@ -0,0 +1,201 @@
+#include "CookedTexture.h"
+#include "lodepng.h"
+#include <algorithm>
+#include <fstream>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <vector>
+
+// payload starts on a page so the mapping hands out well aligned subresources
+static const uint64_t COOKED_PAYLOAD_ALIGNMENT = 4096;
+
+std::string GetCookedTexturePath(const std::string &strSourcePath)
+{
+    size_t nDot = strSourcePath.find_last_of('.');
+    size_t nSlash = strSourcePath.find_last_of("/\\");
+    if (nDot == std::string::npos || (nSlash != std::string::npos && nDot < nSlash))
+        return strSourcePath + ".hvrtex";
+    return strSourcePath.substr(0, nDot) + ".hvrtex";
+}
+
+static bool IsBlockCompressed(CookedFormat format)
+{
+    return format != CookedFormat::RGBA8;
+}
+
+static BCFormat GetBCFormat(CookedFormat format)
+{
+    return format == CookedFormat::BC1 ? BCFormat::BC1 : format == CookedFormat::BC3 ? BCFormat::BC3 : BCFormat::BC7;
+}
+
+int GetCookedRows(CookedFormat format, int nHeight)
+{
+    return IsBlockCompressed(format) ? (nHeight + 3) / 4 : nHeight;
+}
+
+size_t GetCookedRowBytes(CookedFormat format, int nWidth)
+{
+    return IsBlockCompressed(format) ? (size_t)((nWidth + 3) / 4) * GetBCBlockBytes(GetBCFormat(format)) : (size_t)nWidth * 4;
+}
+
+static bool GetSourceStamp(const std::string &strPath, uint64_t *pSize, uint64_t *pTime)
+{
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(strPath.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(strPath.c_str(), &st) != 0)
+        return false;
+#endif
+    *pSize = (uint64_t)st.st_size;
+    *pTime = (uint64_t)st.st_mtime;
+    return true;
+}
+
+static uint32_t GetCookedFlags(const MipFilterOptions &options)
+{
+    return (options.bSRGB ? COOKED_TEXTURE_SRGB : 0) |
+           (options.bPremultipliedAlpha ? COOKED_TEXTURE_PREMULTIPLIED_ALPHA : 0);
+}
+
+bool CookTexture(const std::string &strSourcePath, const std::string &strCookedPath,
+                 const MipFilterOptions &options, CookedFormat format, BCQuality quality, WorkerPool *pWorkers)
+{
+    std::vector<unsigned char> imageRGBA;
+    unsigned nImageWidth, nImageHeight;
+    if (lodepng::decode(imageRGBA, nImageWidth, nImageHeight, strSourcePath) != 0)
+        return false;
+
+    // D3D12 wants whole blocks at the top level
+    if (IsBlockCompressed(format) && (nImageWidth % 4 != 0 || nImageHeight % 4 != 0))
+        return false;
+
+    CookedTextureHeader header = {};
+    header.nMagic = COOKED_TEXTURE_MAGIC;
+    header.nVersion = COOKED_TEXTURE_VERSION;
+    header.nWidth = nImageWidth;
+    header.nHeight = nImageHeight;
+    header.nMipLevels = GetMipChainLevelCount(nImageWidth, nImageHeight);
+    header.nFilter = (uint32_t)options.filter;
+    header.nFlags = GetCookedFlags(options);
+    header.nFormat = (uint32_t)format;
+    if (!GetSourceStamp(strSourcePath, &header.nSourceSize, &header.nSourceTime))
+        return false;
+
+    std::vector<MipLevelLayout> mipLevels(header.nMipLevels);
+    header.nPayloadSize = IsBlockCompressed(format)
+                              ? ComputeMipChainLayoutBC(nImageWidth, nImageHeight, GetBCFormat(format), &mipLevels[0])
+                              : ComputeMipChainLayoutRGBA(nImageWidth, nImageHeight, &mipLevels[0]);
+    size_t nTableSize = sizeof(CookedTextureHeader) + sizeof(CookedSubresource) * header.nMipLevels;
+    header.nPayloadOffset = (nTableSize + COOKED_PAYLOAD_ALIGNMENT - 1) & ~(COOKED_PAYLOAD_ALIGNMENT - 1);
+
+    // the whole file in memory, the chain is generated straight into its payload
+    std::vector<unsigned char> file((size_t)(header.nPayloadOffset + header.nPayloadSize));
+    memcpy(&file[0], &header, sizeof(header));
+    CookedSubresource *pSubresources = reinterpret_cast<CookedSubresource *>(&file[sizeof(header)]);
+    for (uint32_t nMip = 0; nMip < header.nMipLevels; nMip++)
+    {
+        pSubresources[nMip].nOffset = mipLevels[nMip].nOffset;
+        pSubresources[nMip].nWidth = mipLevels[nMip].nWidth;
+        pSubresources[nMip].nHeight = mipLevels[nMip].nHeight;
+        pSubresources[nMip].nRowPitch = (uint32_t)mipLevels[nMip].nRowPitch;
+        pSubresources[nMip].nReserved = 0;
+    }
+    unsigned char *pPayload = &file[(size_t)header.nPayloadOffset];
+    if (!IsBlockCompressed(format))
+    {
+        GenerateMipChainRGBA(&imageRGBA[0], nImageWidth * 4, pPayload, &mipLevels[0], (int)mipLevels.size(), options, pWorkers);
+    }
+    else
+    {
+        // build the RGBA8 chain first, then compress it level by level
+        std::vector<MipLevelLayout> rgbaLevels(header.nMipLevels);
+        std::vector<unsigned char> rgbaChain(ComputeMipChainLayoutRGBA(nImageWidth, nImageHeight, &rgbaLevels[0]));
+        GenerateMipChainRGBA(&imageRGBA[0], nImageWidth * 4, &rgbaChain[0], &rgbaLevels[0], (int)rgbaLevels.size(), options, pWorkers);
+        for (uint32_t nMip = 0; nMip < header.nMipLevels; nMip++)
+        {
+            const MipLevelLayout &src = rgbaLevels[nMip];
+            EncodeImageBC(&rgbaChain[src.nOffset], src.nWidth, src.nHeight, src.nRowPitch,
+                          pPayload + mipLevels[nMip].nOffset, mipLevels[nMip].nRowPitch, GetBCFormat(format), quality, pWorkers);
+        }
+    }
+
+    // a torn write is caught by the size check in CookedTexture::Open
+    std::ofstream out(strCookedPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&file[0]), (std::streamsize)file.size());
+    return out.good();
+}
+
+bool CookedTexture::Open(const std::string &strCookedPath, const std::string &strSourcePath, const MipFilterOptions &options)
+{
+    Close();
+    if (!m_file.Open(strCookedPath.c_str()))
+        return false;
+
+    const size_t nFileSize = m_file.Size();
+    const CookedTextureHeader *pHeader = reinterpret_cast<const CookedTextureHeader *>(m_file.Data());
+    if (nFileSize < sizeof(CookedTextureHeader) ||
+        pHeader->nMagic != COOKED_TEXTURE_MAGIC ||
+        pHeader->nVersion != COOKED_TEXTURE_VERSION ||
+        pHeader->nWidth == 0 || pHeader->nHeight == 0 ||
+        pHeader->nMipLevels != (uint32_t)GetMipChainLevelCount(pHeader->nWidth, pHeader->nHeight) ||
+        pHeader->nFormat > (uint32_t)CookedFormat::BC7 ||
+        sizeof(CookedTextureHeader) + sizeof(CookedSubresource) * (uint64_t)pHeader->nMipLevels > pHeader->nPayloadOffset ||
+        pHeader->nPayloadOffset > nFileSize ||
+        pHeader->nPayloadSize > nFileSize - pHeader->nPayloadOffset)
+    {
+        Close();
+        return false;
+    }
+
+    // cooked with other options: rebuild from the PNG rather than show the wrong filtering
+    if (pHeader->nFilter != (uint32_t)options.filter || pHeader->nFlags != GetCookedFlags(options))
+    {
+        Close();
+        return false;
+    }
+
+    uint64_t nSourceSize, nSourceTime;
+    if (GetSourceStamp(strSourcePath, &nSourceSize, &nSourceTime) &&
+        (nSourceSize != pHeader->nSourceSize || nSourceTime != pHeader->nSourceTime))
+    {
+        Close();
+        return false;
+    }
+
+    const CookedFormat format = (CookedFormat)pHeader->nFormat;
+    const CookedSubresource *pSubresources = reinterpret_cast<const CookedSubresource *>(m_file.Data() + sizeof(CookedTextureHeader));
+    for (uint32_t nMip = 0; nMip < pHeader->nMipLevels; nMip++)
+    {
+        const CookedSubresource &sub = pSubresources[nMip];
+        // the upload copies each level into a footprint sized from the header
+        if (sub.nWidth != std::max(1u, pHeader->nWidth >> nMip) || sub.nHeight != std::max(1u, pHeader->nHeight >> nMip))
+        {
+            Close();
+            return false;
+        }
+        uint64_t nRowBytes = GetCookedRowBytes(format, sub.nWidth);
+        uint64_t nRows = GetCookedRows(format, sub.nHeight);
+        if (sub.nRowPitch < nRowBytes ||
+            sub.nOffset > pHeader->nPayloadSize ||
+            sub.nRowPitch * (nRows - 1) + nRowBytes > pHeader->nPayloadSize - sub.nOffset)
+        {
+            Close();
+            return false;
+        }
+    }
+
+    m_pHeader = pHeader;
+    m_pSubresources = pSubresources;
+    return true;
+}
+
+void CookedTexture::Close()
+{
+    m_file.Close();
+    m_pHeader = nullptr;
+    m_pSubresources = nullptr;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "BlockCompress.h"
+#include "GenMipMapRGBA.h"
+#include "MappedFile.h"
+#include <stdint.h>
+#include <string>
+
+//-----------------------------------------------------------------------------
+// Cooked texture file: a header, one footprint per subresource and the RGBA8
+// payload exactly as ComputeMipChainLayoutRGBA / ComputeMipChainLayoutBC lay
+// it out (512 byte aligned subresources, 256 byte aligned rows). Loading it is a page fault bound copy
+// into the upload heap instead of a PNG decode plus mip generation.
+//-----------------------------------------------------------------------------
+const uint32_t COOKED_TEXTURE_MAGIC = 0x54525648; // "HVRT"
+const uint32_t COOKED_TEXTURE_VERSION = 2;
+const uint32_t COOKED_TEXTURE_SRGB = 1 << 0;
+const uint32_t COOKED_TEXTURE_PREMULTIPLIED_ALPHA = 1 << 1;
+
+// Payload format, block compressed formats keep the sRGB flag separately
+enum class CookedFormat : uint32_t
+{
+    RGBA8,
+    BC1,
+    BC3,
+    BC7,
+};
+
+struct CookedTextureHeader
+{
+    uint32_t nMagic;
+    uint32_t nVersion;
+    uint32_t nWidth;
+    uint32_t nHeight;
+    uint32_t nMipLevels;
+    uint32_t nFilter; // MipFilter the chain was built with
+    uint32_t nFlags;  // COOKED_TEXTURE_*
+    uint32_t nFormat; // CookedFormat
+    // size and modification time of the source PNG, a mismatch means the cook is stale
+    uint64_t nSourceSize;
+    uint64_t nSourceTime;
+    // payload position in the file, page aligned
+    uint64_t nPayloadOffset;
+    uint64_t nPayloadSize;
+};
+
+// Follows the header, nMipLevels entries
+struct CookedSubresource
+{
+    uint64_t nOffset; // from nPayloadOffset
+    uint32_t nWidth;  // in texels
+    uint32_t nHeight;
+    uint32_t nRowPitch; // per row of texels, or of blocks
+    uint32_t nReserved;
+};
+
+// Rows in a subresource and bytes used in each one
+int GetCookedRows(CookedFormat format, int nHeight);
+size_t GetCookedRowBytes(CookedFormat format, int nWidth);
+
+// cube_texture.png -> cube_texture.hvrtex, next to the PNG
+std::string GetCookedTexturePath(const std::string &strSourcePath);
+
+//-----------------------------------------------------------------------------
+// Purpose: Decode a PNG, build its mip chain with the given filter and write
+//          the cooked file, block compressing every level unless the format
+//          is RGBA8. Block compressed textures need a base size that is a
+//          multiple of 4.
+//-----------------------------------------------------------------------------
+bool CookTexture(const std::string &strSourcePath, const std::string &strCookedPath,
+                 const MipFilterOptions &options, CookedFormat format = CookedFormat::RGBA8,
+                 BCQuality quality = BCQuality::Fast, class WorkerPool *pWorkers = nullptr);
+
+///
+/// A mapped, validated cooked texture
+///
+class CookedTexture
+{
+    MappedFile m_file;
+    const CookedTextureHeader *m_pHeader = nullptr;
+    const CookedSubresource *m_pSubresources = nullptr;
+
+public:
+    //-----------------------------------------------------------------------------
+    // Purpose: Map strCookedPath. Fails when the file is missing, malformed,
+    //          cooked with other filter options or older than strSourcePath.
+    //          A missing source PNG is fine, the cooked file can ship alone.
+    //-----------------------------------------------------------------------------
+    bool Open(const std::string &strCookedPath, const std::string &strSourcePath, const MipFilterOptions &options);
+    void Close();
+
+    int Width() const { return (int)m_pHeader->nWidth; }
+    int Height() const { return (int)m_pHeader->nHeight; }
+    int MipLevels() const { return (int)m_pHeader->nMipLevels; }
+    bool IsSRGB() const { return (m_pHeader->nFlags & COOKED_TEXTURE_SRGB) != 0; }
+    CookedFormat Format() const { return (CookedFormat)m_pHeader->nFormat; }
+
+    // rows of texels for RGBA8, rows of blocks otherwise
+    int SubresourceRows(int nMip) const { return GetCookedRows(Format(), m_pSubresources[nMip].nHeight); }
+    size_t SubresourceRowBytes(int nMip) const { return GetCookedRowBytes(Format(), m_pSubresources[nMip].nWidth); }
+
+    const CookedSubresource &Subresource(int nMip) const { return m_pSubresources[nMip]; }
+    const unsigned char *SubresourceData(int nMip) const
+    {
+        return m_file.Data() + m_pHeader->nPayloadOffset + m_pSubresources[nMip].nOffset;
+    }
+};
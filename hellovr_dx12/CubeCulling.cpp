@@ -0,0 +1,388 @@
+#include "CubeCulling.h"
+#include "OcclusionCulling.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+Frustum::Frustum()
+{
+    for (int nPlane = 0; nPlane < 8; nPlane++)
+    {
+        SetPlane(nPlane, Vector4(0, 0, 0, 1));
+    }
+}
+
+void Frustum::SetPlane(int nPlane, const Vector4 &plane)
+{
+    m_nx[nPlane] = plane.x;
+    m_ny[nPlane] = plane.y;
+    m_nz[nPlane] = plane.z;
+    m_d[nPlane] = plane.w;
+}
+
+// Row i of a column major matrix
+static Vector4 Row(const Matrix4 &mat, int i)
+{
+    return Vector4(mat[i], mat[4 + i], mat[8 + i], mat[12 + i]);
+}
+
+// Scaled so the distance to the plane is in world units
+static Vector4 NormalizedPlane(const Vector4 &plane)
+{
+    float fLength = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+    return fLength > 0 ? plane / fLength : plane;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: left, right, bottom, top, near and far of a clip space
+//-----------------------------------------------------------------------------
+static void ClipPlanes(const Matrix4 &mat, Vector4 planes[6])
+{
+    Vector4 r0 = Row(mat, 0), r1 = Row(mat, 1), r2 = Row(mat, 2), r3 = Row(mat, 3);
+    planes[0] = NormalizedPlane(r3 + r0);
+    planes[1] = NormalizedPlane(r3 - r0);
+    planes[2] = NormalizedPlane(r3 + r1);
+    planes[3] = NormalizedPlane(r3 - r1);
+    planes[4] = NormalizedPlane(r2);
+    planes[5] = NormalizedPlane(r3 - r2);
+}
+
+Frustum Frustum::FromViewProjection(const Matrix4 &matViewProjection)
+{
+    Vector4 planes[6];
+    ClipPlanes(matViewProjection, planes);
+    Frustum frustum;
+    for (int nPlane = 0; nPlane < 6; nPlane++)
+    {
+        frustum.SetPlane(nPlane, planes[nPlane]);
+    }
+    return frustum;
+}
+
+Frustum Frustum::Enclosing(const Matrix4 &matLeft, const Matrix4 &matRight)
+{
+    // the corners of both frustums, clip space corners taken back to world
+    Vector3 corners[16];
+    const Matrix4 *rgEyes[2] = {&matLeft, &matRight};
+    for (int nEye = 0; nEye < 2; nEye++)
+    {
+        Matrix4 matInverse = *rgEyes[nEye];
+        matInverse.invertGeneral();
+        for (int nCorner = 0; nCorner < 8; nCorner++)
+        {
+            Vector4 clip((nCorner & 1) ? 1.0f : -1.0f, (nCorner & 2) ? 1.0f : -1.0f, (nCorner & 4) ? 1.0f : 0.0f, 1.0f);
+            Vector4 world = matInverse * clip;
+            corners[nEye * 8 + nCorner] = Vector3(world.x, world.y, world.z) / world.w;
+        }
+    }
+
+    Vector4 rgPlanes[2][6];
+    ClipPlanes(matLeft, rgPlanes[0]);
+    ClipPlanes(matRight, rgPlanes[1]);
+    Frustum frustum;
+    for (int nPlane = 0; nPlane < 6; nPlane++)
+    {
+        Vector4 best;
+        float fBestShift = FLT_MAX;
+        for (const auto &planes : rgPlanes)
+        {
+            float fShift = 0;
+            for (const Vector3 &corner : corners)
+            {
+                fShift = fmaxf(fShift, -(planes[nPlane].x * corner.x + planes[nPlane].y * corner.y + planes[nPlane].z * corner.z + planes[nPlane].w));
+            }
+            if (fShift < fBestShift)
+            {
+                fBestShift = fShift;
+                best = planes[nPlane];
+                best.w += fShift;
+            }
+        }
+        frustum.SetPlane(nPlane, best);
+    }
+    return frustum;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: per plane, the box corner furthest along the normal decides
+//          whether any of it is in front, the nearest whether all of it is.
+//          The SSE and scalar paths add in the same order.
+//-----------------------------------------------------------------------------
+Frustum::Classification Frustum::Classify(const AABB &box) const
+{
+    int nOutside = 0, nStraddling = 0;
+#if MATRICES_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 minX = _mm_set1_ps(box.vMin.x), minY = _mm_set1_ps(box.vMin.y), minZ = _mm_set1_ps(box.vMin.z);
+    const __m128 maxX = _mm_set1_ps(box.vMax.x), maxY = _mm_set1_ps(box.vMax.y), maxZ = _mm_set1_ps(box.vMax.z);
+    for (int nGroup = 0; nGroup < 8; nGroup += 4)
+    {
+        __m128 nx = _mm_load_ps(m_nx + nGroup), ny = _mm_load_ps(m_ny + nGroup), nz = _mm_load_ps(m_nz + nGroup);
+        __m128 d = _mm_load_ps(m_d + nGroup);
+        __m128 bx = _mm_cmpgt_ps(nx, zero), by = _mm_cmpgt_ps(ny, zero), bz = _mm_cmpgt_ps(nz, zero);
+        __m128 px = _mm_or_ps(_mm_and_ps(bx, maxX), _mm_andnot_ps(bx, minX));
+        __m128 py = _mm_or_ps(_mm_and_ps(by, maxY), _mm_andnot_ps(by, minY));
+        __m128 pz = _mm_or_ps(_mm_and_ps(bz, maxZ), _mm_andnot_ps(bz, minZ));
+        __m128 qx = _mm_or_ps(_mm_and_ps(bx, minX), _mm_andnot_ps(bx, maxX));
+        __m128 qy = _mm_or_ps(_mm_and_ps(by, minY), _mm_andnot_ps(by, maxY));
+        __m128 qz = _mm_or_ps(_mm_and_ps(bz, minZ), _mm_andnot_ps(bz, maxZ));
+        __m128 fFar = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, px), _mm_mul_ps(ny, py)), _mm_mul_ps(nz, pz)), d);
+        __m128 fNear = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, qx), _mm_mul_ps(ny, qy)), _mm_mul_ps(nz, qz)), d);
+        nOutside |= _mm_movemask_ps(_mm_cmplt_ps(fFar, zero));
+        nStraddling |= _mm_movemask_ps(_mm_cmplt_ps(fNear, zero));
+    }
+#else
+    for (int nPlane = 0; nPlane < 8; nPlane++)
+    {
+        float px = m_nx[nPlane] > 0 ? box.vMax.x : box.vMin.x, qx = m_nx[nPlane] > 0 ? box.vMin.x : box.vMax.x;
+        float py = m_ny[nPlane] > 0 ? box.vMax.y : box.vMin.y, qy = m_ny[nPlane] > 0 ? box.vMin.y : box.vMax.y;
+        float pz = m_nz[nPlane] > 0 ? box.vMax.z : box.vMin.z, qz = m_nz[nPlane] > 0 ? box.vMin.z : box.vMax.z;
+        float fFar = m_nx[nPlane] * px + m_ny[nPlane] * py + m_nz[nPlane] * pz + m_d[nPlane];
+        float fNear = m_nx[nPlane] * qx + m_ny[nPlane] * qy + m_nz[nPlane] * qz + m_d[nPlane];
+        nOutside |= fFar < 0;
+        nStraddling |= fNear < 0;
+    }
+#endif
+    if (nOutside)
+        return Outside;
+    return nStraddling ? Intersecting : Inside;
+}
+
+// Node nIndex of a level: x, y and z with their bits interleaved, x lowest
+static void MortonCoordinates(uint32_t nIndex, int &x, int &y, int &z)
+{
+    x = y = z = 0;
+    for (int nBit = 0; nBit < 10; nBit++)
+    {
+        x |= ((nIndex >> (3 * nBit)) & 1) << nBit;
+        y |= ((nIndex >> (3 * nBit + 1)) & 1) << nBit;
+        z |= ((nIndex >> (3 * nBit + 2)) & 1) << nBit;
+    }
+}
+
+static int ChunksAlong(int nCubes)
+{
+    return (nCubes + CubeChunkTree::k_nChunkSize - 1) / CubeChunkTree::k_nChunkSize;
+}
+
+CubeChunkTree::CubeChunkTree(const CubeVolume &volume)
+    : m_volume(volume), m_nChunksX(ChunksAlong(volume.Width())), m_nChunksY(ChunksAlong(volume.Height())),
+      m_nChunksZ(ChunksAlong(volume.Depth()))
+{
+    int nSide = 1;
+    while (nSide < m_nChunksX || nSide < m_nChunksY || nSide < m_nChunksZ)
+    {
+        nSide *= 2;
+    }
+
+    // chunks: the corners of their first and last cubes, the far one a cube further
+    std::vector<Node> chunks((size_t)nSide * nSide * nSide);
+    const float fScale = volume.Scale();
+    uint32_t nInstance = 0;
+    for (uint32_t nIndex = 0; nIndex < chunks.size(); nIndex++)
+    {
+        Node &node = chunks[nIndex];
+        node.bounds = {Vector3(FLT_MAX, FLT_MAX, FLT_MAX), Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX)};
+        node.nFirstInstance = nInstance;
+        node.nInstanceCount = 0;
+        node.nChunkCount = 0;
+
+        int x, y, z;
+        MortonCoordinates(nIndex, x, y, z);
+        if (x >= m_nChunksX || y >= m_nChunksY || z >= m_nChunksZ)
+            continue;
+        int x1 = std::min((x + 1) * k_nChunkSize, volume.Width());
+        int y1 = std::min((y + 1) * k_nChunkSize, volume.Height());
+        int z1 = std::min((z + 1) * k_nChunkSize, volume.Depth());
+        x *= k_nChunkSize;
+        y *= k_nChunkSize;
+        z *= k_nChunkSize;
+        Vector3 last = volume.CubeCorner(x1 - 1, y1 - 1, z1 - 1);
+        node.bounds = {volume.CubeCorner(x, y, z), Vector3(fScale + last.x, fScale + last.y, fScale + last.z)};
+        node.nInstanceCount = (uint32_t)((x1 - x) * (y1 - y) * (z1 - z));
+        node.nChunkCount = 1;
+        nInstance += node.nInstanceCount;
+    }
+    m_levels.push_back(std::move(chunks));
+
+    // each parent bounds its eight children
+    while (m_levels.back().size() > 1)
+    {
+        const std::vector<Node> &children = m_levels.back();
+        std::vector<Node> parents(children.size() / 8);
+        for (size_t nParent = 0; nParent < parents.size(); nParent++)
+        {
+            Node &parent = parents[nParent];
+            parent = children[nParent * 8];
+            for (int nChild = 1; nChild < 8; nChild++)
+            {
+                const Node &child = children[nParent * 8 + nChild];
+                parent.bounds.vMin = Vector3(std::min(parent.bounds.vMin.x, child.bounds.vMin.x), std::min(parent.bounds.vMin.y, child.bounds.vMin.y),
+                                             std::min(parent.bounds.vMin.z, child.bounds.vMin.z));
+                parent.bounds.vMax = Vector3(std::max(parent.bounds.vMax.x, child.bounds.vMax.x), std::max(parent.bounds.vMax.y, child.bounds.vMax.y),
+                                             std::max(parent.bounds.vMax.z, child.bounds.vMax.z));
+                parent.nInstanceCount += child.nInstanceCount;
+                parent.nChunkCount += child.nChunkCount;
+            }
+        }
+        m_levels.push_back(std::move(parents));
+    }
+}
+
+void CubeChunkTree::ChunkTranslations(uint32_t nChunk, float *pTranslations) const
+{
+    if (m_levels[0][nChunk].nInstanceCount == 0)
+        return;
+    int x0, y0, z0;
+    MortonCoordinates(nChunk, x0, y0, z0);
+    x0 *= k_nChunkSize;
+    y0 *= k_nChunkSize;
+    z0 *= k_nChunkSize;
+    int x1 = std::min(x0 + k_nChunkSize, m_volume.Width());
+    int y1 = std::min(y0 + k_nChunkSize, m_volume.Height());
+    int z1 = std::min(z0 + k_nChunkSize, m_volume.Depth());
+    for (int z = z0; z < z1; z++)
+    {
+        for (int y = y0; y < y1; y++)
+        {
+            for (int x = x0; x < x1; x++)
+            {
+                Vector3 corner = m_volume.CubeCorner(x, y, z);
+                *pTranslations++ = corner.x;
+                *pTranslations++ = corner.y;
+                *pTranslations++ = corner.z;
+            }
+        }
+    }
+}
+
+void CubeChunkTree::InstanceTranslations(float *pTranslations) const
+{
+    const std::vector<Node> &chunks = m_levels[0];
+    for (uint32_t nIndex = 0; nIndex < chunks.size(); nIndex++)
+    {
+        ChunkTranslations(nIndex, pTranslations + (size_t)chunks[nIndex].nFirstInstance * CubeVolume::k_nFloatsPerInstance);
+    }
+}
+
+static void AddDraw(const CubeChunkTree::Node &node, std::vector<CubeChunkTree::DrawRange> &draws, CubeChunkTree::Stats &stats)
+{
+    if (!draws.empty() && draws.back().nFirstInstance + draws.back().nInstanceCount == node.nFirstInstance)
+    {
+        draws.back().nInstanceCount += node.nInstanceCount;
+    }
+    else
+    {
+        draws.push_back({node.nFirstInstance, node.nInstanceCount});
+    }
+    stats.nChunksVisible += node.nChunkCount;
+    stats.nCubesVisible += node.nInstanceCount;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: a node's children need no frustum test once it is wholly inside.
+//          Without occlusion that subtree is one draw; with it the walk goes on
+//          down to the chunks, dropping whatever is hidden on the way. A box
+//          inside an occluded one is occluded too, so nothing is lost by not
+//          looking further.
+//-----------------------------------------------------------------------------
+void CubeChunkTree::CullNode(const Frustum &frustum, const StereoOcclusion *pOcclusion, int nLevel, uint32_t nIndex, bool bInside,
+                             std::vector<DrawRange> &draws, Stats &stats) const
+{
+    const Node &node = m_levels[nLevel][nIndex];
+    if (node.nInstanceCount == 0)
+        return;
+
+    if (!bInside)
+    {
+        stats.nNodesTested++;
+        Frustum::Classification classification = frustum.Classify(node.bounds);
+        if (classification == Frustum::Outside)
+            return;
+        bInside = classification == Frustum::Inside;
+    }
+    if (pOcclusion)
+    {
+        stats.nOcclusionTests++;
+        if (pOcclusion->IsOccluded(node.bounds))
+        {
+            // counting only what is in the frustum
+            CountNode(frustum, nLevel, nIndex, bInside, stats.nChunksOccluded, stats.nCubesOccluded);
+            return;
+        }
+    }
+    if (nLevel == 0 || (bInside && !pOcclusion))
+    {
+        AddDraw(node, draws, stats);
+        return;
+    }
+    for (uint32_t nChild = 0; nChild < 8; nChild++)
+    {
+        CullNode(frustum, pOcclusion, nLevel - 1, nIndex * 8 + nChild, bInside, draws, stats);
+    }
+}
+
+void CubeChunkTree::CountNode(const Frustum &frustum, int nLevel, uint32_t nIndex, bool bInside, int &nChunks, uint32_t &nCubes) const
+{
+    const Node &node = m_levels[nLevel][nIndex];
+    if (node.nInstanceCount == 0)
+        return;
+
+    if (!bInside)
+    {
+        Frustum::Classification classification = frustum.Classify(node.bounds);
+        if (classification == Frustum::Outside)
+            return;
+        bInside = classification == Frustum::Inside;
+    }
+    if (bInside || nLevel == 0)
+    {
+        nChunks += node.nChunkCount;
+        nCubes += node.nInstanceCount;
+        return;
+    }
+    for (uint32_t nChild = 0; nChild < 8; nChild++)
+    {
+        CountNode(frustum, nLevel - 1, nIndex * 8 + nChild, false, nChunks, nCubes);
+    }
+}
+
+void CubeChunkTree::Cull(const Frustum &frustum, std::vector<DrawRange> &draws, Stats &stats, const StereoOcclusion *pOcclusion) const
+{
+    draws.clear();
+    stats = Stats();
+    stats.nChunks = ChunkCount();
+    stats.nCubes = (uint32_t)m_volume.CubeCount();
+    CullNode(frustum, pOcclusion, LevelCount() - 1, 0, false, draws, stats);
+    stats.nDraws = (int)draws.size();
+}
+
+void CubeChunkTree::VisibleNode(const Frustum &frustum, int nLevel, uint32_t nIndex, bool bInside, std::vector<uint32_t> &chunks) const
+{
+    const Node &node = m_levels[nLevel][nIndex];
+    if (node.nInstanceCount == 0)
+        return;
+
+    if (!bInside)
+    {
+        Frustum::Classification classification = frustum.Classify(node.bounds);
+        if (classification == Frustum::Outside)
+            return;
+        bInside = classification == Frustum::Inside;
+    }
+    if (nLevel == 0)
+    {
+        chunks.push_back(nIndex);
+        return;
+    }
+    for (uint32_t nChild = 0; nChild < 8; nChild++)
+    {
+        VisibleNode(frustum, nLevel - 1, nIndex * 8 + nChild, bInside, chunks);
+    }
+}
+
+void CubeChunkTree::VisibleChunks(const Frustum &frustum, std::vector<uint32_t> &chunks) const
+{
+    chunks.clear();
+    VisibleNode(frustum, LevelCount() - 1, 0, false, chunks);
+}
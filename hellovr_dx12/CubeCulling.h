@@ -0,0 +1,120 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "CubeVolume.h"
+
+struct AABB
+{
+    Vector3 vMin;
+    Vector3 vMax;
+};
+
+///
+/// Six clip planes, a point is inside where n.p + d >= 0. Kept as four arrays
+/// of eight so a box is tested against four planes per SSE instruction; the
+/// last two planes always pass.
+///
+class Frustum
+{
+    alignas(16) float m_nx[8];
+    alignas(16) float m_ny[8];
+    alignas(16) float m_nz[8];
+    alignas(16) float m_d[8];
+
+public:
+    enum Classification
+    {
+        Outside,
+        Intersecting,
+        Inside,
+    };
+
+    // Everything inside
+    Frustum();
+    // The planes of a D3D clip space, -w <= x, y <= w and 0 <= z <= w
+    static Frustum FromViewProjection(const Matrix4 &matViewProjection);
+    // One frustum around both eyes: each plane of one eye pushed out until the
+    // other eye's frustum is behind it too, whichever eye's plane moves less
+    static Frustum Enclosing(const Matrix4 &matLeft, const Matrix4 &matRight);
+
+    Vector4 Plane(int nPlane) const { return Vector4(m_nx[nPlane], m_ny[nPlane], m_nz[nPlane], m_d[nPlane]); }
+    // Outside when the box is wholly behind one plane, inside when wholly in front of all
+    Classification Classify(const AABB &box) const;
+
+private:
+    void SetPlane(int nPlane, const Vector4 &plane);
+};
+
+///
+/// The instanced cube volume split into chunks of k_nChunkSize^3 cubes with
+/// an implicit octree over them. Level 0 holds the chunks in Morton order,
+/// padded to a power of two on each side; node i of level k has children
+/// 8i..8i+7 on level k-1. Instances are laid out in the same order, so every
+/// node's cubes are one contiguous instance range and a subtree wholly in
+/// the frustum is a single draw.
+///
+class CubeChunkTree
+{
+public:
+    static const int k_nChunkSize = 8;
+
+    struct Node
+    {
+        AABB bounds; // empty (min > max) for padding
+        uint32_t nFirstInstance;
+        uint32_t nInstanceCount;
+        uint32_t nChunkCount;
+    };
+
+    struct DrawRange
+    {
+        uint32_t nFirstInstance;
+        uint32_t nInstanceCount;
+    };
+
+    struct Stats
+    {
+        int nChunks = 0;
+        int nChunksVisible = 0;
+        int nNodesTested = 0;
+        uint32_t nCubes = 0;
+        uint32_t nCubesVisible = 0;
+        int nDraws = 0;
+        // in the frustum but hidden behind the occluders
+        int nOcclusionTests = 0;
+        int nChunksOccluded = 0;
+        uint32_t nCubesOccluded = 0;
+    };
+
+    explicit CubeChunkTree(const CubeVolume &volume);
+
+    // Each cube's corner, chunk by chunk in the order the ranges refer to
+    void InstanceTranslations(float *pTranslations) const;
+    // The part of InstanceTranslations for one chunk of level 0
+    void ChunkTranslations(uint32_t nChunk, float *pTranslations) const;
+
+    // Replaces chunks with the level 0 index of every non-empty chunk not outside the frustum
+    void VisibleChunks(const Frustum &frustum, std::vector<uint32_t> &chunks) const;
+
+    // Replaces draws with the visible instance ranges, adjacent ones merged.
+    // With occlusion, nodes hidden from both eyes are dropped as well.
+    void Cull(const Frustum &frustum, std::vector<DrawRange> &draws, Stats &stats, const class StereoOcclusion *pOcclusion = nullptr) const;
+
+    int LevelCount() const { return (int)m_levels.size(); }
+    const std::vector<Node> &Level(int nLevel) const { return m_levels[nLevel]; }
+    int ChunkCount() const { return m_nChunksX * m_nChunksY * m_nChunksZ; }
+    const CubeVolume &Volume() const { return m_volume; }
+
+private:
+    void CullNode(const Frustum &frustum, const StereoOcclusion *pOcclusion, int nLevel, uint32_t nIndex, bool bInside,
+                  std::vector<DrawRange> &draws, Stats &stats) const;
+    void CountNode(const Frustum &frustum, int nLevel, uint32_t nIndex, bool bInside, int &nChunks, uint32_t &nCubes) const;
+    void VisibleNode(const Frustum &frustum, int nLevel, uint32_t nIndex, bool bInside, std::vector<uint32_t> &chunks) const;
+
+    CubeVolume m_volume;
+    int m_nChunksX;
+    int m_nChunksY;
+    int m_nChunksZ;
+    // chunks first, the root last
+    std::vector<std::vector<Node>> m_levels;
+};
@@ -0,0 +1,196 @@
+#include "CubeVolume.h"
+#include "WorkerPool.h"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// Corner A-H of each of a cube's 36 vertices, bit 0 x, bit 1 y, bit 2 z, and its texcoord
+struct CubeVertex
+{
+    int nCorner;
+    float u, v;
+};
+
+enum
+{
+    A = 0, B = 1, C = 3, D = 2, E = 4, F = 5, G = 7, H = 6
+};
+
+// triangles instead of quads
+static const CubeVertex s_cubeVertices[CubeVolume::k_nVerticesPerCube] = {
+    {E, 0, 1}, {F, 1, 1}, {G, 1, 0}, {G, 1, 0}, {H, 0, 0}, {E, 0, 1}, //Front
+    {B, 0, 1}, {A, 1, 1}, {D, 1, 0}, {D, 1, 0}, {C, 0, 0}, {B, 0, 1}, //Back
+    {H, 0, 1}, {G, 1, 1}, {C, 1, 0}, {C, 1, 0}, {D, 0, 0}, {H, 0, 1}, //Top
+    {A, 0, 1}, {B, 1, 1}, {F, 1, 0}, {F, 1, 0}, {E, 0, 0}, {A, 0, 1}, //Bottom
+    {A, 0, 1}, {E, 1, 1}, {H, 1, 0}, {H, 1, 0}, {D, 0, 0}, {A, 0, 1}, //Left
+    {F, 0, 1}, {B, 1, 1}, {C, 1, 0}, {C, 1, 0}, {G, 0, 0}, {F, 0, 1}, //Right
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: one cube's 36 vertices with its near corner at (x, y, z). The far
+//          corner is fScale + x, exactly what the Matrix4 of a scale and a
+//          translation gives for a unit corner.
+//-----------------------------------------------------------------------------
+static void WriteCube(float *pOut, float fScale, float x, float y, float z)
+{
+    const float xs[2] = {0.0f + x, fScale + x};
+    const float ys[2] = {0.0f + y, fScale + y};
+    const float zs[2] = {0.0f + z, fScale + z};
+    for (const CubeVertex &vertex : s_cubeVertices)
+    {
+        pOut[0] = xs[vertex.nCorner & 1];
+        pOut[1] = ys[(vertex.nCorner >> 1) & 1];
+        pOut[2] = zs[vertex.nCorner >> 2];
+        pOut[3] = vertex.u;
+        pOut[4] = vertex.v;
+        pOut += CubeVolume::k_nFloatsPerVertex;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: copy a finished cube out past the cache. Nothing reads the vertices
+//          back, and plain stores would first read every line they fill.
+//-----------------------------------------------------------------------------
+static void StreamCube(float *pOut, const float *pCube)
+{
+    const size_t nFloats = CubeVolume::k_nVerticesPerCube * CubeVolume::k_nFloatsPerVertex;
+#if MATRICES_SSE
+    if (((uintptr_t)pOut & 15) == 0)
+    {
+        for (size_t i = 0; i < nFloats; i += 4)
+        {
+            _mm_stream_ps(pOut + i, _mm_loadu_ps(pCube + i));
+        }
+        return;
+    }
+#endif
+    memcpy(pOut, pCube, sizeof(float) * nFloats);
+}
+
+// Only x changes along a row: the rest of the cube is written once per row
+static void MoveCubeX(float *pCube, float fScale, float x)
+{
+    const float xs[2] = {0.0f + x, fScale + x};
+    for (const CubeVertex &vertex : s_cubeVertices)
+    {
+        pCube[0] = xs[vertex.nCorner & 1];
+        pCube += CubeVolume::k_nFloatsPerVertex;
+    }
+}
+
+CubeVolume::CubeVolume(int nWidth, int nHeight, int nDepth, float fScale, float fSpacing)
+    : m_nWidth(nWidth), m_nHeight(nHeight), m_nDepth(nDepth), m_fScale(fScale), m_fSpacing(fSpacing)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: create a sea of cubes
+//
+// The volume used to be built by chaining a translate onto a Matrix4 for
+// every cube, and the corners carry that chain's rounding. Only the
+// translation column changes along the chain, and each step adds the same
+// scaled offset, so the chain is replayed as float adds in the same order:
+// once up front to find where each z slice starts, then per slice in
+// parallel. The output is bit for bit what the matrices gave.
+//-----------------------------------------------------------------------------
+void CubeVolume::BakeVertices(float *pVertices, WorkerPool *pWorkers) const
+{
+    if (CubeCount() == 0)
+        return;
+
+    // scale * translate(base), then * translate(spacing) per cube, back along
+    // x per row and back along y per slice
+    const float fStep = m_fScale * m_fSpacing;
+    const float fRowBack = m_fScale * (-((float)m_nWidth) * m_fSpacing);
+    const float fSliceBack = m_fScale * (-((float)m_nHeight) * m_fSpacing);
+    float x = m_fScale * (-((float)m_nWidth * m_fSpacing) / 2.f);
+    float y = m_fScale * (-((float)m_nHeight * m_fSpacing) / 2.f);
+    float z = m_fScale * (-((float)m_nDepth * m_fSpacing) / 2.f);
+
+    struct SliceStart
+    {
+        float x, y, z;
+    };
+    std::vector<SliceStart> starts(m_nDepth);
+    for (int nSlice = 0; nSlice < m_nDepth; nSlice++)
+    {
+        starts[nSlice] = {x, y, z};
+        for (int nRow = 0; nRow < m_nHeight; nRow++)
+        {
+            for (int nCube = 0; nCube < m_nWidth; nCube++)
+            {
+                x = fStep + x;
+            }
+            x = fRowBack + x;
+            y = fStep + y;
+        }
+        y = fSliceBack + y;
+        z = fStep + z;
+    }
+
+    const size_t nSliceFloats = (size_t)m_nWidth * m_nHeight * k_nVerticesPerCube * k_nFloatsPerVertex;
+    auto bakeSlice = [&](int nSlice) {
+        float *pOut = pVertices + nSliceFloats * nSlice;
+        float x = starts[nSlice].x, y = starts[nSlice].y;
+        const float z = starts[nSlice].z;
+        for (int nRow = 0; nRow < m_nHeight; nRow++)
+        {
+            // built in cache and copied out whole, the upload heap is write combined
+            float cube[k_nVerticesPerCube * k_nFloatsPerVertex];
+            WriteCube(cube, m_fScale, x, y, z);
+            for (int nCube = 0; nCube < m_nWidth; nCube++)
+            {
+                MoveCubeX(cube, m_fScale, x);
+                StreamCube(pOut, cube);
+                pOut += k_nVerticesPerCube * k_nFloatsPerVertex;
+                x = fStep + x;
+            }
+            x = fRowBack + x;
+            y = fStep + y;
+        }
+#if MATRICES_SSE
+        _mm_sfence();
+#endif
+    };
+    if (pWorkers)
+    {
+        pWorkers->ParallelFor(m_nDepth, bakeSlice);
+    }
+    else
+    {
+        for (int nSlice = 0; nSlice < m_nDepth; nSlice++)
+        {
+            bakeSlice(nSlice);
+        }
+    }
+}
+
+void CubeVolume::UnitCubeVertices(float pVertices[k_nVerticesPerCube * k_nFloatsPerVertex]) const
+{
+    WriteCube(pVertices, m_fScale, 0, 0, 0);
+}
+
+Vector3 CubeVolume::CubeCorner(int x, int y, int z) const
+{
+    // the same origin as the baked volume, scaled with the cube
+    return Vector3(m_fScale * (-((float)m_nWidth * m_fSpacing) / 2.f + x * m_fSpacing),
+                   m_fScale * (-((float)m_nHeight * m_fSpacing) / 2.f + y * m_fSpacing),
+                   m_fScale * (-((float)m_nDepth * m_fSpacing) / 2.f + z * m_fSpacing));
+}
+
+void CubeVolume::InstanceTranslations(float *pTranslations) const
+{
+    for (int z = 0; z < m_nDepth; z++)
+    {
+        for (int y = 0; y < m_nHeight; y++)
+        {
+            for (int x = 0; x < m_nWidth; x++)
+            {
+                Vector3 corner = CubeCorner(x, y, z);
+                *pTranslations++ = corner.x;
+                *pTranslations++ = corner.y;
+                *pTranslations++ = corner.z;
+            }
+        }
+    }
+}
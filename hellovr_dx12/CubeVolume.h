@@ -0,0 +1,55 @@
+#pragma once
+#include <stddef.h>
+#include "Matrices.h"
+
+// How Cubes draws the volume
+enum class CubeMode
+{
+    Instanced, // one cube's triangles, once per cube
+    Baked,     // every cube's triangles in one vertex list
+    Meshed,    // the cubes as voxels, each chunk's visible faces merged
+};
+
+///
+/// The grid of cubes the scene draws, without any D3D12. Either every cube's
+/// triangles are baked into one vertex list, or one cube's triangles are
+/// shared and each cube is an instance translation.
+///
+class CubeVolume
+{
+    int m_nWidth;
+    int m_nHeight;
+    int m_nDepth;
+    float m_fScale;
+    float m_fSpacing;
+
+public:
+    static const int k_nVerticesPerCube = 36;
+    // position then texcoord
+    static const int k_nFloatsPerVertex = 5;
+    // one translation per instance
+    static const int k_nFloatsPerInstance = 3;
+
+    CubeVolume(int nWidth, int nHeight, int nDepth, float fScale = 0.3f, float fSpacing = 4.0f);
+    int Width() const { return m_nWidth; }
+    int Height() const { return m_nHeight; }
+    int Depth() const { return m_nDepth; }
+    int CubeCount() const { return m_nWidth * m_nHeight * m_nDepth; }
+    // Edge length of a cube
+    float Scale() const { return m_fScale; }
+    // Distance from one cube's corner to the next, in cubes
+    float Spacing() const { return m_fSpacing; }
+    // Near corner of cube (x, y, z), its instance translation
+    Vector3 CubeCorner(int x, int y, int z) const;
+
+    size_t BakedFloatCount() const { return (size_t)CubeCount() * k_nVerticesPerCube * k_nFloatsPerVertex; }
+    // Every cube's triangles in tracking space, x fastest then y then z, written
+    // straight to pVertices (BakedFloatCount() floats, may be mapped upload
+    // memory). Slices of z run on pWorkers when given.
+    void BakeVertices(float *pVertices, class WorkerPool *pWorkers = nullptr) const;
+
+    // One cube's triangles with its corner at the origin
+    void UnitCubeVertices(float pVertices[k_nVerticesPerCube * k_nFloatsPerVertex]) const;
+    // Each cube's corner, in the same order as BakeVertices
+    void InstanceTranslations(float *pTranslations) const;
+};
@@ -1,133 +1,229 @@
 #include "Cubes.h"
 #include "d3dx12.h"
+#include "VoxelMesh.h"
+#include "WorkerPool.h"
+#include "dprintf.h"
+#include <chrono>
+#include <string.h>
+
+Cubes::Cubes(int iSceneVolumeInit, CubeMode mode, float fSpacing, bool bCull, bool bOcclusion)
+    : m_volume(iSceneVolumeInit, iSceneVolumeInit, iSceneVolumeInit, 0.3f, fSpacing), m_mode(mode), m_bCull(bCull), m_tree(m_volume),
+      m_pOcclusion(mode == CubeMode::Instanced && bCull && bOcclusion ? new StereoOcclusion : nullptr)
+{
+}
 
-Cubes::Cubes(int iSceneVolumeInit)
+Cubes::~Cubes()
 {
-    // cube array
-    m_iSceneVolumeWidth = iSceneVolumeInit;
-    m_iSceneVolumeHeight = iSceneVolumeInit;
-    m_iSceneVolumeDepth = iSceneVolumeInit;
+    FinishCull();
 }
 
 //-----------------------------------------------------------------------------
 // Purpose: create a sea of cubes
 //-----------------------------------------------------------------------------
-void Cubes::SetupScene(const ComPtr<ID3D12Device> &device)
+void Cubes::SetupScene(const ComPtr<ID3D12Device> &device, WorkerPool *pWorkers)
 {
-    std::vector<float> vertdataarray;
-
-    Matrix4 matScale;
-    matScale.scale(m_fScale, m_fScale, m_fScale);
-    Matrix4 matTransform;
-    matTransform.translate(
-        -((float)m_iSceneVolumeWidth * m_fScaleSpacing) / 2.f,
-        -((float)m_iSceneVolumeHeight * m_fScaleSpacing) / 2.f,
-        -((float)m_iSceneVolumeDepth * m_fScaleSpacing) / 2.f);
-
-    Matrix4 mat = matScale * matTransform;
-
-    for (int z = 0; z < m_iSceneVolumeDepth; z++)
+    auto start = std::chrono::steady_clock::now();
+
+    // instanced: the shared cube then one translation per cube
+    const size_t nCubeFloats = CubeVolume::k_nVerticesPerCube * CubeVolume::k_nFloatsPerVertex;
+    size_t nVertexBytes, nBufferBytes;
+    UINT nVertexStride = sizeof(VertexDataScene);
+    UINT nInstanceStride = sizeof(float) * CubeVolume::k_nFloatsPerInstance;
+    // meshed: the chunks with faces, their vertices then their placements
+    std::vector<std::vector<uint32_t>> chunkVertices;
+    std::vector<int> meshedChunks;
+    std::vector<VoxelVolume::ChunkPlacement> placements;
+    if (m_mode == CubeMode::Instanced)
+    {
+        m_uiVertcount = CubeVolume::k_nVerticesPerCube;
+        nVertexBytes = sizeof(float) * nCubeFloats;
+        nBufferBytes = nVertexBytes + sizeof(float) * CubeVolume::k_nFloatsPerInstance * m_volume.CubeCount();
+    }
+    else if (m_mode == CubeMode::Meshed)
     {
-        for (int y = 0; y < m_iSceneVolumeHeight; y++)
+        VoxelVolume voxels = VoxelVolume::FromCubes(m_volume);
+        voxels.MeshChunks(chunkVertices, pWorkers);
+        m_uiVertcount = 0;
+        m_meshedDraws.clear();
+        for (int nChunk = 0; nChunk < voxels.ChunkCount(); nChunk++)
         {
-            for (int x = 0; x < m_iSceneVolumeWidth; x++)
-            {
-                AddCubeToScene(mat, vertdataarray);
-                mat = mat * Matrix4().translate(m_fScaleSpacing, 0, 0);
-            }
-            mat = mat * Matrix4().translate(-((float)m_iSceneVolumeWidth) * m_fScaleSpacing, m_fScaleSpacing, 0);
+            if (chunkVertices[nChunk].empty())
+                continue;
+            m_meshedDraws.push_back({m_uiVertcount, (UINT)chunkVertices[nChunk].size()});
+            m_uiVertcount += (UINT)chunkVertices[nChunk].size();
+            meshedChunks.push_back(nChunk);
+            placements.push_back(voxels.Placement(nChunk));
         }
-        mat = mat * Matrix4().translate(0, -((float)m_iSceneVolumeHeight) * m_fScaleSpacing, m_fScaleSpacing);
+        nVertexStride = sizeof(uint32_t);
+        nInstanceStride = sizeof(VoxelVolume::ChunkPlacement);
+        nVertexBytes = sizeof(uint32_t) * m_uiVertcount;
+        nBufferBytes = nVertexBytes + sizeof(VoxelVolume::ChunkPlacement) * placements.size();
+    }
+    else
+    {
+        m_uiVertcount = (UINT)(m_volume.CubeCount() * CubeVolume::k_nVerticesPerCube);
+        nVertexBytes = sizeof(float) * m_volume.BakedFloatCount();
+        nBufferBytes = nVertexBytes;
     }
-    m_uiVertcount = (UINT)vertdataarray.size() / 5;
+    if (nBufferBytes == 0)
+        return;
 
     device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
                                     D3D12_HEAP_FLAG_NONE,
-                                    &CD3DX12_RESOURCE_DESC::Buffer(sizeof(float) * vertdataarray.size()),
+                                    &CD3DX12_RESOURCE_DESC::Buffer(nBufferBytes),
                                     D3D12_RESOURCE_STATE_GENERIC_READ,
                                     nullptr,
                                     IID_PPV_ARGS(&m_pSceneVertexBuffer));
 
-    UINT8 *pMappedBuffer;
+    // written in place, the upload heap is write combined so nothing reads it back
+    float *pMappedBuffer;
     CD3DX12_RANGE readRange(0, 0);
     m_pSceneVertexBuffer->Map(0, &readRange, reinterpret_cast<void **>(&pMappedBuffer));
-    memcpy(pMappedBuffer, &vertdataarray[0], sizeof(float) * vertdataarray.size());
+    if (m_mode == CubeMode::Instanced)
+    {
+        m_volume.UnitCubeVertices(pMappedBuffer);
+        if (m_bCull)
+        {
+            m_tree.InstanceTranslations(pMappedBuffer + nCubeFloats);
+        }
+        else
+        {
+            m_volume.InstanceTranslations(pMappedBuffer + nCubeFloats);
+        }
+    }
+    else if (m_mode == CubeMode::Meshed)
+    {
+        uint32_t *pVertices = reinterpret_cast<uint32_t *>(pMappedBuffer);
+        for (size_t nDraw = 0; nDraw < m_meshedDraws.size(); nDraw++)
+        {
+            memcpy(pVertices + m_meshedDraws[nDraw].nFirstVertex, chunkVertices[meshedChunks[nDraw]].data(),
+                   sizeof(uint32_t) * m_meshedDraws[nDraw].nVertexCount);
+        }
+        memcpy(pVertices + m_uiVertcount, placements.data(), sizeof(VoxelVolume::ChunkPlacement) * placements.size());
+    }
+    else
+    {
+        m_volume.BakeVertices(pMappedBuffer, pWorkers);
+    }
     m_pSceneVertexBuffer->Unmap(0, nullptr);
 
     m_sceneVertexBufferView.BufferLocation = m_pSceneVertexBuffer->GetGPUVirtualAddress();
-    m_sceneVertexBufferView.StrideInBytes = sizeof(VertexDataScene);
-    m_sceneVertexBufferView.SizeInBytes = (UINT)(sizeof(float) * vertdataarray.size());
+    m_sceneVertexBufferView.StrideInBytes = nVertexStride;
+    m_sceneVertexBufferView.SizeInBytes = (UINT)nVertexBytes;
+
+    m_sceneInstanceBufferView.BufferLocation = m_sceneVertexBufferView.BufferLocation + nVertexBytes;
+    m_sceneInstanceBufferView.StrideInBytes = nInstanceStride;
+    m_sceneInstanceBufferView.SizeInBytes = (UINT)(nBufferBytes - nVertexBytes);
+
+    static const char *s_modeNames[] = {"instanced", "baked", "meshed"};
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    dprintf("%d cubes %s: %.1f KB vertex buffer, %u triangles, built in %.1f ms\n", m_volume.CubeCount(), s_modeNames[(int)m_mode],
+            nBufferBytes / 1024.0, m_mode == CubeMode::Instanced ? m_volume.CubeCount() * 12u : m_uiVertcount / 3, elapsed.count());
 }
 
-void Cubes::Draw(const ComPtr<ID3D12GraphicsCommandList> &pCommandList)
+//-----------------------------------------------------------------------------
+// Purpose: one frustum around both eyes, so both eyes draw the same ranges.
+//          Started before the frame is recorded and waited for only when the
+//          cubes are, which RenderScene leaves until last.
+//-----------------------------------------------------------------------------
+void Cubes::BeginCull(const Matrix4 &matLeft, const Matrix4 &matRight, WorkerPool *pWorkers)
 {
-    pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    pCommandList->IASetVertexBuffers(0, 1, &m_sceneVertexBufferView);
-    pCommandList->DrawInstanced(m_uiVertcount, 1, 0, 0);
+    if (!IsCulled())
+        return;
+
+    FinishCull();
+    m_matCullLeft = matLeft;
+    m_matCullRight = matRight;
+    m_bCullDone = false;
+    m_pCullClaimed = std::make_shared<std::atomic<bool>>(false);
+    if (!pWorkers)
+    {
+        FinishCull();
+        return;
+    }
+    // the claim is shared so a task still queued after the cull ran here never touches this
+    pWorkers->Submit([this, pWorkers, pClaimed = m_pCullClaimed]() {
+        if (!pClaimed->exchange(true))
+        {
+            RunCull(pWorkers);
+        }
+    });
 }
 
-void Cubes::AddCubeToScene(Matrix4 mat, std::vector<float> &vertdata)
+void Cubes::FinishCull()
 {
-    // Matrix4 mat( outermat.data() );
-
-    Vector4 A = mat * Vector4(0, 0, 0, 1);
-    Vector4 B = mat * Vector4(1, 0, 0, 1);
-    Vector4 C = mat * Vector4(1, 1, 0, 1);
-    Vector4 D = mat * Vector4(0, 1, 0, 1);
-    Vector4 E = mat * Vector4(0, 0, 1, 1);
-    Vector4 F = mat * Vector4(1, 0, 1, 1);
-    Vector4 G = mat * Vector4(1, 1, 1, 1);
-    Vector4 H = mat * Vector4(0, 1, 1, 1);
-
-    // triangles instead of quads
-    AddCubeVertex(E.x, E.y, E.z, 0, 1, vertdata); //Front
-    AddCubeVertex(F.x, F.y, F.z, 1, 1, vertdata);
-    AddCubeVertex(G.x, G.y, G.z, 1, 0, vertdata);
-    AddCubeVertex(G.x, G.y, G.z, 1, 0, vertdata);
-    AddCubeVertex(H.x, H.y, H.z, 0, 0, vertdata);
-    AddCubeVertex(E.x, E.y, E.z, 0, 1, vertdata);
-
-    AddCubeVertex(B.x, B.y, B.z, 0, 1, vertdata); //Back
-    AddCubeVertex(A.x, A.y, A.z, 1, 1, vertdata);
-    AddCubeVertex(D.x, D.y, D.z, 1, 0, vertdata);
-    AddCubeVertex(D.x, D.y, D.z, 1, 0, vertdata);
-    AddCubeVertex(C.x, C.y, C.z, 0, 0, vertdata);
-    AddCubeVertex(B.x, B.y, B.z, 0, 1, vertdata);
-
-    AddCubeVertex(H.x, H.y, H.z, 0, 1, vertdata); //Top
-    AddCubeVertex(G.x, G.y, G.z, 1, 1, vertdata);
-    AddCubeVertex(C.x, C.y, C.z, 1, 0, vertdata);
-    AddCubeVertex(C.x, C.y, C.z, 1, 0, vertdata);
-    AddCubeVertex(D.x, D.y, D.z, 0, 0, vertdata);
-    AddCubeVertex(H.x, H.y, H.z, 0, 1, vertdata);
-
-    AddCubeVertex(A.x, A.y, A.z, 0, 1, vertdata); //Bottom
-    AddCubeVertex(B.x, B.y, B.z, 1, 1, vertdata);
-    AddCubeVertex(F.x, F.y, F.z, 1, 0, vertdata);
-    AddCubeVertex(F.x, F.y, F.z, 1, 0, vertdata);
-    AddCubeVertex(E.x, E.y, E.z, 0, 0, vertdata);
-    AddCubeVertex(A.x, A.y, A.z, 0, 1, vertdata);
-
-    AddCubeVertex(A.x, A.y, A.z, 0, 1, vertdata); //Left
-    AddCubeVertex(E.x, E.y, E.z, 1, 1, vertdata);
-    AddCubeVertex(H.x, H.y, H.z, 1, 0, vertdata);
-    AddCubeVertex(H.x, H.y, H.z, 1, 0, vertdata);
-    AddCubeVertex(D.x, D.y, D.z, 0, 0, vertdata);
-    AddCubeVertex(A.x, A.y, A.z, 0, 1, vertdata);
-
-    AddCubeVertex(F.x, F.y, F.z, 0, 1, vertdata); //Right
-    AddCubeVertex(B.x, B.y, B.z, 1, 1, vertdata);
-    AddCubeVertex(C.x, C.y, C.z, 1, 0, vertdata);
-    AddCubeVertex(C.x, C.y, C.z, 1, 0, vertdata);
-    AddCubeVertex(G.x, G.y, G.z, 0, 0, vertdata);
-    AddCubeVertex(F.x, F.y, F.z, 0, 1, vertdata);
+    // the workers may all be busy loading textures
+    if (m_pCullClaimed && !m_pCullClaimed->exchange(true))
+    {
+        RunCull(nullptr);
+    }
+    std::unique_lock<std::mutex> lock(m_cullMutex);
+    m_cullDone.wait(lock, [this]() { return m_bCullDone; });
 }
 
-void Cubes::AddCubeVertex(float fl0, float fl1, float fl2, float fl3, float fl4, std::vector<float> &vertdata)
+void Cubes::RunCull(WorkerPool *pWorkers)
 {
-    vertdata.push_back(fl0);
-    vertdata.push_back(fl1);
-    vertdata.push_back(fl2);
-    vertdata.push_back(fl3);
-    vertdata.push_back(fl4);
+    auto start = std::chrono::steady_clock::now();
+    Frustum frustum = Frustum::Enclosing(m_matCullLeft, m_matCullRight);
+    if (m_pOcclusion)
+    {
+        m_pOcclusion->Render(m_tree, frustum, m_matCullLeft, m_matCullRight, pWorkers);
+    }
+    auto rendered = std::chrono::steady_clock::now();
+    m_tree.Cull(frustum, m_draws, m_cullStats, m_pOcclusion.get());
+    auto end = std::chrono::steady_clock::now();
+    m_fOcclusionMilliseconds = std::chrono::duration<double, std::milli>(rendered - start).count();
+    m_fCullMilliseconds = std::chrono::duration<double, std::milli>(end - rendered).count();
+
+    if (start - m_lastCullReport >= std::chrono::seconds(1))
+    {
+        m_lastCullReport = start;
+        dprintf("cubes: %u of %u drawn, %u in view occluded, %d of %d chunks in view, %d draws, %.3f ms occluders, %.3f ms cull\n",
+                m_cullStats.nCubesVisible, m_cullStats.nCubes, m_cullStats.nCubesOccluded, m_cullStats.nChunksVisible + m_cullStats.nChunksOccluded,
+                m_cullStats.nChunks, m_cullStats.nDraws, m_fOcclusionMilliseconds, m_fCullMilliseconds);
+    }
+
+    // notified under the lock, FinishCull in the destructor may return the moment it is released
+    std::lock_guard<std::mutex> lock(m_cullMutex);
+    m_bCullDone = true;
+    m_cullDone.notify_all();
+}
+
+void Cubes::Draw(const ComPtr<ID3D12GraphicsCommandList> &pCommandList)
+{
+    if (!m_pSceneVertexBuffer)
+        return;
+
+    pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    if (m_mode == CubeMode::Instanced)
+    {
+        D3D12_VERTEX_BUFFER_VIEW views[] = {m_sceneVertexBufferView, m_sceneInstanceBufferView};
+        pCommandList->IASetVertexBuffers(0, 2, views);
+        if (IsCulled())
+        {
+            FinishCull();
+            for (const CubeChunkTree::DrawRange &draw : m_draws)
+            {
+                pCommandList->DrawInstanced(m_uiVertcount, draw.nInstanceCount, 0, draw.nFirstInstance);
+            }
+        }
+        else
+        {
+            pCommandList->DrawInstanced(m_uiVertcount, m_volume.CubeCount(), 0, 0);
+        }
+    }
+    else if (m_mode == CubeMode::Meshed)
+    {
+        D3D12_VERTEX_BUFFER_VIEW views[] = {m_sceneVertexBufferView, m_sceneInstanceBufferView};
+        pCommandList->IASetVertexBuffers(0, 2, views);
+        for (UINT nDraw = 0; nDraw < (UINT)m_meshedDraws.size(); nDraw++)
+        {
+            pCommandList->DrawInstanced(m_meshedDraws[nDraw].nVertexCount, 1, m_meshedDraws[nDraw].nFirstVertex, nDraw);
+        }
+    }
+    else
+    {
+        pCommandList->IASetVertexBuffers(0, 1, &m_sceneVertexBufferView);
+        pCommandList->DrawInstanced(m_uiVertcount, 1, 0, 0);
+    }
 }
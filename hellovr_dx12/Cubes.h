@@ -1,22 +1,50 @@
 #pragma once
 #include <d3d12.h>
 #include <wrl/client.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <vector>
-#include "Matrices.h"
+#include "OcclusionCulling.h"
 
 class Cubes
 {
     template <class T>
     using ComPtr = Microsoft::WRL::ComPtr<T>;
 
-    int m_iSceneVolumeWidth;
-    int m_iSceneVolumeHeight;
-    int m_iSceneVolumeDepth;
-    float m_fScaleSpacing = 4.0f;
-    float m_fScale = 0.3f;
+    CubeVolume m_volume;
+    // one shared cube drawn once per cube, every cube's triangles baked, or the visible faces merged
+    CubeMode m_mode;
+    // instances laid out chunk by chunk, only the ranges in view drawn
+    bool m_bCull;
+    CubeChunkTree m_tree;
+    // hidden chunks dropped too, against the nearest chunks drawn on the CPU
+    std::unique_ptr<StereoOcclusion> m_pOcclusion;
+    std::vector<CubeChunkTree::DrawRange> m_draws;
+    CubeChunkTree::Stats m_cullStats;
+    double m_fOcclusionMilliseconds = 0;
+    double m_fCullMilliseconds = 0;
+    std::chrono::steady_clock::time_point m_lastCullReport;
+    // a cull started on the workers, run by whoever claims it first
+    Matrix4 m_matCullLeft;
+    Matrix4 m_matCullRight;
+    std::shared_ptr<std::atomic<bool>> m_pCullClaimed;
+    std::mutex m_cullMutex;
+    std::condition_variable m_cullDone;
+    bool m_bCullDone = true;
     unsigned int m_uiVertcount = 0;
+    // meshed: a draw per chunk with any faces, its placement the instance of the same index
+    struct MeshedChunkDraw
+    {
+        UINT nFirstVertex;
+        UINT nVertexCount;
+    };
+    std::vector<MeshedChunkDraw> m_meshedDraws;
     ComPtr<ID3D12Resource> m_pSceneVertexBuffer;
     D3D12_VERTEX_BUFFER_VIEW m_sceneVertexBufferView;
+    D3D12_VERTEX_BUFFER_VIEW m_sceneInstanceBufferView;
     struct VertexDataScene
     {
         Vector3 position;
@@ -24,14 +52,22 @@ class Cubes
     };
 
 public:
-    Cubes(int iSceneVolumeInit);
+    Cubes(int iSceneVolumeInit, CubeMode mode = CubeMode::Instanced, float fSpacing = 4.0f, bool bCull = true, bool bOcclusion = true);
+    ~Cubes();
+    CubeMode Mode() const { return m_mode; }
+    bool IsInstanced() const { return m_mode == CubeMode::Instanced; }
+    bool IsCulled() const { return IsInstanced() && m_bCull; }
     //-----------------------------------------------------------------------------
     // Purpose: create a sea of cubes
     //-----------------------------------------------------------------------------
-    void SetupScene(const ComPtr<ID3D12Device> &device);
+    void SetupScene(const ComPtr<ID3D12Device> &device, class WorkerPool *pWorkers = nullptr);
+    // Start finding the chunks either eye can see for this frame's draws, on a worker when there is one
+    void BeginCull(const Matrix4 &matLeft, const Matrix4 &matRight, class WorkerPool *pWorkers = nullptr);
+    // Waits for the cull started last, or runs it here if no worker has yet
+    void FinishCull();
+    const CubeChunkTree::Stats &CullStats() const { return m_cullStats; }
     void Draw(const ComPtr<ID3D12GraphicsCommandList> &pCommandList);
 
 private:
-    void AddCubeToScene(Matrix4 mat, std::vector<float> &vertdata);
-    void AddCubeVertex(float fl0, float fl1, float fl2, float fl3, float fl4, std::vector<float> &vertdata);
+    void RunCull(class WorkerPool *pWorkers);
 };
@@ -1,58 +1,1006 @@
 #include "GenMipMapRGBA.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
 typedef unsigned char UINT8;
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIP_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MIP_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MIP_TARGET(x) __attribute__((target(x)))
+#else
+#define MIP_TARGET(x)
+#endif
+
+// Box filter one destination row from two source rows. Every source texel
+// pair read is in bounds: the caller handles 1 texel wide/high images.
+typedef void (*MipRowFunc)(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth);
+
+static void DownsampleRow_Scalar(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth)
+{
+    for (int x = 0; x < nDstWidth; x++)
+    {
+        const UINT8 *p0 = pRow0 + x * 8;
+        const UINT8 *p1 = pRow1 + x * 8;
+        for (int c = 0; c < 4; c++)
+        {
+            pDst[x * 4 + c] = (UINT8)((p0[c] + p0[c + 4] + p1[c] + p1[c + 4] + 2) >> 2);
+        }
+    }
+}
+
+#if MIP_X86
+static bool CpuHasAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    // OSXSAVE and AVX, then check the OS saves the YMM state
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+        return false;
+    if ((_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
 //-----------------------------------------------------------------------------
-// Purpose: generate next level mipmap for an RGBA image
+// Purpose: sum 4 source texels per row into 2 destination texels (16 bit lanes)
 //-----------------------------------------------------------------------------
-void GenMipMapRGBA(const UINT8 *pSrc, UINT8 **ppDst, int nSrcWidth, int nSrcHeight, int *pDstWidthOut, int *pDstHeightOut)
+MIP_TARGET("sse2")
+static inline __m128i SumQuad_SSE2(const UINT8 *pRow0, const UINT8 *pRow1)
 {
-    *pDstWidthOut = nSrcWidth / 2;
-    if (*pDstWidthOut <= 0)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i r0 = _mm_loadu_si128((const __m128i *)pRow0);
+    __m128i r1 = _mm_loadu_si128((const __m128i *)pRow1);
+    // vertical sum: texels 0,1 in lo, texels 2,3 in hi
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero));
+    // horizontal sum: (0 + 1), (2 + 3)
+    return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+}
+
+MIP_TARGET("sse2")
+static void DownsampleRow_SSE2(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth)
+{
+    const __m128i round = _mm_set1_epi16(2);
+    int x = 0;
+    for (; x + 4 <= nDstWidth; x += 4)
     {
-        *pDstWidthOut = 1;
+        __m128i a = _mm_srli_epi16(_mm_add_epi16(SumQuad_SSE2(pRow0, pRow1), round), 2);
+        __m128i b = _mm_srli_epi16(_mm_add_epi16(SumQuad_SSE2(pRow0 + 16, pRow1 + 16), round), 2);
+        _mm_storeu_si128((__m128i *)pDst, _mm_packus_epi16(a, b));
+        pRow0 += 32;
+        pRow1 += 32;
+        pDst += 16;
     }
-    *pDstHeightOut = nSrcHeight / 2;
-    if (*pDstHeightOut <= 0)
+    DownsampleRow_Scalar(pRow0, pRow1, pDst, nDstWidth - x);
+}
+
+MIP_TARGET("avx2")
+static inline __m256i SumOct_AVX2(const UINT8 *pRow0, const UINT8 *pRow1)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)pRow0);
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)pRow1);
+    // per 128 bit lane: lo = texels 0,1 | 4,5 and hi = texels 2,3 | 6,7
+    __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(r0, zero), _mm256_unpacklo_epi8(r1, zero));
+    __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(r0, zero), _mm256_unpackhi_epi8(r1, zero));
+    // (0 + 1), (2 + 3) | (4 + 5), (6 + 7): already in destination order
+    return _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+}
+
+MIP_TARGET("avx2")
+static void DownsampleRow_AVX2(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth)
+{
+    const __m256i round = _mm256_set1_epi16(2);
+    int x = 0;
+    for (; x + 8 <= nDstWidth; x += 8)
     {
-        *pDstHeightOut = 1;
+        __m256i a = _mm256_srli_epi16(_mm256_add_epi16(SumOct_AVX2(pRow0, pRow1), round), 2);
+        __m256i b = _mm256_srli_epi16(_mm256_add_epi16(SumOct_AVX2(pRow0 + 32, pRow1 + 32), round), 2);
+        // packus interleaves the 128 bit lanes, put the 64 bit quarters back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)pDst, packed);
+        pRow0 += 64;
+        pRow1 += 64;
+        pDst += 32;
     }
+    DownsampleRow_SSE2(pRow0, pRow1, pDst, nDstWidth - x);
+}
+#endif
 
-    *ppDst = new UINT8[4 * (*pDstWidthOut) * (*pDstHeightOut)];
-    for (int y = 0; y < *pDstHeightOut; y++)
+#if MIP_NEON
+static void DownsampleRow_NEON(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth)
+{
+    int x = 0;
+    for (; x + 4 <= nDstWidth; x += 4)
+    {
+        uint8x16_t a0 = vld1q_u8(pRow0);
+        uint8x16_t a1 = vld1q_u8(pRow1);
+        uint8x16_t b0 = vld1q_u8(pRow0 + 16);
+        uint8x16_t b1 = vld1q_u8(pRow1 + 16);
+        // vertical sums, two texels per register
+        uint16x8_t s0 = vaddl_u8(vget_low_u8(a0), vget_low_u8(a1));
+        uint16x8_t s1 = vaddl_u8(vget_high_u8(a0), vget_high_u8(a1));
+        uint16x8_t s2 = vaddl_u8(vget_low_u8(b0), vget_low_u8(b1));
+        uint16x8_t s3 = vaddl_u8(vget_high_u8(b0), vget_high_u8(b1));
+        // horizontal sums
+        uint16x8_t q01 = vcombine_u16(vadd_u16(vget_low_u16(s0), vget_high_u16(s0)),
+                                      vadd_u16(vget_low_u16(s1), vget_high_u16(s1)));
+        uint16x8_t q23 = vcombine_u16(vadd_u16(vget_low_u16(s2), vget_high_u16(s2)),
+                                      vadd_u16(vget_low_u16(s3), vget_high_u16(s3)));
+        // rounding narrow: (sum + 2) >> 2
+        vst1q_u8(pDst, vcombine_u8(vrshrn_n_u16(q01, 2), vrshrn_n_u16(q23, 2)));
+        pRow0 += 32;
+        pRow1 += 32;
+        pDst += 16;
+    }
+    DownsampleRow_Scalar(pRow0, pRow1, pDst, nDstWidth - x);
+}
+#endif
+
+bool IsMipKernelSupported(MipKernel kernel)
+{
+    switch (kernel)
+    {
+    case MipKernel::Auto:
+    case MipKernel::Scalar:
+        return true;
+#if MIP_X86
+    case MipKernel::SSE2:
+        return true;
+    case MipKernel::AVX2:
+    {
+        static const bool s_bAVX2 = CpuHasAVX2();
+        return s_bAVX2;
+    }
+#endif
+#if MIP_NEON
+    case MipKernel::NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+MipKernel GetBestMipKernel()
+{
+    if (IsMipKernelSupported(MipKernel::AVX2))
+        return MipKernel::AVX2;
+    if (IsMipKernelSupported(MipKernel::SSE2))
+        return MipKernel::SSE2;
+    if (IsMipKernelSupported(MipKernel::NEON))
+        return MipKernel::NEON;
+    return MipKernel::Scalar;
+}
+
+const char *GetMipKernelName(MipKernel kernel)
+{
+    switch (kernel)
+    {
+    case MipKernel::Auto:
+        return "auto";
+    case MipKernel::Scalar:
+        return "scalar";
+    case MipKernel::SSE2:
+        return "sse2";
+    case MipKernel::AVX2:
+        return "avx2";
+    case MipKernel::NEON:
+        return "neon";
+    }
+    return "unknown";
+}
+
+static MipKernel ResolveMipKernel(MipKernel kernel)
+{
+    if (kernel == MipKernel::Auto || !IsMipKernelSupported(kernel))
+    {
+        static const MipKernel s_best = GetBestMipKernel();
+        return s_best;
+    }
+    return kernel;
+}
+
+static MipRowFunc GetMipRowFunc(MipKernel kernel)
+{
+    switch (ResolveMipKernel(kernel))
+    {
+#if MIP_X86
+    case MipKernel::SSE2:
+        return DownsampleRow_SSE2;
+    case MipKernel::AVX2:
+        return DownsampleRow_AVX2;
+#endif
+#if MIP_NEON
+    case MipKernel::NEON:
+        return DownsampleRow_NEON;
+#endif
+    default:
+        return DownsampleRow_Scalar;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: one destination row from source rows 2y and 2y + 1
+//-----------------------------------------------------------------------------
+void DownsampleRowRGBA(const UINT8 *pRow0, const UINT8 *pRow1, int nSrcWidth, UINT8 *pDst, MipKernel kernel)
+{
+    if (nSrcWidth == 1)
+    {
+        // a column: clamp the horizontal pair to the single texel
+        for (int c = 0; c < 4; c++)
+        {
+            pDst[c] = (UINT8)((2 * pRow0[c] + 2 * pRow1[c] + 2) >> 2);
+        }
+        return;
+    }
+    GetMipRowFunc(kernel)(pRow0, pRow1, pDst, nSrcWidth / 2);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 2x2 box filter an RGBA8 image into the next mip level
+//-----------------------------------------------------------------------------
+void DownsampleRGBA(const UINT8 *pSrc, int nSrcWidth, int nSrcHeight, size_t nSrcPitch,
+                    UINT8 *pDst, size_t nDstPitch, MipKernel kernel)
+{
+    int nDstHeight = std::max(nSrcHeight / 2, 1);
+    for (int y = 0; y < nDstHeight; y++)
+    {
+        const UINT8 *pRow0 = pSrc + (y * 2) * nSrcPitch;
+        const UINT8 *pRow1 = pSrc + std::min(y * 2 + 1, nSrcHeight - 1) * nSrcPitch;
+        DownsampleRowRGBA(pRow0, pRow1, nSrcWidth, pDst + y * nDstPitch, kernel);
+    }
+}
+
+const char *GetMipFilterName(MipFilter filter)
+{
+    switch (filter)
+    {
+    case MipFilter::Box:
+        return "box";
+    case MipFilter::Kaiser:
+        return "kaiser";
+    case MipFilter::Lanczos3:
+        return "lanczos3";
+    }
+    return "unknown";
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Byte <-> linear light tables. Linear values are fixed point scaled
+//          to 4095 * 8, so the sum of a 2x2 block shifted right by 5 indexes
+//          the 4096 entry encode table directly, and a value times an alpha
+//          is one signed 16 bit multiply (pmaddwd). Both tables are read 32
+//          bits at a time by the AVX2 gathers: the decode table is widened to
+//          32 bit entries and the encode table padded by 3 bytes.
+//-----------------------------------------------------------------------------
+static const int LINEAR_ONE = 4095 * 8;
+
+struct ColorTables
+{
+    uint32_t toLinear[256];
+    float toLinearF[256];
+    UINT8 fromLinear[4096 + 3] = {};
+
+    explicit ColorTables(bool bSRGB)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            double c = i / 255.0;
+            double l = bSRGB ? (c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4)) : c;
+            toLinear[i] = (uint32_t)(l * LINEAR_ONE + 0.5);
+            toLinearF[i] = (float)l;
+        }
+        for (int i = 0; i < 4096; i++)
+        {
+            double l = i / 4095.0;
+            double c = bSRGB ? (l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055) : l;
+            fromLinear[i] = (UINT8)(c * 255.0 + 0.5);
+        }
+    }
+};
+
+static const ColorTables &GetColorTables(bool bSRGB)
+{
+    static const ColorTables s_linear(false);
+    static const ColorTables s_srgb(true);
+    return bSRGB ? s_srgb : s_linear;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 2x2 box filter in linear light, optionally alpha weighted. The
+//          kernels below must match this bit for bit, so the alpha weighted
+//          average is one correctly rounded float divide, (num / nAlpha + 4) / 8
+//          as (num + 4 nAlpha) / (8 nAlpha). For a flat block both sides and
+//          the quotient are exact, so flat colors stay flat.
+//-----------------------------------------------------------------------------
+static inline void FilterTexelLUT(const UINT8 *s0, const UINT8 *s1, const UINT8 *s2, const UINT8 *s3, UINT8 *d,
+                                  const ColorTables &tables, bool bPremultiplied)
+{
+    const uint32_t *toLinear = tables.toLinear;
+    int nAlpha = s0[3] + s1[3] + s2[3] + s3[3];
+    if (bPremultiplied && nAlpha > 0)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            int num = (int)(toLinear[s0[c]] * s0[3] + toLinear[s1[c]] * s1[3] +
+                            toLinear[s2[c]] * s2[3] + toLinear[s3[c]] * s3[3]);
+            d[c] = tables.fromLinear[(int)((float)(num + nAlpha * 4) / (float)(nAlpha * 8))];
+        }
+    }
+    else
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t sum = toLinear[s0[c]] + toLinear[s1[c]] + toLinear[s2[c]] + toLinear[s3[c]];
+            d[c] = tables.fromLinear[(sum + 16) >> 5];
+        }
+    }
+    d[3] = (UINT8)((nAlpha + 2) >> 2);
+}
+
+// Same contract as MipRowFunc, through the color tables
+typedef void (*MipLUTRowFunc)(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth,
+                              const ColorTables &tables, bool bPremultiplied);
+
+static void DownsampleRowLUT_Scalar(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth,
+                                    const ColorTables &tables, bool bPremultiplied)
+{
+    for (int x = 0; x < nDstWidth; x++)
+    {
+        FilterTexelLUT(pRow0 + x * 8, pRow0 + x * 8 + 4, pRow1 + x * 8, pRow1 + x * 8 + 4, pDst + x * 4,
+                       tables, bPremultiplied);
+    }
+}
+
+#if MIP_X86
+// Linear value of the channel at bit nShift of 8 texels
+MIP_TARGET("avx2")
+static inline __m256i DecodeChannel_AVX2(const int *toLinear, __m256i texels, int nShift)
+{
+    __m256i index = _mm256_and_si256(_mm256_srli_epi32(texels, nShift), _mm256_set1_epi32(0xff));
+    return _mm256_i32gather_epi32(toLinear, index, 4);
+}
+
+// (l + 4) a of 16 texels, each horizontal pair summed: packed to 16 bits for pmaddwd
+MIP_TARGET("avx2")
+static inline __m256i WeightedPair_AVX2(__m256i l0, __m256i l1, __m256i weights)
+{
+    return _mm256_madd_epi16(_mm256_add_epi16(_mm256_packs_epi32(l0, l1), _mm256_set1_epi16(4)), weights);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 8 destination texels at a time, table reads through gathers. Each
+//          row is filtered as 8 texel vectors and pairs summed with hadd (or
+//          pmaddwd), which leaves quarters in the order 0, 2, 1, 3 until the
+//          final permute. Both return how many texels they filtered.
+//-----------------------------------------------------------------------------
+MIP_TARGET("avx2")
+static int DownsampleRowLUTPlain_AVX2(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth, const ColorTables &tables)
+{
+    const int *toLinear = (const int *)tables.toLinear;
+    const int *fromLinear = (const int *)tables.fromLinear;
+    int x = 0;
+    for (; x + 8 <= nDstWidth; x += 8)
+    {
+        __m256i r0lo = _mm256_loadu_si256((const __m256i *)(pRow0 + x * 8));
+        __m256i r0hi = _mm256_loadu_si256((const __m256i *)(pRow0 + x * 8 + 32));
+        __m256i r1lo = _mm256_loadu_si256((const __m256i *)(pRow1 + x * 8));
+        __m256i r1hi = _mm256_loadu_si256((const __m256i *)(pRow1 + x * 8 + 32));
+        __m256i nAlpha = _mm256_hadd_epi32(_mm256_add_epi32(_mm256_srli_epi32(r0lo, 24), _mm256_srli_epi32(r1lo, 24)),
+                                           _mm256_add_epi32(_mm256_srli_epi32(r0hi, 24), _mm256_srli_epi32(r1hi, 24)));
+        __m256i out = _mm256_slli_epi32(_mm256_srli_epi32(_mm256_add_epi32(nAlpha, _mm256_set1_epi32(2)), 2), 24);
+        for (int c = 0; c < 3; c++)
+        {
+            __m256i lo = _mm256_add_epi32(DecodeChannel_AVX2(toLinear, r0lo, c * 8), DecodeChannel_AVX2(toLinear, r1lo, c * 8));
+            __m256i hi = _mm256_add_epi32(DecodeChannel_AVX2(toLinear, r0hi, c * 8), DecodeChannel_AVX2(toLinear, r1hi, c * 8));
+            __m256i index = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(lo, hi), _mm256_set1_epi32(16)), 5);
+            __m256i encoded = _mm256_and_si256(_mm256_i32gather_epi32(fromLinear, index, 1), _mm256_set1_epi32(0xff));
+            out = _mm256_or_si256(out, _mm256_slli_epi32(encoded, c * 8));
+        }
+        _mm256_storeu_si256((__m256i *)(pDst + x * 4), _mm256_permute4x64_epi64(out, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    return x;
+}
+
+// The numerator num + 4 nAlpha is summed as (l + 4) a, and blocks without any
+// alpha weigh their texels 1 each, which divides out to the plain index
+MIP_TARGET("avx2")
+static int DownsampleRowLUTPremultiplied_AVX2(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth, const ColorTables &tables)
+{
+    const int *toLinear = (const int *)tables.toLinear;
+    const int *fromLinear = (const int *)tables.fromLinear;
+    int x = 0;
+    for (; x + 8 <= nDstWidth; x += 8)
+    {
+        __m256i r0lo = _mm256_loadu_si256((const __m256i *)(pRow0 + x * 8));
+        __m256i r0hi = _mm256_loadu_si256((const __m256i *)(pRow0 + x * 8 + 32));
+        __m256i r1lo = _mm256_loadu_si256((const __m256i *)(pRow1 + x * 8));
+        __m256i r1hi = _mm256_loadu_si256((const __m256i *)(pRow1 + x * 8 + 32));
+        __m256i weights0 = _mm256_packs_epi32(_mm256_srli_epi32(r0lo, 24), _mm256_srli_epi32(r0hi, 24));
+        __m256i weights1 = _mm256_packs_epi32(_mm256_srli_epi32(r1lo, 24), _mm256_srli_epi32(r1hi, 24));
+        __m256i nAlpha = _mm256_madd_epi16(_mm256_add_epi16(weights0, weights1), _mm256_set1_epi16(1));
+        __m256i noAlpha = _mm256_cmpeq_epi32(nAlpha, _mm256_setzero_si256());
+        // 16 bit weights in pmaddwd order, the texel pair of each lane +1 when it has no alpha
+        weights0 = _mm256_sub_epi16(weights0, noAlpha);
+        weights1 = _mm256_sub_epi16(weights1, noAlpha);
+        __m256 den = _mm256_cvtepi32_ps(_mm256_slli_epi32(_mm256_sub_epi32(nAlpha, _mm256_slli_epi32(noAlpha, 2)), 3));
+        __m256i out = _mm256_slli_epi32(_mm256_srli_epi32(_mm256_add_epi32(nAlpha, _mm256_set1_epi32(2)), 2), 24);
+        for (int c = 0; c < 3; c++)
+        {
+            __m256i num = _mm256_add_epi32(
+                WeightedPair_AVX2(DecodeChannel_AVX2(toLinear, r0lo, c * 8), DecodeChannel_AVX2(toLinear, r0hi, c * 8), weights0),
+                WeightedPair_AVX2(DecodeChannel_AVX2(toLinear, r1lo, c * 8), DecodeChannel_AVX2(toLinear, r1hi, c * 8), weights1));
+            __m256i index = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(num), den));
+            __m256i encoded = _mm256_and_si256(_mm256_i32gather_epi32(fromLinear, index, 1), _mm256_set1_epi32(0xff));
+            out = _mm256_or_si256(out, _mm256_slli_epi32(encoded, c * 8));
+        }
+        _mm256_storeu_si256((__m256i *)(pDst + x * 4), _mm256_permute4x64_epi64(out, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    return x;
+}
+
+MIP_TARGET("avx2")
+static void DownsampleRowLUT_AVX2(const UINT8 *pRow0, const UINT8 *pRow1, UINT8 *pDst, int nDstWidth,
+                                  const ColorTables &tables, bool bPremultiplied)
+{
+    int x = bPremultiplied ? DownsampleRowLUTPremultiplied_AVX2(pRow0, pRow1, pDst, nDstWidth, tables)
+                           : DownsampleRowLUTPlain_AVX2(pRow0, pRow1, pDst, nDstWidth, tables);
+    DownsampleRowLUT_Scalar(pRow0 + x * 8, pRow1 + x * 8, pDst + x * 4, nDstWidth - x, tables, bPremultiplied);
+}
+#endif
+
+// Without a gather the table reads are the whole cost, and SSE2 or NEON
+// vectors built one read at a time measured slower than the scalar loop
+static MipLUTRowFunc GetMipLUTRowFunc(MipKernel kernel)
+{
+    switch (ResolveMipKernel(kernel))
+    {
+#if MIP_X86
+    case MipKernel::AVX2:
+        return DownsampleRowLUT_AVX2;
+#endif
+    default:
+        return DownsampleRowLUT_Scalar;
+    }
+}
+
+static void DownsampleRowLUT(const UINT8 *pRow0, const UINT8 *pRow1, int nSrcWidth, UINT8 *pDst,
+                             const MipFilterOptions &options)
+{
+    const ColorTables &tables = GetColorTables(options.bSRGB);
+    if (nSrcWidth == 1)
+    {
+        // a column: clamp the horizontal pair to the single texel
+        FilterTexelLUT(pRow0, pRow0, pRow1, pRow1, pDst, tables, options.bPremultipliedAlpha);
+        return;
+    }
+    GetMipLUTRowFunc(options.kernel)(pRow0, pRow1, pDst, nSrcWidth / 2, tables, options.bPremultipliedAlpha);
+}
+
+static void DownsampleRowFiltered(const UINT8 *pRow0, const UINT8 *pRow1, int nSrcWidth, UINT8 *pDst,
+                                  const MipFilterOptions &options)
+{
+    if (options.bSRGB || options.bPremultipliedAlpha)
+    {
+        DownsampleRowLUT(pRow0, pRow1, nSrcWidth, pDst, options);
+    }
+    else
+    {
+        DownsampleRowRGBA(pRow0, pRow1, nSrcWidth, pDst, options.kernel);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Separable windowed sinc weights for a 2x reduction. Destination
+//          texel x is centred on source 2x + 1 and reads sources 2x - 5 .. 2x + 6.
+//-----------------------------------------------------------------------------
+static const int WINDOWED_TAPS = 12;
+
+struct WindowedWeights
+{
+    float w[WINDOWED_TAPS];
+
+    explicit WindowedWeights(MipFilter filter)
+    {
+        const double radius = 3.0;
+        const double alpha = 4.0;
+        auto sinc = [](double x) { return x == 0.0 ? 1.0 : sin(3.14159265358979 * x) / (3.14159265358979 * x); };
+        // zeroth order modified Bessel function, for the Kaiser window
+        auto bessel0 = [](double x) {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 32; k++)
+            {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        };
+        double total = 0.0;
+        double weights[WINDOWED_TAPS];
+        for (int k = 0; k < WINDOWED_TAPS; k++)
+        {
+            // distance in destination texels
+            double t = ((k + 0.5) - WINDOWED_TAPS / 2) / 2.0;
+            double window = filter == MipFilter::Kaiser
+                                ? bessel0(alpha * sqrt(std::max(0.0, 1.0 - (t / radius) * (t / radius)))) / bessel0(alpha)
+                                : sinc(t / radius);
+            weights[k] = fabs(t) < radius ? sinc(t) * window : 0.0;
+            total += weights[k];
+        }
+        for (int k = 0; k < WINDOWED_TAPS; k++)
+        {
+            w[k] = (float)(weights[k] / total);
+        }
+    }
+};
+
+static const WindowedWeights &GetWindowedWeights(MipFilter filter)
+{
+    static const WindowedWeights s_kaiser(MipFilter::Kaiser);
+    static const WindowedWeights s_lanczos(MipFilter::Lanczos3);
+    return filter == MipFilter::Kaiser ? s_kaiser : s_lanczos;
+}
+
+// acc = sum of weights[k] * texel k over WINDOWED_TAPS consecutive linear RGBA texels
+#if MIP_X86
+static inline void WeightedSumRGBA(const float *weights, const float *pSrc, float *acc)
+{
+    __m128 sum = _mm_setzero_ps();
+    for (int k = 0; k < WINDOWED_TAPS; k++)
+    {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(pSrc + k * 4)));
+    }
+    _mm_storeu_ps(acc, sum);
+}
+#elif MIP_NEON
+static inline void WeightedSumRGBA(const float *weights, const float *pSrc, float *acc)
+{
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    for (int k = 0; k < WINDOWED_TAPS; k++)
     {
-        for (int x = 0; x < *pDstWidthOut; x++)
+        sum = vmlaq_n_f32(sum, vld1q_f32(pSrc + k * 4), weights[k]);
+    }
+    vst1q_f32(acc, sum);
+}
+#else
+static inline void WeightedSumRGBA(const float *weights, const float *pSrc, float *acc)
+{
+    for (int k = 0; k < WINDOWED_TAPS; k++)
+    {
+        for (int c = 0; c < 4; c++)
         {
-            int nSrcIndex[4];
-            float r = 0.0f;
-            float g = 0.0f;
-            float b = 0.0f;
-            float a = 0.0f;
+            acc[c] += weights[k] * pSrc[k * 4 + c];
+        }
+    }
+}
+#endif
 
-            nSrcIndex[0] = (((y * 2) * nSrcWidth) + (x * 2)) * 4;
-            nSrcIndex[1] = (((y * 2) * nSrcWidth) + (x * 2 + 1)) * 4;
-            nSrcIndex[2] = ((((y * 2) + 1) * nSrcWidth) + (x * 2)) * 4;
-            nSrcIndex[3] = ((((y * 2) + 1) * nSrcWidth) + (x * 2 + 1)) * 4;
+//-----------------------------------------------------------------------------
+// Purpose: destination rows [y0, y1) with a windowed filter. Source rows are
+//          decoded to linear float and filtered horizontally once each, into a
+//          ring that holds the 12 rows the vertical pass needs.
+//-----------------------------------------------------------------------------
+static void DownsampleRowsWindowed(const UINT8 *pSrc, int nSrcWidth, int nSrcHeight, size_t nSrcPitch,
+                                   UINT8 *pDst, size_t nDstPitch, int y0, int y1, const MipFilterOptions &options)
+{
+    const float *weights = GetWindowedWeights(options.filter).w;
+    const ColorTables &tables = GetColorTables(options.bSRGB);
+    const int nDstWidth = std::max(nSrcWidth / 2, 1);
+    const int nHalf = WINDOWED_TAPS / 2 - 1;
+    const int nRing = 16;
 
-            // Sum all pixels
-            for (int nSample = 0; nSample < 4; nSample++)
+    std::vector<float> linear((size_t)nSrcWidth * 4);
+    std::vector<float> ring((size_t)nRing * nDstWidth * 4);
+    int ringTags[nRing];
+    std::fill(ringTags, ringTags + nRing, -0x7fffffff);
+
+    auto FilteredRow = [&](int nRow) -> const float * {
+        int nSlot = nRow & (nRing - 1);
+        float *pOut = &ring[(size_t)nSlot * nDstWidth * 4];
+        if (ringTags[nSlot] == nRow)
+            return pOut;
+        ringTags[nSlot] = nRow;
+
+        const UINT8 *p = pSrc + std::min(std::max(nRow, 0), nSrcHeight - 1) * nSrcPitch;
+        for (int x = 0; x < nSrcWidth; x++)
+        {
+            float a = p[x * 4 + 3] * (1.0f / 255.0f);
+            float scale = options.bPremultipliedAlpha ? a : 1.0f;
+            linear[x * 4 + 0] = tables.toLinearF[p[x * 4 + 0]] * scale;
+            linear[x * 4 + 1] = tables.toLinearF[p[x * 4 + 1]] * scale;
+            linear[x * 4 + 2] = tables.toLinearF[p[x * 4 + 2]] * scale;
+            linear[x * 4 + 3] = a;
+        }
+        for (int x = 0; x < nDstWidth; x++)
+        {
+            float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            int sx0 = x * 2 - nHalf;
+            if (sx0 >= 0 && sx0 + WINDOWED_TAPS <= nSrcWidth)
             {
-                r += pSrc[nSrcIndex[nSample]];
-                g += pSrc[nSrcIndex[nSample] + 1];
-                b += pSrc[nSrcIndex[nSample] + 2];
-                a += pSrc[nSrcIndex[nSample] + 3];
+                WeightedSumRGBA(weights, &linear[sx0 * 4], acc);
             }
+            else
+            {
+                for (int k = 0; k < WINDOWED_TAPS; k++)
+                {
+                    const float *s = &linear[std::min(std::max(sx0 + k, 0), nSrcWidth - 1) * 4];
+                    for (int c = 0; c < 4; c++)
+                    {
+                        acc[c] += weights[k] * s[c];
+                    }
+                }
+            }
+            memcpy(pOut + x * 4, acc, sizeof(acc));
+        }
+        return pOut;
+    };
 
-            // Average results
-            r /= 4.0;
-            g /= 4.0;
-            b /= 4.0;
-            a /= 4.0;
+    std::vector<float> column((size_t)nDstWidth * 4);
+    for (int y = y0; y < y1; y++)
+    {
+        // vertical pass a whole row at a time, which vectorizes cleanly
+        std::fill(column.begin(), column.end(), 0.0f);
+        for (int k = 0; k < WINDOWED_TAPS; k++)
+        {
+            const float *pRow = FilteredRow(y * 2 - nHalf + k);
+            const float w = weights[k];
+            float *pColumn = column.data();
+            for (int i = 0; i < nDstWidth * 4; i++)
+            {
+                pColumn[i] += w * pRow[i];
+            }
+        }
+        UINT8 *d = pDst + y * nDstPitch;
+        for (int x = 0; x < nDstWidth; x++)
+        {
+            const float *acc = &column[x * 4];
+            // negative lobes can ring outside [0, 1]
+            float a = std::min(std::max(acc[3], 0.0f), 1.0f);
+            float unpremultiply = 1.0f;
+            if (options.bPremultipliedAlpha)
+            {
+                unpremultiply = a > (0.5f / 255.0f) ? 1.0f / a : 0.0f;
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                float v = std::min(std::max(acc[c] * unpremultiply, 0.0f), 1.0f);
+                d[x * 4 + c] = tables.fromLinear[(int)(v * 4095.0f + 0.5f)];
+            }
+            d[x * 4 + 3] = (UINT8)(a * 255.0f + 0.5f);
+        }
+    }
+}
+
+static void DownsampleRowsFiltered(const UINT8 *pSrc, int nSrcWidth, int nSrcHeight, size_t nSrcPitch,
+                                   UINT8 *pDst, size_t nDstPitch, int y0, int y1, const MipFilterOptions &options)
+{
+    if (options.filter != MipFilter::Box)
+    {
+        DownsampleRowsWindowed(pSrc, nSrcWidth, nSrcHeight, nSrcPitch, pDst, nDstPitch, y0, y1, options);
+        return;
+    }
+    for (int y = y0; y < y1; y++)
+    {
+        const UINT8 *pRow0 = pSrc + (y * 2) * nSrcPitch;
+        const UINT8 *pRow1 = pSrc + std::min(y * 2 + 1, nSrcHeight - 1) * nSrcPitch;
+        DownsampleRowFiltered(pRow0, pRow1, nSrcWidth, pDst + y * nDstPitch, options);
+    }
+}
+
+void DownsampleRGBAFiltered(const UINT8 *pSrc, int nSrcWidth, int nSrcHeight, size_t nSrcPitch,
+                            UINT8 *pDst, size_t nDstPitch, const MipFilterOptions &options)
+{
+    DownsampleRowsFiltered(pSrc, nSrcWidth, nSrcHeight, nSrcPitch, pDst, nDstPitch,
+                           0, std::max(nSrcHeight / 2, 1), options);
+}
+
+int GetMipChainLevelCount(int nWidth, int nHeight)
+{
+    int nLevels = 1;
+    while (nWidth > 1 || nHeight > 1)
+    {
+        nWidth = std::max(nWidth / 2, 1);
+        nHeight = std::max(nHeight / 2, 1);
+        nLevels++;
+    }
+    return nLevels;
+}
+
+static size_t AlignUp(size_t n, size_t alignment)
+{
+    return (n + alignment - 1) & ~(alignment - 1);
+}
 
-            // Store resulting pixels
-            (*ppDst)[(y * (*pDstWidthOut) + x) * 4] = (UINT8)(r);
-            (*ppDst)[(y * (*pDstWidthOut) + x) * 4 + 1] = (UINT8)(g);
-            (*ppDst)[(y * (*pDstWidthOut) + x) * 4 + 2] = (UINT8)(b);
-            (*ppDst)[(y * (*pDstWidthOut) + x) * 4 + 3] = (UINT8)(a);
+size_t ComputeMipChainLayoutRGBA(int nWidth, int nHeight, MipLevelLayout *pLevels)
+{
+    int nLevels = GetMipChainLevelCount(nWidth, nHeight);
+    size_t nOffset = 0;
+    for (int i = 0; i < nLevels; i++)
+    {
+        MipLevelLayout &level = pLevels[i];
+        level.nOffset = AlignUp(nOffset, MIP_PLACEMENT_ALIGNMENT);
+        level.nWidth = nWidth;
+        level.nHeight = nHeight;
+        level.nRowPitch = AlignUp((size_t)nWidth * 4, MIP_ROW_PITCH_ALIGNMENT);
+        nOffset = level.nOffset + level.nRowPitch * nHeight;
+
+        nWidth = std::max(nWidth / 2, 1);
+        nHeight = std::max(nHeight / 2, 1);
+    }
+    return nOffset;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Base row y is done: build every row of the levels below it finishes.
+//          RowPtr(level, y) returns the row of a level, each level needs its
+//          last row pair. pTailRows, when set, also receives the rows of the
+//          last level packed.
+//-----------------------------------------------------------------------------
+template <typename RowPtrFunc>
+static void CascadeRow(int y, const RowPtrFunc &RowPtr, UINT8 *pArena, const MipLevelLayout *pLevels, int nLevels,
+                       UINT8 *pTailRows, const MipFilterOptions &options)
+{
+    // every finished row pair produces one row of the next level
+    int nLevel = 0;
+    int nRow = y;
+    while (nLevel + 1 < nLevels)
+    {
+        const MipLevelLayout &src = pLevels[nLevel];
+        const MipLevelLayout &dst = pLevels[nLevel + 1];
+        if ((nRow & 1) == 0 && nRow != src.nHeight - 1)
+            break;
+        int nDstRow = nRow / 2;
+        if (nDstRow >= dst.nHeight)
+            break; // odd height, the last row has no pair and is dropped
+
+        UINT8 *pOut = RowPtr(nLevel + 1, nDstRow);
+        DownsampleRowFiltered(RowPtr(nLevel, nDstRow * 2),
+                              RowPtr(nLevel, std::min(nDstRow * 2 + 1, src.nHeight - 1)),
+                              src.nWidth, pOut, options);
+        memcpy(pArena + dst.nOffset + nDstRow * dst.nRowPitch, pOut, (size_t)dst.nWidth * 4);
+        if (pTailRows && nLevel + 2 == nLevels)
+        {
+            memcpy(pTailRows + (size_t)nDstRow * dst.nWidth * 4, pOut, (size_t)dst.nWidth * 4);
         }
+
+        nLevel++;
+        nRow = nDstRow;
+    }
+}
+
+// Two rows (even, odd) per level below the base, packed
+static size_t GetCascadeScratch(const MipLevelLayout *pLevels, int nLevels, std::vector<size_t> &scratchOffsets)
+{
+    scratchOffsets.assign(nLevels, 0);
+    size_t nScratchSize = 0;
+    for (int i = 1; i < nLevels; i++)
+    {
+        scratchOffsets[i] = nScratchSize;
+        nScratchSize += 2 * (size_t)pLevels[i].nWidth * 4;
     }
-}
\ No newline at end of file
+    return nScratchSize;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Cascade base rows [y0, y1) down pLevels[0 .. nLevels - 1].
+//          y0 must be a multiple of 2^(nLevels - 1) so every level of the band
+//          starts on a row pair. pTailRows, when set, also receives the rows
+//          of the last level packed, so a later pass can read them back.
+//-----------------------------------------------------------------------------
+static void CascadeRows(const UINT8 *pSrc, size_t nSrcPitch, int y0, int y1, bool bCopyBase,
+                        UINT8 *pArena, const MipLevelLayout *pLevels, int nLevels,
+                        UINT8 *pTailRows, const MipFilterOptions &options)
+{
+    // level 0 reads straight from pSrc
+    std::vector<size_t> scratchOffsets;
+    std::vector<UINT8> scratch(GetCascadeScratch(pLevels, nLevels, scratchOffsets));
+
+    auto RowPtr = [&](int nLevel, int y) -> UINT8 * {
+        if (nLevel == 0)
+            return const_cast<UINT8 *>(pSrc) + y * nSrcPitch;
+        return &scratch[scratchOffsets[nLevel] + (y & 1) * (size_t)pLevels[nLevel].nWidth * 4];
+    };
+
+    const MipLevelLayout &base = pLevels[0];
+    for (int y = y0; y < y1; y++)
+    {
+        UINT8 *pBaseRow = pArena + base.nOffset + y * base.nRowPitch;
+        if (bCopyBase && pBaseRow != RowPtr(0, y))
+        {
+            memcpy(pBaseRow, RowPtr(0, y), (size_t)base.nWidth * 4);
+        }
+        CascadeRow(y, RowPtr, pArena, pLevels, nLevels, pTailRows, options);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Windowed filters read 12 rows around each row pair, so build one
+//          level at a time in cached scratch memory (the arena stays write
+//          only) with a barrier between levels.
+//-----------------------------------------------------------------------------
+static void GenerateMipChainWindowed(const UINT8 *pSrc, size_t nSrcPitch,
+                                     UINT8 *pArena, const MipLevelLayout *pLevels, int nLevels,
+                                     const MipFilterOptions &options, WorkerPool *pWorkers)
+{
+    for (int y = 0; y < pLevels[0].nHeight; y++)
+    {
+        memcpy(pArena + pLevels[0].nOffset + y * pLevels[0].nRowPitch, pSrc + y * nSrcPitch, (size_t)pLevels[0].nWidth * 4);
+    }
+
+    std::vector<UINT8> prev, next;
+    for (int i = 1; i < nLevels; i++)
+    {
+        const MipLevelLayout &src = pLevels[i - 1];
+        const MipLevelLayout &dst = pLevels[i];
+        next.resize((size_t)dst.nWidth * dst.nHeight * 4);
+        const UINT8 *pLevelSrc = i == 1 ? pSrc : prev.data();
+        size_t nLevelPitch = i == 1 ? nSrcPitch : (size_t)src.nWidth * 4;
+
+        const int nBandRows = 32;
+        int nBands = (dst.nHeight + nBandRows - 1) / nBandRows;
+        auto band = [&](int nBand) {
+            int y0 = nBand * nBandRows;
+            int y1 = std::min(y0 + nBandRows, dst.nHeight);
+            DownsampleRowsWindowed(pLevelSrc, src.nWidth, src.nHeight, nLevelPitch,
+                                   next.data(), (size_t)dst.nWidth * 4, y0, y1, options);
+            for (int y = y0; y < y1; y++)
+            {
+                memcpy(pArena + dst.nOffset + y * dst.nRowPitch, &next[(size_t)y * dst.nWidth * 4], (size_t)dst.nWidth * 4);
+            }
+        };
+        if (pWorkers && nBands > 1)
+        {
+            pWorkers->ParallelFor(nBands, band);
+        }
+        else
+        {
+            for (int b = 0; b < nBands; b++)
+            {
+                band(b);
+            }
+        }
+        prev.swap(next);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Build every mip level in one pass over the base image
+//-----------------------------------------------------------------------------
+void GenerateMipChainRGBA(const UINT8 *pSrc, size_t nSrcPitch,
+                          UINT8 *pArena, const MipLevelLayout *pLevels, int nLevels,
+                          const MipFilterOptions &options, WorkerPool *pWorkers)
+{
+    if (options.filter != MipFilter::Box)
+    {
+        GenerateMipChainWindowed(pSrc, nSrcPitch, pArena, pLevels, nLevels, options, pWorkers);
+        return;
+    }
+
+    bool bCopyBase = true;
+    std::vector<UINT8> tail;
+    while (nLevels > 0)
+    {
+        // Split the base into bands of 2^k rows. Each band cascades levels
+        // 1..k on its own, then the bands are joined before level k feeds the
+        // next group. Deepest k that still gives every thread several bands.
+        int k = 0;
+        if (pWorkers && pWorkers->ThreadCount() > 1)
+        {
+            const int nMinBands = pWorkers->ThreadCount() * 4;
+            while (k + 1 < nLevels && (pLevels[0].nHeight >> (k + 1)) >= nMinBands)
+            {
+                k++;
+            }
+        }
+        if (k == 0)
+        {
+            CascadeRows(pSrc, nSrcPitch, 0, pLevels[0].nHeight, bCopyBase, pArena, pLevels, nLevels, nullptr, options);
+            return;
+        }
+
+        const int nBandRows = 1 << k;
+        const int nBands = (pLevels[0].nHeight + nBandRows - 1) / nBandRows;
+        const MipLevelLayout &last = pLevels[k];
+        std::vector<UINT8> groupTail((size_t)last.nWidth * last.nHeight * 4);
+        pWorkers->ParallelFor(nBands, [&](int nBand) {
+            int y0 = nBand * nBandRows;
+            int y1 = std::min(y0 + nBandRows, pLevels[0].nHeight);
+            CascadeRows(pSrc, nSrcPitch, y0, y1, bCopyBase, pArena, pLevels, k + 1, groupTail.data(), options);
+        });
+
+        // level k is the base of the next group, already in the arena
+        tail.swap(groupTail);
+        pSrc = tail.data();
+        nSrcPitch = (size_t)last.nWidth * 4;
+        pLevels += k;
+        nLevels -= k;
+        bCopyBase = false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: generate next level mipmap for an RGBA image
+//-----------------------------------------------------------------------------
+void GenMipMapRGBA(const UINT8 *pSrc, UINT8 **ppDst, int nSrcWidth, int nSrcHeight, int *pDstWidthOut, int *pDstHeightOut)
+{
+    *pDstWidthOut = std::max(nSrcWidth / 2, 1);
+    *pDstHeightOut = std::max(nSrcHeight / 2, 1);
+
+    *ppDst = new UINT8[4 * (*pDstWidthOut) * (*pDstHeightOut)];
+    DownsampleRGBA(pSrc, nSrcWidth, nSrcHeight, nSrcWidth * 4, *ppDst, (*pDstWidthOut) * 4);
+}
+
+MipChainBuilder::MipChainBuilder(UINT8 *pArena, const MipLevelLayout *pLevels, int nLevels, const MipFilterOptions &options)
+    : m_pArena(pArena), m_levels(pLevels, pLevels + nLevels), m_options(options)
+{
+    if (options.filter != MipFilter::Box)
+    {
+        m_scratch.resize((size_t)pLevels[0].nWidth * pLevels[0].nHeight * 4);
+        return;
+    }
+    // the base keeps its last row pair like every other level
+    m_scratch.resize(GetCascadeScratch(pLevels, nLevels, m_scratchOffsets) + 2 * (size_t)pLevels[0].nWidth * 4);
+}
+
+UINT8 *MipChainBuilder::RowPtr(int nLevel, int y)
+{
+    if (nLevel == 0)
+        return &m_scratch[m_scratch.size() - (2 - (y & 1)) * (size_t)m_levels[0].nWidth * 4];
+    return &m_scratch[m_scratchOffsets[nLevel] + (y & 1) * (size_t)m_levels[nLevel].nWidth * 4];
+}
+
+void MipChainBuilder::AddRow(const UINT8 *pRow)
+{
+    const MipLevelLayout &base = m_levels[0];
+    const size_t nRowBytes = (size_t)base.nWidth * 4;
+    if (m_nRows >= base.nHeight)
+        return;
+    memcpy(m_pArena + base.nOffset + m_nRows * base.nRowPitch, pRow, nRowBytes);
+
+    if (m_options.filter != MipFilter::Box)
+    {
+        memcpy(&m_scratch[(size_t)m_nRows * nRowBytes], pRow, nRowBytes);
+    }
+    else
+    {
+        memcpy(RowPtr(0, m_nRows), pRow, nRowBytes);
+        CascadeRow(m_nRows, [this](int nLevel, int y) { return RowPtr(nLevel, y); }, m_pArena, m_levels.data(),
+                   (int)m_levels.size(), nullptr, m_options);
+    }
+    m_nRows++;
+}
+
+void MipChainBuilder::Finish(WorkerPool *pWorkers)
+{
+    if (m_options.filter == MipFilter::Box || m_nRows < m_levels[0].nHeight)
+        return;
+    GenerateMipChainWindowed(m_scratch.data(), (size_t)m_levels[0].nWidth * 4, m_pArena, m_levels.data(),
+                             (int)m_levels.size(), m_options, pWorkers);
+    std::vector<UINT8>().swap(m_scratch);
+}
+
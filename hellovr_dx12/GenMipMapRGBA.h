@@ -1,3 +1,133 @@
 #pragma once
+#include <stddef.h>
+#include <vector>
+
+// Row kernels used by the 2x2 box filter. Auto picks the best one the CPU supports.
+enum class MipKernel
+{
+    Auto,
+    Scalar,
+    SSE2,
+    AVX2,
+    NEON,
+};
+
+bool IsMipKernelSupported(MipKernel kernel);
+MipKernel GetBestMipKernel();
+const char *GetMipKernelName(MipKernel kernel);
+
+// Reconstruction filter for a 2x reduction. Kaiser and Lanczos3 read 12x12 texels.
+enum class MipFilter
+{
+    Box,
+    Kaiser,
+    Lanczos3,
+};
+
+const char *GetMipFilterName(MipFilter filter);
+
+struct MipFilterOptions
+{
+    MipFilter filter = MipFilter::Box;
+    // texels are sRGB encoded: filter in linear light through lookup tables
+    bool bSRGB = false;
+    // weight color by alpha, so transparent texels do not bleed into their neighbours
+    bool bPremultipliedAlpha = false;
+    // box filter only, with or without the tables
+    MipKernel kernel = MipKernel::Auto;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: 2x2 box filter an RGBA8 image into the next mip level.
+//          The destination is max(1, w / 2) x max(1, h / 2) texels, each one
+//          the rounded integer average (a + b + c + d + 2) >> 2 of its source
+//          block. Every kernel produces identical output.
+//-----------------------------------------------------------------------------
+void DownsampleRGBA(const unsigned char *pSrc, int nSrcWidth, int nSrcHeight, size_t nSrcPitch,
+                    unsigned char *pDst, size_t nDstPitch, MipKernel kernel = MipKernel::Auto);
+
+// One destination row of DownsampleRGBA from source rows 2y and 2y + 1 (clamped)
+void DownsampleRowRGBA(const unsigned char *pRow0, const unsigned char *pRow1, int nSrcWidth,
+                       unsigned char *pDst, MipKernel kernel = MipKernel::Auto);
+
+//-----------------------------------------------------------------------------
+// Purpose: DownsampleRGBA with a selectable filter. sRGB texels go through a
+//          256 entry sRGB -> linear table and come back through a 4096 entry
+//          linear -> sRGB table, so there is no pow() per sample.
+//-----------------------------------------------------------------------------
+void DownsampleRGBAFiltered(const unsigned char *pSrc, int nSrcWidth, int nSrcHeight, size_t nSrcPitch,
+                            unsigned char *pDst, size_t nDstPitch, const MipFilterOptions &options);
+
+// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT and D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+const size_t MIP_PLACEMENT_ALIGNMENT = 512;
+const size_t MIP_ROW_PITCH_ALIGNMENT = 256;
+
+// Where one mip level lives inside a mip chain arena
+struct MipLevelLayout
+{
+    size_t nOffset;
+    int nWidth;
+    int nHeight;
+    size_t nRowPitch;
+};
+
+// Full chain down to 1x1
+int GetMipChainLevelCount(int nWidth, int nHeight);
+
+//-----------------------------------------------------------------------------
+// Purpose: Lay out a full RGBA8 mip chain the way GetCopyableFootprints does
+//          (512 byte aligned subresources, 256 byte aligned rows).
+//          pLevels receives GetMipChainLevelCount() entries.
+//          Returns the arena size in bytes.
+//-----------------------------------------------------------------------------
+size_t ComputeMipChainLayoutRGBA(int nWidth, int nHeight, MipLevelLayout *pLevels);
+
+//-----------------------------------------------------------------------------
+// Purpose: Build every mip level in one pass over the base image.
+//          Each finished row pair immediately cascades down the chain, so the
+//          data is still in cache when the next level reads it. Only the two
+//          most recent rows of each level are kept in scratch memory; pArena is
+//          written and never read back, which makes a mapped upload heap a
+//          good destination.
+//          With pWorkers the base is split into row bands that run in
+//          parallel; the output does not depend on the thread count.
+//          Kaiser and Lanczos3 need more than a row pair: they build one level
+//          at a time in scratch memory and copy each finished level out.
+//-----------------------------------------------------------------------------
+void GenerateMipChainRGBA(const unsigned char *pSrc, size_t nSrcPitch,
+                          unsigned char *pArena, const MipLevelLayout *pLevels, int nLevels,
+                          const MipFilterOptions &options = MipFilterOptions(), class WorkerPool *pWorkers = nullptr);
+
+//-----------------------------------------------------------------------------
+// Purpose: GenerateMipChainRGBA fed one base row at a time, e.g. by a streaming
+//          PNG decode. Each row goes into level 0 of the arena and cascades
+//          down the chain as soon as it completes a row pair, so level 1 is
+//          built while level 0 is still arriving. Keeps the last two rows of
+//          every level; the arena is written and never read back. Kaiser and
+//          Lanczos3 keep the whole base in scratch memory and filter it in
+//          Finish. The output is the same as GenerateMipChainRGBA's.
+//-----------------------------------------------------------------------------
+class MipChainBuilder
+{
+    unsigned char *m_pArena;
+    std::vector<MipLevelLayout> m_levels;
+    MipFilterOptions m_options;
+    std::vector<size_t> m_scratchOffsets;
+    std::vector<unsigned char> m_scratch;
+    int m_nRows = 0;
+
+    unsigned char *RowPtr(int nLevel, int y);
+
+public:
+    MipChainBuilder(unsigned char *pArena, const MipLevelLayout *pLevels, int nLevels,
+                    const MipFilterOptions &options = MipFilterOptions());
+
+    // Base rows in order, pLevels[0].nWidth RGBA8 texels each. Extra rows are ignored.
+    void AddRow(const unsigned char *pRow);
+    // Every base row is in; builds the levels of a windowed filter
+    void Finish(class WorkerPool *pWorkers = nullptr);
+
+    int RowsAdded() const { return m_nRows; }
+};
 
 void GenMipMapRGBA(const unsigned char *pSrc, unsigned char **ppDst, int nSrcWidth, int nSrcHeight, int *pDstWidthOut, int *pDstHeightOut);
@@ -1,17 +1,6 @@
 #include "Hmd.h"
-
-//-----------------------------------------------------------------------------
-// Purpose: Converts a SteamVR matrix to our local matrix class
-//-----------------------------------------------------------------------------
-static Matrix4 ConvertSteamVRMatrixToMatrix4(const vr::HmdMatrix34_t &matPose)
-{
-    Matrix4 matrixObj(
-        matPose.m[0][0], matPose.m[1][0], matPose.m[2][0], 0.0,
-        matPose.m[0][1], matPose.m[1][1], matPose.m[2][1], 0.0,
-        matPose.m[0][2], matPose.m[1][2], matPose.m[2][2], 0.0,
-        matPose.m[0][3], matPose.m[1][3], matPose.m[2][3], 1.0f);
-    return matrixObj;
-}
+#include <chrono>
+#include <math.h>
 
 //-----------------------------------------------------------------------------
 // Purpose: Helper to get a string from a tracked device property and turn it
@@ -31,7 +20,8 @@ static std::string GetTrackedDeviceString(vr::IVRSystem *pHmd, vr::TrackedDevice
     return sResult;
 }
 
-HMD::HMD()
+HMD::HMD(PoseModel posePrediction)
+    : m_posePrediction(posePrediction)
 {
     for (int nDevice = 0; nDevice < vr::k_unMaxTrackedDeviceCount; ++nDevice)
     {
@@ -103,21 +93,15 @@ Matrix4 HMD::GetHMDMatrixProjectionEye(vr::Hmd_Eye nEye)
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: Gets an HMDMatrixPoseEye with respect to nEye.
+// Purpose: Gets an HMDMatrixPoseEye with respect to nEye, head to eye.
 //-----------------------------------------------------------------------------
-Matrix4 HMD::GetHMDMatrixPoseEye(vr::Hmd_Eye nEye)
+RigidTransform HMD::GetHMDMatrixPoseEye(vr::Hmd_Eye nEye)
 {
     if (!m_pHMD)
-        return Matrix4();
+        return RigidTransform();
 
-    vr::HmdMatrix34_t matEyeRight = m_pHMD->GetEyeToHeadTransform(nEye);
-    Matrix4 matrixObj(
-        matEyeRight.m[0][0], matEyeRight.m[1][0], matEyeRight.m[2][0], 0.0,
-        matEyeRight.m[0][1], matEyeRight.m[1][1], matEyeRight.m[2][1], 0.0,
-        matEyeRight.m[0][2], matEyeRight.m[1][2], matEyeRight.m[2][2], 0.0,
-        matEyeRight.m[0][3], matEyeRight.m[1][3], matEyeRight.m[2][3], 1.0f);
-
-    return matrixObj.invert();
+    vr::HmdMatrix34_t matEyeToHead = m_pHMD->GetEyeToHeadTransform(nEye);
+    return RigidTransform::FromHmdMatrix34(matEyeToHead.m).Inverse();
 }
 
 //-----------------------------------------------------------------------------
@@ -126,14 +110,15 @@ Matrix4 HMD::GetHMDMatrixPoseEye(vr::Hmd_Eye nEye)
 //-----------------------------------------------------------------------------
 Matrix4 HMD::GetCurrentViewProjectionMatrix(vr::Hmd_Eye nEye)
 {
+    // the two rigid transforms compose as 3x4s, one 4x4 product for the projection
     Matrix4 matMVP;
     if (nEye == vr::Eye_Left)
     {
-        matMVP = m_mat4ProjectionLeft * m_mat4eyePosLeft * m_mat4HMDPose;
+        matMVP = m_mat4ProjectionLeft * (m_poseEyeLeft * m_poseHMD).ToMatrix4();
     }
     else if (nEye == vr::Eye_Right)
     {
-        matMVP = m_mat4ProjectionRight * m_mat4eyePosRight * m_mat4HMDPose;
+        matMVP = m_mat4ProjectionRight * (m_poseEyeRight * m_poseHMD).ToMatrix4();
     }
 
     return matMVP;
@@ -148,6 +133,10 @@ int HMD::UpdateHMDMatrixPose()
         return 0;
 
     vr::VRCompositor()->WaitGetPoses(m_rTrackedDevicePose, vr::k_unMaxTrackedDeviceCount, NULL, 0);
+    // those are already predicted for the next frame's photons, the history
+    // keeps what the devices measure now so PredictPoses has a real interval
+    double fSampleTime = Now();
+    m_pHMD->GetDeviceToAbsoluteTrackingPose(vr::VRCompositor()->GetTrackingSpace(), 0, m_rTrackedDeviceSample, vr::k_unMaxTrackedDeviceCount);
 
     auto m_iValidPoseCount = 0;
     m_strPoseClasses = "";
@@ -156,7 +145,7 @@ int HMD::UpdateHMDMatrixPose()
         if (m_rTrackedDevicePose[nDevice].bPoseIsValid)
         {
             m_iValidPoseCount++;
-            m_rmat4DevicePose[nDevice] = ConvertSteamVRMatrixToMatrix4(m_rTrackedDevicePose[nDevice].mDeviceToAbsoluteTracking);
+            m_rPoseDevice[nDevice] = RigidTransform::FromHmdMatrix34(m_rTrackedDevicePose[nDevice].mDeviceToAbsoluteTracking.m);
             if (m_rDevClassChar[nDevice] == 0)
             {
                 switch (m_pHMD->GetTrackedDeviceClass(nDevice))
@@ -183,22 +172,93 @@ int HMD::UpdateHMDMatrixPose()
             }
             m_strPoseClasses += m_rDevClassChar[nDevice];
         }
+
+        const vr::TrackedDevicePose_t &measured = m_rTrackedDeviceSample[nDevice];
+        if (measured.bPoseIsValid)
+        {
+            PoseSample sample;
+            sample.fTime = fSampleTime;
+            sample.pose = RigidTransform::FromHmdMatrix34(measured.mDeviceToAbsoluteTracking.m);
+            sample.velocity = Vector3(measured.vVelocity.v[0], measured.vVelocity.v[1], measured.vVelocity.v[2]);
+            sample.angularVelocity = Vector3(measured.vAngularVelocity.v[0], measured.vAngularVelocity.v[1], measured.vAngularVelocity.v[2]);
+            sample.bHasVelocity = true;
+            m_rPoseHistory[nDevice].Add(sample);
+        }
+        else
+        {
+            // a device that comes back should not extrapolate across the gap
+            m_rPoseHistory[nDevice].Clear();
+        }
     }
 
     if (m_rTrackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd].bPoseIsValid)
     {
-        m_mat4HMDPose = m_rmat4DevicePose[vr::k_unTrackedDeviceIndex_Hmd];
-        m_mat4HMDPose.invert();
+        m_poseHMD = m_rPoseDevice[vr::k_unTrackedDeviceIndex_Hmd].Inverse();
     }
 
     return m_iValidPoseCount;
 }
+//-----------------------------------------------------------------------------
+// Purpose: Replaces the runtime's render poses with the history's measured
+//          poses carried to the photons of the frame about to be rendered.
+//          Hold keeps the runtime's own prediction.
+//-----------------------------------------------------------------------------
+void HMD::PredictPoses()
+{
+    if (!m_pHMD || m_posePrediction == PoseModel::Hold)
+        return;
+
+    double fPhotonTime = Now() + SecondsToPhotons();
+    for (int nDevice = 0; nDevice < vr::k_unMaxTrackedDeviceCount; ++nDevice)
+    {
+        if (m_rTrackedDevicePose[nDevice].bPoseIsValid && m_rPoseHistory[nDevice].Count() > 0)
+        {
+            m_rPoseDevice[nDevice] = PredictDevicePose(nDevice, fPhotonTime, m_posePrediction);
+        }
+    }
+    if (m_rTrackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd].bPoseIsValid)
+    {
+        m_poseHMD = m_rPoseDevice[vr::k_unTrackedDeviceIndex_Hmd].Inverse();
+    }
+}
+
+RigidTransform HMD::PredictDevicePose(uint32_t unTrackedDevice, double fTime, PoseModel model) const
+{
+    return m_rPoseHistory[unTrackedDevice].Predict(fTime, model);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Seconds from now until the next frame's photons leave the display
+//-----------------------------------------------------------------------------
+float HMD::SecondsToPhotons() const
+{
+    if (!m_pHMD)
+        return 0;
+
+    float fSecondsSinceLastVsync;
+    m_pHMD->GetTimeSinceLastVsync(&fSecondsSinceLastVsync, NULL);
+    float fDisplayFrequency = m_pHMD->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+    float fVsyncToPhotons = m_pHMD->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
+    float fFrameDuration = fDisplayFrequency > 0 ? 1.0f / fDisplayFrequency : 0;
+    // a missed vsync reports more than a frame, the next vsync is still within one
+    if (fFrameDuration > 0)
+    {
+        fSecondsSinceLastVsync = fmodf(fSecondsSinceLastVsync, fFrameDuration);
+    }
+    return fFrameDuration - fSecondsSinceLastVsync + fVsyncToPhotons;
+}
+
+double HMD::Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void HMD::SetupCameras()
 {
     m_mat4ProjectionLeft = GetHMDMatrixProjectionEye(vr::Eye_Left);
     m_mat4ProjectionRight = GetHMDMatrixProjectionEye(vr::Eye_Right);
-    m_mat4eyePosLeft = GetHMDMatrixPoseEye(vr::Eye_Left);
-    m_mat4eyePosRight = GetHMDMatrixPoseEye(vr::Eye_Right);
+    m_poseEyeLeft = GetHMDMatrixPoseEye(vr::Eye_Left);
+    m_poseEyeRight = GetHMDMatrixPoseEye(vr::Eye_Right);
 }
 
 bool HMD::PoseIsValid(uint32_t unTrackedDevice)
@@ -1,5 +1,7 @@
 #pragma once
 #include "Matrices.h"
+#include "RigidTransform.h"
+#include "PosePrediction.h"
 #include <openvr.h>
 #include <string>
 #include "stdint.h"
@@ -9,9 +11,9 @@ class HMD
     std::string m_strPoseClasses;
     vr::IVRSystem *m_pHMD = nullptr;
 
-    Matrix4 m_mat4HMDPose;
-    Matrix4 m_mat4eyePosLeft;
-    Matrix4 m_mat4eyePosRight;
+    RigidTransform m_poseHMD; // tracking space to head, the inverse of the HMD's device pose
+    RigidTransform m_poseEyeLeft; // head to eye
+    RigidTransform m_poseEyeRight;
 
     Matrix4 m_mat4ProjectionCenter;
     Matrix4 m_mat4ProjectionLeft;
@@ -20,12 +22,15 @@ class HMD
     float m_fFarClip = 30.0f;
 
     vr::TrackedDevicePose_t m_rTrackedDevicePose[vr::k_unMaxTrackedDeviceCount];
-    Matrix4 m_rmat4DevicePose[vr::k_unMaxTrackedDeviceCount];
+    vr::TrackedDevicePose_t m_rTrackedDeviceSample[vr::k_unMaxTrackedDeviceCount]; // unpredicted, for the history
+    RigidTransform m_rPoseDevice[vr::k_unMaxTrackedDeviceCount];
+    PoseHistory m_rPoseHistory[vr::k_unMaxTrackedDeviceCount];
+    PoseModel m_posePrediction = PoseModel::Hold;
     bool m_rbShowTrackedDevice[vr::k_unMaxTrackedDeviceCount];
     char m_rDevClassChar[vr::k_unMaxTrackedDeviceCount]; // for each device, a character representing its class
 
 public:
-    HMD();
+    HMD(PoseModel posePrediction = PoseModel::Hold);
     ~HMD();
     bool Initialize();
     vr::IVRSystem *Hmd() const { return m_pHMD; }
@@ -36,7 +41,7 @@ public:
 
     void SetupCameras();
     Matrix4 GetHMDMatrixProjectionEye(vr::Hmd_Eye nEye);
-    Matrix4 GetHMDMatrixPoseEye(vr::Hmd_Eye nEye);
+    RigidTransform GetHMDMatrixPoseEye(vr::Hmd_Eye nEye);
     Matrix4 GetCurrentViewProjectionMatrix(vr::Hmd_Eye nEye);
     int UpdateHMDMatrixPose();
     bool PoseIsValid(uint32_t unTrackedDevice);
@@ -44,6 +49,12 @@ public:
     {
         return m_rbShowTrackedDevice[unTrackedDevice];
     }
-    const Matrix4 &DevicePose(uint32_t unTrackedDevice) const { return m_rmat4DevicePose[unTrackedDevice]; }
+    const RigidTransform &DevicePose(uint32_t unTrackedDevice) const { return m_rPoseDevice[unTrackedDevice]; }
+    const PoseHistory &DevicePoseHistory(uint32_t unTrackedDevice) const { return m_rPoseHistory[unTrackedDevice]; }
+    // fTime in seconds on the same clock as Now()
+    RigidTransform PredictDevicePose(uint32_t unTrackedDevice, double fTime, PoseModel model) const;
+    void PredictPoses();
+    float SecondsToPhotons() const;
+    static double Now();
     void Update();
 };
@@ -0,0 +1,24 @@
+#pragma once
+#include <stddef.h>
+
+///
+/// Read only view of a whole file. Pages fault in from the OS cache on first touch.
+///
+class MappedFile
+{
+    const unsigned char *m_pData = nullptr;
+    size_t m_nSize = 0;
+
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // false if the file is missing or empty
+    bool Open(const char *pchPath);
+    void Close();
+
+    const unsigned char *Data() const { return m_pData; }
+    size_t Size() const { return m_nSize; }
+};
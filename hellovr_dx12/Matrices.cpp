@@ -144,12 +144,24 @@ Matrix3& Matrix3::invert()
 ///////////////////////////////////////////////////////////////////////////////
 Matrix4& Matrix4::transpose()
 {
+#if MATRICES_SSE
+    __m128 c0 = _mm_load_ps(&m[0]);
+    __m128 c1 = _mm_load_ps(&m[4]);
+    __m128 c2 = _mm_load_ps(&m[8]);
+    __m128 c3 = _mm_load_ps(&m[12]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_store_ps(&m[0], c0);
+    _mm_store_ps(&m[4], c1);
+    _mm_store_ps(&m[8], c2);
+    _mm_store_ps(&m[12], c3);
+#else
     std::swap(m[1],  m[4]);
     std::swap(m[2],  m[8]);
     std::swap(m[3],  m[12]);
     std::swap(m[6],  m[9]);
     std::swap(m[7],  m[13]);
     std::swap(m[11], m[14]);
+#endif
 
     return *this;
 }
@@ -341,6 +353,51 @@ Matrix4& Matrix4::invertProjective()
 
 
 
+#if MATRICES_SSE
+///////////////////////////////////////////////////////////////////////////////
+// one column of adj(M) from a row r of M and six 2x2 determinants d of the
+// other pair of rows, d = (d0,d1,d2,d3) and (d4,d5,d4,d5):
+//   ( r1*d5 - r2*d4 + r3*d3,
+//    -r0*d5 + r2*d2 - r3*d1,
+//     r0*d4 - r1*d2 + r3*d0,
+//    -r0*d3 + r1*d1 - r2*d0 )
+// returned without the alternating signs, which the caller applies
+///////////////////////////////////////////////////////////////////////////////
+static inline __m128 adjugateColumn(__m128 r, __m128 dLo, __m128 dHi)
+{
+    __m128 d4d3 = _mm_shuffle_ps(dHi, dLo, _MM_SHUFFLE(3,3,0,0));   // (d4,d4,d3,d3)
+    __m128 d4d2 = _mm_shuffle_ps(dHi, dLo, _MM_SHUFFLE(1,2,0,0));   // (d4,d4,d2,d1)
+    __m128 q1 = _mm_shuffle_ps(dHi, d4d3, _MM_SHUFFLE(2,0,1,1));    // (d5,d5,d4,d3)
+    __m128 q2 = _mm_shuffle_ps(d4d2, d4d2, _MM_SHUFFLE(3,2,2,0));   // (d4,d2,d2,d1)
+    __m128 q3 = _mm_shuffle_ps(dLo, dLo, _MM_SHUFFLE(0,0,1,3));     // (d3,d1,d0,d0)
+    __m128 c = _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(0,0,0,1)), q1);
+    c = _mm_sub_ps(c, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(1,1,2,2)), q2));
+    return _mm_add_ps(c, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(2,3,3,3)), q3));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the six 2x2 determinants of rows a and b, a[p]*b[q] - b[p]*a[q] for the
+// column pairs (0,1),(0,2),(0,3),(1,2) in lo and (1,3),(2,3) twice in hi
+///////////////////////////////////////////////////////////////////////////////
+static inline void pairDeterminants(__m128 a, __m128 b, __m128& lo, __m128& hi)
+{
+    __m128 ap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(1,0,0,0));
+    __m128 bp = _mm_shuffle_ps(b, b, _MM_SHUFFLE(1,0,0,0));
+    __m128 aq = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,2,1));
+    __m128 bq = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2,3,2,1));
+    lo = _mm_sub_ps(_mm_mul_ps(ap, bq), _mm_mul_ps(bp, aq));
+    ap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,1,2,1));
+    bp = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2,1,2,1));
+    aq = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3,3,3,3));
+    bq = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,3,3,3));
+    hi = _mm_sub_ps(_mm_mul_ps(ap, bq), _mm_mul_ps(bp, aq));
+}
+#endif
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // compute the inverse of a general 4x4 matrix using Cramer's Rule
 // If cannot find inverse, return indentity matrix
@@ -348,6 +405,42 @@ Matrix4& Matrix4::invertProjective()
 ///////////////////////////////////////////////////////////////////////////////
 Matrix4& Matrix4::invertGeneral()
 {
+#if MATRICES_SSE
+    // rows of M, then the 2x2 determinants of rows 0,1 (s) and rows 2,3 (c)
+    // that every 3x3 cofactor expands into (Laplace expansion)
+    __m128 r0 = _mm_load_ps(&m[0]);
+    __m128 r1 = _mm_load_ps(&m[4]);
+    __m128 r2 = _mm_load_ps(&m[8]);
+    __m128 r3 = _mm_load_ps(&m[12]);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    __m128 sLo, sHi, cLo, cHi;
+    pairDeterminants(r0, r1, sLo, sHi);
+    pairDeterminants(r2, r3, cLo, cHi);
+
+    const __m128 signPN = _mm_castsi128_ps(_mm_set_epi32((int)0x80000000, 0, (int)0x80000000, 0));
+    const __m128 signNP = _mm_castsi128_ps(_mm_set_epi32(0, (int)0x80000000, 0, (int)0x80000000));
+    __m128 col0 = _mm_xor_ps(adjugateColumn(r1, cLo, cHi), signPN);
+    __m128 col1 = _mm_xor_ps(adjugateColumn(r0, cLo, cHi), signNP);
+    __m128 col2 = _mm_xor_ps(adjugateColumn(r3, sLo, sHi), signPN);
+    __m128 col3 = _mm_xor_ps(adjugateColumn(r2, sLo, sHi), signNP);
+
+    // row 0 of M dotted with column 0 of adj(M)
+    __m128 dot = _mm_mul_ps(r0, col0);
+    dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(2,3,0,1)));
+    dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1,0,3,2)));
+    float determinant = _mm_cvtss_f32(dot);
+    if(fabs(determinant) <= EPSILON)
+    {
+        return identity();
+    }
+
+    __m128 invDeterminant = _mm_set1_ps(1.0f / determinant);
+    _mm_store_ps(&m[0],  _mm_mul_ps(col0, invDeterminant));
+    _mm_store_ps(&m[4],  _mm_mul_ps(col1, invDeterminant));
+    _mm_store_ps(&m[8],  _mm_mul_ps(col2, invDeterminant));
+    _mm_store_ps(&m[12], _mm_mul_ps(col3, invDeterminant));
+    return *this;
+#else
     // get cofactors of minor matrices
     float cofactor0 = getCofactor(m[5],m[6],m[7], m[9],m[10],m[11], m[13],m[14],m[15]);
     float cofactor1 = getCofactor(m[4],m[6],m[7], m[8],m[10],m[11], m[12],m[14],m[15]);
@@ -401,6 +494,7 @@ Matrix4& Matrix4::invertGeneral()
     m[15]=  invDeterminant * cofactor15;
 
     return *this;
+#endif
 }
 
 
@@ -579,3 +673,130 @@ Matrix4& Matrix4::rotateZ(float angle)
 
     return *this;
 }
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// batch point transforms
+// Every path sums in the order of the scalar one,
+//   x' = m[0]*x + m[4]*y + m[8]*z + m[12]
+// 4 (8 with AVX) points are done at once, one coordinate per register,
+// transposed back to a point per register to store.
+///////////////////////////////////////////////////////////////////////////////
+static inline void transformPoint(const float* m, float x, float y, float z, float* dst)
+{
+    dst[0] = m[0]*x + m[4]*y + m[8]*z  + m[12];
+    dst[1] = m[1]*x + m[5]*y + m[9]*z  + m[13];
+    dst[2] = m[2]*x + m[6]*y + m[10]*z + m[14];
+}
+
+static inline float* advance(float* p, size_t stride)
+{
+    return (float*)((char*)p + stride);
+}
+
+#if MATRICES_SSE
+// the matrix broadcast an element per register, for the vector loops
+struct BroadcastMatrix
+{
+    __m128 e[12];
+
+    explicit BroadcastMatrix(const float* m)
+    {
+        for(int i = 0; i < 4; ++i)
+        {
+            e[i]     = _mm_set1_ps(m[i * 4]);         // x' terms
+            e[4 + i] = _mm_set1_ps(m[i * 4 + 1]);     // y' terms
+            e[8 + i] = _mm_set1_ps(m[i * 4 + 2]);     // z' terms
+        }
+    }
+
+    inline __m128 row(int r, __m128 x, __m128 y, __m128 z) const
+    {
+        __m128 v = _mm_mul_ps(e[r * 4], x);
+        v = _mm_add_ps(v, _mm_mul_ps(e[r * 4 + 1], y));
+        v = _mm_add_ps(v, _mm_mul_ps(e[r * 4 + 2], z));
+        return _mm_add_ps(v, e[r * 4 + 3]);
+    }
+};
+
+// store 4 transformed points, x'/y'/z' per register, as 12 bytes each
+static inline float* storePoints(__m128 x, __m128 y, __m128 z, float* dst, size_t dstStride)
+{
+    __m128 w = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    const __m128 points[4] = { x, y, z, w };
+    for(int i = 0; i < 4; ++i)
+    {
+        _mm_storel_pi((__m64*)dst, points[i]);
+        _mm_store_ss(dst + 2, _mm_movehl_ps(points[i], points[i]));
+        dst = advance(dst, dstStride);
+    }
+    return dst;
+}
+
+#if MATRICES_AVX
+struct BroadcastMatrix8
+{
+    __m256 e[12];
+
+    explicit BroadcastMatrix8(const float* m)
+    {
+        for(int i = 0; i < 4; ++i)
+        {
+            e[i]     = _mm256_set1_ps(m[i * 4]);
+            e[4 + i] = _mm256_set1_ps(m[i * 4 + 1]);
+            e[8 + i] = _mm256_set1_ps(m[i * 4 + 2]);
+        }
+    }
+
+    inline __m256 row(int r, __m256 x, __m256 y, __m256 z) const
+    {
+        __m256 v = _mm256_mul_ps(e[r * 4], x);
+        v = _mm256_add_ps(v, _mm256_mul_ps(e[r * 4 + 1], y));
+        v = _mm256_add_ps(v, _mm256_mul_ps(e[r * 4 + 2], z));
+        return _mm256_add_ps(v, e[r * 4 + 3]);
+    }
+};
+
+static inline float* storePoints8(const BroadcastMatrix8& bm, __m256 x, __m256 y, __m256 z, float* dst, size_t dstStride)
+{
+    __m256 tx = bm.row(0, x, y, z);
+    __m256 ty = bm.row(1, x, y, z);
+    __m256 tz = bm.row(2, x, y, z);
+    dst = storePoints(_mm256_castps256_ps128(tx), _mm256_castps256_ps128(ty), _mm256_castps256_ps128(tz), dst, dstStride);
+    return storePoints(_mm256_extractf128_ps(tx, 1), _mm256_extractf128_ps(ty, 1), _mm256_extractf128_ps(tz, 1), dst, dstStride);
+}
+#endif
+#endif
+
+
+
+void transformPoints(const Matrix4& m, const float* xs, const float* ys, const float* zs,
+                     float* dst, size_t dstStride, size_t count)
+{
+    const float* mat = m.get();
+    size_t i = 0;
+#if MATRICES_SSE
+#if MATRICES_AVX
+    BroadcastMatrix8 bm8(mat);
+    for(; i + 8 <= count; i += 8)
+    {
+        dst = storePoints8(bm8, _mm256_loadu_ps(xs + i), _mm256_loadu_ps(ys + i), _mm256_loadu_ps(zs + i), dst, dstStride);
+    }
+#endif
+    BroadcastMatrix bm(mat);
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 z = _mm_loadu_ps(zs + i);
+        dst = storePoints(bm.row(0, x, y, z), bm.row(1, x, y, z), bm.row(2, x, y, z), dst, dstStride);
+    }
+#endif
+    for(; i < count; ++i)
+    {
+        transformPoint(mat, xs[i], ys[i], zs[i], dst);
+        dst = advance(dst, dstStride);
+    }
+}
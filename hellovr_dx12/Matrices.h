@@ -21,8 +21,20 @@
 
 #include <iostream>
 #include <iomanip>
+#include <stddef.h>
 #include "Vectors.h"
 
+// Matrix4's multiply, transforms, transpose and general inverse use SSE on
+// x86, and multiply two columns at a time when the build targets AVX.
+// Define MATRICES_NO_SIMD to get the plain scalar code everywhere.
+#if !defined(MATRICES_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MATRICES_SSE 1
+#include <immintrin.h>
+#ifdef __AVX__
+#define MATRICES_AVX 1
+#endif
+#endif
+
 ///////////////////////////////////////////////////////////////////////////
 // 2x2 matrix
 ///////////////////////////////////////////////////////////////////////////
@@ -207,13 +219,27 @@ private:
                             float m3, float m4, float m5,
                             float m6, float m7, float m8);
 
-    float m[16];
-    float tm[16];                                       // transpose m
+    alignas(16) float m[16];                            // 16-byte aligned columns for SSE
+    alignas(16) float tm[16];                           // transpose m
 
 };
 
 
 
+///////////////////////////////////////////////////////////////////////////
+// batch transform of points (w = 1) by a Matrix4, 4 or 8 at a time
+// The points come as separate x, y and z arrays, which load straight into
+// registers; interleaved ones would have to be transposed first, which costs
+// about what it saves. Each result is written as x,y,z at dst, which then advances dstStride
+// bytes, so positions go straight into an interleaved vertex stream and the
+// rest of each vertex is left alone. The results are bit for bit those of
+// m * Vector4(x, y, z, 1).
+///////////////////////////////////////////////////////////////////////////
+void transformPoints(const Matrix4& m, const float* xs, const float* ys, const float* zs,
+                     float* dst, size_t dstStride, size_t count);
+
+
+
 ///////////////////////////////////////////////////////////////////////////
 // inline functions for Matrix2
 ///////////////////////////////////////////////////////////////////////////
@@ -736,10 +762,22 @@ inline const float* Matrix4::get() const
 
 inline const float* Matrix4::getTranspose()
 {
+#if MATRICES_SSE
+    __m128 c0 = _mm_load_ps(&m[0]);
+    __m128 c1 = _mm_load_ps(&m[4]);
+    __m128 c2 = _mm_load_ps(&m[8]);
+    __m128 c3 = _mm_load_ps(&m[12]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_store_ps(&tm[0], c0);
+    _mm_store_ps(&tm[4], c1);
+    _mm_store_ps(&tm[8], c2);
+    _mm_store_ps(&tm[12], c3);
+#else
     tm[0] = m[0];   tm[1] = m[4];   tm[2] = m[8];   tm[3] = m[12];
     tm[4] = m[1];   tm[5] = m[5];   tm[6] = m[9];   tm[7] = m[13];
     tm[8] = m[2];   tm[9] = m[6];   tm[10]= m[10];  tm[11]= m[14];
     tm[12]= m[3];   tm[13]= m[7];   tm[14]= m[11];  tm[15]= m[15];
+#endif
     return tm;
 }
 
@@ -796,31 +834,90 @@ inline Matrix4& Matrix4::operator-=(const Matrix4& rhs)
 
 
 
+// The SIMD paths weight the columns and sum them in the same order as the
+// scalar expressions, so both give bit for bit the same results.
 inline Vector4 Matrix4::operator*(const Vector4& rhs) const
 {
+#if MATRICES_SSE
+    // broadcast each element rather than load rhs whole: it is often built
+    // just before from scalars, and a 16 byte load of that stalls
+    __m128 r = _mm_mul_ps(_mm_load_ps(&m[0]), _mm_set1_ps(rhs.x));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&m[4]),  _mm_set1_ps(rhs.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&m[8]),  _mm_set1_ps(rhs.z)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&m[12]), _mm_set1_ps(rhs.w)));
+    Vector4 result;
+    _mm_store_ps(&result.x, r);
+    return result;
+#else
     return Vector4(m[0]*rhs.x + m[4]*rhs.y + m[8]*rhs.z  + m[12]*rhs.w,
                    m[1]*rhs.x + m[5]*rhs.y + m[9]*rhs.z  + m[13]*rhs.w,
                    m[2]*rhs.x + m[6]*rhs.y + m[10]*rhs.z + m[14]*rhs.w,
                    m[3]*rhs.x + m[7]*rhs.y + m[11]*rhs.z + m[15]*rhs.w);
+#endif
 }
 
 
 
 inline Vector3 Matrix4::operator*(const Vector3& rhs) const
 {
+#if MATRICES_SSE
+    __m128 r = _mm_mul_ps(_mm_load_ps(&m[0]), _mm_set1_ps(rhs.x));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&m[4]), _mm_set1_ps(rhs.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&m[8]), _mm_set1_ps(rhs.z)));
+    alignas(16) float result[4];
+    _mm_store_ps(result, r);
+    return Vector3(result[0], result[1], result[2]);
+#else
     return Vector3(m[0]*rhs.x + m[4]*rhs.y + m[8]*rhs.z,
                    m[1]*rhs.x + m[5]*rhs.y + m[9]*rhs.z,
                    m[2]*rhs.x + m[6]*rhs.y + m[10]*rhs.z);
+#endif
 }
 
 
 
 inline Matrix4 Matrix4::operator*(const Matrix4& n) const
 {
+#if MATRICES_AVX
+    // both halves hold the same column of this, and each half of n's pair of
+    // columns is broadcast within its own lane
+    __m256 c0 = _mm256_broadcast_ps((const __m128*)&m[0]);
+    __m256 c1 = _mm256_broadcast_ps((const __m128*)&m[4]);
+    __m256 c2 = _mm256_broadcast_ps((const __m128*)&m[8]);
+    __m256 c3 = _mm256_broadcast_ps((const __m128*)&m[12]);
+    Matrix4 result;
+    for(int i = 0; i < 16; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(&n.m[i]);
+        __m256 r = _mm256_mul_ps(c0, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(0,0,0,0)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(1,1,1,1))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2,2,2,2))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(3,3,3,3))));
+        _mm256_storeu_ps(&result.m[i], r);
+    }
+    return result;
+#elif MATRICES_SSE
+    __m128 c0 = _mm_load_ps(&m[0]);
+    __m128 c1 = _mm_load_ps(&m[4]);
+    __m128 c2 = _mm_load_ps(&m[8]);
+    __m128 c3 = _mm_load_ps(&m[12]);
+    Matrix4 result;
+    for(int i = 0; i < 16; i += 4)
+    {
+        __m128 v = _mm_load_ps(&n.m[i]);
+        __m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0,0,0,0)));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1,1,1,1))));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,2,2))));
+        r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,3,3))));
+        _mm_store_ps(&result.m[i], r);
+    }
+    return result;
+#else
     return Matrix4(m[0]*n[0]  + m[4]*n[1]  + m[8]*n[2]  + m[12]*n[3],   m[1]*n[0]  + m[5]*n[1]  + m[9]*n[2]  + m[13]*n[3],   m[2]*n[0]  + m[6]*n[1]  + m[10]*n[2]  + m[14]*n[3],   m[3]*n[0]  + m[7]*n[1]  + m[11]*n[2]  + m[15]*n[3],
                    m[0]*n[4]  + m[4]*n[5]  + m[8]*n[6]  + m[12]*n[7],   m[1]*n[4]  + m[5]*n[5]  + m[9]*n[6]  + m[13]*n[7],   m[2]*n[4]  + m[6]*n[5]  + m[10]*n[6]  + m[14]*n[7],   m[3]*n[4]  + m[7]*n[5]  + m[11]*n[6]  + m[15]*n[7],
                    m[0]*n[8]  + m[4]*n[9]  + m[8]*n[10] + m[12]*n[11],  m[1]*n[8]  + m[5]*n[9]  + m[9]*n[10] + m[13]*n[11],  m[2]*n[8]  + m[6]*n[9]  + m[10]*n[10] + m[14]*n[11],  m[3]*n[8]  + m[7]*n[9]  + m[11]*n[10] + m[15]*n[11],
                    m[0]*n[12] + m[4]*n[13] + m[8]*n[14] + m[12]*n[15],  m[1]*n[12] + m[5]*n[13] + m[9]*n[14] + m[13]*n[15],  m[2]*n[12] + m[6]*n[13] + m[10]*n[14] + m[14]*n[15],  m[3]*n[12] + m[7]*n[13] + m[11]*n[14] + m[15]*n[15]);
+#endif
 }
 
 
@@ -883,7 +980,23 @@ inline Matrix4 operator*(float s, const Matrix4& rhs)
 
 inline Vector4 operator*(const Vector4& v, const Matrix4& m)
 {
+#if MATRICES_SSE
+    // rows of m weighted by v, the transform of the transpose
+    __m128 r0 = _mm_load_ps(&m.m[0]);
+    __m128 r1 = _mm_load_ps(&m.m[4]);
+    __m128 r2 = _mm_load_ps(&m.m[8]);
+    __m128 r3 = _mm_load_ps(&m.m[12]);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    __m128 r = _mm_mul_ps(r0, _mm_set1_ps(v.x));
+    r = _mm_add_ps(r, _mm_mul_ps(r1, _mm_set1_ps(v.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(r2, _mm_set1_ps(v.z)));
+    r = _mm_add_ps(r, _mm_mul_ps(r3, _mm_set1_ps(v.w)));
+    Vector4 result;
+    _mm_store_ps(&result.x, r);
+    return result;
+#else
     return Vector4(v.x*m[0] + v.y*m[1] + v.z*m[2] + v.w*m[3],  v.x*m[4] + v.y*m[5] + v.z*m[6] + v.w*m[7],  v.x*m[8] + v.y*m[9] + v.z*m[10] + v.w*m[11], v.x*m[12] + v.y*m[13] + v.z*m[14] + v.w*m[15]);
+#endif
 }
 
 
@@ -0,0 +1,130 @@
+#include "MipStreaming.h"
+#include <algorithm>
+
+int GetMipStreamTailLevel(int nWidth, int nHeight, int nMipLevels)
+{
+    int nMip = 0;
+    while (nMip < nMipLevels - 1 && std::max(nWidth, nHeight) > MIP_STREAM_TAIL_SIZE)
+    {
+        nWidth = std::max(nWidth / 2, 1);
+        nHeight = std::max(nHeight / 2, 1);
+        nMip++;
+    }
+    return nMip;
+}
+
+int MipStreamScheduler::AddTexture(const size_t *pLevelBytes, int nMipLevels, int nTailMip)
+{
+    Entry entry;
+    entry.levelBytes.assign(pLevelBytes, pLevelBytes + nMipLevels);
+    entry.nTailMip = std::min(std::max(nTailMip, 0), nMipLevels - 1);
+    entry.nResidentMip = nMipLevels;
+    entry.nReadyMip = nMipLevels;
+    entry.bActive = true;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_textures.size(); i++)
+    {
+        if (!m_textures[i].bActive)
+        {
+            m_textures[i] = std::move(entry);
+            return (int)i;
+        }
+    }
+    m_textures.push_back(std::move(entry));
+    return (int)m_textures.size() - 1;
+}
+
+void MipStreamScheduler::RemoveTexture(int nTexture)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_textures[nTexture].bActive = false;
+    m_textures[nTexture].levelBytes.clear();
+}
+
+void MipStreamScheduler::SetLevelsReady(int nTexture, int nMip)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry &entry = m_textures[nTexture];
+    entry.nReadyMip = std::min(entry.nReadyMip, std::max(nMip, 0));
+}
+
+size_t MipStreamScheduler::Update(IMipStreamCommands &commands, size_t nByteBudget)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<int> previous(m_textures.size());
+    for (size_t i = 0; i < m_textures.size(); i++)
+    {
+        previous[i] = m_textures[i].nResidentMip;
+    }
+
+    size_t nSpent = 0;
+    bool bOversized = false;
+    while (!bOversized)
+    {
+        // tail levels first, then the smallest next level of any texture
+        int nBest = -1;
+        bool bBestTail = false;
+        size_t nBestBytes = 0;
+        for (size_t i = 0; i < m_textures.size(); i++)
+        {
+            const Entry &entry = m_textures[i];
+            const int nNext = entry.nResidentMip - 1;
+            if (!entry.bActive || nNext < 0 || nNext < entry.nReadyMip)
+                continue;
+
+            const bool bTail = nNext >= entry.nTailMip;
+            const size_t nBytes = entry.levelBytes[nNext];
+            if (nBest < 0 || (bTail && !bBestTail) || (bTail == bBestTail && nBytes < nBestBytes))
+            {
+                nBest = (int)i;
+                bBestTail = bTail;
+                nBestBytes = nBytes;
+            }
+        }
+        if (nBest < 0)
+            break;
+
+        if (!bBestTail)
+        {
+            if (nSpent + nBestBytes > nByteBudget)
+            {
+                if (nSpent > 0 || nByteBudget == 0)
+                    break;
+                bOversized = true;
+            }
+            nSpent += nBestBytes;
+        }
+
+        Entry &entry = m_textures[nBest];
+        entry.nResidentMip--;
+        commands.CopyMip(nBest, entry.nResidentMip);
+    }
+
+    for (size_t i = 0; i < m_textures.size(); i++)
+    {
+        if (m_textures[i].bActive && m_textures[i].nResidentMip != previous[i])
+        {
+            commands.SetMostDetailedMip((int)i, m_textures[i].nResidentMip);
+        }
+    }
+    return nSpent;
+}
+
+int MipStreamScheduler::MostDetailedMip(int nTexture) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_textures[nTexture].nResidentMip;
+}
+
+bool MipStreamScheduler::IsComplete() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &entry : m_textures)
+    {
+        if (entry.bActive && entry.nResidentMip > 0)
+            return false;
+    }
+    return true;
+}
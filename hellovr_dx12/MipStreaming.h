@@ -0,0 +1,73 @@
+#pragma once
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+
+// Levels this size and below on both sides form the tail uploaded before the first frame
+const int MIP_STREAM_TAIL_SIZE = 64;
+
+// Most detailed mip of the tail of a nWidth x nHeight chain of nMipLevels
+int GetMipStreamTailLevel(int nWidth, int nHeight, int nMipLevels);
+
+///
+/// What the scheduler records. The D3D12 implementation copies a level out of
+/// the texture's upload heap and rewrites its SRV; tests record the calls.
+///
+class IMipStreamCommands
+{
+public:
+    virtual ~IMipStreamCommands() = default;
+
+    // Copy one mip level into the texture and leave it shader readable
+    virtual void CopyMip(int nTexture, int nMip) = 0;
+
+    // Let shaders sample nMip and everything coarser, called after that frame's copies
+    virtual void SetMostDetailedMip(int nTexture, int nMip) = 0;
+};
+
+///
+/// Picks the mip levels to upload each frame. A texture's levels land
+/// coarsest first so its resident range stays contiguous; across textures the
+/// smallest pending level goes next. Thread safe, CPU data may become ready
+/// on a worker while the render thread updates.
+///
+class MipStreamScheduler
+{
+    struct Entry
+    {
+        std::vector<size_t> levelBytes;
+        int nTailMip;
+        int nResidentMip; // most detailed level on the GPU, nMipLevels when none
+        int nReadyMip;    // most detailed level with CPU data, nMipLevels when none
+        bool bActive;
+    };
+    mutable std::mutex m_mutex;
+    std::vector<Entry> m_textures;
+
+public:
+    //-----------------------------------------------------------------------------
+    // Purpose: Register a texture whose mip n uploads pLevelBytes[n] bytes.
+    //          Levels nTailMip and coarser ignore the budget. No level is
+    //          ready yet. Returns the id used by the other calls.
+    //-----------------------------------------------------------------------------
+    int AddTexture(const size_t *pLevelBytes, int nMipLevels, int nTailMip);
+    void RemoveTexture(int nTexture);
+
+    // CPU data of nMip and coarser is available
+    void SetLevelsReady(int nTexture, int nMip);
+
+    //-----------------------------------------------------------------------------
+    // Purpose: Record this frame's uploads. Ready tail levels always go; other
+    //          levels go while their bytes fit in nByteBudget, and a single
+    //          level larger than the whole budget goes alone so it cannot
+    //          stall forever. A budget of 0 uploads tails only. Returns the
+    //          bytes spent against the budget.
+    //-----------------------------------------------------------------------------
+    size_t Update(IMipStreamCommands &commands, size_t nByteBudget);
+
+    // nMipLevels while nothing is resident
+    int MostDetailedMip(int nTexture) const;
+
+    // Every registered texture has all of its levels resident
+    bool IsComplete() const;
+};
@@ -1,177 +1,229 @@
 #include "Models.h"
 #include "d3dx12.h"
-#include "GenMipMapRGBA.h"
 #include "CBV.h"
 #include "dprintf.h"
 #include "Matrices.h"
 #include "Hmd.h"
+#include "Texture.h"
 #include <vector>
 
-static void ThreadSleep(unsigned long nMilliseconds)
+//-----------------------------------------------------------------------------
+// IVRRenderModels for the loader, each call polls once and returns
+//-----------------------------------------------------------------------------
+class OpenVRRenderModelSource : public IRenderModelSource
 {
-    ::Sleep(nMilliseconds);
-}
+public:
+    RenderModelLoadStatus LoadModel(const char *pchName, RenderModelAsset *pModel) override
+    {
+        vr::RenderModel_t *pVRModel;
+        vr::EVRRenderModelError error = vr::VRRenderModels()->LoadRenderModel_Async(pchName, &pVRModel);
+        if (error == vr::VRRenderModelError_Loading)
+            return RenderModelLoadStatus::Loading;
+        if (error != vr::VRRenderModelError_None)
+        {
+            dprintf("Unable to load render model %s - %s\n", pchName, vr::VRRenderModels()->GetRenderModelErrorNameFromEnum(error));
+            return RenderModelLoadStatus::Failed;
+        }
 
-class DX12RenderModel
+        pModel->pHandle = pVRModel;
+        pModel->pVertexData = pVRModel->rVertexData;
+        pModel->nVertexStride = sizeof(vr::RenderModel_Vertex_t);
+        pModel->nVertexCount = pVRModel->unVertexCount;
+        pModel->pIndexData = pVRModel->rIndexData;
+        pModel->nTriangleCount = pVRModel->unTriangleCount;
+        pModel->nTextureId = pVRModel->diffuseTextureId;
+        return RenderModelLoadStatus::Ready;
+    }
+    RenderModelLoadStatus LoadTexture(int32_t nTextureId, RenderModelTextureAsset *pTexture) override
+    {
+        vr::RenderModel_TextureMap_t *pVRTexture;
+        vr::EVRRenderModelError error = vr::VRRenderModels()->LoadTexture_Async(nTextureId, &pVRTexture);
+        if (error == vr::VRRenderModelError_Loading)
+            return RenderModelLoadStatus::Loading;
+        if (error != vr::VRRenderModelError_None)
+        {
+            dprintf("Unable to load render texture id:%d\n", nTextureId);
+            return RenderModelLoadStatus::Failed;
+        }
+
+        pTexture->pHandle = pVRTexture;
+        pTexture->pRGBA = pVRTexture->rubTextureMapData;
+        pTexture->nWidth = pVRTexture->unWidth;
+        pTexture->nHeight = pVRTexture->unHeight;
+        return RenderModelLoadStatus::Ready;
+    }
+    void FreeModel(const RenderModelAsset &model) override
+    {
+        vr::VRRenderModels()->FreeRenderModel((vr::RenderModel_t *)model.pHandle);
+    }
+    void FreeTexture(const RenderModelTextureAsset &texture) override
+    {
+        vr::VRRenderModels()->FreeTexture((vr::RenderModel_TextureMap_t *)texture.pHandle);
+    }
+};
+
+//-----------------------------------------------------------------------------
+// Geometry and texture of one render model, shared by every tracked device
+// that shows it
+//-----------------------------------------------------------------------------
+class DX12RenderModel : public RenderModelStaging
 {
     Microsoft::WRL::ComPtr<ID3D12Resource> m_pVertexBuffer;
     D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
     Microsoft::WRL::ComPtr<ID3D12Resource> m_pIndexBuffer;
     D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_pTexture;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_pTextureUploadHeap;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_pConstantBuffer;
-    UINT8 *m_pConstantBufferData[2] = {nullptr, nullptr};
+    Texture m_texture;
     size_t m_unVertexCount;
-    vr::TrackedDeviceIndex_t m_unTrackedDeviceIndex;
-    ID3D12DescriptorHeap *m_pCBVSRVHeap;
     std::string m_sModelName;
+    int m_nRefCount = 0;
+    size_t m_nGpuBytes = 0;
 
 public:
-    DX12RenderModel(const std::string &sRenderModelName)
-        : m_sModelName(sRenderModelName)
+    DX12RenderModel(const std::string &sRenderModelName, const MipFilterOptions &mipFilter)
+        : m_sModelName(sRenderModelName), m_texture(mipFilter)
     {
     }
     ~DX12RenderModel()
     {
     }
     const std::string &GetName() const { return m_sModelName; }
-
-    bool BInit(ID3D12Device *pDevice,
-               ID3D12GraphicsCommandList *pCommandList, ID3D12DescriptorHeap *pCBVSRVHeap,
-               vr::TrackedDeviceIndex_t unTrackedDeviceIndex,
-               const vr::RenderModel_t &vrModel,
-               const vr::RenderModel_TextureMap_t &vrDiffuseTexture)
+    Texture &GetTexture() { return m_texture; }
+    size_t GpuBytes() const { return m_nGpuBytes; }
+
+    // References held by DX12RenderModelInstance, the cache frees the model at zero
+    int AddRef() { return ++m_nRefCount; }
+    int Release() { return --m_nRefCount; }
+
+    //-----------------------------------------------------------------------------
+    // Purpose: Buffers, texture and its mips, no command list involved so a
+    //          worker can run it
+    //-----------------------------------------------------------------------------
+    bool Stage(ID3D12Device *pDevice, const RenderModelAsset &model, const RenderModelTextureAsset &diffuseTexture,
+               WorkerPool *pWorkers)
     {
-        m_unTrackedDeviceIndex = unTrackedDeviceIndex;
-        m_pCBVSRVHeap = pCBVSRVHeap;
+        const UINT nVertexBytes = model.nVertexStride * model.nVertexCount;
+        const UINT nIndexBytes = sizeof(uint16_t) * model.nTriangleCount * 3;
 
         // Create and populate the vertex buffer
         {
-            pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-                                             D3D12_HEAP_FLAG_NONE,
-                                             &CD3DX12_RESOURCE_DESC::Buffer(sizeof(vr::RenderModel_Vertex_t) * vrModel.unVertexCount),
-                                             D3D12_RESOURCE_STATE_GENERIC_READ,
-                                             nullptr,
-                                             IID_PPV_ARGS(&m_pVertexBuffer));
+            if (FAILED(pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+                                                        D3D12_HEAP_FLAG_NONE,
+                                                        &CD3DX12_RESOURCE_DESC::Buffer(nVertexBytes),
+                                                        D3D12_RESOURCE_STATE_GENERIC_READ,
+                                                        nullptr,
+                                                        IID_PPV_ARGS(&m_pVertexBuffer))))
+            {
+                return false;
+            }
 
             UINT8 *pMappedBuffer;
             CD3DX12_RANGE readRange(0, 0);
             m_pVertexBuffer->Map(0, &readRange, reinterpret_cast<void **>(&pMappedBuffer));
-            memcpy(pMappedBuffer, vrModel.rVertexData, sizeof(vr::RenderModel_Vertex_t) * vrModel.unVertexCount);
+            memcpy(pMappedBuffer, model.pVertexData, nVertexBytes);
             m_pVertexBuffer->Unmap(0, nullptr);
 
             m_vertexBufferView.BufferLocation = m_pVertexBuffer->GetGPUVirtualAddress();
-            m_vertexBufferView.StrideInBytes = sizeof(vr::RenderModel_Vertex_t);
-            m_vertexBufferView.SizeInBytes = sizeof(vr::RenderModel_Vertex_t) * vrModel.unVertexCount;
+            m_vertexBufferView.StrideInBytes = model.nVertexStride;
+            m_vertexBufferView.SizeInBytes = nVertexBytes;
         }
 
         // Create and populate the index buffer
         {
-            pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-                                             D3D12_HEAP_FLAG_NONE,
-                                             &CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint16_t) * vrModel.unTriangleCount * 3),
-                                             D3D12_RESOURCE_STATE_GENERIC_READ,
-                                             nullptr,
-                                             IID_PPV_ARGS(&m_pIndexBuffer));
+            if (FAILED(pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+                                                        D3D12_HEAP_FLAG_NONE,
+                                                        &CD3DX12_RESOURCE_DESC::Buffer(nIndexBytes),
+                                                        D3D12_RESOURCE_STATE_GENERIC_READ,
+                                                        nullptr,
+                                                        IID_PPV_ARGS(&m_pIndexBuffer))))
+            {
+                return false;
+            }
 
             UINT8 *pMappedBuffer;
             CD3DX12_RANGE readRange(0, 0);
             m_pIndexBuffer->Map(0, &readRange, reinterpret_cast<void **>(&pMappedBuffer));
-            memcpy(pMappedBuffer, vrModel.rIndexData, sizeof(uint16_t) * vrModel.unTriangleCount * 3);
+            memcpy(pMappedBuffer, model.pIndexData, nIndexBytes);
             m_pIndexBuffer->Unmap(0, nullptr);
 
             m_indexBufferView.BufferLocation = m_pIndexBuffer->GetGPUVirtualAddress();
             m_indexBufferView.Format = DXGI_FORMAT_R16_UINT;
-            m_indexBufferView.SizeInBytes = sizeof(uint16_t) * vrModel.unTriangleCount * 3;
+            m_indexBufferView.SizeInBytes = nIndexBytes;
         }
 
-        // create and populate the texture
+        // create the texture and generate its mips into the upload heap
+        if (!m_texture.StageRGBA(pDevice, diffuseTexture.pRGBA, diffuseTexture.nWidth, diffuseTexture.nHeight, pWorkers))
         {
-            int nImageWidth = vrDiffuseTexture.unWidth;
-            int nImageHeight = vrDiffuseTexture.unHeight;
-            std::vector<D3D12_SUBRESOURCE_DATA> mipLevelData;
-
-            UINT8 *pBaseData = new UINT8[nImageWidth * nImageHeight * 4];
-            memcpy(pBaseData, vrDiffuseTexture.rubTextureMapData, sizeof(UINT8) * nImageWidth * nImageHeight * 4);
-            D3D12_SUBRESOURCE_DATA textureData = {};
-            textureData.pData = &pBaseData[0];
-            textureData.RowPitch = nImageWidth * 4;
-            textureData.SlicePitch = textureData.RowPitch * nImageHeight;
-            mipLevelData.push_back(textureData);
-
-            // Generate mipmaps for the image
-            int nPrevImageIndex = 0;
-            int nMipWidth = nImageWidth;
-            int nMipHeight = nImageHeight;
-
-            while (nMipWidth > 1 && nMipHeight > 1)
-            {
-                UINT8 *pNewImage;
-                ::GenMipMapRGBA((UINT8 *)mipLevelData[nPrevImageIndex].pData, &pNewImage, nMipWidth, nMipHeight, &nMipWidth, &nMipHeight);
+            return false;
+        }
 
-                D3D12_SUBRESOURCE_DATA mipData = {};
-                mipData.pData = pNewImage;
-                mipData.RowPitch = nMipWidth * 4;
-                mipData.SlicePitch = textureData.RowPitch * nMipHeight;
-                mipLevelData.push_back(mipData);
+        m_unVertexCount = model.nTriangleCount * 3;
+        m_nGpuBytes = nVertexBytes + nIndexBytes + (size_t)m_texture.GpuBytes();
 
-                nPrevImageIndex++;
-            }
+        return true;
+    }
 
-            D3D12_RESOURCE_DESC textureDesc = {};
-            textureDesc.MipLevels = (UINT16)mipLevelData.size();
-            textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-            textureDesc.Width = nImageWidth;
-            textureDesc.Height = nImageHeight;
-            textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-            textureDesc.DepthOrArraySize = 1;
-            textureDesc.SampleDesc.Count = 1;
-            textureDesc.SampleDesc.Quality = 0;
-            textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-
-            pDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-                                             D3D12_HEAP_FLAG_NONE,
-                                             &textureDesc,
-                                             D3D12_RESOURCE_STATE_COPY_DEST,
-                                             nullptr,
-                                             IID_PPV_ARGS(&m_pTexture));
-
-            // Create shader resource view
-            CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(pCBVSRVHeap->GetCPUDescriptorHandleForHeapStart());
-            srvHandle.Offset(SRV_TEXTURE_RENDER_MODEL0 + unTrackedDeviceIndex, pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
-            pDevice->CreateShaderResourceView(m_pTexture.Get(), nullptr, srvHandle);
-
-            const UINT64 nUploadBufferSize = GetRequiredIntermediateSize(m_pTexture.Get(), 0, textureDesc.MipLevels);
-
-            // Create the GPU upload buffer.
-            pDevice->CreateCommittedResource(
-                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-                D3D12_HEAP_FLAG_NONE,
-                &CD3DX12_RESOURCE_DESC::Buffer(nUploadBufferSize),
-                D3D12_RESOURCE_STATE_GENERIC_READ,
-                nullptr,
-                IID_PPV_ARGS(&m_pTextureUploadHeap));
-
-            UpdateSubresources(pCommandList, m_pTexture.Get(), m_pTextureUploadHeap.Get(), 0, 0, (UINT)mipLevelData.size(), &mipLevelData[0]);
-            pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_pTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-
-            // Free mip pointers
-            for (size_t nMip = 0; nMip < mipLevelData.size(); nMip++)
-            {
-                delete[] mipLevelData[nMip].pData;
-            }
+    // Record the texture upload on the render thread, srvHandle is the first device's slot
+    bool Finish(ID3D12GraphicsCommandList *pCommandList, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle, TextureStreamer *pStreamer)
+    {
+        return m_texture.UploadStaged(pCommandList, srvHandle, pStreamer);
+    }
+    void Draw(ID3D12GraphicsCommandList *pCommandList)
+    {
+        // Bind the VB/IB and draw
+        pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        pCommandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
+        pCommandList->IASetIndexBuffer(&m_indexBufferView);
+        pCommandList->DrawIndexedInstanced((UINT)m_unVertexCount, 1, 0, 0, 0);
+    }
+};
+
+//-----------------------------------------------------------------------------
+// One tracked device showing a shared model: its transforms and descriptors
+//-----------------------------------------------------------------------------
+class DX12RenderModelInstance
+{
+    DX12RenderModel *m_pModel;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_pConstantBuffer;
+    UINT8 *m_pConstantBufferData[2] = {nullptr, nullptr};
+    vr::TrackedDeviceIndex_t m_unTrackedDeviceIndex;
+    ID3D12DescriptorHeap *m_pCBVSRVHeap;
+    D3D12_CPU_DESCRIPTOR_HANDLE m_srvHandle = {};
+
+public:
+    DX12RenderModelInstance(DX12RenderModel *pModel)
+        : m_pModel(pModel)
+    {
+    }
+    ~DX12RenderModelInstance()
+    {
+        if (m_srvHandle.ptr)
+        {
+            m_pModel->GetTexture().RemoveShaderResourceView(m_srvHandle);
         }
+    }
+    DX12RenderModel *GetModel() const { return m_pModel; }
+
+    bool BInit(ID3D12Device *pDevice, ID3D12DescriptorHeap *pCBVSRVHeap, vr::TrackedDeviceIndex_t unTrackedDeviceIndex)
+    {
+        m_unTrackedDeviceIndex = unTrackedDeviceIndex;
+        m_pCBVSRVHeap = pCBVSRVHeap;
+
+        // Point this device's texture slot at the shared texture
+        m_srvHandle = GetRenderModelSRVHandle(pDevice, pCBVSRVHeap, unTrackedDeviceIndex);
+        m_pModel->GetTexture().AddShaderResourceView(m_srvHandle);
 
         // Create a constant buffer to hold the transform (one for each eye)
         {
-            pDevice->CreateCommittedResource(
-                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-                D3D12_HEAP_FLAG_NONE,
-                &CD3DX12_RESOURCE_DESC::Buffer(1024 * 64),
-                D3D12_RESOURCE_STATE_GENERIC_READ,
-                nullptr,
-                IID_PPV_ARGS(&m_pConstantBuffer));
+            if (FAILED(pDevice->CreateCommittedResource(
+                    &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+                    D3D12_HEAP_FLAG_NONE,
+                    &CD3DX12_RESOURCE_DESC::Buffer(1024 * 64),
+                    D3D12_RESOURCE_STATE_GENERIC_READ,
+                    nullptr,
+                    IID_PPV_ARGS(&m_pConstantBuffer))))
+            {
+                return false;
+            }
 
             // Keep as persistently mapped buffer, store left eye in first 256 bytes, right eye in second
             UINT8 *pBuffer;
@@ -196,8 +248,6 @@ public:
             pDevice->CreateConstantBufferView(&cbvDesc, cbvRightEyeHandle);
         }
 
-        m_unVertexCount = vrModel.unTriangleCount * 3;
-
         return true;
     }
     void Draw(vr::EVREye nEye, ID3D12GraphicsCommandList *pCommandList, UINT nCBVSRVDescriptorSize, const class Matrix4 &matMVP)
@@ -216,14 +266,37 @@ public:
         srvHandle.Offset(SRV_TEXTURE_RENDER_MODEL0 + m_unTrackedDeviceIndex, nCBVSRVDescriptorSize);
         pCommandList->SetGraphicsRootDescriptorTable(1, srvHandle);
 
-        // Bind the VB/IB and draw
-        pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        pCommandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-        pCommandList->IASetIndexBuffer(&m_indexBufferView);
-        pCommandList->DrawIndexedInstanced((UINT)m_unVertexCount, 1, 0, 0, 0);
+        m_pModel->Draw(pCommandList);
+    }
+
+    static D3D12_CPU_DESCRIPTOR_HANDLE GetRenderModelSRVHandle(ID3D12Device *pDevice, ID3D12DescriptorHeap *pCBVSRVHeap,
+                                                               vr::TrackedDeviceIndex_t unTrackedDeviceIndex)
+    {
+        CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(pCBVSRVHeap->GetCPUDescriptorHandleForHeapStart());
+        srvHandle.Offset(SRV_TEXTURE_RENDER_MODEL0 + unTrackedDeviceIndex, pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
+        return srvHandle;
     }
 };
 
+Models::Models(const MipFilterOptions &mipFilter)
+    : m_mipFilter(mipFilter), m_pSource(new OpenVRRenderModelSource())
+{
+}
+
+Models::~Models()
+{
+    // staging still running on a worker builds models nobody will own
+    m_pLoader.reset();
+    for (auto pInstance : m_rTrackedDeviceToRenderModel)
+    {
+        delete pInstance;
+    }
+    for (auto &entry : m_renderModelCache)
+    {
+        delete entry.second;
+    }
+}
+
 void Models::Draw(const ComPtr<ID3D12GraphicsCommandList> &pCommandList, vr::EVREye nEye, UINT unTrackedDevice, const Matrix4 &matMVP)
 {
     auto model = m_rTrackedDeviceToRenderModel[unTrackedDevice];
@@ -239,103 +312,173 @@ void Models::Draw(const ComPtr<ID3D12GraphicsCommandList> &pCommandList, vr::EVR
 void Models::SetupRenderModels(HMD *hmd,
                                const ComPtr<ID3D12Device> &device,
                                const ComPtr<ID3D12DescriptorHeap> &heap,
-                               const ComPtr<ID3D12GraphicsCommandList> &pCommandList)
+                               WorkerPool *pWorkers, TextureStreamer *pStreamer)
 {
+    m_pDevice = device;
+    m_pCBVSRVHeap = heap;
+    m_pWorkers = pWorkers;
+    m_pStreamer = pStreamer;
     m_nCBVSRVDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    memset(m_rTrackedDeviceToRenderModel, 0, sizeof(m_rTrackedDeviceToRenderModel));
+    m_pLoader.reset(new RenderModelLoader(m_pSource.get(), this, pWorkers));
+    for (uint32_t unTrackedDevice = 0; unTrackedDevice < vr::k_unMaxTrackedDeviceCount; unTrackedDevice++)
+    {
+        DetachRenderModel(unTrackedDevice);
+    }
 
     for (uint32_t unTrackedDevice = vr::k_unTrackedDeviceIndex_Hmd + 1; unTrackedDevice < vr::k_unMaxTrackedDeviceCount; unTrackedDevice++)
     {
-        SetupRenderModelForTrackedDevice(hmd, device, heap, pCommandList, unTrackedDevice);
+        SetupRenderModelForTrackedDevice(hmd, unTrackedDevice);
     }
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: Create/destroy D3D12 a Render Model for a single tracked device
+// Purpose: Start loading the Render Model for a single tracked device, the
+//          device keeps drawing its old model until Update attaches the new one
 //-----------------------------------------------------------------------------
-void Models::SetupRenderModelForTrackedDevice(HMD *hmd,
-                                              const ComPtr<ID3D12Device> &device,
-                                              const ComPtr<ID3D12DescriptorHeap> &heap,
-                                              const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
-                                              vr::TrackedDeviceIndex_t unTrackedDeviceIndex)
+void Models::SetupRenderModelForTrackedDevice(HMD *hmd, vr::TrackedDeviceIndex_t unTrackedDeviceIndex)
 {
-    if (unTrackedDeviceIndex >= vr::k_unMaxTrackedDeviceCount)
+    if (unTrackedDeviceIndex >= vr::k_unMaxTrackedDeviceCount || !m_pLoader)
         return;
     if (!hmd->Hmd()->IsTrackedDeviceConnected(unTrackedDeviceIndex))
         return;
 
-    // try to find a model we've already set up
-    auto sRenderModelName = hmd->RenderModelName(unTrackedDeviceIndex);
-    auto pRenderModel = FindOrLoadRenderModel(device, heap, pCommandList, unTrackedDeviceIndex, sRenderModelName.c_str());
-    if (!pRenderModel)
-    {
-        std::string sTrackingSystemName = hmd->SystemName(unTrackedDeviceIndex);
-        dprintf("Unable to load render model for tracked device %d (%s.%s)", unTrackedDeviceIndex, sTrackingSystemName.c_str(), sRenderModelName.c_str());
-    }
-    else
+    m_pLoader->Request(unTrackedDeviceIndex, hmd->RenderModelName(unTrackedDeviceIndex));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Drop a detached device's model and anything still loading for it
+//-----------------------------------------------------------------------------
+void Models::ReleaseRenderModelForTrackedDevice(vr::TrackedDeviceIndex_t unTrackedDeviceIndex)
+{
+    if (unTrackedDeviceIndex >= vr::k_unMaxTrackedDeviceCount)
+        return;
+    if (m_pLoader)
     {
-        m_rTrackedDeviceToRenderModel[unTrackedDeviceIndex] = pRenderModel;
+        m_pLoader->Cancel(unTrackedDeviceIndex);
     }
+    DetachRenderModel(unTrackedDeviceIndex);
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: Finds a render model we've already loaded or loads a new one
+// Purpose: Attach the models that finished loading since the last frame
 //-----------------------------------------------------------------------------
-DX12RenderModel *Models::FindOrLoadRenderModel(
-    const ComPtr<ID3D12Device> &device,
-    const ComPtr<ID3D12DescriptorHeap> &heap,
-    const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
-    vr::TrackedDeviceIndex_t unTrackedDeviceIndex, const char *pchRenderModelName)
+void Models::Update(const ComPtr<ID3D12GraphicsCommandList> &pCommandList)
 {
-    DX12RenderModel *pRenderModel = NULL;
+    if (!m_pLoader)
+        return;
 
-    // load the model if we didn't find one
-    if (!pRenderModel)
+    for (auto &result : m_pLoader->Poll())
     {
-        vr::RenderModel_t *pModel;
-        vr::EVRRenderModelError error;
-        while (1)
+        if (result.bFailed)
         {
-            error = vr::VRRenderModels()->LoadRenderModel_Async(pchRenderModelName, &pModel);
-            if (error != vr::VRRenderModelError_Loading)
-                break;
-
-            ThreadSleep(1);
+            dprintf("Unable to load render model %s for tracked device %d\n", result.strName.c_str(), result.nDevice);
+            continue;
         }
 
-        if (error != vr::VRRenderModelError_None)
+        auto key = std::make_pair(result.strName, (vr::TextureID_t)result.nTextureId);
+        auto cached = m_renderModelCache.find(key);
+        DX12RenderModel *pRenderModel;
+        if (result.pStaging && cached == m_renderModelCache.end())
         {
-            dprintf("Unable to load render model %s - %s\n", pchRenderModelName, vr::VRRenderModels()->GetRenderModelErrorNameFromEnum(error));
-            return NULL; // move on to the next tracked device
+            // the upload lands in this frame's list, the texture binds to the first device's slot
+            pRenderModel = static_cast<DX12RenderModel *>(result.pStaging.release());
+            m_cacheStats.nMisses++;
+            auto srvHandle = DX12RenderModelInstance::GetRenderModelSRVHandle(m_pDevice.Get(), m_pCBVSRVHeap.Get(), result.nDevice);
+            if (!pRenderModel->Finish(pCommandList.Get(), srvHandle, m_pStreamer))
+            {
+                dprintf("Unable to upload render model %s\n", result.strName.c_str());
+                delete pRenderModel;
+                continue;
+            }
+            m_renderModelCache.emplace(key, pRenderModel);
         }
-
-        vr::RenderModel_TextureMap_t *pTexture;
-        while (1)
+        else
         {
-            error = vr::VRRenderModels()->LoadTexture_Async(pModel->diffuseTextureId, &pTexture);
-            if (error != vr::VRRenderModelError_Loading)
-                break;
-
-            ThreadSleep(1);
+            if (cached == m_renderModelCache.end())
+            {
+                // released between the loader's check and now, load it again
+                m_pLoader->Request(result.nDevice, result.strName);
+                continue;
+            }
+            // staged again while the first was on its way, the cached one is shared instead
+            result.pStaging.reset();
+            pRenderModel = cached->second;
+
+            m_cacheStats.nHits++;
+            m_cacheStats.nBytesSaved += pRenderModel->GpuBytes();
+            dprintf("Sharing render model %s with tracked device %d (%d hits, %d misses, %zu KB saved)\n", result.strName.c_str(), result.nDevice,
+                    m_cacheStats.nHits, m_cacheStats.nMisses, m_cacheStats.nBytesSaved / 1024);
         }
 
-        if (error != vr::VRRenderModelError_None)
-        {
-            dprintf("Unable to load render texture id:%d for render model %s\n", pModel->diffuseTextureId, pchRenderModelName);
-            vr::VRRenderModels()->FreeRenderModel(pModel);
-            return NULL; // move on to the next tracked device
-        }
+        pRenderModel->AddRef();
+        AttachRenderModel(result.nDevice, pRenderModel);
+    }
+}
+
+bool Models::IsLoaded(const std::string &strName, int32_t nTextureId)
+{
+    return m_renderModelCache.count(std::make_pair(strName, (vr::TextureID_t)nTextureId)) != 0;
+}
+
+std::unique_ptr<RenderModelStaging> Models::Stage(const std::string &strName, const RenderModelAsset &model,
+                                                  const RenderModelTextureAsset &texture)
+{
+    std::unique_ptr<DX12RenderModel> pRenderModel(new DX12RenderModel(strName, m_mipFilter));
+    if (!pRenderModel->Stage(m_pDevice.Get(), model, texture, m_pWorkers))
+    {
+        dprintf("Unable to create D3D12 model from render model %s\n", strName.c_str());
+        return nullptr;
+    }
+    return std::move(pRenderModel);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Give the device its own instance of a model it now holds a
+//          reference on. A device activated again drops its old instance
+//          only now, so an unchanged model stays loaded.
+//-----------------------------------------------------------------------------
+void Models::AttachRenderModel(vr::TrackedDeviceIndex_t unTrackedDeviceIndex, DX12RenderModel *pRenderModel)
+{
+    DetachRenderModel(unTrackedDeviceIndex);
+
+    auto pInstance = new DX12RenderModelInstance(pRenderModel);
+    if (!pInstance->BInit(m_pDevice.Get(), m_pCBVSRVHeap.Get(), unTrackedDeviceIndex))
+    {
+        dprintf("Unable to create D3D12 model instance for tracked device %d\n", unTrackedDeviceIndex);
+        delete pInstance;
+        ReleaseRenderModel(pRenderModel);
+        return;
+    }
+    m_rTrackedDeviceToRenderModel[unTrackedDeviceIndex] = pInstance;
+}
+
+void Models::DetachRenderModel(vr::TrackedDeviceIndex_t unTrackedDeviceIndex)
+{
+    auto pInstance = m_rTrackedDeviceToRenderModel[unTrackedDeviceIndex];
+    if (!pInstance)
+        return;
 
-        pRenderModel = new DX12RenderModel(pchRenderModelName);
-        if (!pRenderModel->BInit(device.Get(), pCommandList.Get(), heap.Get(), unTrackedDeviceIndex, *pModel, *pTexture))
+    m_rTrackedDeviceToRenderModel[unTrackedDeviceIndex] = nullptr;
+    auto pRenderModel = pInstance->GetModel();
+    delete pInstance;
+    ReleaseRenderModel(pRenderModel);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Drop one reference, the last one frees the shared model
+//-----------------------------------------------------------------------------
+void Models::ReleaseRenderModel(DX12RenderModel *pRenderModel)
+{
+    if (pRenderModel->Release() > 0)
+        return;
+
+    for (auto it = m_renderModelCache.begin(); it != m_renderModelCache.end(); ++it)
+    {
+        if (it->second == pRenderModel)
         {
-            dprintf("Unable to create D3D12 model from render model %s\n", pchRenderModelName);
-            delete pRenderModel;
-            pRenderModel = NULL;
+            m_renderModelCache.erase(it);
+            break;
         }
-        vr::VRRenderModels()->FreeRenderModel(pModel);
-        vr::VRRenderModels()->FreeTexture(pTexture);
     }
-
-    return pRenderModel;
+    delete pRenderModel;
 }
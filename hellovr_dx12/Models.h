@@ -2,42 +2,87 @@
 #include <d3d12.h>
 #include <wrl/client.h>
 #include <openvr.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include "GenMipMapRGBA.h"
+#include "RenderModelLoader.h"
 
-class Models
+// How much the render model cache has shared so far
+struct RenderModelCacheStats
+{
+    int nHits = 0;
+    int nMisses = 0;
+    // vertex, index and texture memory a hit did not allocate again
+    size_t nBytesSaved = 0;
+};
+
+class Models : private IRenderModelStager
 {
     template <class T>
     using ComPtr = Microsoft::WRL::ComPtr<T>;
 
-    class DX12RenderModel *m_rTrackedDeviceToRenderModel[vr::k_unMaxTrackedDeviceCount];
+    class DX12RenderModelInstance *m_rTrackedDeviceToRenderModel[vr::k_unMaxTrackedDeviceCount] = {};
+    // geometry and texture by render model name and diffuse texture id, shared by reference count
+    std::map<std::pair<std::string, vr::TextureID_t>, class DX12RenderModel *> m_renderModelCache;
+    RenderModelCacheStats m_cacheStats;
     UINT m_nCBVSRVDescriptorSize = 0;
+    ComPtr<ID3D12Device> m_pDevice;
+    ComPtr<ID3D12DescriptorHeap> m_pCBVSRVHeap;
+    class WorkerPool *m_pWorkers = nullptr;
+    class TextureStreamer *m_pStreamer = nullptr;
+    MipFilterOptions m_mipFilter;
+    // IVRRenderModels behind the loader's interface
+    std::unique_ptr<IRenderModelSource> m_pSource;
+    std::unique_ptr<RenderModelLoader> m_pLoader;
 
 public:
+    Models(const MipFilterOptions &mipFilter = MipFilterOptions());
+    ~Models();
+
     void Draw(const ComPtr<ID3D12GraphicsCommandList> &pCommandList, vr::EVREye nEye, UINT unTrackedDevice, const class Matrix4 &matMVP);
 
     //-----------------------------------------------------------------------------
-    // Purpose: Create/destroy D3D12 Render Models
+    // Purpose: Create/destroy D3D12 Render Models. Loading starts here and
+    //          finishes over the following frames in Update.
     //-----------------------------------------------------------------------------
     void SetupRenderModels(class HMD *hmd,
                            const ComPtr<ID3D12Device> &device,
                            const ComPtr<ID3D12DescriptorHeap> &heap,
-                           const ComPtr<ID3D12GraphicsCommandList> &pCommandList);
+                           class WorkerPool *pWorkers = nullptr,
+                           class TextureStreamer *pStreamer = nullptr);
 
     //-----------------------------------------------------------------------------
-    // Purpose: Create/destroy D3D12 a Render Model for a single tracked device
+    // Purpose: Start loading the Render Model for a single tracked device
     //-----------------------------------------------------------------------------
-    void SetupRenderModelForTrackedDevice(class HMD *hmd,
-                                          const ComPtr<ID3D12Device> &device,
-                                          const ComPtr<ID3D12DescriptorHeap> &heap,
-                                          const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
-                                          vr::TrackedDeviceIndex_t unTrackedDeviceIndex);
+    void SetupRenderModelForTrackedDevice(class HMD *hmd, vr::TrackedDeviceIndex_t unTrackedDeviceIndex);
 
-private:
     //-----------------------------------------------------------------------------
-    // Purpose: Finds a render model we've already loaded or loads a new one
+    // Purpose: Drop a detached device's model, the shared geometry and texture
+    //          go with the last device using them. The GPU must be done with
+    //          the frames that drew it.
+    //-----------------------------------------------------------------------------
+    void ReleaseRenderModelForTrackedDevice(vr::TrackedDeviceIndex_t unTrackedDeviceIndex);
+
     //-----------------------------------------------------------------------------
-    DX12RenderModel *FindOrLoadRenderModel(
-        const ComPtr<ID3D12Device> &device,
-        const ComPtr<ID3D12DescriptorHeap> &heap,
-        const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
-        vr::TrackedDeviceIndex_t unTrackedDeviceIndex, const char *pchRenderModelName);
+    // Purpose: Once per frame: advance the loads and record the uploads of
+    //          the models that finished staging on pCommandList
+    //-----------------------------------------------------------------------------
+    void Update(const ComPtr<ID3D12GraphicsCommandList> &pCommandList);
+
+    const RenderModelCacheStats &CacheStats() const { return m_cacheStats; }
+
+private:
+    // IRenderModelStager, Stage runs on a worker
+    bool IsLoaded(const std::string &strName, int32_t nTextureId) override;
+    std::unique_ptr<RenderModelStaging> Stage(const std::string &strName, const RenderModelAsset &model,
+                                              const RenderModelTextureAsset &texture) override;
+
+    // Give the device its own instance of a model it now holds a reference on
+    void AttachRenderModel(vr::TrackedDeviceIndex_t unTrackedDeviceIndex, DX12RenderModel *pRenderModel);
+    void DetachRenderModel(vr::TrackedDeviceIndex_t unTrackedDeviceIndex);
+
+    // Drop one reference, the last one frees the shared model
+    void ReleaseRenderModel(DX12RenderModel *pRenderModel);
 };
@@ -0,0 +1,299 @@
+#include "OcclusionCulling.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+// Occluder depth is interpolated across each face, its rounding must not hide what is level with it
+static const float k_fDepthBias = 1e-5f;
+
+// The cube's corners, bit 0 x, bit 1 y, bit 2 z, counter-clockwise seen from outside
+static const int s_cubeFaces[6][4] = {
+    {0, 2, 3, 1}, {4, 5, 7, 6}, // -z, +z
+    {0, 4, 6, 2}, {1, 3, 7, 5}, // -x, +x
+    {0, 1, 5, 4}, {2, 6, 7, 3}, // -y, +y
+};
+
+static Vector4 Column(const Matrix4 &mat, int i)
+{
+    return Vector4(mat[4 * i], mat[4 * i + 1], mat[4 * i + 2], mat[4 * i + 3]);
+}
+
+void OcclusionBuffer::Clear(const Matrix4 &matViewProjection)
+{
+    m_matViewProjection = matViewProjection;
+    std::fill(m_depth, m_depth + k_nWidth * k_nHeight, FLT_MAX);
+    std::fill(m_tileMax, m_tileMax + k_nTilesX * k_nTilesY, FLT_MAX);
+}
+
+bool OcclusionBuffer::DrawCube(const Vector3 &corner, float fSize)
+{
+    // the corners step along the matrix columns from the first
+    Vector4 origin = m_matViewProjection * Vector4(corner.x, corner.y, corner.z, 1);
+    Vector4 steps[3] = {Column(m_matViewProjection, 0) * fSize, Column(m_matViewProjection, 1) * fSize, Column(m_matViewProjection, 2) * fSize};
+    ScreenVertex vertices[8];
+    for (int nCorner = 0; nCorner < 8; nCorner++)
+    {
+        Vector4 clip = origin;
+        for (int nAxis = 0; nAxis < 3; nAxis++)
+        {
+            if (nCorner & (1 << nAxis))
+            {
+                clip += steps[nAxis];
+            }
+        }
+        if (clip.z < 0 || clip.w <= 0)
+            return false;
+        float fInvW = 1.0f / clip.w;
+        vertices[nCorner] = {(clip.x * fInvW * 0.5f + 0.5f) * k_nWidth, (0.5f - clip.y * fInvW * 0.5f) * k_nHeight, clip.z * fInvW};
+    }
+    for (const auto &face : s_cubeFaces)
+    {
+        DrawQuad(vertices[face[0]], vertices[face[1]], vertices[face[2]], vertices[face[3]]);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: a convex planar quad, pixels whose centres are inside all four
+//          edges take the nearer of their depth and the face's. Faces turned
+//          away from the eye wind the other way on screen and are skipped.
+//-----------------------------------------------------------------------------
+void OcclusionBuffer::DrawQuad(const ScreenVertex &v0, const ScreenVertex &v1, const ScreenVertex &v2, const ScreenVertex &v3)
+{
+    const ScreenVertex *rgVertices[4] = {&v0, &v1, &v2, &v3};
+
+    // counter-clockwise with y up is clockwise once y points down the screen
+    float fArea = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        const ScreenVertex &a = *rgVertices[i], &b = *rgVertices[(i + 1) & 3];
+        fArea += a.x * b.y - b.x * a.y;
+    }
+    if (!(fArea < 0))
+        return;
+
+    float fMinX = fminf(fminf(v0.x, v1.x), fminf(v2.x, v3.x)), fMaxX = fmaxf(fmaxf(v0.x, v1.x), fmaxf(v2.x, v3.x));
+    float fMinY = fminf(fminf(v0.y, v1.y), fminf(v2.y, v3.y)), fMaxY = fmaxf(fmaxf(v0.y, v1.y), fmaxf(v2.y, v3.y));
+    if (fMaxX < 0.5f || fMaxY < 0.5f || fMinX > k_nWidth - 0.5f || fMinY > k_nHeight - 0.5f)
+        return;
+    // pixels with their centres in the bounds
+    int nX0 = std::max(0, (int)ceilf(fMinX - 0.5f)), nX1 = std::min(k_nWidth - 1, (int)floorf(fMaxX - 0.5f));
+    int nY0 = std::max(0, (int)ceilf(fMinY - 0.5f)), nY1 = std::min(k_nHeight - 1, (int)floorf(fMaxY - 0.5f));
+    if (nX0 > nX1 || nY0 > nY1)
+        return;
+
+    // e = a x + b y + c, positive inside each edge
+    float a[4], b[4], c[4];
+    for (int i = 0; i < 4; i++)
+    {
+        const ScreenVertex &p = *rgVertices[i], &q = *rgVertices[(i + 1) & 3];
+        a[i] = q.y - p.y;
+        b[i] = p.x - q.x;
+        c[i] = -(a[i] * p.x + b[i] * p.y);
+    }
+
+    // the face is planar, so z/w is a plane on screen too; solved on whichever
+    // half of the quad is less thin
+    const ScreenVertex &p = v0, &q = v2;
+    float fDet1 = (v1.x - p.x) * (q.y - p.y) - (q.x - p.x) * (v1.y - p.y);
+    float fDet3 = (q.x - p.x) * (v3.y - p.y) - (v3.x - p.x) * (q.y - p.y);
+    const ScreenVertex &r = fabsf(fDet1) >= fabsf(fDet3) ? v1 : v3;
+    float fDet = (r.x - p.x) * (q.y - p.y) - (q.x - p.x) * (r.y - p.y);
+    float fDzDx = ((r.z - p.z) * (q.y - p.y) - (q.z - p.z) * (r.y - p.y)) / fDet;
+    float fDzDy = ((r.x - p.x) * (q.z - p.z) - (q.x - p.x) * (r.z - p.z)) / fDet;
+    float fDz = p.z - fDzDx * p.x - fDzDy * p.y;
+
+    // whole groups of four, the rows are a multiple of four wide
+    const int nStart = nX0 & ~3;
+    for (int y = nY0; y <= nY1; y++)
+    {
+        const float fY = (float)y + 0.5f;
+        float *pRow = m_depth + y * k_nWidth;
+#if MATRICES_SSE
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 rowE[4], edgeA[4];
+        for (int i = 0; i < 4; i++)
+        {
+            rowE[i] = _mm_set1_ps(b[i] * fY + c[i]);
+            edgeA[i] = _mm_set1_ps(a[i]);
+        }
+        const __m128 rowZ = _mm_set1_ps(fDzDy * fY + fDz), dzdx = _mm_set1_ps(fDzDx);
+        for (int x = nStart; x <= nX1; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), rowE[0]), zero);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], px), rowE[1]), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], px), rowE[2]), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[3], px), rowE[3]), zero));
+            __m128 z = _mm_add_ps(_mm_mul_ps(dzdx, px), rowZ);
+            __m128 depth = _mm_load_ps(pRow + x);
+            depth = _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(depth, z)), _mm_andnot_ps(inside, depth));
+            _mm_store_ps(pRow + x, depth);
+        }
+#else
+        float rowE[4];
+        for (int i = 0; i < 4; i++)
+        {
+            rowE[i] = b[i] * fY + c[i];
+        }
+        const float fRowZ = fDzDy * fY + fDz;
+        for (int x = nStart; x < ((nX1 + 4) & ~3); x++)
+        {
+            float fX = (float)x + 0.5f;
+            if (a[0] * fX + rowE[0] >= 0 && a[1] * fX + rowE[1] >= 0 && a[2] * fX + rowE[2] >= 0 && a[3] * fX + rowE[3] >= 0)
+            {
+                pRow[x] = fminf(pRow[x], fDzDx * fX + fRowZ);
+            }
+        }
+#endif
+    }
+}
+
+void OcclusionBuffer::Finish()
+{
+    for (int nTileY = 0; nTileY < k_nTilesY; nTileY++)
+    {
+        for (int nTileX = 0; nTileX < k_nTilesX; nTileX++)
+        {
+            const float *pTile = m_depth + nTileY * k_nTileSize * k_nWidth + nTileX * k_nTileSize;
+#if MATRICES_SSE
+            __m128 farthest = _mm_load_ps(pTile);
+            for (int y = 0; y < k_nTileSize; y++)
+            {
+                for (int x = 0; x < k_nTileSize; x += 4)
+                {
+                    farthest = _mm_max_ps(farthest, _mm_load_ps(pTile + y * k_nWidth + x));
+                }
+            }
+            farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+            farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+            m_tileMax[nTileY * k_nTilesX + nTileX] = _mm_cvtss_f32(farthest);
+#else
+            float fFarthest = pTile[0];
+            for (int y = 0; y < k_nTileSize; y++)
+            {
+                for (int x = 0; x < k_nTileSize; x++)
+                {
+                    fFarthest = fmaxf(fFarthest, pTile[y * k_nWidth + x]);
+                }
+            }
+            m_tileMax[nTileY * k_nTilesX + nTileX] = fFarthest;
+#endif
+        }
+    }
+}
+
+bool OcclusionBuffer::IsOccluded(const AABB &box) const
+{
+    Vector4 origin = m_matViewProjection * Vector4(box.vMin.x, box.vMin.y, box.vMin.z, 1);
+    Vector4 steps[3] = {Column(m_matViewProjection, 0) * (box.vMax.x - box.vMin.x), Column(m_matViewProjection, 1) * (box.vMax.y - box.vMin.y),
+                        Column(m_matViewProjection, 2) * (box.vMax.z - box.vMin.z)};
+    float fMinX = FLT_MAX, fMaxX = -FLT_MAX, fMinY = FLT_MAX, fMaxY = -FLT_MAX, fMinZ = FLT_MAX;
+    for (int nCorner = 0; nCorner < 8; nCorner++)
+    {
+        Vector4 clip = origin;
+        for (int nAxis = 0; nAxis < 3; nAxis++)
+        {
+            if (nCorner & (1 << nAxis))
+            {
+                clip += steps[nAxis];
+            }
+        }
+        // around the eye, it cannot be projected
+        if (clip.w <= 0)
+            return false;
+        float fInvW = 1.0f / clip.w;
+        float fX = (clip.x * fInvW * 0.5f + 0.5f) * k_nWidth, fY = (0.5f - clip.y * fInvW * 0.5f) * k_nHeight;
+        fMinX = fminf(fMinX, fX);
+        fMaxX = fmaxf(fMaxX, fX);
+        fMinY = fminf(fMinY, fY);
+        fMaxY = fmaxf(fMaxY, fY);
+        fMinZ = fminf(fMinZ, clip.z * fInvW);
+    }
+    if (fMaxX < 0 || fMaxY < 0 || fMinX >= k_nWidth || fMinY >= k_nHeight)
+        return true;
+
+    // every pixel the bounds touch, not only those whose centres they hold
+    int nX0 = (int)fmaxf(fMinX, 0), nX1 = (int)fminf(fMaxX, k_nWidth - 1);
+    int nY0 = (int)fmaxf(fMinY, 0), nY1 = (int)fminf(fMaxY, k_nHeight - 1);
+    const float fThreshold = fMinZ - k_fDepthBias;
+    for (int nTileY = nY0 / k_nTileSize; nTileY <= nY1 / k_nTileSize; nTileY++)
+    {
+        for (int nTileX = nX0 / k_nTileSize; nTileX <= nX1 / k_nTileSize; nTileX++)
+        {
+            if (m_tileMax[nTileY * k_nTilesX + nTileX] < fThreshold)
+                continue;
+            int x0 = std::max(nX0, nTileX * k_nTileSize), x1 = std::min(nX1, nTileX * k_nTileSize + k_nTileSize - 1);
+            int y0 = std::max(nY0, nTileY * k_nTileSize), y1 = std::min(nY1, nTileY * k_nTileSize + k_nTileSize - 1);
+            for (int y = y0; y <= y1; y++)
+            {
+                for (int x = x0; x <= x1; x++)
+                {
+                    if (m_depth[y * k_nWidth + x] >= fThreshold)
+                        return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: the cubes of the chunks in view nearest the left eye, drawn for
+//          each eye, on two workers when there are any
+//-----------------------------------------------------------------------------
+void StereoOcclusion::Render(const CubeChunkTree &tree, const Frustum &frustum, const Matrix4 &matLeft, const Matrix4 &matRight, WorkerPool *pWorkers)
+{
+    tree.VisibleChunks(frustum, m_chunks);
+    const std::vector<CubeChunkTree::Node> &chunks = tree.Level(0);
+    m_nearest.clear();
+    for (uint32_t nChunk : m_chunks)
+    {
+        // the view depth of its nearest corner
+        const AABB &bounds = chunks[nChunk].bounds;
+        float fDepth = FLT_MAX;
+        for (int nCorner = 0; nCorner < 8; nCorner++)
+        {
+            Vector4 clip = matLeft * Vector4((nCorner & 1) ? bounds.vMax.x : bounds.vMin.x, (nCorner & 2) ? bounds.vMax.y : bounds.vMin.y,
+                                             (nCorner & 4) ? bounds.vMax.z : bounds.vMin.z, 1);
+            fDepth = fminf(fDepth, clip.w);
+        }
+        m_nearest.push_back({fDepth, nChunk});
+    }
+    const size_t nOccluderChunks = std::min(m_nearest.size(), (size_t)k_nOccluderChunks);
+    std::partial_sort(m_nearest.begin(), m_nearest.begin() + nOccluderChunks, m_nearest.end());
+
+    m_stats = Stats();
+    m_occluders.clear();
+    for (size_t i = 0; i < nOccluderChunks; i++)
+    {
+        const CubeChunkTree::Node &chunk = chunks[m_nearest[i].second];
+        size_t nFloats = m_occluders.size();
+        m_occluders.resize(nFloats + (size_t)chunk.nInstanceCount * CubeVolume::k_nFloatsPerInstance);
+        tree.ChunkTranslations(m_nearest[i].second, m_occluders.data() + nFloats);
+        m_stats.nOccluderChunks++;
+        m_stats.nOccluderCubes += chunk.nInstanceCount;
+    }
+
+    const float fSize = tree.Volume().Scale();
+    auto drawEye = [&](int nEye) {
+        OcclusionBuffer &buffer = m_eyes[nEye];
+        buffer.Clear(nEye ? matRight : matLeft);
+        for (size_t i = 0; i < m_occluders.size(); i += CubeVolume::k_nFloatsPerInstance)
+        {
+            buffer.DrawCube(Vector3(m_occluders[i], m_occluders[i + 1], m_occluders[i + 2]), fSize);
+        }
+        buffer.Finish();
+    };
+    if (pWorkers)
+    {
+        pWorkers->ParallelFor(2, drawEye);
+    }
+    else
+    {
+        drawEye(0);
+        drawEye(1);
+    }
+}
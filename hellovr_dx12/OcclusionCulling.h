@@ -0,0 +1,79 @@
+#pragma once
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include "CubeCulling.h"
+
+///
+/// One eye's low resolution depth buffer for occlusion culling, D3D's z/w
+/// with 0 at the near plane. Occluder cubes are rasterized into it front
+/// faces only, four pixels at a time with half-space tests, keeping the
+/// nearest depth. Boxes are tested against the farthest depth of each tile
+/// first and against the pixels only where the tile cannot decide.
+///
+class OcclusionBuffer
+{
+public:
+    static const int k_nWidth = 128;
+    static const int k_nHeight = 128;
+    static const int k_nTileSize = 8;
+    static const int k_nTilesX = k_nWidth / k_nTileSize;
+    static const int k_nTilesY = k_nHeight / k_nTileSize;
+
+    // Empty for a new view, nothing is occluded
+    void Clear(const Matrix4 &matViewProjection);
+    // The axis aligned cube from corner to corner + fSize. A cube reaching in
+    // front of the near plane is clipped on the GPU and left out here.
+    bool DrawCube(const Vector3 &corner, float fSize);
+    // Tile maxima for IsOccluded, after the last DrawCube
+    void Finish();
+
+    // Every pixel the box touches has something drawn nearer than all of the
+    // box. A box off this eye's screen is occluded too.
+    bool IsOccluded(const AABB &box) const;
+
+    float Depth(int x, int y) const { return m_depth[y * k_nWidth + x]; }
+
+private:
+    struct ScreenVertex
+    {
+        float x, y, z;
+    };
+    void DrawQuad(const ScreenVertex &v0, const ScreenVertex &v1, const ScreenVertex &v2, const ScreenVertex &v3);
+
+    Matrix4 m_matViewProjection;
+    alignas(16) float m_depth[k_nWidth * k_nHeight];
+    float m_tileMax[k_nTilesX * k_nTilesY];
+};
+
+///
+/// Both eyes' occlusion buffers, 256x128 between them, drawn from the cubes
+/// of the chunks nearest the eyes. A box is only hidden when it is hidden
+/// from both.
+///
+class StereoOcclusion
+{
+public:
+    // chunks whose cubes are drawn as occluders each frame
+    static const int k_nOccluderChunks = 4;
+
+    struct Stats
+    {
+        int nOccluderChunks = 0;
+        int nOccluderCubes = 0;
+    };
+
+    void Render(const CubeChunkTree &tree, const Frustum &frustum, const Matrix4 &matLeft, const Matrix4 &matRight,
+                class WorkerPool *pWorkers = nullptr);
+    bool IsOccluded(const AABB &box) const { return m_eyes[0].IsOccluded(box) && m_eyes[1].IsOccluded(box); }
+
+    const OcclusionBuffer &Eye(int nEye) const { return m_eyes[nEye]; }
+    const Stats &GetStats() const { return m_stats; }
+
+private:
+    OcclusionBuffer m_eyes[2];
+    Stats m_stats;
+    std::vector<uint32_t> m_chunks;
+    std::vector<std::pair<float, uint32_t>> m_nearest;
+    std::vector<float> m_occluders;
+};
@@ -73,7 +73,10 @@ bool Pipeline::CreateAllShaders(const ComPtr<ID3D12Device> &device)
     // Scene shader
     {
         ComPtr<ID3DBlob> vertexShader;
+        ComPtr<ID3DBlob> instancedVertexShader;
+        ComPtr<ID3DBlob> meshedVertexShader;
         ComPtr<ID3DBlob> pixelShader;
+        ComPtr<ID3DBlob> meshedPixelShader;
         UINT compileFlags = 0;
 
         ComPtr<ID3DBlob> error;
@@ -82,11 +85,26 @@ bool Pipeline::CreateAllShaders(const ComPtr<ID3D12Device> &device)
             dprintf("Failed compiling vertex shader 'scene':\n%s\n", (char *)error->GetBufferPointer());
             return false;
         }
+        if (FAILED(D3DCompile(g_scene.data(), g_scene.size(), "scene", nullptr, nullptr, "VSInstanced", "vs_5_0", compileFlags, 0, &instancedVertexShader, &error)))
+        {
+            dprintf("Failed compiling instanced vertex shader 'scene':\n%s\n", (char *)error->GetBufferPointer());
+            return false;
+        }
+        if (FAILED(D3DCompile(g_scene.data(), g_scene.size(), "scene", nullptr, nullptr, "VSMeshed", "vs_5_0", compileFlags, 0, &meshedVertexShader, &error)))
+        {
+            dprintf("Failed compiling meshed vertex shader 'scene':\n%s\n", (char *)error->GetBufferPointer());
+            return false;
+        }
         if (FAILED(D3DCompile(g_scene.data(), g_scene.size(), "scene", nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, &error)))
         {
             dprintf("Failed compiling pixel shader 'scene':\n%s\n", (char *)error->GetBufferPointer());
             return false;
         }
+        if (FAILED(D3DCompile(g_scene.data(), g_scene.size(), "scene", nullptr, nullptr, "PSMeshed", "ps_5_0", compileFlags, 0, &meshedPixelShader, &error)))
+        {
+            dprintf("Failed compiling meshed pixel shader 'scene':\n%s\n", (char *)error->GetBufferPointer());
+            return false;
+        }
 
         // Define the vertex input layout.
         D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
@@ -118,6 +136,36 @@ bool Pipeline::CreateAllShaders(const ComPtr<ID3D12Device> &device)
             dprintf("Error creating D3D12 pipeline state.\n");
             return false;
         }
+
+        // Same state, the cube's corner from a second per instance stream
+        D3D12_INPUT_ELEMENT_DESC instancedElementDescs[] =
+            {
+                {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+                {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+                {"POSITION", 1, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+            };
+        psoDesc.InputLayout = {instancedElementDescs, _countof(instancedElementDescs)};
+        psoDesc.VS = CD3DX12_SHADER_BYTECODE(instancedVertexShader.Get());
+        if (FAILED(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pSceneInstancedPipelineState))))
+        {
+            dprintf("Error creating D3D12 pipeline state.\n");
+            return false;
+        }
+
+        // Same state, packed chunk vertices with the chunk's origin and voxel size per instance
+        D3D12_INPUT_ELEMENT_DESC meshedElementDescs[] =
+            {
+                {"POSITION", 0, DXGI_FORMAT_R32_UINT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+                {"POSITION", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+            };
+        psoDesc.InputLayout = {meshedElementDescs, _countof(meshedElementDescs)};
+        psoDesc.VS = CD3DX12_SHADER_BYTECODE(meshedVertexShader.Get());
+        psoDesc.PS = CD3DX12_SHADER_BYTECODE(meshedPixelShader.Get());
+        if (FAILED(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pSceneMeshedPipelineState))))
+        {
+            dprintf("Error creating D3D12 pipeline state.\n");
+            return false;
+        }
     }
 
     // Companion shader
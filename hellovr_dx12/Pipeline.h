@@ -10,6 +10,8 @@ class Pipeline
     int m_nMSAASampleCount;
     ComPtr<ID3D12RootSignature> m_pRootSignature;
     ComPtr<ID3D12PipelineState> m_pScenePipelineState;
+    ComPtr<ID3D12PipelineState> m_pSceneInstancedPipelineState;
+    ComPtr<ID3D12PipelineState> m_pSceneMeshedPipelineState;
     ComPtr<ID3D12PipelineState> m_pCompanionPipelineState;
     ComPtr<ID3D12PipelineState> m_pRenderModelPipelineState;
     ComPtr<ID3D12PipelineState> m_pAxesPipelineState;
@@ -18,6 +20,8 @@ public:
     Pipeline(int msaa);
     const ComPtr<ID3D12RootSignature> &RootSignature() const { return m_pRootSignature; }
     const ComPtr<ID3D12PipelineState> &SceneState() const { return m_pScenePipelineState; }
+    const ComPtr<ID3D12PipelineState> &SceneInstancedState() const { return m_pSceneInstancedPipelineState; }
+    const ComPtr<ID3D12PipelineState> &SceneMeshedState() const { return m_pSceneMeshedPipelineState; }
     const ComPtr<ID3D12PipelineState> &CompanionState() const { return m_pCompanionPipelineState; }
     const ComPtr<ID3D12PipelineState> &RenderModelState() const { return m_pRenderModelPipelineState; }
     const ComPtr<ID3D12PipelineState> &AxisState() const { return m_pAxesPipelineState; }
@@ -0,0 +1,116 @@
+#include "PosePrediction.h"
+
+// Acceleration is the change in velocity across this many samples, one
+// frame apart is mostly tracker noise
+static const int k_nAccelerationSpan = 3;
+
+const char *GetPoseModelName(PoseModel model)
+{
+    switch (model)
+    {
+    case PoseModel::Hold:
+        return "hold";
+    case PoseModel::ConstantVelocity:
+        return "constant velocity";
+    case PoseModel::ConstantAcceleration:
+        return "constant acceleration";
+    }
+    return "?";
+}
+
+void PoseHistory::Add(const PoseSample &sample)
+{
+    if (m_nCount > 0 && sample.fTime <= Sample(0).fTime)
+        return;
+    m_nNewest = (m_nNewest + 1) % k_nCapacity;
+    m_samples[m_nNewest] = sample;
+    if (m_nCount < k_nCapacity)
+    {
+        m_nCount++;
+    }
+}
+
+void PoseHistory::Clear()
+{
+    m_nNewest = -1;
+    m_nCount = 0;
+}
+
+const PoseSample &PoseHistory::Sample(int nAge) const
+{
+    return m_samples[(m_nNewest - nAge + k_nCapacity) % k_nCapacity];
+}
+
+bool PoseHistory::GetVelocity(int nAge, Vector3 &linear, Vector3 &angular) const
+{
+    if (nAge >= m_nCount)
+        return false;
+    const PoseSample &sample = Sample(nAge);
+    if (sample.bHasVelocity)
+    {
+        linear = sample.velocity;
+        angular = sample.angularVelocity;
+        return true;
+    }
+
+    // backward difference to the sample before
+    if (nAge + 1 >= m_nCount)
+        return false;
+    const PoseSample &before = Sample(nAge + 1);
+    float fInvDt = (float)(1.0 / (sample.fTime - before.fTime));
+    linear = (sample.pose.Translation() - before.pose.Translation()) * fInvDt;
+    Quaternion delta = sample.pose.Orientation() * before.pose.Orientation().Conjugate();
+    angular = delta.ToRotationVector() * fInvDt;
+    return true;
+}
+
+bool PoseHistory::GetAcceleration(Vector3 &linear, Vector3 &angular) const
+{
+    Vector3 linear0, angular0;
+    if (!GetVelocity(0, linear0, angular0))
+        return false;
+    for (int nAge = k_nAccelerationSpan < m_nCount - 1 ? k_nAccelerationSpan : m_nCount - 1; nAge > 0; nAge--)
+    {
+        Vector3 linearN, angularN;
+        if (GetVelocity(nAge, linearN, angularN))
+        {
+            float fInvDt = (float)(1.0 / (Sample(0).fTime - Sample(nAge).fTime));
+            linear = (linear0 - linearN) * fInvDt;
+            angular = (angular0 - angularN) * fInvDt;
+            return true;
+        }
+    }
+    return false;
+}
+
+RigidTransform PoseHistory::Predict(double fTime, PoseModel model) const
+{
+    if (m_nCount == 0)
+        return RigidTransform();
+    const PoseSample &newest = Sample(0);
+    Vector3 velocity, angularVelocity;
+    if (model == PoseModel::Hold || !GetVelocity(0, velocity, angularVelocity))
+        return newest.pose;
+
+    float dt = (float)(fTime - newest.fTime);
+    Vector3 acceleration, angularAcceleration;
+    bool bAcceleration = model == PoseModel::ConstantAcceleration && GetAcceleration(acceleration, angularAcceleration);
+    if (bAcceleration && !newest.bHasVelocity)
+    {
+        // a backward difference is the velocity half way back to the sample before
+        float fHalfStep = (float)(0.5 * (newest.fTime - Sample(1).fTime));
+        velocity += acceleration * fHalfStep;
+        angularVelocity += angularAcceleration * fHalfStep;
+    }
+
+    Vector3 position = newest.pose.Translation() + velocity * dt;
+    Vector3 rotation = angularVelocity * dt;
+    if (bAcceleration)
+    {
+        float fHalfDt2 = 0.5f * dt * dt;
+        position += acceleration * fHalfDt2;
+        rotation += angularAcceleration * fHalfDt2;
+    }
+    Quaternion orientation = Quaternion::FromRotationVector(rotation) * newest.pose.Orientation();
+    return RigidTransform(orientation.Normalized(), position);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "RigidTransform.h"
+
+// How a pose is carried forward from its history to a later time
+enum class PoseModel
+{
+    Hold,                 // the newest pose as it is
+    ConstantVelocity,     // linear and angular velocity of the newest pose
+    ConstantAcceleration, // plus the change in velocity over the last few poses
+};
+
+const char *GetPoseModelName(PoseModel model);
+
+// One tracked pose. Velocities are in tracking space, m/s and rad/s about the axis.
+struct PoseSample
+{
+    double fTime = 0; // seconds, any fixed origin
+    RigidTransform pose;
+    Vector3 velocity;
+    Vector3 angularVelocity;
+    bool bHasVelocity = false; // else estimated from the poses around it
+};
+
+///
+/// The last few poses of one tracked device, oldest overwritten first, and
+/// predictions from them at a target time. Rotation is integrated as a
+/// rotation vector, theta = w dt (+ a dt^2 / 2), applied on the left of the
+/// newest orientation since the angular velocity is in tracking space.
+///
+class PoseHistory
+{
+public:
+    static const int k_nCapacity = 8;
+
+    // Dropped unless newer than the newest sample
+    void Add(const PoseSample &sample);
+    void Clear();
+    int Count() const { return m_nCount; }
+    // 0 is the newest
+    const PoseSample &Sample(int nAge) const;
+
+    // False when the history is too short to tell
+    bool GetVelocity(int nAge, Vector3 &linear, Vector3 &angular) const;
+    bool GetAcceleration(Vector3 &linear, Vector3 &angular) const;
+
+    // The newest pose carried to fTime; identity with no history
+    RigidTransform Predict(double fTime, PoseModel model) const;
+
+private:
+    PoseSample m_samples[k_nCapacity];
+    int m_nNewest = -1;
+    int m_nCount = 0;
+};
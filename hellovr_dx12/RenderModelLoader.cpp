@@ -0,0 +1,194 @@
+#include "RenderModelLoader.h"
+#include "WorkerPool.h"
+#include <thread>
+
+struct RenderModelLoader::Job
+{
+    enum class State
+    {
+        LoadingModel,
+        Waiting, // for another job loading the same model
+        LoadingTexture,
+        Staging,
+    };
+
+    uint32_t nDevice;
+    std::string strName;
+    State state = State::LoadingModel;
+    bool bCancelled = false;
+    bool bHasModel = false;
+    bool bHasTexture = false;
+    RenderModelAsset model = {};
+    RenderModelTextureAsset texture = {};
+    std::unique_ptr<RenderModelStaging> pStaging;
+    std::atomic<bool> bStaged{false};
+};
+
+RenderModelLoader::RenderModelLoader(IRenderModelSource *pSource, IRenderModelStager *pStager, WorkerPool *pWorkers)
+    : m_pSource(pSource), m_pStager(pStager), m_pWorkers(pWorkers)
+{
+}
+
+RenderModelLoader::~RenderModelLoader()
+{
+    for (auto &job : m_jobs)
+    {
+        if (job->state == Job::State::Staging)
+        {
+            while (!job->bStaged.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+        job->pStaging.reset();
+        FreeAssets(*job);
+    }
+}
+
+void RenderModelLoader::Request(uint32_t nDevice, const std::string &strName)
+{
+    Cancel(nDevice);
+    auto job = std::make_shared<Job>();
+    job->nDevice = nDevice;
+    job->strName = strName;
+    m_jobs.push_back(job);
+}
+
+void RenderModelLoader::Cancel(uint32_t nDevice)
+{
+    for (size_t i = 0; i < m_jobs.size();)
+    {
+        Job &job = *m_jobs[i];
+        if (job.nDevice != nDevice || job.bCancelled)
+        {
+            i++;
+        }
+        else if (job.state == Job::State::Staging)
+        {
+            // the worker still reads the assets, Poll drops it once done
+            job.bCancelled = true;
+            i++;
+        }
+        else
+        {
+            FreeAssets(job);
+            m_jobs.erase(m_jobs.begin() + i);
+        }
+    }
+}
+
+void RenderModelLoader::FreeAssets(Job &job)
+{
+    if (job.bHasTexture)
+    {
+        m_pSource->FreeTexture(job.texture);
+        job.bHasTexture = false;
+    }
+    if (job.bHasModel)
+    {
+        m_pSource->FreeModel(job.model);
+        job.bHasModel = false;
+    }
+}
+
+bool RenderModelLoader::IsKeyLoading(const Job &job, const std::vector<RenderModelLoadResult> &results) const
+{
+    for (auto &result : results)
+    {
+        if (!result.bFailed && result.nTextureId == job.model.nTextureId && result.strName == job.strName)
+            return true;
+    }
+    for (auto &other : m_jobs)
+    {
+        if (other.get() != &job && !other->bCancelled &&
+            (other->state == Job::State::LoadingTexture || other->state == Job::State::Staging) &&
+            other->model.nTextureId == job.model.nTextureId && other->strName == job.strName)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RenderModelLoader::Advance(const std::shared_ptr<Job> &pJob, std::vector<RenderModelLoadResult> &results)
+{
+    Job &job = *pJob;
+    auto finish = [&](bool bFailed) {
+        FreeAssets(job);
+        if (!job.bCancelled)
+        {
+            results.push_back({job.nDevice, job.strName, job.model.nTextureId, bFailed, std::move(job.pStaging)});
+        }
+        // the worker may hold the last reference to the job, release here instead
+        job.pStaging.reset();
+        return true;
+    };
+
+    if (job.state == Job::State::LoadingModel)
+    {
+        RenderModelLoadStatus status = m_pSource->LoadModel(job.strName.c_str(), &job.model);
+        if (status == RenderModelLoadStatus::Loading)
+            return false;
+        if (status == RenderModelLoadStatus::Failed)
+            return finish(true);
+        job.bHasModel = true;
+        job.state = Job::State::Waiting;
+    }
+
+    if (job.state == Job::State::Waiting)
+    {
+        if (m_pStager->IsLoaded(job.strName, job.model.nTextureId))
+            return finish(false);
+        if (IsKeyLoading(job, results))
+            return false;
+        job.state = Job::State::LoadingTexture;
+    }
+
+    if (job.state == Job::State::LoadingTexture)
+    {
+        RenderModelLoadStatus status = m_pSource->LoadTexture(job.model.nTextureId, &job.texture);
+        if (status == RenderModelLoadStatus::Loading)
+            return false;
+        if (status == RenderModelLoadStatus::Failed)
+            return finish(true);
+        job.bHasTexture = true;
+        job.state = Job::State::Staging;
+
+        if (m_pWorkers)
+        {
+            // the task holds the job, the loader may be done with it first
+            IRenderModelStager *pStager = m_pStager;
+            m_pWorkers->Submit([pJob, pStager]() {
+                pJob->pStaging = pStager->Stage(pJob->strName, pJob->model, pJob->texture);
+                pJob->bStaged.store(true, std::memory_order_release);
+            });
+        }
+        else
+        {
+            job.pStaging = m_pStager->Stage(job.strName, job.model, job.texture);
+            job.bStaged.store(true, std::memory_order_release);
+        }
+    }
+
+    // Staging
+    if (!job.bStaged.load(std::memory_order_acquire))
+        return false;
+    return finish(!job.pStaging);
+}
+
+std::vector<RenderModelLoadResult> RenderModelLoader::Poll()
+{
+    std::vector<RenderModelLoadResult> results;
+    for (size_t i = 0; i < m_jobs.size();)
+    {
+        if (Advance(m_jobs[i], results))
+        {
+            m_jobs.erase(m_jobs.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+    return results;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Geometry as the runtime hands it out, valid until freed
+struct RenderModelAsset
+{
+    const void *pHandle; // the source's own object, for FreeModel
+    const void *pVertexData;
+    uint32_t nVertexStride;
+    uint32_t nVertexCount;
+    const uint16_t *pIndexData;
+    uint32_t nTriangleCount;
+    int32_t nTextureId;
+};
+
+// RGBA8 diffuse texture, valid until freed
+struct RenderModelTextureAsset
+{
+    const void *pHandle;
+    const unsigned char *pRGBA;
+    int nWidth;
+    int nHeight;
+};
+
+enum class RenderModelLoadStatus
+{
+    Loading, // ask again next frame
+    Ready,
+    Failed,
+};
+
+///
+/// Where render models come from: IVRRenderModels in the app, a fake with
+/// latency in tests. Only called from the thread that polls the loader.
+///
+class IRenderModelSource
+{
+public:
+    virtual ~IRenderModelSource() = default;
+    virtual RenderModelLoadStatus LoadModel(const char *pchName, RenderModelAsset *pModel) = 0;
+    virtual RenderModelLoadStatus LoadTexture(int32_t nTextureId, RenderModelTextureAsset *pTexture) = 0;
+    virtual void FreeModel(const RenderModelAsset &model) = 0;
+    virtual void FreeTexture(const RenderModelTextureAsset &texture) = 0;
+};
+
+// Whatever IRenderModelStager builds for a model before it reaches a command list
+class RenderModelStaging
+{
+public:
+    virtual ~RenderModelStaging() = default;
+};
+
+class IRenderModelStager
+{
+public:
+    virtual ~IRenderModelStager() = default;
+
+    // A model with this name and texture is already resident, nothing to load
+    virtual bool IsLoaded(const std::string &strName, int32_t nTextureId) = 0;
+
+    //-----------------------------------------------------------------------------
+    // Purpose: Build buffers, mips and upload memory from the assets. Runs on a
+    //          worker when the loader has one, so it must not touch a command
+    //          list. Null on failure.
+    //-----------------------------------------------------------------------------
+    virtual std::unique_ptr<RenderModelStaging> Stage(const std::string &strName, const RenderModelAsset &model,
+                                                      const RenderModelTextureAsset &texture) = 0;
+};
+
+// A request that finished during Poll
+struct RenderModelLoadResult
+{
+    uint32_t nDevice;
+    std::string strName;
+    int32_t nTextureId;
+    bool bFailed;
+    std::unique_ptr<RenderModelStaging> pStaging; // null when IsLoaded answered or on failure
+};
+
+///
+/// Loads render models without blocking: each Poll advances every request as
+/// far as the source allows, staging runs on the worker pool, and finished
+/// requests come back for the caller to record on its frame's command list.
+/// Requests for a model another request is already loading wait for it
+/// instead of loading it twice.
+///
+class RenderModelLoader
+{
+    struct Job;
+    IRenderModelSource *m_pSource;
+    IRenderModelStager *m_pStager;
+    class WorkerPool *m_pWorkers;
+    std::vector<std::shared_ptr<Job>> m_jobs;
+
+public:
+    RenderModelLoader(IRenderModelSource *pSource, IRenderModelStager *pStager, class WorkerPool *pWorkers = nullptr);
+    // Waits for staging still running on a worker
+    ~RenderModelLoader();
+    RenderModelLoader(const RenderModelLoader &) = delete;
+    RenderModelLoader &operator=(const RenderModelLoader &) = delete;
+
+    // Load strName for nDevice, replacing any request the device still has pending
+    void Request(uint32_t nDevice, const std::string &strName);
+    // Forget nDevice's pending request, staging already running is thrown away when it finishes
+    void Cancel(uint32_t nDevice);
+
+    // Once per frame, never waits on the source or the workers
+    std::vector<RenderModelLoadResult> Poll();
+
+    bool IsIdle() const { return m_jobs.empty(); }
+
+private:
+    // true once the job is finished and can go
+    bool Advance(const std::shared_ptr<Job> &pJob, std::vector<RenderModelLoadResult> &results);
+    // Another job is loading the model, or finished it this Poll and the
+    // caller has yet to put it in the cache
+    bool IsKeyLoading(const Job &job, const std::vector<RenderModelLoadResult> &results) const;
+    void FreeAssets(Job &job);
+};
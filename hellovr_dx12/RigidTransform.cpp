@@ -0,0 +1,182 @@
+#include "RigidTransform.h"
+#include <math.h>
+
+Quaternion Quaternion::FromAxisAngle(const Vector3 &axis, float fRadians)
+{
+    float s = sinf(fRadians * 0.5f);
+    return Quaternion(axis.x * s, axis.y * s, axis.z * s, cosf(fRadians * 0.5f));
+}
+
+Quaternion Quaternion::FromRotationVector(const Vector3 &v)
+{
+    float fAngle = v.length();
+    if (fAngle < 1e-6f)
+    {
+        // sin(a/2)/a -> 1/2, keep the first order term so tiny rotations survive
+        return Quaternion(v.x * 0.5f, v.y * 0.5f, v.z * 0.5f, 1.0f).Normalized();
+    }
+    return FromAxisAngle(v * (1.0f / fAngle), fAngle);
+}
+
+Vector3 Quaternion::ToRotationVector() const
+{
+    // the short way round: q and -q are the same rotation
+    float fSign = w < 0 ? -1.0f : 1.0f;
+    Vector3 u(x * fSign, y * fSign, z * fSign);
+    float fSin = u.length();
+    if (fSin < 1e-6f)
+        return u * 2.0f;
+    float fAngle = 2 * atan2f(fSin, w * fSign);
+    return u * (fAngle / fSin);
+}
+
+Quaternion Quaternion::FromRotation(const float r[9])
+{
+    // Shepperd: take the root of the largest of w, x, y, z so it never
+    // divides by something near zero. r[col * 3 + row].
+    float fTrace = r[0] + r[4] + r[8];
+    Quaternion q;
+    if (fTrace > 0)
+    {
+        float s = sqrtf(fTrace + 1.0f) * 2;
+        q = Quaternion((r[5] - r[7]) / s, (r[6] - r[2]) / s, (r[1] - r[3]) / s, 0.25f * s);
+    }
+    else if (r[0] > r[4] && r[0] > r[8])
+    {
+        float s = sqrtf(1.0f + r[0] - r[4] - r[8]) * 2;
+        q = Quaternion(0.25f * s, (r[3] + r[1]) / s, (r[6] + r[2]) / s, (r[5] - r[7]) / s);
+    }
+    else if (r[4] > r[8])
+    {
+        float s = sqrtf(1.0f + r[4] - r[0] - r[8]) * 2;
+        q = Quaternion((r[3] + r[1]) / s, 0.25f * s, (r[7] + r[5]) / s, (r[6] - r[2]) / s);
+    }
+    else
+    {
+        float s = sqrtf(1.0f + r[8] - r[0] - r[4]) * 2;
+        q = Quaternion((r[6] + r[2]) / s, (r[7] + r[5]) / s, 0.25f * s, (r[1] - r[3]) / s);
+    }
+    return q.Normalized();
+}
+
+void Quaternion::ToRotation(float r[9]) const
+{
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+    r[0] = 1 - 2 * (yy + zz);
+    r[1] = 2 * (xy + wz);
+    r[2] = 2 * (xz - wy);
+    r[3] = 2 * (xy - wz);
+    r[4] = 1 - 2 * (xx + zz);
+    r[5] = 2 * (yz + wx);
+    r[6] = 2 * (xz + wy);
+    r[7] = 2 * (yz - wx);
+    r[8] = 1 - 2 * (xx + yy);
+}
+
+Quaternion Quaternion::operator*(const Quaternion &q) const
+{
+    return Quaternion(w * q.x + x * q.w + y * q.z - z * q.y,
+                      w * q.y - x * q.z + y * q.w + z * q.x,
+                      w * q.z + x * q.y - y * q.x + z * q.w,
+                      w * q.w - x * q.x - y * q.y - z * q.z);
+}
+
+Quaternion Quaternion::Normalized() const
+{
+    float fLength = sqrtf(Dot(*this));
+    if (fLength == 0)
+        return Quaternion();
+    float fInv = 1.0f / fLength;
+    return Quaternion(x * fInv, y * fInv, z * fInv, w * fInv);
+}
+
+Vector3 Quaternion::Rotate(const Vector3 &v) const
+{
+    // v + 2w (u x v) + 2 u x (u x v), u the vector part
+    Vector3 u(x, y, z);
+    Vector3 t = u.cross(v) * 2.0f;
+    return v + t * w + u.cross(t);
+}
+
+Quaternion Quaternion::Nlerp(const Quaternion &a, const Quaternion &b, float t)
+{
+    float fSign = a.Dot(b) < 0 ? -1.0f : 1.0f;
+    float s = 1 - t, u = t * fSign;
+    return Quaternion(a.x * s + b.x * u, a.y * s + b.y * u, a.z * s + b.z * u, a.w * s + b.w * u).Normalized();
+}
+
+Quaternion Quaternion::Slerp(const Quaternion &a, const Quaternion &b, float t)
+{
+    float fCos = a.Dot(b);
+    float fSign = 1.0f;
+    if (fCos < 0)
+    {
+        fCos = -fCos;
+        fSign = -1.0f;
+    }
+    // nearly the same rotation: sin(theta) is too small to divide by and nlerp is as good
+    if (fCos > 0.9995f)
+        return Nlerp(a, b, t);
+
+    float fTheta = acosf(fCos);
+    float fInvSin = 1.0f / sinf(fTheta);
+    float s = sinf((1 - t) * fTheta) * fInvSin;
+    float u = sinf(t * fTheta) * fInvSin * fSign;
+    return Quaternion(a.x * s + b.x * u, a.y * s + b.y * u, a.z * s + b.z * u, a.w * s + b.w * u).Normalized();
+}
+
+RigidTransform::RigidTransform(const Quaternion &rotation, const Vector3 &translation) : m_translation(translation)
+{
+    rotation.ToRotation(m_rotation);
+}
+
+RigidTransform RigidTransform::FromHmdMatrix34(const float m[3][4])
+{
+    RigidTransform transform;
+    for (int nCol = 0; nCol < 3; nCol++)
+    {
+        for (int nRow = 0; nRow < 3; nRow++)
+        {
+            transform.m_rotation[nCol * 3 + nRow] = m[nRow][nCol];
+        }
+    }
+    transform.m_translation = Vector3(m[0][3], m[1][3], m[2][3]);
+    return transform;
+}
+
+RigidTransform RigidTransform::FromMatrix4(const Matrix4 &mat)
+{
+    RigidTransform transform;
+    for (int nCol = 0; nCol < 3; nCol++)
+    {
+        for (int nRow = 0; nRow < 3; nRow++)
+        {
+            transform.m_rotation[nCol * 3 + nRow] = mat[nCol * 4 + nRow];
+        }
+    }
+    transform.m_translation = Vector3(mat[12], mat[13], mat[14]);
+    return transform;
+}
+
+Matrix4 RigidTransform::ToMatrix4() const
+{
+    const float *r = m_rotation;
+    return Matrix4(r[0], r[1], r[2], 0.0f,
+                   r[3], r[4], r[5], 0.0f,
+                   r[6], r[7], r[8], 0.0f,
+                   m_translation.x, m_translation.y, m_translation.z, 1.0f);
+}
+
+RigidTransform RigidTransform::Lerp(const RigidTransform &a, const RigidTransform &b, float t)
+{
+    return RigidTransform(Quaternion::Nlerp(a.Orientation(), b.Orientation(), t),
+                          a.m_translation + (b.m_translation - a.m_translation) * t);
+}
+
+RigidTransform RigidTransform::Slerp(const RigidTransform &a, const RigidTransform &b, float t)
+{
+    return RigidTransform(Quaternion::Slerp(a.Orientation(), b.Orientation(), t),
+                          a.m_translation + (b.m_translation - a.m_translation) * t);
+}
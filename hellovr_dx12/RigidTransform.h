@@ -0,0 +1,117 @@
+#pragma once
+#include "Matrices.h"
+
+// Unit quaternion, x/y/z the vector part
+struct Quaternion
+{
+    float x = 0;
+    float y = 0;
+    float z = 0;
+    float w = 1;
+
+    Quaternion() = default;
+    Quaternion(float fx, float fy, float fz, float fw) : x(fx), y(fy), z(fz), w(fw) {}
+
+    // fRadians about a unit axis
+    static Quaternion FromAxisAngle(const Vector3 &axis, float fRadians);
+    // Rotation vector: the axis scaled by the angle in radians, and back
+    static Quaternion FromRotationVector(const Vector3 &v);
+    Vector3 ToRotationVector() const;
+    // From a column major orthonormal 3x3 rotation
+    static Quaternion FromRotation(const float rotation[9]);
+    // Column major 3x3 rotation
+    void ToRotation(float rotation[9]) const;
+
+    Quaternion operator*(const Quaternion &rhs) const;
+    Quaternion Conjugate() const { return Quaternion(-x, -y, -z, w); }
+    float Dot(const Quaternion &rhs) const { return x * rhs.x + y * rhs.y + z * rhs.z + w * rhs.w; }
+    Quaternion Normalized() const;
+    Vector3 Rotate(const Vector3 &v) const;
+
+    // Shortest arc: b is negated when it is in the other hemisphere from a
+    static Quaternion Nlerp(const Quaternion &a, const Quaternion &b, float t);
+    static Quaternion Slerp(const Quaternion &a, const Quaternion &b, float t);
+};
+
+///
+/// A rotation then a translation, the 3x4 that SteamVR tracks every pose as.
+/// Kept as the rotation matrix rather than a quaternion so converting from
+/// a HmdMatrix34_t and to a Matrix4 is exact. Inverting is a transpose and
+/// three dot products.
+///
+class RigidTransform
+{
+    float m_rotation[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1}; // column major, the first three columns of the Matrix4
+    Vector3 m_translation;
+
+public:
+    RigidTransform() = default;
+    RigidTransform(const Quaternion &rotation, const Vector3 &translation);
+
+    // m is the row major float[3][4] of a vr::HmdMatrix34_t
+    static RigidTransform FromHmdMatrix34(const float m[3][4]);
+    // The upper 3x4 of a matrix known to be rigid
+    static RigidTransform FromMatrix4(const Matrix4 &mat);
+    Matrix4 ToMatrix4() const;
+
+    const float *Rotation() const { return m_rotation; }
+    const Vector3 &Translation() const { return m_translation; }
+    Quaternion Orientation() const { return Quaternion::FromRotation(m_rotation); }
+
+    // this applied after rhs
+    RigidTransform operator*(const RigidTransform &rhs) const;
+    RigidTransform Inverse() const;
+    Vector3 TransformPoint(const Vector3 &p) const;
+    Vector3 TransformVector(const Vector3 &v) const;
+
+    // Translation lerped, rotation nlerped or slerped along the shortest arc
+    static RigidTransform Lerp(const RigidTransform &a, const RigidTransform &b, float t);
+    static RigidTransform Slerp(const RigidTransform &a, const RigidTransform &b, float t);
+};
+
+inline Vector3 RigidTransform::TransformVector(const Vector3 &v) const
+{
+    const float *r = m_rotation;
+    return Vector3(r[0] * v.x + r[3] * v.y + r[6] * v.z,
+                   r[1] * v.x + r[4] * v.y + r[7] * v.z,
+                   r[2] * v.x + r[5] * v.y + r[8] * v.z);
+}
+
+inline Vector3 RigidTransform::TransformPoint(const Vector3 &p) const
+{
+    const float *r = m_rotation;
+    return Vector3(r[0] * p.x + r[3] * p.y + r[6] * p.z + m_translation.x,
+                   r[1] * p.x + r[4] * p.y + r[7] * p.z + m_translation.y,
+                   r[2] * p.x + r[5] * p.y + r[8] * p.z + m_translation.z);
+}
+
+inline RigidTransform RigidTransform::operator*(const RigidTransform &rhs) const
+{
+    // each column of rhs's rotation rotated by this, then rhs's origin moved
+    RigidTransform result;
+    for (int nCol = 0; nCol < 3; nCol++)
+    {
+        Vector3 column = TransformVector(Vector3(rhs.m_rotation[nCol * 3], rhs.m_rotation[nCol * 3 + 1], rhs.m_rotation[nCol * 3 + 2]));
+        result.m_rotation[nCol * 3] = column.x;
+        result.m_rotation[nCol * 3 + 1] = column.y;
+        result.m_rotation[nCol * 3 + 2] = column.z;
+    }
+    result.m_translation = TransformPoint(rhs.m_translation);
+    return result;
+}
+
+inline RigidTransform RigidTransform::Inverse() const
+{
+    // [R | t]^-1 = [R^T | -R^T t]
+    RigidTransform result;
+    const float *r = m_rotation;
+    float *rt = result.m_rotation;
+    rt[0] = r[0]; rt[1] = r[3]; rt[2] = r[6];
+    rt[3] = r[1]; rt[4] = r[4]; rt[5] = r[7];
+    rt[6] = r[2]; rt[7] = r[5]; rt[8] = r[8];
+    const Vector3 &t = m_translation;
+    result.m_translation = Vector3(-(r[0] * t.x + r[1] * t.y + r[2] * t.z),
+                                   -(r[3] * t.x + r[4] * t.y + r[5] * t.z),
+                                   -(r[6] * t.x + r[7] * t.y + r[8] * t.z));
+    return result;
+}
@@ -3,92 +3,454 @@
 #include "lodepng.h"
 #include "d3dx12.h"
 #include "GenMipMapRGBA.h"
+#include "CookedTexture.h"
+#include "WorkerPool.h"
+#include "TextureBatch.h"
+#include <string.h>
 
-bool Texture::SetupTexturemaps(const ComPtr<ID3D12Device> &device, const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
-                               D3D12_CPU_DESCRIPTOR_HANDLE srvHandle)
+static std::string GetTextureSourcePath()
 {
     std::string sExecutableDirectory = Path_StripFilename(Path_GetExecutablePath());
-    std::string strFullPath = Path_MakeAbsolute("../../hellovr_dx12/cube_texture.png", sExecutableDirectory);
-
-    std::vector<unsigned char> imageRGBA;
-    unsigned nImageWidth, nImageHeight;
-    unsigned nError = lodepng::decode(imageRGBA, nImageWidth, nImageHeight, strFullPath.c_str());
-
-    if (nError != 0)
-        return false;
+    return Path_MakeAbsolute("../../hellovr_dx12/cube_texture.png", sExecutableDirectory);
+}
 
-    // Store level 0
-    std::vector<D3D12_SUBRESOURCE_DATA> mipLevelData;
-    UINT8 *pBaseData = new UINT8[nImageWidth * nImageHeight * 4];
-    memcpy(pBaseData, &imageRGBA[0], sizeof(UINT8) * nImageWidth * nImageHeight * 4);
+Texture::~Texture()
+{
+    if (m_pStreamer)
+    {
+        m_pStreamer->Unregister(m_nStreamId);
+    }
+}
 
-    D3D12_SUBRESOURCE_DATA textureData = {};
-    textureData.pData = &pBaseData[0];
-    textureData.RowPitch = nImageWidth * 4;
-    textureData.SlicePitch = textureData.RowPitch * nImageHeight;
-    mipLevelData.push_back(textureData);
+bool Texture::SetupTexturemaps(const ComPtr<ID3D12Device> &device, const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
+                               D3D12_CPU_DESCRIPTOR_HANDLE srvHandle, WorkerPool *pWorkers, TextureStreamer *pStreamer)
+{
+    std::string strFullPath = GetTextureSourcePath();
 
-    // Generate mipmaps for the image
-    int nPrevImageIndex = 0;
-    int nMipWidth = nImageWidth;
-    int nMipHeight = nImageHeight;
+    // A cooked file skips both the decode and the mip generation
+    if (m_cooked.Open(GetCookedTexturePath(strFullPath), strFullPath, m_mipFilter))
+    {
+        bool bResult = CreateFromCooked(device, pCommandList, srvHandle, m_cooked, pStreamer);
+        if (!pStreamer)
+        {
+            m_cooked.Close();
+        }
+        return bResult;
+    }
 
-    while (nMipWidth > 1 && nMipHeight > 1)
+    if (pStreamer && pWorkers)
     {
-        UINT8 *pNewImage;
-        GenMipMapRGBA((UINT8 *)mipLevelData[nPrevImageIndex].pData, &pNewImage, nMipWidth, nMipHeight, &nMipWidth, &nMipHeight);
+        return CreateFromPNGAsync(device, srvHandle, strFullPath, pWorkers, pStreamer);
+    }
 
-        D3D12_SUBRESOURCE_DATA mipData = {};
-        mipData.pData = pNewImage;
-        mipData.RowPitch = nMipWidth * 4;
-        mipData.SlicePitch = textureData.RowPitch * nMipHeight;
-        mipLevelData.push_back(mipData);
+    return StagePNG(device, strFullPath, pWorkers) && UploadStaged(pCommandList.Get(), srvHandle, pStreamer);
+}
 
-        nPrevImageIndex++;
+bool Texture::CookTexturemaps(const MipFilterOptions &mipFilter, CookedFormat format, BCQuality quality, WorkerPool *pWorkers)
+{
+    std::string strFullPath = GetTextureSourcePath();
+    return CookTexture(strFullPath, GetCookedTexturePath(strFullPath), mipFilter, format, quality, pWorkers);
+}
+
+static DXGI_FORMAT GetCookedDXGIFormat(CookedFormat format, bool bSRGB)
+{
+    switch (format)
+    {
+    case CookedFormat::BC1:
+        return bSRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+    case CookedFormat::BC3:
+        return bSRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+    case CookedFormat::BC7:
+        return bSRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+    default:
+        return bSRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
     }
+}
 
+bool Texture::CreateTextureResource(const ComPtr<ID3D12Device> &device, int nWidth, int nHeight, int nMipLevels, DXGI_FORMAT format)
+{
     D3D12_RESOURCE_DESC textureDesc = {};
-    textureDesc.MipLevels = (UINT16)mipLevelData.size();
-    textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    textureDesc.Width = nImageWidth;
-    textureDesc.Height = nImageHeight;
+    textureDesc.MipLevels = (UINT16)nMipLevels;
+    textureDesc.Format = format;
+    textureDesc.Width = nWidth;
+    textureDesc.Height = nHeight;
     textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
     textureDesc.DepthOrArraySize = 1;
     textureDesc.SampleDesc.Count = 1;
     textureDesc.SampleDesc.Quality = 0;
     textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
 
-    device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-                                    D3D12_HEAP_FLAG_NONE,
-                                    &textureDesc,
-                                    D3D12_RESOURCE_STATE_COPY_DEST,
-                                    nullptr,
-                                    IID_PPV_ARGS(&m_pTexture));
+    if (FAILED(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+                                               D3D12_HEAP_FLAG_NONE,
+                                               &textureDesc,
+                                               D3D12_RESOURCE_STATE_COPY_DEST,
+                                               nullptr,
+                                               IID_PPV_ARGS(&m_pTexture))))
+    {
+        return false;
+    }
+
+    m_pDevice = device;
+    m_nMipLevels = nMipLevels;
+    m_nMostDetailedMip = 0;
+    m_nGpuBytes = device->GetResourceAllocationInfo(0, 1, &textureDesc).SizeInBytes;
+    return true;
+}
+
+bool Texture::CreateUploadHeap(const ComPtr<ID3D12Device> &device, UINT64 nUploadBufferSize)
+{
+    if (FAILED(device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(nUploadBufferSize),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&m_pTextureUploadHeap))))
+    {
+        return false;
+    }
+    m_nGpuBytes += nUploadBufferSize;
+    return true;
+}
+
+void Texture::WriteShaderResourceView(D3D12_CPU_DESCRIPTOR_HANDLE srvHandle) const
+{
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = m_pTexture->GetDesc().Format;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    if (m_nMostDetailedMip >= m_nMipLevels)
+    {
+        // A null SRV samples as zero
+        srvDesc.Texture2D.MipLevels = 1;
+        m_pDevice->CreateShaderResourceView(nullptr, &srvDesc, srvHandle);
+        return;
+    }
+    srvDesc.Texture2D.MostDetailedMip = m_nMostDetailedMip;
+    srvDesc.Texture2D.MipLevels = m_nMipLevels - m_nMostDetailedMip;
+    srvDesc.Texture2D.ResourceMinLODClamp = (FLOAT)m_nMostDetailedMip;
+    m_pDevice->CreateShaderResourceView(m_pTexture.Get(), &srvDesc, srvHandle);
+}
+
+void Texture::SetShaderResourceView(D3D12_CPU_DESCRIPTOR_HANDLE srvHandle)
+{
+    m_srvHandles.assign(1, srvHandle);
+    WriteShaderResourceView(srvHandle);
+}
 
-    // D3D12_CPU_DESCRIPTOR_HANDLE m_textureShaderResourceView;
-    // Create shader resource view
-    // auto srvHandle = m_cbv->CpuHandle(SRV_TEXTURE_MAP);
-    device->CreateShaderResourceView(m_pTexture.Get(), nullptr, srvHandle);
-    // m_textureShaderResourceView = srvHandle;
+void Texture::AddShaderResourceView(D3D12_CPU_DESCRIPTOR_HANDLE srvHandle)
+{
+    bool bKnown = false;
+    for (auto &known : m_srvHandles)
+    {
+        bKnown |= known.ptr == srvHandle.ptr;
+    }
+    if (!bKnown)
+    {
+        m_srvHandles.push_back(srvHandle);
+    }
+    WriteShaderResourceView(srvHandle);
+}
 
-    const UINT64 nUploadBufferSize = GetRequiredIntermediateSize(m_pTexture.Get(), 0, textureDesc.MipLevels);
+void Texture::RemoveShaderResourceView(D3D12_CPU_DESCRIPTOR_HANDLE srvHandle)
+{
+    for (size_t i = 0; i < m_srvHandles.size(); i++)
+    {
+        if (m_srvHandles[i].ptr == srvHandle.ptr)
+        {
+            m_srvHandles.erase(m_srvHandles.begin() + i);
+            return;
+        }
+    }
+}
+
+bool Texture::CreateFromRGBA(const ComPtr<ID3D12Device> &device, const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
+                             D3D12_CPU_DESCRIPTOR_HANDLE srvHandle,
+                             const UINT8 *pImageRGBA, int nImageWidth, int nImageHeight,
+                             WorkerPool *pWorkers, TextureStreamer *pStreamer)
+{
+    return StageRGBA(device, pImageRGBA, nImageWidth, nImageHeight, pWorkers) &&
+           UploadStaged(pCommandList.Get(), srvHandle, pStreamer);
+}
+
+bool Texture::CreateRGBAResources(const ComPtr<ID3D12Device> &device, int nWidth, int nHeight,
+                                  std::vector<MipLevelLayout> &mipLevels, DXGI_FORMAT &format)
+{
+    // Placement of every mip level in the upload heap
+    mipLevels.resize(GetMipChainLevelCount(nWidth, nHeight));
+    const size_t nUploadBufferSize = ComputeMipChainLayoutRGBA(nWidth, nHeight, &mipLevels[0]);
+
+    format = m_mipFilter.bSRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+    if (!CreateTextureResource(device, nWidth, nHeight, (int)mipLevels.size(), format))
+        return false;
 
     // Create the GPU upload buffer.
-    device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(nUploadBufferSize),
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&m_pTextureUploadHeap));
-
-    UpdateSubresources(pCommandList.Get(), m_pTexture.Get(), m_pTextureUploadHeap.Get(), 0, 0, (UINT)mipLevelData.size(), &mipLevelData[0]);
+    if (!CreateUploadHeap(device, nUploadBufferSize))
+        return false;
+
+    CD3DX12_RANGE readRange(0, 0);
+    m_pTextureUploadHeap->Map(0, &readRange, reinterpret_cast<void **>(&m_pMappedUploadHeap));
+    return true;
+}
+
+bool Texture::StageRGBA(const ComPtr<ID3D12Device> &device, const UINT8 *pImageRGBA, int nImageWidth, int nImageHeight,
+                        WorkerPool *pWorkers)
+{
+    std::vector<MipLevelLayout> mipLevels;
+    DXGI_FORMAT format;
+    if (!CreateRGBAResources(device, nImageWidth, nImageHeight, mipLevels, format))
+        return false;
+
+    // Generate the whole mip chain into the mapped upload heap
+    GenerateMipChainRGBA(pImageRGBA, nImageWidth * 4, m_pMappedUploadHeap, &mipLevels[0], (int)mipLevels.size(), m_mipFilter, pWorkers);
+    SetGeneratedUploadLevels(mipLevels, format);
+    return true;
+}
+
+bool Texture::StagePNG(const ComPtr<ID3D12Device> &device, const std::string &strPath, WorkerPool *pWorkers)
+{
+    unsigned nImageWidth, nImageHeight;
+    std::vector<MipLevelLayout> mipLevels;
+    DXGI_FORMAT format;
+    if (!InspectPNG(TextureSource::File(strPath), &nImageWidth, &nImageHeight) ||
+        !CreateRGBAResources(device, nImageWidth, nImageHeight, mipLevels, format))
+        return false;
+
+    if (!DecodePNGIntoMipChain(TextureSource::File(strPath), m_pMappedUploadHeap, mipLevels, m_mipFilter, pWorkers))
+        return false;
+    SetGeneratedUploadLevels(mipLevels, format);
+    return true;
+}
+
+bool Texture::StageMipChain(const ComPtr<ID3D12Device> &device, const LoadedTexture &texture)
+{
+    std::vector<MipLevelLayout> mipLevels;
+    DXGI_FORMAT format;
+    if (texture.bFailed || texture.bCancelled ||
+        !CreateRGBAResources(device, texture.nWidth, texture.nHeight, mipLevels, format))
+        return false;
+
+    // same layout on both sides, one straight write into the upload heap
+    memcpy(m_pMappedUploadHeap, &texture.mipChain[0], texture.mipChain.size());
+    SetGeneratedUploadLevels(mipLevels, format);
+    return true;
+}
+
+bool Texture::UploadStaged(ID3D12GraphicsCommandList *pCommandList, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle, TextureStreamer *pStreamer)
+{
+    SetShaderResourceView(srvHandle);
+    if (pStreamer)
+    {
+        // the heap stays mapped, every level is already in place
+        BeginStreaming(pStreamer);
+        pStreamer->SetLevelsReady(m_nStreamId, 0);
+        return true;
+    }
+    m_pTextureUploadHeap->Unmap(0, nullptr);
+    m_pMappedUploadHeap = nullptr;
+
+    for (UINT nMip = 0; nMip < (UINT)m_uploadLevels.size(); nMip++)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION dst(m_pTexture.Get(), nMip);
+        CD3DX12_TEXTURE_COPY_LOCATION src(m_pTextureUploadHeap.Get(), m_uploadLevels[nMip].footprint);
+        pCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
     pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_pTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 
-    // Free mip pointers
-    for (size_t nMip = 0; nMip < mipLevelData.size(); nMip++)
+    return true;
+}
+
+bool Texture::CreateFromCooked(const ComPtr<ID3D12Device> &device, const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
+                               D3D12_CPU_DESCRIPTOR_HANDLE srvHandle, const CookedTexture &cooked, TextureStreamer *pStreamer)
+{
+    const UINT nMipLevels = (UINT)cooked.MipLevels();
+    DXGI_FORMAT format = GetCookedDXGIFormat(cooked.Format(), cooked.IsSRGB());
+    if (!CreateTextureResource(device, cooked.Width(), cooked.Height(), nMipLevels, format))
+        return false;
+
+    if (!CreateUploadHeap(device, GetRequiredIntermediateSize(m_pTexture.Get(), 0, nMipLevels)))
+        return false;
+    SetShaderResourceView(srvHandle);
+
+    if (pStreamer)
+    {
+        // Levels are copied out of the mapping as they stream, the device decides the footprints
+        m_uploadLevels.resize(nMipLevels);
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(nMipLevels);
+        std::vector<UINT> rows(nMipLevels);
+        std::vector<UINT64> rowBytes(nMipLevels);
+        D3D12_RESOURCE_DESC textureDesc = m_pTexture->GetDesc();
+        device->GetCopyableFootprints(&textureDesc, 0, nMipLevels, 0, &footprints[0], &rows[0], &rowBytes[0], nullptr);
+        for (UINT nMip = 0; nMip < nMipLevels; nMip++)
+        {
+            UploadLevel &upload = m_uploadLevels[nMip];
+            upload.footprint = footprints[nMip];
+            upload.nRows = rows[nMip];
+            upload.nRowBytes = rowBytes[nMip];
+            upload.pSource = cooked.SubresourceData(nMip);
+            upload.nSourcePitch = cooked.Subresource(nMip).nRowPitch;
+        }
+
+        CD3DX12_RANGE readRange(0, 0);
+        m_pTextureUploadHeap->Map(0, &readRange, reinterpret_cast<void **>(&m_pMappedUploadHeap));
+        BeginStreaming(pStreamer);
+        pStreamer->SetLevelsReady(m_nStreamId, 0);
+        return true;
+    }
+
+    // Subresources point straight into the mapping, the copy into the upload heap is the only touch.
+    // Block compressed rows are rows of 4x4 blocks.
+    std::vector<D3D12_SUBRESOURCE_DATA> subresources(nMipLevels);
+    for (UINT nMip = 0; nMip < nMipLevels; nMip++)
     {
-        delete[] mipLevelData[nMip].pData;
+        const CookedSubresource &sub = cooked.Subresource(nMip);
+        subresources[nMip].pData = cooked.SubresourceData(nMip);
+        subresources[nMip].RowPitch = sub.nRowPitch;
+        subresources[nMip].SlicePitch = (LONG_PTR)sub.nRowPitch * cooked.SubresourceRows(nMip);
     }
+    if (UpdateSubresources(pCommandList.Get(), m_pTexture.Get(), m_pTextureUploadHeap.Get(), 0, 0, nMipLevels, &subresources[0]) == 0)
+        return false;
+
+    pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_pTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
     return true;
-}
\ No newline at end of file
+}
+
+bool Texture::CreateFromPNGAsync(const ComPtr<ID3D12Device> &device, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle,
+                                 const std::string &strPath, WorkerPool *pWorkers, TextureStreamer *pStreamer)
+{
+    // The header is enough to size the resource, the decode itself moves off the render thread
+    unsigned nImageWidth, nImageHeight;
+    std::vector<MipLevelLayout> mipLevels;
+    DXGI_FORMAT format;
+    if (!InspectPNG(TextureSource::File(strPath), &nImageWidth, &nImageHeight) ||
+        !CreateRGBAResources(device, nImageWidth, nImageHeight, mipLevels, format))
+        return false;
+    SetShaderResourceView(srvHandle);
+    SetGeneratedUploadLevels(mipLevels, format);
+    BeginStreaming(pStreamer);
+
+    // The pool drains its queue before it is destroyed, owners keep it alive past this texture
+    pWorkers->Submit([this, strPath, mipLevels, pWorkers, pStreamer]() {
+        if (DecodePNGIntoMipChain(TextureSource::File(strPath), m_pMappedUploadHeap, mipLevels, m_mipFilter, pWorkers))
+        {
+            pStreamer->SetLevelsReady(m_nStreamId, 0);
+        }
+    });
+    return true;
+}
+
+void Texture::SetGeneratedUploadLevels(const std::vector<MipLevelLayout> &mipLevels, DXGI_FORMAT format)
+{
+    m_uploadLevels.resize(mipLevels.size());
+    for (size_t nMip = 0; nMip < mipLevels.size(); nMip++)
+    {
+        const MipLevelLayout &level = mipLevels[nMip];
+        UploadLevel &upload = m_uploadLevels[nMip];
+        upload.footprint.Offset = level.nOffset;
+        upload.footprint.Footprint = CD3DX12_SUBRESOURCE_FOOTPRINT(format, level.nWidth, level.nHeight, 1, (UINT)level.nRowPitch);
+        upload.nRows = level.nHeight;
+        upload.nRowBytes = (UINT64)level.nWidth * 4;
+        upload.pSource = nullptr;
+        upload.nSourcePitch = 0;
+    }
+}
+
+void Texture::BeginStreaming(TextureStreamer *pStreamer)
+{
+    // nothing is shader readable yet
+    SetMostDetailedMip(m_nMipLevels);
+
+    const int nMipLevels = (int)m_uploadLevels.size();
+    std::vector<size_t> levelBytes(nMipLevels);
+    for (int nMip = 0; nMip < nMipLevels; nMip++)
+    {
+        levelBytes[nMip] = (size_t)m_uploadLevels[nMip].footprint.Footprint.RowPitch * m_uploadLevels[nMip].nRows;
+    }
+    const D3D12_RESOURCE_DESC textureDesc = m_pTexture->GetDesc();
+    const int nTailMip = GetMipStreamTailLevel((int)textureDesc.Width, (int)textureDesc.Height, nMipLevels);
+
+    m_pStreamer = pStreamer;
+    m_nStreamId = pStreamer->Register(this, &levelBytes[0], nMipLevels, nTailMip);
+}
+
+void Texture::RecordMipCopy(ID3D12GraphicsCommandList *pCommandList, int nMip)
+{
+    const UploadLevel &level = m_uploadLevels[nMip];
+    if (level.pSource)
+    {
+        UINT8 *pDst = m_pMappedUploadHeap + level.footprint.Offset;
+        for (UINT nRow = 0; nRow < level.nRows; nRow++)
+        {
+            memcpy(pDst + (size_t)nRow * level.footprint.Footprint.RowPitch, level.pSource + nRow * level.nSourcePitch, (size_t)level.nRowBytes);
+        }
+    }
+
+    CD3DX12_TEXTURE_COPY_LOCATION dst(m_pTexture.Get(), nMip);
+    CD3DX12_TEXTURE_COPY_LOCATION src(m_pTextureUploadHeap.Get(), level.footprint);
+    pCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+    // Levels not yet streamed stay in COPY_DEST, the SRV never covers them
+    pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_pTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nMip));
+}
+
+void Texture::SetMostDetailedMip(int nMip)
+{
+    m_nMostDetailedMip = nMip;
+    for (auto &srvHandle : m_srvHandles)
+    {
+        WriteShaderResourceView(srvHandle);
+    }
+}
+
+///
+/// Forwards the scheduler's decisions to the registered textures
+///
+class TextureStreamCommands : public IMipStreamCommands
+{
+    ID3D12GraphicsCommandList *m_pCommandList;
+    const std::vector<Texture *> &m_textures;
+
+public:
+    TextureStreamCommands(ID3D12GraphicsCommandList *pCommandList, const std::vector<Texture *> &textures)
+        : m_pCommandList(pCommandList), m_textures(textures)
+    {
+    }
+    void CopyMip(int nTexture, int nMip) override
+    {
+        m_textures[nTexture]->RecordMipCopy(m_pCommandList, nMip);
+    }
+    void SetMostDetailedMip(int nTexture, int nMip) override
+    {
+        m_textures[nTexture]->SetMostDetailedMip(nMip);
+    }
+};
+
+int TextureStreamer::Register(Texture *pTexture, const size_t *pLevelBytes, int nMipLevels, int nTailMip)
+{
+    int nStreamId = m_scheduler.AddTexture(pLevelBytes, nMipLevels, nTailMip);
+    if (nStreamId >= (int)m_textures.size())
+    {
+        m_textures.resize(nStreamId + 1, nullptr);
+    }
+    m_textures[nStreamId] = pTexture;
+    return nStreamId;
+}
+
+void TextureStreamer::Unregister(int nStreamId)
+{
+    m_scheduler.RemoveTexture(nStreamId);
+    m_textures[nStreamId] = nullptr;
+}
+
+void TextureStreamer::Update(ID3D12GraphicsCommandList *pCommandList)
+{
+    TextureStreamCommands commands(pCommandList, m_textures);
+    m_scheduler.Update(commands, m_nFrameBudget);
+}
+
+void TextureStreamer::UploadTails(ID3D12GraphicsCommandList *pCommandList)
+{
+    TextureStreamCommands commands(pCommandList, m_textures);
+    m_scheduler.Update(commands, 0);
+}
@@ -1,6 +1,11 @@
 #pragma once
 #include <d3d12.h>
 #include <wrl/client.h>
+#include <string>
+#include <vector>
+#include "GenMipMapRGBA.h"
+#include "CookedTexture.h"
+#include "MipStreaming.h"
 
 class Texture
 {
@@ -9,9 +14,166 @@ class Texture
 
     ComPtr<ID3D12Resource> m_pTexture;
     ComPtr<ID3D12Resource> m_pTextureUploadHeap;
+    MipFilterOptions m_mipFilter;
+
+    // Every descriptor viewing the texture, rewritten together as mips stream in
+    ComPtr<ID3D12Device> m_pDevice;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_srvHandles;
+    int m_nMipLevels = 0;
+    int m_nMostDetailedMip = 0; // m_nMipLevels while nothing is resident
+    UINT64 m_nGpuBytes = 0;
+
+    // Mip levels in the upload heap, for staged uploads and streaming
+    struct UploadLevel
+    {
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+        UINT nRows;
+        UINT64 nRowBytes;
+        const UINT8 *pSource; // rows still to copy into the upload heap, null when generated there
+        size_t nSourcePitch;
+    };
+    std::vector<UploadLevel> m_uploadLevels;
+    UINT8 *m_pMappedUploadHeap = nullptr;
+    CookedTexture m_cooked; // stays mapped while its levels stream
+    class TextureStreamer *m_pStreamer = nullptr;
+    int m_nStreamId = -1;
 
 public:
+    Texture(const MipFilterOptions &mipFilter = MipFilterOptions())
+        : m_mipFilter(mipFilter)
+    {
+    }
+    ~Texture();
+    Texture(const Texture &) = delete;
+    Texture &operator=(const Texture &) = delete;
+
+    //-----------------------------------------------------------------------------
+    // Purpose: Load the cube texture, cooked if possible. A PNG is decoded a
+    //          piece of the file at a time straight into the mip chain. With
+    //          pStreamer only the mip tail is uploaded up front; the PNG is then
+    //          also decoded on pWorkers so startup does not wait for it.
+    //-----------------------------------------------------------------------------
     bool SetupTexturemaps(const ComPtr<ID3D12Device> &device,
                           const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
-                          D3D12_CPU_DESCRIPTOR_HANDLE srvHandle);
+                          D3D12_CPU_DESCRIPTOR_HANDLE srvHandle,
+                          class WorkerPool *pWorkers = nullptr,
+                          class TextureStreamer *pStreamer = nullptr);
+
+    // Write the cooked file next to the texture PNG for these filter options
+    static bool CookTexturemaps(const MipFilterOptions &mipFilter, CookedFormat format, BCQuality quality,
+                                class WorkerPool *pWorkers = nullptr);
+
+    //-----------------------------------------------------------------------------
+    // Purpose: Create the texture with a full mip chain from an RGBA8 image.
+    //          sRGB filtering also makes the texture an _SRGB format, so the
+    //          sampler decodes what the mips were filtered against.
+    //          The chain is generated straight into the upload heap, split
+    //          over pWorkers when given. With pStreamer the copies are left to
+    //          the streamer instead of being recorded on pCommandList.
+    //-----------------------------------------------------------------------------
+    bool CreateFromRGBA(const ComPtr<ID3D12Device> &device,
+                        const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
+                        D3D12_CPU_DESCRIPTOR_HANDLE srvHandle,
+                        const UINT8 *pImageRGBA, int nImageWidth, int nImageHeight,
+                        class WorkerPool *pWorkers = nullptr,
+                        class TextureStreamer *pStreamer = nullptr);
+
+    //-----------------------------------------------------------------------------
+    // Purpose: Create the texture from a mapped cooked file. The payload already
+    //          has D3D12 row pitch, so it is copied into the upload heap as is,
+    //          block compressed or not. With pStreamer each level is copied
+    //          out of the mapping when it streams, cooked must stay open.
+    //-----------------------------------------------------------------------------
+    bool CreateFromCooked(const ComPtr<ID3D12Device> &device,
+                          const ComPtr<ID3D12GraphicsCommandList> &pCommandList,
+                          D3D12_CPU_DESCRIPTOR_HANDLE srvHandle,
+                          const class CookedTexture &cooked,
+                          class TextureStreamer *pStreamer = nullptr);
+
+    //-----------------------------------------------------------------------------
+    // Purpose: CreateFromRGBA in two steps. StageRGBA creates the resources and
+    //          generates the chain into the upload heap without touching a
+    //          command list or descriptor, so it can run on a worker.
+    //          UploadStaged then records the copies, or hands them to pStreamer.
+    //-----------------------------------------------------------------------------
+    bool StageRGBA(const ComPtr<ID3D12Device> &device, const UINT8 *pImageRGBA, int nImageWidth, int nImageHeight,
+                   class WorkerPool *pWorkers = nullptr);
+    bool UploadStaged(ID3D12GraphicsCommandList *pCommandList, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle,
+                      class TextureStreamer *pStreamer = nullptr);
+
+    // StageRGBA for a texture TextureBatchLoader already decoded, with this texture's filter options
+    bool StageMipChain(const ComPtr<ID3D12Device> &device, const struct LoadedTexture &texture);
+
+    // Point another descriptor at the texture, it follows the streamed mips like the first.
+    // Adding one that is already there only rewrites it.
+    void AddShaderResourceView(D3D12_CPU_DESCRIPTOR_HANDLE srvHandle);
+    void RemoveShaderResourceView(D3D12_CPU_DESCRIPTOR_HANDLE srvHandle);
+
+    // Texture and upload heap memory
+    UINT64 GpuBytes() const { return m_nGpuBytes; }
+
+private:
+    friend class TextureStreamer;
+
+    bool CreateTextureResource(const ComPtr<ID3D12Device> &device, int nWidth, int nHeight, int nMipLevels, DXGI_FORMAT format);
+    bool CreateUploadHeap(const ComPtr<ID3D12Device> &device, UINT64 nUploadBufferSize);
+
+    // Texture and mapped upload heap for an RGBA8 chain laid out in mipLevels
+    bool CreateRGBAResources(const ComPtr<ID3D12Device> &device, int nWidth, int nHeight,
+                             std::vector<MipLevelLayout> &mipLevels, DXGI_FORMAT &format);
+
+    // StageRGBA for a PNG file, decoded into the upload heap without a whole image in between
+    bool StagePNG(const ComPtr<ID3D12Device> &device, const std::string &strPath, class WorkerPool *pWorkers = nullptr);
+
+    // Decode the PNG on a worker straight into the upload heap, levels become ready when done
+    bool CreateFromPNGAsync(const ComPtr<ID3D12Device> &device, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle,
+                            const std::string &strPath, class WorkerPool *pWorkers, class TextureStreamer *pStreamer);
+
+    // Stream levels of an RGBA8 chain generated into the upload heap
+    void SetGeneratedUploadLevels(const std::vector<MipLevelLayout> &mipLevels, DXGI_FORMAT format);
+
+    // Hand the levels in m_uploadLevels to pStreamer, the SRVs stay null until the tail lands
+    void BeginStreaming(class TextureStreamer *pStreamer);
+
+    // srvHandle becomes the only view of the texture
+    void SetShaderResourceView(D3D12_CPU_DESCRIPTOR_HANDLE srvHandle);
+
+    // Resident mips of the texture, or a null view before any
+    void WriteShaderResourceView(D3D12_CPU_DESCRIPTOR_HANDLE srvHandle) const;
+
+    // Called by TextureStreamer::Update
+    void RecordMipCopy(ID3D12GraphicsCommandList *pCommandList, int nMip);
+    void SetMostDetailedMip(int nMip);
+};
+
+///
+/// Uploads registered textures a few mip levels per frame, see MipStreamScheduler
+///
+class TextureStreamer
+{
+    MipStreamScheduler m_scheduler;
+    std::vector<Texture *> m_textures; // by scheduler id
+    size_t m_nFrameBudget;
+
+public:
+    explicit TextureStreamer(size_t nFrameBudget)
+        : m_nFrameBudget(nFrameBudget)
+    {
+    }
+
+    int Register(Texture *pTexture, const size_t *pLevelBytes, int nMipLevels, int nTailMip);
+    void Unregister(int nStreamId);
+
+    // CPU data of nMip and coarser is in the texture's upload heap or mapping, any thread
+    void SetLevelsReady(int nStreamId, int nMip) { m_scheduler.SetLevelsReady(nStreamId, nMip); }
+
+    //-----------------------------------------------------------------------------
+    // Purpose: Record this frame's copies on pCommandList ahead of its draws.
+    //          SRVs are rewritten in place, so the GPU must be done with the
+    //          previous frame. UploadTails spends no budget, for loading.
+    //-----------------------------------------------------------------------------
+    void Update(ID3D12GraphicsCommandList *pCommandList);
+    void UploadTails(ID3D12GraphicsCommandList *pCommandList);
+
+    bool IsComplete() const { return m_scheduler.IsComplete(); }
 };
@@ -0,0 +1,226 @@
+#include "TextureBatch.h"
+#include "lodepng.h"
+#include "WorkerPool.h"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+
+TextureSource TextureSource::File(const std::string &strPath)
+{
+    TextureSource source;
+    source.strPath = strPath;
+    return source;
+}
+
+TextureSource TextureSource::Memory(const void *pData, size_t nSize)
+{
+    TextureSource source;
+    source.pData = (const unsigned char *)pData;
+    source.nSize = nSize;
+    return source;
+}
+
+bool InspectPNG(const TextureSource &source, unsigned *pWidth, unsigned *pHeight)
+{
+    unsigned char header[33]; // signature and IHDR chunk
+    const unsigned char *pHeader = source.pData;
+    size_t nHeaderSize = source.nSize;
+    if (!source.pData)
+    {
+        std::ifstream file(source.strPath, std::ios::binary);
+        if (!file.read((char *)header, sizeof(header)))
+            return false;
+        pHeader = header;
+        nHeaderSize = sizeof(header);
+    }
+    lodepng::State state;
+    return lodepng_inspect(pWidth, pHeight, &state, pHeader, nHeaderSize) == 0;
+}
+
+struct DecodeRowContext
+{
+    MipChainBuilder *pBuilder;
+    const CancellationToken *pCancel;
+    const CancellationToken *pShutdown; // the loader's, on top of the batch's
+};
+
+static bool IsCancelled(const CancellationToken *pCancel, const CancellationToken *pShutdown)
+{
+    return (pCancel && pCancel->IsCancelled()) || (pShutdown && pShutdown->IsCancelled());
+}
+
+static unsigned AddDecodedRow(void *pUser, const unsigned char *pRow, unsigned, unsigned, unsigned)
+{
+    DecodeRowContext &context = *(DecodeRowContext *)pUser;
+    if (IsCancelled(context.pCancel, context.pShutdown))
+        return 1;
+    context.pBuilder->AddRow(pRow);
+    return 0;
+}
+
+static bool DecodeIntoMipChain(const TextureSource &source, unsigned char *pArena, const std::vector<MipLevelLayout> &mipLevels,
+                               const MipFilterOptions &options, WorkerPool *pWorkers, const CancellationToken *pCancel,
+                               const CancellationToken *pShutdown)
+{
+    MipChainBuilder builder(pArena, &mipLevels[0], (int)mipLevels.size(), options);
+    DecodeRowContext context = {&builder, pCancel, pShutdown};
+
+    // Files go in 64 KB at a time, blobs in one piece
+    lodepng::State state;
+    LodePNGStreamDecoder *pDecoder = lodepng_stream_decoder_new(&state, AddDecodedRow, &context);
+    unsigned nError = pDecoder ? 0 : 83;
+    if (nError == 0 && source.pData)
+    {
+        nError = lodepng_stream_decoder_push(pDecoder, source.pData, source.nSize);
+    }
+    else if (nError == 0)
+    {
+        std::ifstream file(source.strPath, std::ios::binary);
+        std::vector<char> piece(64 * 1024);
+        while (nError == 0 && file)
+        {
+            file.read(&piece[0], piece.size());
+            nError = lodepng_stream_decoder_push(pDecoder, (const unsigned char *)&piece[0], (size_t)file.gcount());
+        }
+    }
+    if (nError == 0)
+    {
+        nError = lodepng_stream_decoder_finish(pDecoder);
+    }
+    lodepng_stream_decoder_delete(pDecoder);
+
+    if (nError == 94)
+    {
+        // Adam7 completes its rows only in the last pass
+        std::vector<unsigned char> imageRGBA;
+        unsigned nWidth, nHeight;
+        nError = source.pData ? lodepng::decode(imageRGBA, nWidth, nHeight, source.pData, source.nSize)
+                              : lodepng::decode(imageRGBA, nWidth, nHeight, source.strPath);
+        if (nError != 0 || (int)nWidth != mipLevels[0].nWidth || (int)nHeight != mipLevels[0].nHeight ||
+            IsCancelled(pCancel, pShutdown))
+            return false;
+        GenerateMipChainRGBA(&imageRGBA[0], nWidth * 4, pArena, &mipLevels[0], (int)mipLevels.size(), options, pWorkers);
+        return true;
+    }
+    if (nError != 0 || builder.RowsAdded() != mipLevels[0].nHeight)
+        return false;
+    builder.Finish(pWorkers);
+    return true;
+}
+
+bool DecodePNGIntoMipChain(const TextureSource &source, unsigned char *pArena, const std::vector<MipLevelLayout> &mipLevels,
+                           const MipFilterOptions &options, WorkerPool *pWorkers, const CancellationToken *pCancel)
+{
+    return DecodeIntoMipChain(source, pArena, mipLevels, options, pWorkers, pCancel, nullptr);
+}
+
+struct TextureBatchLoader::Shared
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<LoadedTexture> finished;
+    int nOutstanding = 0; // submitted, not handed back
+    int nRunning = 0;     // tasks still queued or running on the pool
+    CancellationToken shutdown; // the loader is going away
+};
+
+// One texture of a batch, on a worker
+static void LoadTexture(const TextureSource &source, const MipFilterOptions &options, const CancellationToken &cancel,
+                        const CancellationToken &shutdown, LoadedTexture &texture)
+{
+    unsigned nWidth, nHeight;
+    if (!InspectPNG(source, &nWidth, &nHeight))
+    {
+        texture.bFailed = true;
+        return;
+    }
+    texture.nWidth = (int)nWidth;
+    texture.nHeight = (int)nHeight;
+    texture.mipLevels.resize(GetMipChainLevelCount(texture.nWidth, texture.nHeight));
+    texture.mipChain.resize(ComputeMipChainLayoutRGBA(texture.nWidth, texture.nHeight, &texture.mipLevels[0]));
+
+    // the texture is one task already, its chain is not split further
+    if (!DecodeIntoMipChain(source, &texture.mipChain[0], texture.mipLevels, options, nullptr, &cancel, &shutdown))
+    {
+        texture.bCancelled = IsCancelled(&cancel, &shutdown);
+        texture.bFailed = !texture.bCancelled;
+        texture.mipChain = std::vector<unsigned char>();
+    }
+}
+
+TextureBatchLoader::TextureBatchLoader(WorkerPool *pWorkers, const MipFilterOptions &options)
+    : m_pWorkers(pWorkers), m_options(options), m_pShared(std::make_shared<Shared>())
+{
+}
+
+TextureBatchLoader::~TextureBatchLoader()
+{
+    // queued tasks find the flag and return at once, running ones stop at their next row
+    m_pShared->shutdown.Cancel();
+    std::unique_lock<std::mutex> lock(m_pShared->mutex);
+    m_pShared->cv.wait(lock, [this]() { return m_pShared->nRunning == 0; });
+}
+
+int TextureBatchLoader::Submit(const std::vector<TextureSource> &sources, const CancellationToken &cancel)
+{
+    const int nBatch = m_nBatches++;
+    {
+        std::lock_guard<std::mutex> lock(m_pShared->mutex);
+        m_pShared->nOutstanding += (int)sources.size();
+        m_pShared->nRunning += (int)sources.size();
+    }
+
+    // tasks hold the shared state, not the loader
+    std::shared_ptr<Shared> pShared = m_pShared;
+    MipFilterOptions options = m_options;
+    for (int i = 0; i < (int)sources.size(); i++)
+    {
+        m_pWorkers->Submit([pShared, source = sources[i], cancel, options, nBatch, i]() {
+            LoadedTexture texture = {nBatch, i, false, false, 0, 0, {}, {}};
+            if (IsCancelled(&cancel, &pShared->shutdown))
+            {
+                texture.bCancelled = true;
+            }
+            else
+            {
+                LoadTexture(source, options, cancel, pShared->shutdown, texture);
+            }
+
+            std::lock_guard<std::mutex> lock(pShared->mutex);
+            pShared->finished.push_back(std::move(texture));
+            pShared->nRunning--;
+            pShared->cv.notify_all();
+        });
+    }
+    return nBatch;
+}
+
+bool TextureBatchLoader::WaitNext(LoadedTexture &texture)
+{
+    std::unique_lock<std::mutex> lock(m_pShared->mutex);
+    m_pShared->cv.wait(lock, [this]() { return !m_pShared->finished.empty() || m_pShared->nOutstanding == 0; });
+    if (m_pShared->finished.empty())
+        return false;
+    texture = std::move(m_pShared->finished.front());
+    m_pShared->finished.pop_front();
+    m_pShared->nOutstanding--;
+    return true;
+}
+
+bool TextureBatchLoader::TryNext(LoadedTexture &texture)
+{
+    std::lock_guard<std::mutex> lock(m_pShared->mutex);
+    if (m_pShared->finished.empty())
+        return false;
+    texture = std::move(m_pShared->finished.front());
+    m_pShared->finished.pop_front();
+    m_pShared->nOutstanding--;
+    return true;
+}
+
+int TextureBatchLoader::Pending() const
+{
+    std::lock_guard<std::mutex> lock(m_pShared->mutex);
+    return m_pShared->nOutstanding;
+}
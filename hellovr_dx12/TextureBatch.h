@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "GenMipMapRGBA.h"
+
+///
+/// Shared cancel flag: copies see the same flag, so the caller keeps one and
+/// hands the others to the loads it may want to stop
+///
+class CancellationToken
+{
+    std::shared_ptr<std::atomic<bool>> m_pCancelled = std::make_shared<std::atomic<bool>>(false);
+
+public:
+    void Cancel() { m_pCancelled->store(true, std::memory_order_relaxed); }
+    bool IsCancelled() const { return m_pCancelled->load(std::memory_order_relaxed); }
+};
+
+// A PNG to load: a file, or a blob the caller keeps alive until its texture comes back
+struct TextureSource
+{
+    std::string strPath;
+    const unsigned char *pData = nullptr;
+    size_t nSize = 0;
+
+    static TextureSource File(const std::string &strPath);
+    static TextureSource Memory(const void *pData, size_t nSize);
+};
+
+// Size of the image from the PNG header alone
+bool InspectPNG(const TextureSource &source, unsigned *pWidth, unsigned *pHeight);
+
+//-----------------------------------------------------------------------------
+// Purpose: Decode the PNG a row at a time straight down the mip chain in
+//          pArena, laid out as mipLevels, so neither the image nor a file
+//          source is ever held whole. Interlaced files fall back to a whole
+//          image decode. A cancelled pCancel stops the decode at the next row
+//          and fails it.
+//-----------------------------------------------------------------------------
+bool DecodePNGIntoMipChain(const TextureSource &source, unsigned char *pArena, const std::vector<MipLevelLayout> &mipLevels,
+                           const MipFilterOptions &options, class WorkerPool *pWorkers = nullptr,
+                           const CancellationToken *pCancel = nullptr);
+
+// A texture of a batch, decoded with its full RGBA8 mip chain
+struct LoadedTexture
+{
+    int nBatch;
+    int nIndex; // into the sources of the batch
+    bool bFailed;
+    bool bCancelled; // never started or stopped part way, nothing else is valid
+    int nWidth;
+    int nHeight;
+    std::vector<MipLevelLayout> mipLevels;
+    std::vector<unsigned char> mipChain; // the arena mipLevels describe, D3D12 row pitch
+};
+
+///
+/// Decodes batches of PNGs on a worker pool, one texture per task with its
+/// mip chain generated as the rows stream in, and hands them back in the
+/// order they finish. Each batch takes a CancellationToken; cancelling it
+/// drops the textures that have not started and stops those that have at
+/// their next row. Every texture submitted comes back exactly once.
+///
+class TextureBatchLoader
+{
+    struct Shared;
+    class WorkerPool *m_pWorkers;
+    MipFilterOptions m_options;
+    std::shared_ptr<Shared> m_pShared;
+    int m_nBatches = 0;
+
+public:
+    TextureBatchLoader(class WorkerPool *pWorkers, const MipFilterOptions &options = MipFilterOptions());
+    // Cancels everything in flight: queued textures are dropped and running ones
+    // stop at their next row. Then waits for the workers to let go of it.
+    ~TextureBatchLoader();
+    TextureBatchLoader(const TextureBatchLoader &) = delete;
+    TextureBatchLoader &operator=(const TextureBatchLoader &) = delete;
+
+    // Queue the sources, returns the batch number the textures come back with
+    int Submit(const std::vector<TextureSource> &sources, const CancellationToken &cancel = CancellationToken());
+
+    //-----------------------------------------------------------------------------
+    // Purpose: The next texture to finish. WaitNext blocks until one does and
+    //          must not be called from a task on the loader's pool; both return
+    //          false once everything submitted has been handed back.
+    //-----------------------------------------------------------------------------
+    bool WaitNext(LoadedTexture &texture);
+    bool TryNext(LoadedTexture &texture);
+
+    // Submitted and not handed back yet
+    int Pending() const;
+};
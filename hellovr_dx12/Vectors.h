@@ -108,9 +108,9 @@ struct Vector3
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// 4D vector
+// 4D vector, aligned so Matrix4 can load it into one SSE register
 ///////////////////////////////////////////////////////////////////////////////
-struct Vector4
+struct alignas(16) Vector4
 {
     float x;
     float y;
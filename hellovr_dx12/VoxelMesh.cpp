@@ -0,0 +1,341 @@
+#include "VoxelMesh.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <bit>
+#include <math.h>
+#include <string.h>
+
+static const int N = VoxelVolume::k_nChunkSize;
+
+// In plane axes a then b of each face, a x b pointing out of it, so a quad's
+// corners go anticlockwise seen from outside like the baked cube's
+static const int s_faceAxes[6][2] = {
+    {2, 1}, {1, 2}, // -x, +x
+    {0, 2}, {2, 0}, // -y, +y
+    {1, 0}, {0, 1}, // -z, +z
+};
+
+VoxelVolume::VoxelVolume(int nWidth, int nHeight, int nDepth, const Vector3 &origin, float fVoxelSize)
+    : m_nWidth(nWidth), m_nHeight(nHeight), m_nDepth(nDepth),
+      m_nChunksX((nWidth + N - 1) / N), m_nChunksY((nHeight + N - 1) / N), m_nChunksZ((nDepth + N - 1) / N),
+      m_origin(origin), m_fVoxelSize(fVoxelSize)
+{
+    if (nWidth <= 0 || nHeight <= 0 || nDepth <= 0)
+    {
+        m_nChunksX = m_nChunksY = m_nChunksZ = 0;
+    }
+    m_chunks.resize(ChunkCount());
+    memset(m_chunks.data(), 0, m_chunks.size() * sizeof(Chunk));
+    m_empty.assign(ChunkCount(), true);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: a voxel per cube at every nPitch voxels, written a row of 32 at a
+//          time. A spacing of 1 makes the volume solid.
+//-----------------------------------------------------------------------------
+VoxelVolume VoxelVolume::FromCubes(const CubeVolume &volume)
+{
+    const int nPitch = std::max(1, (int)lroundf(volume.Spacing()));
+    auto extent = [nPitch](int nCubes) { return nCubes > 0 ? (nCubes - 1) * nPitch + 1 : 0; };
+    VoxelVolume voxels(extent(volume.Width()), extent(volume.Height()), extent(volume.Depth()), volume.CubeCorner(0, 0, 0), volume.Scale());
+
+    // the bits of a row each chunk column sets, the same for every row with a cube on it
+    std::vector<uint32_t> columnRows(voxels.m_nChunksX, 0);
+    for (int x = 0; x < voxels.m_nWidth; x += nPitch)
+    {
+        columnRows[x / N] |= 1u << (x % N);
+    }
+
+    for (int cz = 0; cz < voxels.m_nChunksZ; cz++)
+    {
+        for (int cy = 0; cy < voxels.m_nChunksY; cy++)
+        {
+            for (int cx = 0; cx < voxels.m_nChunksX; cx++)
+            {
+                int nChunk = (cz * voxels.m_nChunksY + cy) * voxels.m_nChunksX + cx;
+                Chunk &chunk = voxels.m_chunks[nChunk];
+                bool bEmpty = true;
+                for (int z = 0; z < N; z++)
+                {
+                    int gz = cz * N + z;
+                    if (gz >= voxels.m_nDepth || gz % nPitch)
+                        continue;
+                    for (int y = 0; y < N; y++)
+                    {
+                        int gy = cy * N + y;
+                        if (gy >= voxels.m_nHeight || gy % nPitch)
+                            continue;
+                        chunk.rows[z * N + y] = columnRows[cx];
+                        bEmpty = bEmpty && columnRows[cx] == 0;
+                    }
+                }
+                voxels.m_empty[nChunk] = bEmpty;
+            }
+        }
+    }
+    return voxels;
+}
+
+VoxelVolume::ChunkPlacement VoxelVolume::Placement(int nChunk) const
+{
+    int cx = nChunk % m_nChunksX;
+    int cy = nChunk / m_nChunksX % m_nChunksY;
+    int cz = nChunk / (m_nChunksX * m_nChunksY);
+    float fChunkSize = m_fVoxelSize * N;
+    return {m_origin.x + cx * fChunkSize, m_origin.y + cy * fChunkSize, m_origin.z + cz * fChunkSize, m_fVoxelSize};
+}
+
+bool VoxelVolume::Get(int x, int y, int z) const
+{
+    if (x < 0 || y < 0 || z < 0 || x >= m_nWidth || y >= m_nHeight || z >= m_nDepth)
+        return false;
+    const Chunk &chunk = m_chunks[(z / N * m_nChunksY + y / N) * m_nChunksX + x / N];
+    return (chunk.rows[z % N * N + y % N] >> (x % N)) & 1;
+}
+
+void VoxelVolume::Set(int x, int y, int z, bool bSolid)
+{
+    if (x < 0 || y < 0 || z < 0 || x >= m_nWidth || y >= m_nHeight || z >= m_nDepth)
+        return;
+    int nChunk = (z / N * m_nChunksY + y / N) * m_nChunksX + x / N;
+    uint32_t &row = m_chunks[nChunk].rows[z % N * N + y % N];
+    if (bSolid)
+    {
+        row |= 1u << (x % N);
+        m_empty[nChunk] = false;
+    }
+    else
+    {
+        row &= ~(1u << (x % N));
+    }
+}
+
+const VoxelVolume::Chunk *VoxelVolume::ChunkAt(int cx, int cy, int cz) const
+{
+    if (cx < 0 || cy < 0 || cz < 0 || cx >= m_nChunksX || cy >= m_nChunksY || cz >= m_nChunksZ)
+        return nullptr;
+    int nChunk = (cz * m_nChunksY + cy) * m_nChunksX + cx;
+    return m_empty[nChunk] ? nullptr : &m_chunks[nChunk];
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: swap bit i of row j with bit j of row i, in five passes of
+//          exchanging ever smaller blocks
+//-----------------------------------------------------------------------------
+static void Transpose32(uint32_t rows[32])
+{
+    uint32_t nMask = 0x0000FFFF;
+    for (int j = 16; j != 0; j >>= 1, nMask ^= nMask << j)
+    {
+        for (int k = 0; k < 32; k = ((k | j) + 1) & ~j)
+        {
+            uint32_t t = ((rows[k] >> j) ^ rows[k | j]) & nMask;
+            rows[k] ^= t << j;
+            rows[k | j] ^= t;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: cover the set bits of a slice with rectangles: the first run of a
+//          row as wide as it goes, then down the rows for as long as every one
+//          has the whole run. Covered bits are cleared as they go.
+//-----------------------------------------------------------------------------
+template <class EmitQuad>
+static void GreedyMerge(uint32_t slice[32], EmitQuad &&emitQuad)
+{
+    for (int nRow = 0; nRow < N; nRow++)
+    {
+        while (slice[nRow])
+        {
+            int nBit = std::countr_zero(slice[nRow]);
+            int nBits = std::countr_one(slice[nRow] >> nBit);
+            uint32_t nRun = (nBits == 32 ? ~0u : (1u << nBits) - 1) << nBit;
+            slice[nRow] &= ~nRun;
+            int nRows = 1;
+            while (nRow + nRows < N && (slice[nRow + nRows] & nRun) == nRun)
+            {
+                slice[nRow + nRows] &= ~nRun;
+                nRows++;
+            }
+            emitQuad(nBit, nRow, nBits, nRows);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: two triangles for a quad of face nFace whose near corner is
+//          corner, nA voxels along its first in plane axis and nB along its
+//          second. The coordinates are 6 bit fields that never carry, so the
+//          other corners are the packed near corner plus the extents.
+//-----------------------------------------------------------------------------
+static void EmitQuad(std::vector<uint32_t> &vertices, int nFace, const int corner[3], int nA, int nB)
+{
+    const uint32_t v0 = VoxelVolume::PackVertex(corner[0], corner[1], corner[2], nFace);
+    const uint32_t nAlongA = (uint32_t)nA << (6 * s_faceAxes[nFace][0]);
+    const uint32_t nAlongB = (uint32_t)nB << (6 * s_faceAxes[nFace][1]);
+    const size_t nFirst = vertices.size();
+    vertices.resize(nFirst + VoxelVolume::k_nVerticesPerQuad);
+    uint32_t *pOut = &vertices[nFirst];
+    pOut[0] = v0;
+    pOut[1] = v0 + nAlongA;
+    pOut[2] = v0 + nAlongA + nAlongB;
+    pOut[3] = v0 + nAlongA + nAlongB;
+    pOut[4] = v0 + nAlongB;
+    pOut[5] = v0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: merge the visible faces of one direction, faces[s] being slice s
+//          across nFace's axis as rows along nRowAxis of bits along nBitAxis.
+//          The faces are cleared as they are merged.
+//-----------------------------------------------------------------------------
+static void MeshFaces(uint32_t faces[N][N], int nFace, int nBitAxis, int nRowAxis, std::vector<uint32_t> &vertices)
+{
+    const int nAxis = nFace / 2;
+    for (int s = 0; s < N; s++)
+    {
+        uint32_t nAny = 0;
+        for (int nRow = 0; nRow < N; nRow++)
+        {
+            nAny |= faces[s][nRow];
+        }
+        if (!nAny)
+            continue;
+        GreedyMerge(faces[s], [&](int nBit, int nRow, int nBits, int nRows) {
+            int corner[3], extent[3];
+            corner[nAxis] = s + (nFace & 1);
+            corner[nBitAxis] = nBit;
+            corner[nRowAxis] = nRow;
+            extent[nAxis] = 0;
+            extent[nBitAxis] = nBits;
+            extent[nRowAxis] = nRows;
+            EmitQuad(vertices, nFace, corner, extent[s_faceAxes[nFace][0]], extent[s_faceAxes[nFace][1]]);
+        });
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: a face shows where the voxel in front of it is empty, found a
+//          whole row at a time. Rows run along x, so faces across z and y
+//          compare with the rows a slice away and faces across x with the row
+//          shifted a bit, transposed to run along y only where a slice of z
+//          has any. A neighbour past the chunk is read from the next chunk and
+//          counts as empty outside the volume.
+//-----------------------------------------------------------------------------
+void VoxelVolume::MeshChunk(int nChunk, std::vector<uint32_t> &vertices) const
+{
+    vertices.clear();
+    if (m_empty[nChunk])
+        return;
+
+    const int cx = nChunk % m_nChunksX;
+    const int cy = nChunk / m_nChunksX % m_nChunksY;
+    const int cz = nChunk / (m_nChunksX * m_nChunksY);
+    const uint32_t *rows = m_chunks[nChunk].rows;
+    static const uint32_t s_emptyRows[N * N] = {};
+    const Chunk *pNeighbour;
+    pNeighbour = ChunkAt(cx - 1, cy, cz);
+    const uint32_t *pNegX = pNeighbour ? pNeighbour->rows : s_emptyRows;
+    pNeighbour = ChunkAt(cx + 1, cy, cz);
+    const uint32_t *pPosX = pNeighbour ? pNeighbour->rows : s_emptyRows;
+    pNeighbour = ChunkAt(cx, cy - 1, cz);
+    const uint32_t *pNegY = pNeighbour ? pNeighbour->rows : s_emptyRows;
+    pNeighbour = ChunkAt(cx, cy + 1, cz);
+    const uint32_t *pPosY = pNeighbour ? pNeighbour->rows : s_emptyRows;
+    pNeighbour = ChunkAt(cx, cy, cz - 1);
+    const uint32_t *pNegZ = pNeighbour ? pNeighbour->rows : s_emptyRows;
+    pNeighbour = ChunkAt(cx, cy, cz + 1);
+    const uint32_t *pPosZ = pNeighbour ? pNeighbour->rows : s_emptyRows;
+
+    uint32_t faces[N][N];
+
+    // across z: slices of z, rows of y, bits of x
+    for (int z = 0; z < N; z++)
+    {
+        const uint32_t *pFront = z > 0 ? rows + (z - 1) * N : pNegZ + (N - 1) * N;
+        for (int y = 0; y < N; y++)
+        {
+            faces[z][y] = rows[z * N + y] & ~pFront[y];
+        }
+    }
+    MeshFaces(faces, 4, 0, 1, vertices);
+    for (int z = 0; z < N; z++)
+    {
+        const uint32_t *pFront = z + 1 < N ? rows + (z + 1) * N : pPosZ;
+        for (int y = 0; y < N; y++)
+        {
+            faces[z][y] = rows[z * N + y] & ~pFront[y];
+        }
+    }
+    MeshFaces(faces, 5, 0, 1, vertices);
+
+    // across y: slices of y, rows of z, bits of x
+    for (int z = 0; z < N; z++)
+    {
+        const uint32_t *pRows = rows + z * N;
+        faces[0][z] = pRows[0] & ~pNegY[z * N + N - 1];
+        for (int y = 1; y < N; y++)
+        {
+            faces[y][z] = pRows[y] & ~pRows[y - 1];
+        }
+    }
+    MeshFaces(faces, 2, 0, 2, vertices);
+    for (int z = 0; z < N; z++)
+    {
+        const uint32_t *pRows = rows + z * N;
+        for (int y = 0; y + 1 < N; y++)
+        {
+            faces[y][z] = pRows[y] & ~pRows[y + 1];
+        }
+        faces[N - 1][z] = pRows[N - 1] & ~pPosY[z * N];
+    }
+    MeshFaces(faces, 3, 0, 2, vertices);
+
+    // across x: slices of x, rows of z, bits of y
+    uint32_t slice[N];
+    for (int nFace = 0; nFace < 2; nFace++)
+    {
+        const uint32_t *pNext = nFace == 1 ? pPosX : pNegX;
+        for (int z = 0; z < N; z++)
+        {
+            uint32_t nAny = 0;
+            for (int y = 0; y < N; y++)
+            {
+                uint32_t nRow = rows[z * N + y];
+                uint32_t nFront;
+                if (nFace == 1)
+                    nFront = nRow >> 1 | pNext[z * N + y] << (N - 1);
+                else
+                    nFront = nRow << 1 | pNext[z * N + y] >> (N - 1);
+                slice[y] = nRow & ~nFront;
+                nAny |= slice[y];
+            }
+            if (nAny)
+            {
+                Transpose32(slice);
+            }
+            for (int x = 0; x < N; x++)
+            {
+                faces[x][z] = slice[x] & (0u - (nAny != 0));
+            }
+        }
+        MeshFaces(faces, nFace, 1, 2, vertices);
+    }
+}
+
+void VoxelVolume::MeshChunks(std::vector<std::vector<uint32_t>> &chunkVertices, WorkerPool *pWorkers) const
+{
+    chunkVertices.resize(ChunkCount());
+    if (pWorkers)
+    {
+        pWorkers->ParallelFor(ChunkCount(), [&](int nChunk) { MeshChunk(nChunk, chunkVertices[nChunk]); });
+    }
+    else
+    {
+        for (int nChunk = 0; nChunk < ChunkCount(); nChunk++)
+        {
+            MeshChunk(nChunk, chunkVertices[nChunk]);
+        }
+    }
+}
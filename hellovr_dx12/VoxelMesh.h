@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "CubeVolume.h"
+
+///
+/// Solid voxels in chunks of 32^3, one bit each: chunk row y + 32 z holds x
+/// as bits 0..31. Meshing a chunk keeps only faces with an empty voxel in
+/// front of them and merges them greedily into as few quads as it can, each
+/// two triangles of packed vertices placed relative to the chunk.
+///
+class VoxelVolume
+{
+public:
+    static const int k_nChunkSize = 32;
+
+    // A corner in voxels from the chunk's origin, 0..32 each, and the face
+    // it belongs to: -x, +x, -y, +y, -z, +z
+    static uint32_t PackVertex(int x, int y, int z, int nFace) { return (uint32_t)x | (uint32_t)y << 6 | (uint32_t)z << 12 | (uint32_t)nFace << 18; }
+    static int VertexX(uint32_t nVertex) { return nVertex & 63; }
+    static int VertexY(uint32_t nVertex) { return (nVertex >> 6) & 63; }
+    static int VertexZ(uint32_t nVertex) { return (nVertex >> 12) & 63; }
+    static int VertexFace(uint32_t nVertex) { return (nVertex >> 18) & 7; }
+    static const int k_nVerticesPerQuad = 6;
+
+    // Per chunk draw data, where its voxels start and how big they are
+    struct ChunkPlacement
+    {
+        float x, y, z;
+        float fVoxelSize;
+    };
+
+    // Empty, voxel (0, 0, 0) with its near corner at origin
+    VoxelVolume(int nWidth, int nHeight, int nDepth, const Vector3 &origin, float fVoxelSize);
+    // The cubes as voxels the size of a cube, spacing rounded to a whole number of them
+    static VoxelVolume FromCubes(const CubeVolume &volume);
+
+    int Width() const { return m_nWidth; }
+    int Height() const { return m_nHeight; }
+    int Depth() const { return m_nDepth; }
+    int ChunksX() const { return m_nChunksX; }
+    int ChunksY() const { return m_nChunksY; }
+    int ChunksZ() const { return m_nChunksZ; }
+    int ChunkCount() const { return m_nChunksX * m_nChunksY * m_nChunksZ; }
+    ChunkPlacement Placement(int nChunk) const;
+    // No voxel set, MeshChunk returns at once
+    bool ChunkEmpty(int nChunk) const { return m_empty[nChunk]; }
+
+    bool Get(int x, int y, int z) const;
+    void Set(int x, int y, int z, bool bSolid);
+
+    // Replaces vertices with the chunk's visible faces, merged, as triangles
+    void MeshChunk(int nChunk, std::vector<uint32_t> &vertices) const;
+    // Every chunk, on pWorkers when given
+    void MeshChunks(std::vector<std::vector<uint32_t>> &chunkVertices, class WorkerPool *pWorkers = nullptr) const;
+
+private:
+    struct Chunk
+    {
+        uint32_t rows[k_nChunkSize * k_nChunkSize];
+    };
+    const Chunk *ChunkAt(int cx, int cy, int cz) const;
+
+    int m_nWidth;
+    int m_nHeight;
+    int m_nDepth;
+    int m_nChunksX;
+    int m_nChunksY;
+    int m_nChunksZ;
+    Vector3 m_origin;
+    float m_fVoxelSize;
+    std::vector<Chunk> m_chunks;
+    // no voxel set, skipped when meshing and as a neighbour
+    std::vector<bool> m_empty;
+};
@@ -0,0 +1,99 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+WorkerPool::WorkerPool(int nThreads)
+{
+    if (nThreads <= 0)
+    {
+        nThreads = (int)std::thread::hardware_concurrency();
+        if (nThreads <= 0)
+        {
+            nThreads = 1;
+        }
+    }
+    for (int i = 0; i < nThreads; i++)
+    {
+        m_threads.emplace_back(&WorkerPool::WorkerMain, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bQuit = true;
+    }
+    m_cv.notify_all();
+    for (auto &t : m_threads)
+    {
+        t.join();
+    }
+}
+
+void WorkerPool::Submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_cv.notify_one();
+}
+
+void WorkerPool::WorkerMain()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]() { return m_bQuit || !m_tasks.empty(); });
+            if (m_tasks.empty())
+                return; // quit once the queue is drained
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void WorkerPool::ParallelFor(int nCount, const std::function<void(int)> &fn)
+{
+    if (nCount <= 0)
+        return;
+
+    struct Shared
+    {
+        std::atomic<int> nNext{0};
+        std::atomic<int> nDone{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+    // helpers may start after the caller returned, they keep the state alive
+    auto shared = std::make_shared<Shared>();
+    int nCountCopy = nCount;
+    auto run = [shared, nCountCopy, &fn]() {
+        int i;
+        while ((i = shared->nNext.fetch_add(1)) < nCountCopy)
+        {
+            fn(i);
+            if (shared->nDone.fetch_add(1) + 1 == nCountCopy)
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->cv.notify_all();
+            }
+        }
+    };
+
+    int nHelpers = std::min(nCount, ThreadCount() + 1) - 1;
+    for (int i = 0; i < nHelpers; i++)
+    {
+        Submit(run);
+    }
+    run();
+
+    // only wait for indices other threads already claimed
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->cv.wait(lock, [&]() { return shared->nDone.load() == nCount; });
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///
+/// Fixed set of worker threads for CPU side loading work (mip generation, decoding)
+///
+class WorkerPool
+{
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_bQuit = false;
+
+public:
+    // nThreads <= 0: one thread per hardware thread
+    explicit WorkerPool(int nThreads = 0);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int ThreadCount() const { return (int)m_threads.size(); }
+
+    // Queue a task, runs on some worker
+    void Submit(std::function<void()> task);
+
+    //-----------------------------------------------------------------------------
+    // Purpose: Call fn(i) for every i in [0, nCount) and return once all are done.
+    //          The calling thread takes part, so nesting inside a task is safe.
+    //-----------------------------------------------------------------------------
+    void ParallelFor(int nCount, const std::function<void(int)> &fn);
+
+private:
+    void WorkerMain();
+};
@@ -0,0 +1,204 @@
+#include "BlockCompress.h"
+#include "WorkerPool.h"
+#include "lodepng.h"
+#include "bench.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+typedef unsigned char UINT8;
+
+struct TestImage
+{
+    std::string name;
+    int nWidth;
+    int nHeight;
+    std::vector<UINT8> rgba;
+    // round trip floor in dB for BC1/BC3 and BC7, 0 for photographic content
+    double floor;
+    double floorBC7;
+};
+
+// gradients, a hard edged checker and some noise; alpha ramps when bAlpha
+static TestImage MakeImage(const char *pchName, int nWidth, int nHeight, bool bAlpha)
+{
+    bench::Random random;
+    TestImage image = {pchName, nWidth, nHeight, std::vector<UINT8>((size_t)nWidth * nHeight * 4), 32.0, 38.0};
+    for (int y = 0; y < nHeight; y++)
+    {
+        for (int x = 0; x < nWidth; x++)
+        {
+            UINT8 *p = &image.rgba[((size_t)y * nWidth + x) * 4];
+            UINT8 noise = (UINT8)(random.Next() & 3);
+            p[0] = (UINT8)(x * 255 / nWidth + noise);
+            p[1] = (UINT8)(y * 255 / nHeight + noise);
+            p[2] = (UINT8)(((x / 32) ^ (y / 32)) & 1 ? 220 : 30);
+            p[3] = bAlpha ? (UINT8)((x + y) * 255 / (nWidth + nHeight)) : 255;
+        }
+    }
+    return image;
+}
+
+// over channels [nFirst, nFirst + nChannels)
+static double PSNR(const TestImage &image, const std::vector<UINT8> &decoded, int nFirst, int nChannels)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < image.rgba.size(); i += 4)
+    {
+        for (int c = nFirst; c < nFirst + nChannels; c++)
+        {
+            double d = (double)image.rgba[i + c] - decoded[i + c];
+            sum += d * d;
+        }
+    }
+    double mse = sum / ((double)image.nWidth * image.nHeight * nChannels);
+    return mse == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+static size_t EncodedSize(const TestImage &image, BCFormat format, size_t *pPitch)
+{
+    *pPitch = (size_t)((image.nWidth + 3) / 4) * GetBCBlockBytes(format);
+    return *pPitch * ((image.nHeight + 3) / 4);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: round trip quality floors, presets ordered, BC7 above BC1 on opaque
+//          images, threaded output identical
+//-----------------------------------------------------------------------------
+static bool Verify(const std::vector<TestImage> &images)
+{
+    WorkerPool workers(4);
+    const BCFormat formats[] = {BCFormat::BC1, BCFormat::BC3, BCFormat::BC7};
+    for (auto &image : images)
+    {
+        // BC1 turns texels below alpha 128 transparent black, no color floor there
+        bool bTranslucent = false;
+        for (size_t i = 3; i < image.rgba.size(); i += 4)
+        {
+            bTranslucent |= image.rgba[i] != 255;
+        }
+        double bc1Quality = 0.0;
+        for (auto format : formats)
+        {
+            double psnr[2];
+            for (int q = 0; q < 2; q++)
+            {
+                BCQuality quality = (BCQuality)q;
+                size_t nPitch;
+                std::vector<UINT8> encoded(EncodedSize(image, format, &nPitch)), threaded(encoded.size());
+                EncodeImageBC(image.rgba.data(), image.nWidth, image.nHeight, image.nWidth * 4, encoded.data(), nPitch, format, quality);
+                EncodeImageBC(image.rgba.data(), image.nWidth, image.nHeight, image.nWidth * 4, threaded.data(), nPitch, format, quality, &workers);
+                if (encoded != threaded)
+                {
+                    printf("FAIL: %s %s threaded output differs\n", GetBCFormatName(format), GetBCQualityName(quality));
+                    return false;
+                }
+                std::vector<UINT8> decoded(image.rgba.size());
+                DecodeImageBC(encoded.data(), image.nWidth, image.nHeight, nPitch, format, decoded.data(), image.nWidth * 4);
+                // BC1 alpha is a single bit, score its color only
+                psnr[q] = PSNR(image, decoded, 0, format == BCFormat::BC1 ? 3 : 4);
+            }
+            const double floor = format == BCFormat::BC1 && bTranslucent ? 0.0 : format == BCFormat::BC7 ? image.floorBC7 : image.floor;
+            if (psnr[0] < floor || psnr[1] < floor || psnr[1] + 0.05 < psnr[0] ||
+                (format == BCFormat::BC7 && !bTranslucent && psnr[1] < bc1Quality))
+            {
+                printf("FAIL: %s %s psnr fast %.2f quality %.2f\n", image.name.c_str(), GetBCFormatName(format), psnr[0], psnr[1]);
+                return false;
+            }
+            if (format == BCFormat::BC1)
+                bc1Quality = psnr[1];
+        }
+    }
+
+    // BC1 punch through alpha: transparent texels must stay transparent
+    UINT8 texels[64], block[8], decoded[64];
+    for (int i = 0; i < 16; i++)
+    {
+        texels[i * 4 + 0] = (UINT8)(i * 16);
+        texels[i * 4 + 1] = 128;
+        texels[i * 4 + 2] = 64;
+        texels[i * 4 + 3] = (i & 1) ? 255 : 0;
+    }
+    EncodeBlockBC(texels, BCFormat::BC1, BCQuality::Quality, block);
+    DecodeBlockBC(block, BCFormat::BC1, decoded);
+    for (int i = 0; i < 16; i++)
+    {
+        if (decoded[i * 4 + 3] != texels[i * 4 + 3])
+        {
+            printf("FAIL: bc1 alpha texel %d\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int nSize = argc > 1 ? atoi(argv[1]) : 1024;
+
+    std::vector<TestImage> images;
+    images.push_back(MakeImage("synthetic", nSize, nSize, false));
+    images.push_back(MakeImage("synthetic-alpha", nSize, nSize, true));
+#ifdef HELLOVR_TEXTURE_PATH
+    TestImage cube = {"cube_texture", 0, 0, {}, 0.0, 0.0};
+    unsigned nWidth, nHeight;
+    if (lodepng::decode(cube.rgba, nWidth, nHeight, HELLOVR_TEXTURE_PATH) == 0)
+    {
+        cube.nWidth = (int)nWidth;
+        cube.nHeight = (int)nHeight;
+        images.push_back(cube);
+    }
+#endif
+
+    if (!Verify(images))
+        return 1;
+
+    printf("%-16s %-4s %-8s %10s %12s %8s %8s\n", "image", "fmt", "preset", "ms", "Mblocks/s", "rgb dB", "a dB");
+    const BCFormat formats[] = {BCFormat::BC1, BCFormat::BC3, BCFormat::BC7};
+    for (auto &image : images)
+    {
+        const double nBlocks = (double)((image.nWidth + 3) / 4) * ((image.nHeight + 3) / 4);
+        for (auto format : formats)
+        {
+            for (int q = 0; q < 2; q++)
+            {
+                BCQuality quality = (BCQuality)q;
+                size_t nPitch;
+                std::vector<UINT8> encoded(EncodedSize(image, format, &nPitch));
+                double sec = bench::MeasureBest(3, [&]() {
+                    EncodeImageBC(image.rgba.data(), image.nWidth, image.nHeight, image.nWidth * 4,
+                                  encoded.data(), nPitch, format, quality);
+                });
+                std::vector<UINT8> decoded(image.rgba.size());
+                DecodeImageBC(encoded.data(), image.nWidth, image.nHeight, nPitch, format, decoded.data(), image.nWidth * 4);
+
+                double rgb = PSNR(image, decoded, 0, 3);
+                double alpha = PSNR(image, decoded, 3, 1);
+                printf("%-16s %-4s %-8s %10.2f %12.2f %8.2f %8.2f\n", image.name.c_str(), GetBCFormatName(format),
+                       GetBCQualityName(quality), sec * 1000.0, nBlocks / sec / 1e6, rgb, alpha);
+            }
+        }
+    }
+
+    // block throughput against worker count
+    const TestImage &image = images[0];
+    const double nBlocks = (double)((image.nWidth + 3) / 4) * ((image.nHeight + 3) / 4);
+    printf("\n%-8s %-8s %12s\n", "fmt", "threads", "Mblocks/s");
+    for (auto format : formats)
+    {
+        size_t nPitch;
+        std::vector<UINT8> encoded(EncodedSize(image, format, &nPitch));
+        for (int nThreads = 1; nThreads <= 8; nThreads *= 2)
+        {
+            WorkerPool workers(nThreads);
+            double sec = bench::MeasureBest(3, [&]() {
+                EncodeImageBC(image.rgba.data(), image.nWidth, image.nHeight, image.nWidth * 4,
+                              encoded.data(), nPitch, format, BCQuality::Quality, &workers);
+            });
+            printf("%-8s %-8d %12.2f\n", GetBCFormatName(format), nThreads, nBlocks / sec / 1e6);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+
+//-----------------------------------------------------------------------------
+// Purpose: shared helpers for the hellovr_dx12 CPU benchmarks
+//-----------------------------------------------------------------------------
+namespace bench
+{
+
+// seconds of the fastest run, so a noisy machine does not skew the result
+template <class F>
+double MeasureBest(int nIterations, F &&f)
+{
+    double best = 1e30;
+    for (int i = 0; i < nIterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best)
+        {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+// repeat small workloads so each run lasts long enough to time
+inline int IterationsFor(uint64_t nBytes)
+{
+    if (nBytes >= (64ull << 20))
+        return 3;
+    if (nBytes >= (4ull << 20))
+        return 10;
+    return 50;
+}
+
+// deterministic xorshift, benchmarks must be reproducible across runs
+struct Random
+{
+    uint32_t state;
+    explicit Random(uint32_t seed = 0x2545F491) : state(seed ? seed : 1) {}
+    uint32_t Next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    float NextFloat(float lo, float hi)
+    {
+        return lo + (hi - lo) * (float)(Next() & 0xFFFFFF) / (float)0x1000000;
+    }
+};
+
+} // namespace bench
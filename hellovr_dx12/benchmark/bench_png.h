@@ -0,0 +1,161 @@
+#pragma once
+#include "lodepng.h"
+#include "bench.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Purpose: PNG helpers shared by the lodepng benchmarks. Include from the one
+//          translation unit of a benchmark: with LODEPNG_NO_COMPILE_ALLOCATORS
+//          this also defines lodepng's allocators and the global operator new.
+//-----------------------------------------------------------------------------
+
+#ifdef LODEPNG_NO_COMPILE_ALLOCATORS
+// every lodepng allocation is counted here
+static size_t g_nLiveBytes = 0;
+static size_t g_nPeakBytes = 0;
+static size_t g_nAllocs = 0;
+
+static void TrackAlloc(ptrdiff_t nBytes)
+{
+    g_nLiveBytes += nBytes;
+    if (g_nLiveBytes > g_nPeakBytes)
+        g_nPeakBytes = g_nLiveBytes;
+}
+
+void *lodepng_realloc(void *ptr, size_t new_size)
+{
+    // the size lives in front of the block
+    size_t nOld = ptr ? ((size_t *)ptr)[-1] : 0;
+    size_t *p = (size_t *)realloc(ptr ? (size_t *)ptr - 1 : nullptr, new_size + sizeof(size_t));
+    if (!p)
+        return nullptr;
+    g_nAllocs++;
+    TrackAlloc((ptrdiff_t)new_size - (ptrdiff_t)nOld);
+    p[0] = new_size;
+    return p + 1;
+}
+
+void *lodepng_malloc(size_t size)
+{
+    return lodepng_realloc(nullptr, size);
+}
+
+void lodepng_free(void *ptr)
+{
+    if (!ptr)
+        return;
+    TrackAlloc(-(ptrdiff_t)((size_t *)ptr)[-1]);
+    free((size_t *)ptr - 1);
+}
+
+// and so is everything else: the C++ wrapper's vectors, the mip builder's scratch
+void *operator new(size_t size)
+{
+    void *p = lodepng_malloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    lodepng_free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    lodepng_free(p);
+}
+#endif
+
+namespace bench
+{
+
+// gradients plus noise masked by nNoise, 255 is all noise
+inline std::vector<unsigned char> MakeImage(int nWidth, int nHeight, int nChannels, uint32_t nSeed, int nNoise = 7)
+{
+    Random random(nSeed);
+    std::vector<unsigned char> image((size_t)nWidth * nHeight * nChannels);
+    for (size_t i = 0; i < image.size(); i++)
+    {
+        image[i] = (unsigned char)((i / nChannels) % nWidth + (i / nChannels / nWidth) * 3 + (random.Next() & nNoise));
+    }
+    return image;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: encode exactly the given format. nBType is the deflate block type,
+//          0 stored, 1 fixed, 2 dynamic. pFilters, when given, holds the filter
+//          of every scanline, interlace passes included.
+//-----------------------------------------------------------------------------
+inline std::vector<unsigned char> Encode(const std::vector<unsigned char> &image, int nWidth, int nHeight,
+                                         LodePNGColorType colorType, unsigned nBitDepth, unsigned nBType = 2,
+                                         bool bInterlace = false, const unsigned char *pFilters = nullptr)
+{
+    lodepng::State state;
+    state.info_raw.colortype = colorType;
+    state.info_raw.bitdepth = nBitDepth;
+    state.info_png.color.colortype = colorType;
+    state.info_png.color.bitdepth = nBitDepth;
+    state.info_png.interlace_method = bInterlace ? 1 : 0;
+    state.encoder.auto_convert = 0;
+    state.encoder.zlibsettings.btype = nBType;
+    if (pFilters)
+    {
+        state.encoder.filter_palette_zero = 0;
+        state.encoder.filter_strategy = LFS_PREDEFINED;
+        state.encoder.predefined_filters = pFilters;
+    }
+    std::vector<unsigned char> png;
+    if (lodepng::encode(png, image, nWidth, nHeight, state) != 0)
+        png.clear();
+    return png;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Split the IDAT into chunks of nChunkSize bytes, with an empty IDAT
+//          and an unknown ancillary chunk thrown in, so chunk boundaries fall
+//          everywhere in the zlib stream
+//-----------------------------------------------------------------------------
+inline std::vector<unsigned char> SplitIDAT(const std::vector<unsigned char> &png, size_t nChunkSize)
+{
+    std::vector<unsigned char> idat;
+    unsigned char *pOut = nullptr;
+    size_t nOutSize = 0;
+    for (const unsigned char *pChunk = &png[8]; pChunk < &png[0] + png.size(); pChunk = lodepng_chunk_next_const(pChunk))
+    {
+        if (lodepng_chunk_type_equals(pChunk, "IDAT"))
+        {
+            const unsigned char *pData = lodepng_chunk_data_const(pChunk);
+            idat.insert(idat.end(), pData, pData + lodepng_chunk_length(pChunk));
+            continue;
+        }
+        if (lodepng_chunk_type_equals(pChunk, "IEND"))
+        {
+            const unsigned char note[] = {'s', 'p', 'l', 'i', 't'};
+            lodepng_chunk_create(&pOut, &nOutSize, sizeof(note), "noTe", note);
+            for (size_t i = 0; i < idat.size(); i += nChunkSize)
+            {
+                size_t n = std::min(nChunkSize, idat.size() - i);
+                lodepng_chunk_create(&pOut, &nOutSize, (unsigned)n, "IDAT", &idat[i]);
+                if (i == 0)
+                    lodepng_chunk_create(&pOut, &nOutSize, 0, "IDAT", nullptr);
+            }
+        }
+        lodepng_chunk_append(&pOut, &nOutSize, pChunk);
+    }
+    std::vector<unsigned char> split(png.begin(), png.begin() + 8);
+    split.insert(split.end(), pOut, pOut + nOutSize);
+    // lodepng's own allocators are plain malloc and free
+#ifdef LODEPNG_NO_COMPILE_ALLOCATORS
+    lodepng_free(pOut);
+#else
+    free(pOut);
+#endif
+    return split;
+}
+
+} // namespace bench
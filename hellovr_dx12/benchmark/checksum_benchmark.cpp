@@ -0,0 +1,161 @@
+#include "lodepng.h"
+#include "bench.h"
+#include <stdlib.h>
+#include <vector>
+
+typedef unsigned char UINT8;
+
+// The byte-at-a-time definitions lodepng used before
+static uint32_t ReferenceCRC32(const UINT8 *pData, size_t nSize)
+{
+    static uint32_t table[256];
+    if (table[1] == 0)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    }
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < nSize; i++)
+        c = table[(c ^ pData[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+static uint32_t ReferenceAdler32(const UINT8 *pData, size_t nSize)
+{
+    uint32_t s1 = 1, s2 = 0;
+    for (size_t i = 0; i < nSize; i++)
+    {
+        s1 = (s1 + pData[i]) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    return (s2 << 16) | s1;
+}
+
+struct Path
+{
+    const char *pchName;
+    unsigned nFeatures;
+};
+
+// Every path this CPU can run, the portable one first
+static std::vector<Path> AvailablePaths(unsigned nFeatures, unsigned nMask)
+{
+    const Path all[] = {
+        {"SSSE3", LODEPNG_CPU_SSSE3},
+        {"AVX2", LODEPNG_CPU_AVX2 | LODEPNG_CPU_SSSE3},
+        {"PCLMUL", LODEPNG_CPU_PCLMUL},
+        {"ARM CRC32", LODEPNG_CPU_ARM_CRC32},
+    };
+    std::vector<Path> paths = {{"portable", 0}};
+    for (const Path &path : all)
+    {
+        if ((path.nFeatures & nMask) != 0 && (path.nFeatures & nFeatures) == path.nFeatures)
+            paths.push_back(path);
+    }
+    return paths;
+}
+
+// Every length up to a few blocks, at every alignment, with all-0xFF and random bytes
+static bool Verify(unsigned nFeatures)
+{
+    std::vector<UINT8> data(70000 + 64);
+    bench::Random random(3);
+    for (UINT8 &b : data)
+        b = (UINT8)random.Next();
+    std::vector<UINT8> ones(data.size(), 0xFF);
+
+    std::vector<size_t> sizes;
+    for (size_t n = 0; n <= 300; n++)
+        sizes.push_back(n);
+    for (size_t n : {1023, 1024, 5551, 5552, 5553, 11104, 11105, 65535, 65536, 70000})
+        sizes.push_back(n);
+
+    int nChecks = 0;
+    for (unsigned nMask : {LODEPNG_CPU_PCLMUL | LODEPNG_CPU_ARM_CRC32, LODEPNG_CPU_SSSE3 | LODEPNG_CPU_AVX2})
+    {
+        const bool bCRC = (nMask & LODEPNG_CPU_PCLMUL) != 0;
+        for (const Path &path : AvailablePaths(nFeatures, nMask))
+        {
+            lodepng_set_cpu_features(path.nFeatures);
+            for (const std::vector<UINT8> *pBuffer : {&data, &ones})
+            {
+                for (size_t nSize : sizes)
+                {
+                    for (size_t nOffset = 0; nOffset < (nSize < 1024 ? 32u : 2u); nOffset++)
+                    {
+                        const UINT8 *p = &(*pBuffer)[nOffset];
+                        uint32_t expected = bCRC ? ReferenceCRC32(p, nSize) : ReferenceAdler32(p, nSize);
+                        uint32_t actual = bCRC ? lodepng_crc32(p, nSize) : lodepng_adler32(p, (unsigned)nSize);
+                        if (actual != expected)
+                        {
+                            printf("FAIL: %s %s of %zu bytes at offset %zu: %08x, expected %08x\n", path.pchName, bCRC ? "CRC32" : "Adler-32",
+                                   nSize, nOffset, actual, expected);
+                            return false;
+                        }
+                        nChecks++;
+                    }
+                }
+            }
+        }
+    }
+    lodepng_set_cpu_features(~0u);
+    printf("%d checksums match the byte-at-a-time definitions\n\n", nChecks);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const unsigned nFeatures = lodepng_cpu_features();
+    printf("CPU features:%s%s%s%s\n", nFeatures & LODEPNG_CPU_SSSE3 ? " SSSE3" : "", nFeatures & LODEPNG_CPU_AVX2 ? " AVX2" : "",
+           nFeatures & LODEPNG_CPU_PCLMUL ? " PCLMUL" : "", nFeatures & LODEPNG_CPU_ARM_CRC32 ? " ARM-CRC32" : "");
+    if (!Verify(nFeatures))
+        return 1;
+
+    // MB/s per path against the code it replaces. 8 KB is a typical IDAT chunk, each one's CRC is checked on decode.
+    const size_t sizes[] = {64, 8192, (size_t)(argc > 1 ? atoi(argv[1]) : 16 << 20)};
+    std::vector<UINT8> data(sizes[2]);
+    bench::Random random(5);
+    for (UINT8 &b : data)
+        b = (UINT8)random.Next();
+
+    printf("%-9s %-10s %10s %12s %8s\n", "checksum", "path", "bytes", "MB/s", "speedup");
+    for (unsigned nMask : {LODEPNG_CPU_PCLMUL | LODEPNG_CPU_ARM_CRC32, LODEPNG_CPU_SSSE3 | LODEPNG_CPU_AVX2})
+    {
+        const bool bCRC = (nMask & LODEPNG_CPU_PCLMUL) != 0;
+        for (size_t nSize : sizes)
+        {
+            const int nRepeats = (int)((64u << 20) / nSize);
+            double fBaseSeconds = 0;
+            volatile uint32_t nSink = 0;
+            if (bCRC)
+            {
+                // the byte loop lodepng_crc32 used before. Adler-32 kept its scalar loop as the portable path.
+                fBaseSeconds = bench::MeasureBest(3, [&]() {
+                    for (int r = 0; r < nRepeats; r++)
+                        nSink = nSink + ReferenceCRC32(&data[0], nSize);
+                });
+                printf("%-9s %-10s %10zu %12.1f %7.2fx\n", "CRC32", "bytewise", nSize,
+                       (double)nSize * nRepeats / (1024.0 * 1024.0) / fBaseSeconds, 1.0);
+            }
+            for (const Path &path : AvailablePaths(nFeatures, nMask))
+            {
+                lodepng_set_cpu_features(path.nFeatures);
+                double seconds = bench::MeasureBest(3, [&]() {
+                    for (int r = 0; r < nRepeats; r++)
+                        nSink = nSink + (bCRC ? lodepng_crc32(&data[0], nSize) : lodepng_adler32(&data[0], (unsigned)nSize));
+                });
+                if (fBaseSeconds == 0)
+                    fBaseSeconds = seconds;
+                printf("%-9s %-10s %10zu %12.1f %7.2fx\n", bCRC ? "CRC32" : "Adler-32", path.pchName, nSize,
+                       (double)nSize * nRepeats / (1024.0 * 1024.0) / seconds, fBaseSeconds / seconds);
+            }
+            lodepng_set_cpu_features(~0u);
+        }
+    }
+    return 0;
+}
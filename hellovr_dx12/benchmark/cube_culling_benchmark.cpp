@@ -0,0 +1,266 @@
+#include "CubeCulling.h"
+#include "RigidTransform.h"
+#include "bench.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const float k_fNearClip = 0.1f;
+static const float k_fFarClip = 30.0f;
+// half the distance between the eyes, metres
+static const float k_fHalfIPD = 0.032f;
+
+//-----------------------------------------------------------------------------
+// Purpose: what IVRSystem::GetProjectionMatrix builds from the raw tangents,
+//          as HMD turns it into a Matrix4
+//-----------------------------------------------------------------------------
+static Matrix4 Projection(float fLeft, float fRight, float fTop, float fBottom)
+{
+    float idx = 1.0f / (fRight - fLeft);
+    float idy = 1.0f / (fBottom - fTop);
+    float idz = 1.0f / (k_fFarClip - k_fNearClip);
+    float m[4][4] = {
+        {2 * idx, 0, (fRight + fLeft) * idx, 0},
+        {0, 2 * idy, (fBottom + fTop) * idy, 0},
+        {0, 0, -k_fFarClip * idz, -k_fFarClip * k_fNearClip * idz},
+        {0, 0, -1.0f, 0},
+    };
+    return Matrix4(m[0][0], m[1][0], m[2][0], m[3][0], m[0][1], m[1][1], m[2][1], m[3][1],
+                   m[0][2], m[1][2], m[2][2], m[3][2], m[0][3], m[1][3], m[2][3], m[3][3]);
+}
+
+struct StereoView
+{
+    Matrix4 matLeft;
+    Matrix4 matRight;
+};
+
+// A headset's wider outer than inner field of view, looking at yaw and pitch from position
+static StereoView LookFrom(const Vector3 &position, float fYaw, float fPitch)
+{
+    Quaternion orientation = Quaternion::FromAxisAngle(Vector3(0, 1, 0), fYaw) * Quaternion::FromAxisAngle(Vector3(1, 0, 0), fPitch);
+    RigidTransform head = RigidTransform(orientation, position).Inverse();
+    RigidTransform leftEye = RigidTransform(Quaternion(), Vector3(-k_fHalfIPD, 0, 0)).Inverse();
+    RigidTransform rightEye = RigidTransform(Quaternion(), Vector3(k_fHalfIPD, 0, 0)).Inverse();
+    StereoView view;
+    view.matLeft = Projection(-1.39f, 1.24f, -1.47f, 1.47f) * (leftEye * head).ToMatrix4();
+    view.matRight = Projection(-1.24f, 1.39f, -1.47f, 1.47f) * (rightEye * head).ToMatrix4();
+    return view;
+}
+
+static StereoView RandomView(bench::Random &random, float fExtent)
+{
+    Vector3 position(random.NextFloat(-fExtent, fExtent), random.NextFloat(-fExtent, fExtent), random.NextFloat(-fExtent, fExtent));
+    return LookFrom(position, random.NextFloat(-3.14159f, 3.14159f), random.NextFloat(-1.2f, 1.2f));
+}
+
+// Strictly inside the clip volume of matViewProjection
+static bool InClip(const Matrix4 &matViewProjection, const Vector3 &p)
+{
+    Vector4 clip = matViewProjection * Vector4(p.x, p.y, p.z, 1);
+    return clip.w > 0 && fabsf(clip.x) < clip.w && fabsf(clip.y) < clip.w && clip.z > 0 && clip.z < clip.w;
+}
+
+// Every chunk tested, none skipped because of its parent
+static void CullFlat(const CubeChunkTree &tree, const Frustum &frustum, std::vector<CubeChunkTree::DrawRange> &draws)
+{
+    draws.clear();
+    for (const CubeChunkTree::Node &chunk : tree.Level(0))
+    {
+        if (chunk.nInstanceCount == 0 || frustum.Classify(chunk.bounds) == Frustum::Outside)
+            continue;
+        if (!draws.empty() && draws.back().nFirstInstance + draws.back().nInstanceCount == chunk.nFirstInstance)
+        {
+            draws.back().nInstanceCount += chunk.nInstanceCount;
+        }
+        else
+        {
+            draws.push_back({chunk.nFirstInstance, chunk.nInstanceCount});
+        }
+    }
+}
+
+static bool SameDraws(const std::vector<CubeChunkTree::DrawRange> &a, const std::vector<CubeChunkTree::DrawRange> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].nFirstInstance != b[i].nFirstInstance || a[i].nInstanceCount != b[i].nInstanceCount)
+            return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: every cube with a corner in either eye is drawn; the tree draws
+//          exactly the chunks testing each one would; each cube is placed
+//          once; and the enclosing frustum holds both eyes' corners
+//-----------------------------------------------------------------------------
+static bool Verify()
+{
+    bench::Random random(23);
+    for (int nSize : {5, 8, 19, 40})
+    {
+        CubeVolume volume(nSize, nSize + 3, nSize - 2);
+        CubeChunkTree tree(volume);
+        std::vector<float> instances((size_t)volume.CubeCount() * CubeVolume::k_nFloatsPerInstance);
+        tree.InstanceTranslations(instances.data());
+
+        std::vector<int> placed(volume.CubeCount(), 0);
+        // back to grid coordinates through the first cube's corner
+        const float fScale = volume.Scale();
+        const Vector3 first = volume.CubeCorner(0, 0, 0), step = volume.CubeCorner(1, 1, 1) - first;
+        for (size_t i = 0; i < instances.size(); i += 3)
+        {
+            int x = (int)lroundf((instances[i] - first.x) / step.x);
+            int y = (int)lroundf((instances[i + 1] - first.y) / step.y);
+            int z = (int)lroundf((instances[i + 2] - first.z) / step.z);
+            if (x < 0 || y < 0 || z < 0 || x >= volume.Width() || y >= volume.Height() || z >= volume.Depth() ||
+                volume.CubeCorner(x, y, z) != Vector3(instances[i], instances[i + 1], instances[i + 2]))
+            {
+                printf("FAIL: instance %zu is not a cube of the volume\n", i / 3);
+                return false;
+            }
+            placed[(z * volume.Height() + y) * volume.Width() + x]++;
+        }
+        for (int nPlaced : placed)
+        {
+            if (nPlaced != 1)
+            {
+                printf("FAIL: a cube is placed %d times\n", nPlaced);
+                return false;
+            }
+        }
+
+        float fExtent = fScale * 4 * nSize * 0.7f;
+        std::vector<CubeChunkTree::DrawRange> draws, flat;
+        for (int nView = 0; nView < 200; nView++)
+        {
+            StereoView view = RandomView(random, fExtent);
+            Frustum frustum = Frustum::Enclosing(view.matLeft, view.matRight);
+            CubeChunkTree::Stats stats;
+            tree.Cull(frustum, draws, stats);
+            CullFlat(tree, frustum, flat);
+            if (!SameDraws(draws, flat))
+            {
+                printf("FAIL: the tree's draws differ from testing every chunk\n");
+                return false;
+            }
+
+            std::vector<bool> drawn(volume.CubeCount(), false);
+            uint32_t nDrawn = 0;
+            for (const CubeChunkTree::DrawRange &draw : draws)
+            {
+                for (uint32_t i = 0; i < draw.nInstanceCount; i++)
+                {
+                    drawn[draw.nFirstInstance + i] = true;
+                }
+                nDrawn += draw.nInstanceCount;
+            }
+            if (nDrawn != stats.nCubesVisible)
+            {
+                printf("FAIL: %u cubes drawn, stats say %u\n", nDrawn, stats.nCubesVisible);
+                return false;
+            }
+            for (int nInstance = 0; nInstance < volume.CubeCount(); nInstance++)
+            {
+                const float *p = &instances[(size_t)nInstance * 3];
+                bool bVisible = false;
+                for (int nCorner = 0; nCorner < 8 && !bVisible; nCorner++)
+                {
+                    Vector3 corner(p[0] + ((nCorner & 1) ? fScale : 0), p[1] + ((nCorner & 2) ? fScale : 0), p[2] + ((nCorner & 4) ? fScale : 0));
+                    bVisible = InClip(view.matLeft, corner) || InClip(view.matRight, corner);
+                }
+                if (bVisible && !drawn[nInstance])
+                {
+                    printf("FAIL: a cube in view is culled\n");
+                    return false;
+                }
+            }
+        }
+    }
+
+    // points anywhere in either eye's clip volume are in front of every enclosing plane
+    for (int nView = 0; nView < 1000; nView++)
+    {
+        StereoView view = RandomView(random, 10);
+        Frustum frustum = Frustum::Enclosing(view.matLeft, view.matRight);
+        for (Matrix4 matInverse : {view.matLeft, view.matRight})
+        {
+            matInverse.invertGeneral();
+            for (int nPoint = 0; nPoint < 16; nPoint++)
+            {
+                Vector4 world = matInverse * Vector4(random.NextFloat(-1, 1), random.NextFloat(-1, 1), random.NextFloat(0, 1), 1);
+                Vector3 p = Vector3(world.x, world.y, world.z) / world.w;
+                for (int nPlane = 0; nPlane < 6; nPlane++)
+                {
+                    Vector4 plane = frustum.Plane(nPlane);
+                    if (plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < -1e-4f * (k_fFarClip + p.length()))
+                    {
+                        printf("FAIL: the enclosing frustum's plane %d cuts into an eye\n", nPlane);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    printf("tree culls exactly as testing every chunk, nothing in view culled, each cube placed once, both eyes enclosed\n\n");
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const int nMaxSize = argc > 1 ? atoi(argv[1]) : 256;
+    if (!Verify())
+        return 1;
+
+    printf("%-8s %8s %8s %10s %10s %10s %8s %10s %10s\n", "volume", "chunks", "tree ms", "tested", "visible", "cubes", "draws", "tree us", "flat us");
+    for (int nSize : {32, 64, 128, 256})
+    {
+        if (nSize > nMaxSize)
+            break;
+        CubeVolume volume(nSize, nSize, nSize);
+        CubeChunkTree *pTree = nullptr;
+        double fBuild = bench::MeasureBest(3, [&]() {
+            delete pTree;
+            pTree = new CubeChunkTree(volume);
+        });
+
+        // standing inside the volume looking about
+        bench::Random random(7);
+        const int nViews = 256;
+        std::vector<Frustum> frustums;
+        for (int i = 0; i < nViews; i++)
+        {
+            StereoView view = RandomView(random, volume.Scale() * 4 * nSize * 0.25f);
+            frustums.push_back(Frustum::Enclosing(view.matLeft, view.matRight));
+        }
+
+        std::vector<CubeChunkTree::DrawRange> draws;
+        CubeChunkTree::Stats stats, total;
+        double fTree = bench::MeasureBest(5, [&]() {
+            total = CubeChunkTree::Stats();
+            for (const Frustum &frustum : frustums)
+            {
+                pTree->Cull(frustum, draws, stats);
+                total.nNodesTested += stats.nNodesTested;
+                total.nChunksVisible += stats.nChunksVisible;
+                total.nCubesVisible += stats.nCubesVisible / nViews;
+                total.nDraws += stats.nDraws;
+            }
+        });
+        double fFlat = bench::MeasureBest(5, [&]() {
+            for (const Frustum &frustum : frustums)
+            {
+                CullFlat(*pTree, frustum, draws);
+            }
+        });
+        printf("%4d^3   %8d %8.2f %10d %9.1f%% %9.1f%% %8d %10.2f %10.2f\n", nSize, pTree->ChunkCount(), fBuild * 1e3, total.nNodesTested / nViews,
+               100.0 * total.nChunksVisible / nViews / pTree->ChunkCount(), 100.0 * total.nCubesVisible / volume.CubeCount(), total.nDraws / nViews,
+               fTree * 1e6 / nViews, fFlat * 1e6 / nViews);
+        delete pTree;
+    }
+    return 0;
+}
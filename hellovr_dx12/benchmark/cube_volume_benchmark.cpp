@@ -0,0 +1,181 @@
+#include "CubeVolume.h"
+#include "WorkerPool.h"
+#include "bench.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static void AddCubeVertex(float fl0, float fl1, float fl2, float fl3, float fl4, std::vector<float> &vertdata)
+{
+    vertdata.push_back(fl0);
+    vertdata.push_back(fl1);
+    vertdata.push_back(fl2);
+    vertdata.push_back(fl3);
+    vertdata.push_back(fl4);
+}
+
+static void AddCubeToScene(Matrix4 mat, std::vector<float> &vertdata)
+{
+    static const float s_xs[8] = {0, 1, 1, 0, 0, 1, 1, 0};
+    static const float s_ys[8] = {0, 0, 1, 1, 0, 0, 1, 1};
+    static const float s_zs[8] = {0, 0, 0, 0, 1, 1, 1, 1};
+    Vector3 corners[8];
+    transformPoints(mat, s_xs, s_ys, s_zs, &corners[0].x, sizeof(Vector3), 8);
+    const Vector3 &A = corners[0], &B = corners[1], &C = corners[2], &D = corners[3];
+    const Vector3 &E = corners[4], &F = corners[5], &G = corners[6], &H = corners[7];
+
+    const Vector3 *rgFaces[6][4] = {{&E, &F, &G, &H}, {&B, &A, &D, &C}, {&H, &G, &C, &D},
+                                    {&A, &B, &F, &E}, {&A, &E, &H, &D}, {&F, &B, &C, &G}};
+    for (const auto &face : rgFaces)
+    {
+        AddCubeVertex(face[0]->x, face[0]->y, face[0]->z, 0, 1, vertdata);
+        AddCubeVertex(face[1]->x, face[1]->y, face[1]->z, 1, 1, vertdata);
+        AddCubeVertex(face[2]->x, face[2]->y, face[2]->z, 1, 0, vertdata);
+        AddCubeVertex(face[2]->x, face[2]->y, face[2]->z, 1, 0, vertdata);
+        AddCubeVertex(face[3]->x, face[3]->y, face[3]->z, 0, 0, vertdata);
+        AddCubeVertex(face[0]->x, face[0]->y, face[0]->z, 0, 1, vertdata);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: what Cubes::SetupScene did before: a translate chained onto a
+//          Matrix4 per cube, pushed back a float at a time
+//-----------------------------------------------------------------------------
+static void BakeWithMatrices(int nWidth, int nHeight, int nDepth, std::vector<float> &vertdataarray)
+{
+    const float fScale = 0.3f, fSpacing = 4.0f;
+    Matrix4 matScale;
+    matScale.scale(fScale, fScale, fScale);
+    Matrix4 matTransform;
+    matTransform.translate(
+        -((float)nWidth * fSpacing) / 2.f,
+        -((float)nHeight * fSpacing) / 2.f,
+        -((float)nDepth * fSpacing) / 2.f);
+
+    Matrix4 mat = matScale * matTransform;
+
+    for (int z = 0; z < nDepth; z++)
+    {
+        for (int y = 0; y < nHeight; y++)
+        {
+            for (int x = 0; x < nWidth; x++)
+            {
+                AddCubeToScene(mat, vertdataarray);
+                mat = mat * Matrix4().translate(fSpacing, 0, 0);
+            }
+            mat = mat * Matrix4().translate(-((float)nWidth) * fSpacing, fSpacing, 0);
+        }
+        mat = mat * Matrix4().translate(0, -((float)nHeight) * fSpacing, fSpacing);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: the baked volume is byte for byte the matrix chain's, serial and
+//          on workers; the shared cube moved by each instance translation
+//          lands on the baked triangles
+//-----------------------------------------------------------------------------
+static bool Verify(int nWidth, int nHeight, int nDepth, WorkerPool &workers)
+{
+    CubeVolume volume(nWidth, nHeight, nDepth);
+    std::vector<float> expected;
+    BakeWithMatrices(nWidth, nHeight, nDepth, expected);
+    if (expected.size() != volume.BakedFloatCount())
+    {
+        printf("FAIL: %zu floats baked, %zu expected\n", volume.BakedFloatCount(), expected.size());
+        return false;
+    }
+    for (WorkerPool *pWorkers : {(WorkerPool *)nullptr, &workers})
+    {
+        std::vector<float> baked(volume.BakedFloatCount() + 1, -1.0f);
+        volume.BakeVertices(baked.data(), pWorkers);
+        if (volume.CubeCount() && memcmp(baked.data(), expected.data(), sizeof(float) * expected.size()) != 0)
+        {
+            printf("FAIL: %dx%dx%d baked %s differs from the matrix chain\n", nWidth, nHeight, nDepth, pWorkers ? "on workers" : "serially");
+            return false;
+        }
+        if (baked.back() != -1.0f)
+        {
+            printf("FAIL: baking wrote past the end of the buffer\n");
+            return false;
+        }
+    }
+
+    float unit[CubeVolume::k_nVerticesPerCube * CubeVolume::k_nFloatsPerVertex];
+    volume.UnitCubeVertices(unit);
+    std::vector<float> instances((size_t)volume.CubeCount() * CubeVolume::k_nFloatsPerInstance);
+    volume.InstanceTranslations(instances.data());
+
+    // the matrix chain drifts with the rounding of every translate, the
+    // instance translations are computed directly
+    float fMaxError = 0, fExtent = 0;
+    for (int nCube = 0; nCube < volume.CubeCount(); nCube++)
+    {
+        const float *pInstance = &instances[(size_t)nCube * CubeVolume::k_nFloatsPerInstance];
+        for (int nVertex = 0; nVertex < CubeVolume::k_nVerticesPerCube; nVertex++)
+        {
+            const float *pUnit = &unit[nVertex * CubeVolume::k_nFloatsPerVertex];
+            const float *pBaked = &expected[((size_t)nCube * CubeVolume::k_nVerticesPerCube + nVertex) * CubeVolume::k_nFloatsPerVertex];
+            for (int i = 0; i < 3; i++)
+            {
+                fMaxError = fmaxf(fMaxError, fabsf(pUnit[i] + pInstance[i] - pBaked[i]));
+                fExtent = fmaxf(fExtent, fabsf(pBaked[i]));
+            }
+            if (pUnit[3] != pBaked[3] || pUnit[4] != pBaked[4])
+            {
+                printf("FAIL: cube %d vertex %d texcoord differs\n", nCube, nVertex);
+                return false;
+            }
+        }
+    }
+    if (fMaxError > 1e-3f * fExtent)
+    {
+        printf("FAIL: instanced %dx%dx%d volume is %g off the baked one\n", nWidth, nHeight, nDepth, fMaxError);
+        return false;
+    }
+    printf("%dx%dx%d: baked identical to the matrix chain, instanced within %g (extent %g)\n", nWidth, nHeight, nDepth, fMaxError, fExtent);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    // 100^3 baked is 687 MB twice over, opt in from the command line
+    const int nMaxSize = argc > 1 ? atoi(argv[1]) : 64;
+    WorkerPool workers(argc > 2 ? atoi(argv[2]) : 0);
+    if (!Verify(0, 3, 3, workers) || !Verify(3, 4, 5, workers) || !Verify(20, 21, 22, workers) || !Verify(64, 7, 9, workers))
+        return 1;
+
+    printf("\n%d worker threads\n", workers.ThreadCount());
+    printf("%-8s %10s %10s %14s %12s %12s %14s %12s\n", "volume", "cubes", "baked MB", "matrix ms", "serial ms", "workers ms",
+           "instanced KB", "instanced ms");
+    for (int nSize : {20, 40, 64, 100, 128})
+    {
+        if (nSize > nMaxSize)
+            break;
+        CubeVolume volume(nSize, nSize, nSize);
+        int nIterations = nSize <= 40 ? 5 : 2;
+
+        double fMatrices = bench::MeasureBest(nIterations, [&]() {
+            std::vector<float> vertdata;
+            BakeWithMatrices(nSize, nSize, nSize, vertdata);
+        });
+
+        // touched once first so the timings below are not page faults
+        std::vector<float> baked(volume.BakedFloatCount());
+        double fSerial = bench::MeasureBest(nIterations, [&]() { volume.BakeVertices(baked.data()); });
+        double fWorkers = bench::MeasureBest(nIterations, [&]() { volume.BakeVertices(baked.data(), &workers); });
+
+        // what Cubes uploads: the shared cube then one translation per cube
+        size_t nInstancedFloats = CubeVolume::k_nVerticesPerCube * CubeVolume::k_nFloatsPerVertex +
+                                  (size_t)volume.CubeCount() * CubeVolume::k_nFloatsPerInstance;
+        std::vector<float> instanced(nInstancedFloats);
+        double fInstanced = bench::MeasureBest(nIterations, [&]() {
+            volume.UnitCubeVertices(instanced.data());
+            volume.InstanceTranslations(instanced.data() + CubeVolume::k_nVerticesPerCube * CubeVolume::k_nFloatsPerVertex);
+        });
+        printf("%4d^3   %10d %10.1f %14.1f %12.1f %12.1f %14.1f %12.2f\n", nSize, volume.CubeCount(), sizeof(float) * baked.size() / 1048576.0,
+               fMatrices * 1e3, fSerial * 1e3, fWorkers * 1e3, sizeof(float) * nInstancedFloats / 1024.0, fInstanced * 1e3);
+    }
+    return 0;
+}
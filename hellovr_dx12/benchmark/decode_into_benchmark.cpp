@@ -0,0 +1,247 @@
+#include "bench_png.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+typedef unsigned char UINT8;
+
+// The reference: lodepng::decode into a vector, then rows copied to the pitched destination
+static unsigned DecodeThenCopy(const std::vector<UINT8> &png, LodePNGColorType colorType, unsigned nBitDepth, bool bSwap,
+                               UINT8 *pOut, size_t nPitch, bool bArena = true)
+{
+    lodepng::State state;
+    state.info_raw.colortype = colorType;
+    state.info_raw.bitdepth = nBitDepth;
+    state.decoder.swap_red_blue = bSwap ? 1 : 0;
+    state.decoder.scratch_arena = bArena ? 1 : 0;
+    std::vector<UINT8> image;
+    unsigned nWidth, nHeight;
+    unsigned nError = lodepng::decode(image, nWidth, nHeight, state, png);
+    if (nError != 0)
+        return nError;
+    const size_t nRowBits = (size_t)nWidth * lodepng_get_bpp(&state.info_raw);
+    const size_t nRowBytes = (nRowBits + 7) / 8;
+    for (unsigned y = 0; y < nHeight; y++)
+    {
+        UINT8 *pRow = pOut + y * nPitch;
+        if (nRowBits % 8 == 0)
+        {
+            memcpy(pRow, &image[y * nRowBytes], nRowBytes);
+            continue;
+        }
+        // packed rows start mid byte
+        memset(pRow, 0, nRowBytes);
+        for (size_t b = 0; b < nRowBits; b++)
+        {
+            size_t nBit = y * nRowBits + b;
+            if ((image[nBit / 8] >> (7 - nBit % 8)) & 1)
+                pRow[b / 8] |= (UINT8)(0x80 >> (b % 8));
+        }
+    }
+    return 0;
+}
+
+static unsigned DecodeInto(const std::vector<UINT8> &png, LodePNGColorType colorType, unsigned nBitDepth, bool bSwap,
+                           UINT8 *pOut, size_t nPitch, size_t nOutSize, bool bArena = true)
+{
+    lodepng::State state;
+    state.info_raw.colortype = colorType;
+    state.info_raw.bitdepth = nBitDepth;
+    state.decoder.swap_red_blue = bSwap ? 1 : 0;
+    state.decoder.scratch_arena = bArena ? 1 : 0;
+    unsigned nWidth, nHeight;
+    return lodepng_decode_into(pOut, nPitch, nOutSize, &nWidth, &nHeight, &state, &png[0], png.size());
+}
+
+static bool Verify()
+{
+    struct Case
+    {
+        LodePNGColorType pngType;
+        unsigned nPngDepth;
+        int nChannels;
+        LodePNGColorType rawType;
+        unsigned nRawDepth;
+        bool bSwap;
+    };
+    const Case cases[] = {
+        {LCT_RGBA, 8, 4, LCT_RGBA, 8, false}, {LCT_RGBA, 8, 4, LCT_RGBA, 8, true},  {LCT_RGB, 8, 3, LCT_RGBA, 8, false},
+        {LCT_RGB, 8, 3, LCT_RGBA, 8, true},   {LCT_RGB, 8, 3, LCT_RGB, 8, true},     {LCT_GREY, 8, 1, LCT_RGBA, 8, false},
+        {LCT_GREY, 1, 1, LCT_RGBA, 8, false}, {LCT_GREY, 2, 1, LCT_GREY, 2, false}, {LCT_GREY, 4, 1, LCT_GREY, 4, false},
+        {LCT_RGBA, 16, 8, LCT_RGBA, 8, true}, {LCT_RGB, 16, 6, LCT_RGBA, 16, false}, {LCT_GREY_ALPHA, 8, 2, LCT_RGBA, 8, false},
+    };
+    const int widths[] = {1, 3, 7, 8, 13, 64, 65};
+    int nChecks = 0;
+    for (const Case &c : cases)
+    {
+        for (int nWidth : widths)
+        {
+            for (int nInterlace = 0; nInterlace < 2; nInterlace++)
+            {
+                const int nHeight = 11;
+                // 1, 2 and 4 bit images store one sample per byte here, keep them in range
+                std::vector<UINT8> image = bench::MakeImage(nWidth, nHeight, c.nChannels, nWidth + nInterlace);
+                if (c.nPngDepth < 8)
+                {
+                    std::vector<UINT8> packed(((size_t)nWidth * c.nPngDepth + 7) / 8 * nHeight, 0);
+                    size_t nRowBytes = ((size_t)nWidth * c.nPngDepth + 7) / 8;
+                    for (int y = 0; y < nHeight; y++)
+                        for (int x = 0; x < nWidth; x++)
+                        {
+                            unsigned v = image[(size_t)y * nWidth + x] & ((1u << c.nPngDepth) - 1);
+                            size_t nBit = (size_t)x * c.nPngDepth;
+                            packed[y * nRowBytes + nBit / 8] |= (UINT8)(v << (8 - c.nPngDepth - nBit % 8));
+                        }
+                    // encode wants the rows packed without padding for bit depths below 8
+                    std::vector<UINT8> bits(((size_t)nWidth * nHeight * c.nPngDepth + 7) / 8, 0);
+                    for (int y = 0; y < nHeight; y++)
+                        for (size_t b = 0; b < (size_t)nWidth * c.nPngDepth; b++)
+                        {
+                            size_t nOut = (size_t)y * nWidth * c.nPngDepth + b;
+                            if ((packed[y * nRowBytes + b / 8] >> (7 - b % 8)) & 1)
+                                bits[nOut / 8] |= (UINT8)(0x80 >> (nOut % 8));
+                        }
+                    image.swap(bits);
+                }
+                std::vector<UINT8> png = bench::Encode(image, nWidth, nHeight, c.pngType, c.nPngDepth, 2, nInterlace != 0);
+                if (nWidth == 13)
+                    png = bench::SplitIDAT(png, 5);
+                LodePNGColorMode raw;
+                lodepng_color_mode_init(&raw);
+                raw.colortype = c.rawType;
+                raw.bitdepth = c.nRawDepth;
+                const size_t nRowBytes = lodepng_get_raw_size(nWidth, 1, &raw);
+                const size_t nPitch = (nRowBytes + 255) & ~(size_t)255;
+                const size_t nSize = nPitch * (nHeight - 1) + nRowBytes;
+                // untouched padding must stay as it was, the reference decodes without the scratch arena
+                std::vector<UINT8> expected(nSize, 0xCD), actual(nSize, 0xCD), copied(nSize, 0xCD);
+                if (png.empty() || DecodeThenCopy(png, c.rawType, c.nRawDepth, c.bSwap, &expected[0], nPitch, false) != 0 ||
+                    DecodeThenCopy(png, c.rawType, c.nRawDepth, c.bSwap, &copied[0], nPitch) != 0 || copied != expected)
+                {
+                    printf("FAIL: reference decode of %d bit type %d width %d\n", c.nPngDepth, c.pngType, nWidth);
+                    return false;
+                }
+                unsigned nError = DecodeInto(png, c.rawType, c.nRawDepth, c.bSwap, &actual[0], nPitch, nSize);
+                if (nError != 0 || actual != expected)
+                {
+                    printf("FAIL: %d bit type %d to %d bit type %d%s, width %d%s: error %u\n", c.nPngDepth, c.pngType, c.nRawDepth,
+                           c.rawType, c.bSwap ? " swapped" : "", nWidth, nInterlace ? " interlaced" : "", nError);
+                    return false;
+                }
+                nChecks++;
+
+                // one byte short, and a pitch below a row
+                if (DecodeInto(png, c.rawType, c.nRawDepth, c.bSwap, &actual[0], nPitch, nSize - 1) != 91 ||
+                    (nRowBytes > 1 && DecodeInto(png, c.rawType, c.nRawDepth, c.bSwap, &actual[0], nRowBytes - 1, nSize) != 91))
+                {
+                    printf("FAIL: undersized output accepted\n");
+                    return false;
+                }
+            }
+        }
+    }
+    // only 8-bit RGB and RGBA have a red and blue to swap
+    std::vector<UINT8> png = bench::Encode(bench::MakeImage(4, 4, 1, 1), 4, 4, LCT_GREY, 8), out(64);
+    if (DecodeInto(png, LCT_GREY, 8, true, &out[0], 4, out.size()) != 92)
+    {
+        printf("FAIL: swap_red_blue accepted grey output\n");
+        return false;
+    }
+    printf("%d pitched decodes match decode + copy\n\n", nChecks);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const int nSize = argc > 1 ? atoi(argv[1]) : 4096;
+    if (!Verify())
+        return 1;
+
+    // An RGBA texture decoded into a 256 byte pitched "upload heap" as RGBA8 and BGRA8
+    std::vector<UINT8> image = bench::MakeImage(nSize, nSize, 4, 9);
+    std::vector<UINT8> png = bench::Encode(image, nSize, nSize, LCT_RGBA, 8);
+    const size_t nImageBytes = image.size();
+    const size_t nPitch = ((size_t)nSize * 4 + 255) & ~(size_t)255;
+    std::vector<UINT8> upload(nPitch * nSize);
+
+    printf("%dx%d RGBA, %.1f MB image, %.1f MB PNG\n", nSize, nSize, nImageBytes / 1048576.0, png.size() / 1048576.0);
+    // peak heap is what the decode allocates on top of the PNG and the destination
+    printf("%-7s %-16s %10s %16s %14s\n", "format", "path", "ms", "image copies", "peak heap MB");
+    for (int nSwap = 0; nSwap < 2; nSwap++)
+    {
+        for (int nInto = 0; nInto < 2; nInto++)
+        {
+            unsigned nError = 0;
+            const size_t nBaseline = g_nLiveBytes;
+            g_nPeakBytes = nBaseline;
+            double seconds = bench::MeasureBest(5, [&]() {
+                nError |= nInto ? DecodeInto(png, LCT_RGBA, 8, nSwap != 0, &upload[0], nPitch, upload.size())
+                                : DecodeThenCopy(png, LCT_RGBA, 8, nSwap != 0, &upload[0], nPitch);
+            });
+            bool bSame = true;
+            for (int y = 0; y < nSize && bSame; y++)
+            {
+                const UINT8 *pRow = &upload[y * nPitch];
+                const UINT8 *pRef = &image[(size_t)y * nSize * 4];
+                for (int x = 0; x < nSize * 4 && bSame; x++)
+                {
+                    int c = x & 3;
+                    int nSource = nSwap && c != 1 && c != 3 ? 2 - c : c;
+                    bSame = pRow[x] == pRef[x - c + nSource];
+                }
+            }
+            if (nError != 0 || !bSame)
+            {
+                printf("FAIL: %s decode\n", nInto ? "pitched" : "vector");
+                return 1;
+            }
+            // unfilter into lodepng's image, the C++ wrapper's vector, the rows into the upload heap;
+            // the pitched decode unfilters in place and writes each row once
+            const int nCopies = nInto ? 1 : 3;
+            printf("%-7s %-16s %10.2f %16d %14.1f\n", nSwap ? "BGRA8" : "RGBA8", nInto ? "decode_into" : "decode + copy",
+                   seconds * 1000.0, nCopies, (g_nPeakBytes - nBaseline) / 1048576.0);
+        }
+    }
+
+    // Texture after texture on one thread, the IDAT in 8 KB chunks the way libpng writes it.
+    // Peak heap includes the arena the thread keeps between images.
+    printf("\n%-9s %-16s %-6s %10s %14s %14s\n", "texture", "path", "arena", "ms", "allocs/decode", "peak heap MB");
+    const int textureSizes[] = {256, 1024, nSize};
+    for (int nTexture : textureSizes)
+    {
+        std::vector<UINT8> texture = bench::MakeImage(nTexture, nTexture, 4, nTexture);
+        std::vector<UINT8> chunked = bench::SplitIDAT(bench::Encode(texture, nTexture, nTexture, LCT_RGBA, 8), 8192);
+        const size_t nTexturePitch = ((size_t)nTexture * 4 + 255) & ~(size_t)255;
+        std::vector<UINT8> reference(nTexturePitch * nTexture), dest(reference.size());
+        const int nIterations = bench::IterationsFor(texture.size());
+        for (int nInto = 0; nInto < 2; nInto++)
+        {
+            for (int nArena = 0; nArena < 2; nArena++)
+            {
+                unsigned nError = 0;
+                auto decode = [&]() {
+                    nError |= nInto ? DecodeInto(chunked, LCT_RGBA, 8, false, &dest[0], nTexturePitch, dest.size(), nArena != 0)
+                                    : DecodeThenCopy(chunked, LCT_RGBA, 8, false, &dest[0], nTexturePitch, nArena != 0);
+                };
+                const size_t nBaseline = g_nLiveBytes;
+                g_nPeakBytes = nBaseline;
+                decode(); // the first image sizes the arena
+                const size_t nAllocs = g_nAllocs;
+                double seconds = bench::MeasureBest(nIterations, decode);
+                const double allocsPerDecode = (double)(g_nAllocs - nAllocs) / nIterations;
+                if (nInto == 0 && nArena == 0)
+                    reference = dest;
+                if (nError != 0 || dest != reference)
+                {
+                    printf("FAIL: %d %s decode with%s the arena\n", nTexture, nInto ? "pitched" : "vector", nArena ? "" : "out");
+                    return 1;
+                }
+                printf("%-9d %-16s %-6s %10.2f %14.1f %14.1f\n", nTexture, nInto ? "decode_into" : "decode + copy",
+                       nArena ? "yes" : "no", seconds * 1000.0, allocsPerDecode, (g_nPeakBytes - nBaseline) / 1048576.0);
+                lodepng_scratch_release();
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,246 @@
+#include "lodepng.h"
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+typedef unsigned char UINT8;
+
+enum class DataKind
+{
+    Noise,     // incompressible, mostly literals
+    Gradient,  // image-like rows, literals and mid distance matches
+    Repeating, // short periods, long matches at distances 1 to 7
+    Text,      // words from a small vocabulary
+};
+
+static const char *g_kindNames[] = {"noise", "gradient", "repeating", "text"};
+
+static std::vector<UINT8> MakeData(DataKind kind, size_t nSize, uint32_t nSeed)
+{
+    bench::Random random(nSeed);
+    std::vector<UINT8> data(nSize);
+    static const char *words[] = {"render ", "model ", "texture ", "mip ", "the ", "eye ", "pose ", "frame ", "\n"};
+    size_t nPeriod = 1 + random.Next() % 7;
+    for (size_t i = 0; i < nSize;)
+    {
+        switch (kind)
+        {
+        case DataKind::Noise:
+            data[i++] = (UINT8)random.Next();
+            break;
+        case DataKind::Gradient:
+            data[i] = (UINT8)((i & 255) + (i >> 10) + (random.Next() & 3));
+            i++;
+            break;
+        case DataKind::Repeating:
+            if ((random.Next() & 1023) == 0)
+                nPeriod = 1 + random.Next() % 7;
+            data[i] = i < nPeriod ? (UINT8)random.Next() : data[i - nPeriod];
+            i++;
+            break;
+        case DataKind::Text:
+            for (const char *pch = words[random.Next() % 9]; *pch && i < nSize; pch++)
+                data[i++] = (UINT8)*pch;
+            break;
+        }
+    }
+    return data;
+}
+
+static std::vector<UINT8> Compress(const std::vector<UINT8> &data, unsigned nBType, unsigned nWindowSize, unsigned bLazy = 1)
+{
+    LodePNGCompressSettings settings;
+    lodepng_compress_settings_init(&settings);
+    settings.btype = nBType;
+    settings.windowsize = nWindowSize;
+    settings.lazymatching = bLazy;
+    unsigned char *pOut = nullptr;
+    size_t nOutSize = 0;
+    std::vector<UINT8> compressed;
+    if (lodepng_zlib_compress(&pOut, &nOutSize, data.empty() ? nullptr : &data[0], data.size(), &settings) == 0)
+    {
+        compressed.assign(pOut, pOut + nOutSize);
+    }
+    free(pOut);
+    return compressed;
+}
+
+// bFast picks lodepng_inflate_fast, otherwise the original lodepng_inflate
+static unsigned Decompress(const UINT8 *pCompressed, size_t nSize, bool bFast, std::vector<UINT8> &out, bool bIgnoreAdler = false)
+{
+    LodePNGDecompressSettings settings;
+    lodepng_decompress_settings_init(&settings);
+    settings.custom_inflate = bFast ? lodepng_inflate_fast : nullptr;
+    settings.ignore_adler32 = bIgnoreAdler ? 1 : 0;
+    unsigned char *pOut = nullptr;
+    size_t nOutSize = 0;
+    unsigned nError = lodepng_zlib_decompress(&pOut, &nOutSize, pCompressed, nSize, &settings);
+    out.assign(pOut, pOut + nOutSize);
+    free(pOut);
+    return nError;
+}
+
+static unsigned Decompress(const std::vector<UINT8> &compressed, bool bFast, std::vector<UINT8> &out)
+{
+    return Decompress(&compressed[0], compressed.size(), bFast, out);
+}
+
+static unsigned DecodePNG(const std::vector<UINT8> &png, bool bFast, std::vector<UINT8> &image)
+{
+    lodepng::State state;
+    state.decoder.zlibsettings.custom_inflate = bFast ? lodepng_inflate_fast : nullptr;
+    unsigned nWidth, nHeight;
+    image.clear();
+    return lodepng::decode(image, nWidth, nHeight, state, png);
+}
+
+// Both inflaters must agree on every stream the deflater makes, and on corrupted ones whenever both accept them
+static bool Verify(const std::vector<const char *> &pngPaths)
+{
+    const size_t sizes[] = {1, 7, 300, 4096, 70000, 1 << 20};
+    const unsigned windows[] = {256, 2048, 32768};
+    int nCases = 0;
+    for (int nKind = 0; nKind < 4; nKind++)
+    {
+        for (size_t nSize : sizes)
+        {
+            std::vector<UINT8> data = MakeData((DataKind)nKind, nSize, (uint32_t)nSize * 7 + nKind + 1);
+            for (unsigned nBType = 0; nBType < 3; nBType++)
+            {
+                for (unsigned nWindow : windows)
+                {
+                    std::vector<UINT8> compressed = Compress(data, nBType, nWindow, nWindow != 2048);
+                    std::vector<UINT8> reference, fast;
+                    if (compressed.empty() || Decompress(compressed, false, reference) != 0 || reference != data)
+                    {
+                        printf("FAIL: %s %zu bytes btype %u did not round trip\n", g_kindNames[nKind], nSize, nBType);
+                        return false;
+                    }
+                    if (Decompress(compressed, true, fast) != 0 || fast != data)
+                    {
+                        printf("FAIL: %s %zu bytes btype %u window %u: fast inflate differs\n", g_kindNames[nKind], nSize, nBType, nWindow);
+                        return false;
+                    }
+                    nCases++;
+                    if (nBType == 0)
+                        break; // stored blocks ignore the window
+                }
+            }
+        }
+    }
+
+    // flipped bits and truncation may fail differently, but must never crash or decode differently
+    bench::Random random(99);
+    int nCorrupt = 0, nBothFailed = 0;
+    for (int nKind = 0; nKind < 4; nKind++)
+    {
+        std::vector<UINT8> data = MakeData((DataKind)nKind, 5000, nKind + 11);
+        for (unsigned nBType = 0; nBType < 3; nBType++)
+        {
+            const std::vector<UINT8> compressed = Compress(data, nBType, 2048);
+            for (int i = 0; i < 2000; i++)
+            {
+                std::vector<UINT8> corrupt = compressed;
+                int nFlips = 1 + (int)(random.Next() % 3);
+                for (int f = 0; f < nFlips; f++)
+                {
+                    // mostly near the front, where the block headers are
+                    size_t nPos = 2 + random.Next() % (random.Next() & 1 ? corrupt.size() - 2 : std::min<size_t>(64, corrupt.size() - 2));
+                    corrupt[nPos] ^= (UINT8)(1 << (random.Next() & 7));
+                }
+                size_t nSize = corrupt.size();
+                if ((random.Next() & 7) == 0)
+                    nSize = 2 + random.Next() % (nSize - 2);
+                // lodepng_inflate reads a few bytes past a truncated stream, keep them addressable
+                corrupt.resize(nSize + 64, 0);
+                std::vector<UINT8> reference, fast;
+                unsigned nReferenceError = Decompress(&corrupt[0], nSize, false, reference, true);
+                unsigned nFastError = Decompress(&corrupt[0], nSize, true, fast, true);
+                if (nReferenceError == 0 && nFastError == 0 && reference != fast)
+                {
+                    printf("FAIL: %s btype %u corruption %d decodes differently\n", g_kindNames[nKind], nBType, i);
+                    return false;
+                }
+                nBothFailed += nReferenceError != 0 && nFastError != 0;
+                nCorrupt++;
+            }
+        }
+    }
+
+    for (const char *pchPath : pngPaths)
+    {
+        std::vector<UINT8> png, reference, fast;
+        lodepng::load_file(png, pchPath);
+        if (png.empty())
+        {
+            printf("skipping %s, not found\n", pchPath);
+            continue;
+        }
+        unsigned nError = DecodePNG(png, false, reference);
+        if (DecodePNG(png, true, fast) != nError || fast != reference)
+        {
+            printf("FAIL: %s decodes differently\n", pchPath);
+            return false;
+        }
+        nCases++;
+    }
+    printf("%d streams identical with both inflaters, %d corrupted ones never disagreed (%d rejected by both)\n\n", nCases,
+           nCorrupt, nBothFailed);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<const char *> pngPaths(argv + 1, argv + argc);
+    if (pngPaths.empty())
+        pngPaths.push_back("cube_texture.png");
+
+    if (!Verify(pngPaths))
+        return 1;
+
+    // MB/s of inflated output
+    printf("%-10s %-8s %8s %12s %12s %8s\n", "data", "blocks", "ratio", "inflate MB/s", "fast MB/s", "speedup");
+    const char *blockNames[] = {"stored", "fixed", "dynamic"};
+    const size_t nSize = 8 << 20;
+    for (int nKind = 0; nKind < 4; nKind++)
+    {
+        std::vector<UINT8> data = MakeData((DataKind)nKind, nSize, 5);
+        const double mb = (double)nSize / (1024.0 * 1024.0);
+        for (unsigned nBType = 0; nBType < 3; nBType++)
+        {
+            std::vector<UINT8> compressed = Compress(data, nBType, 32768);
+            std::vector<UINT8> out;
+            double seconds[2];
+            for (int nFast = 0; nFast < 2; nFast++)
+            {
+                unsigned nError = 0;
+                seconds[nFast] = bench::MeasureBest(5, [&]() { nError |= Decompress(compressed, nFast != 0, out); });
+                if (nError != 0 || out != data)
+                {
+                    printf("FAIL: %s %s inflate\n", g_kindNames[nKind], blockNames[nBType]);
+                    return 1;
+                }
+            }
+            printf("%-10s %-8s %8.2f %12.1f %12.1f %7.2fx\n", g_kindNames[nKind], blockNames[nBType],
+                   (double)nSize / compressed.size(), mb / seconds[0], mb / seconds[1], seconds[0] / seconds[1]);
+        }
+    }
+
+    for (const char *pchPath : pngPaths)
+    {
+        std::vector<UINT8> png, image;
+        lodepng::load_file(png, pchPath);
+        if (png.empty())
+            continue;
+        double seconds[2];
+        for (int nFast = 0; nFast < 2; nFast++)
+        {
+            seconds[nFast] = bench::MeasureBest(10, [&]() { DecodePNG(png, nFast != 0, image); });
+        }
+        const double mb = (double)image.size() / (1024.0 * 1024.0);
+        printf("%-19s %8s %12.1f %12.1f %7.2fx  (whole PNG decode)\n", pchPath, "", mb / seconds[0], mb / seconds[1],
+               seconds[0] / seconds[1]);
+    }
+    return 0;
+}
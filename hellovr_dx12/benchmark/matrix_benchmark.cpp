@@ -0,0 +1,415 @@
+#include "Matrices.h"
+#include "bench.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Purpose: the scalar Matrix4 code the SIMD paths replaced, on plain column
+//          major arrays
+//-----------------------------------------------------------------------------
+namespace scalar
+{
+
+static void Multiply(const float *m, const float *n, float *r)
+{
+    for (int j = 0; j < 16; j += 4)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            r[j + i] = m[i] * n[j] + m[4 + i] * n[j + 1] + m[8 + i] * n[j + 2] + m[12 + i] * n[j + 3];
+        }
+    }
+}
+
+static Vector4 Transform(const float *m, const Vector4 &v)
+{
+    return Vector4(m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12] * v.w, m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13] * v.w,
+                   m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14] * v.w, m[3] * v.x + m[7] * v.y + m[11] * v.z + m[15] * v.w);
+}
+
+static Vector3 Transform(const float *m, const Vector3 &v)
+{
+    return Vector3(m[0] * v.x + m[4] * v.y + m[8] * v.z, m[1] * v.x + m[5] * v.y + m[9] * v.z, m[2] * v.x + m[6] * v.y + m[10] * v.z);
+}
+
+static Vector4 PreTransform(const Vector4 &v, const float *m)
+{
+    return Vector4(v.x * m[0] + v.y * m[1] + v.z * m[2] + v.w * m[3], v.x * m[4] + v.y * m[5] + v.z * m[6] + v.w * m[7],
+                   v.x * m[8] + v.y * m[9] + v.z * m[10] + v.w * m[11], v.x * m[12] + v.y * m[13] + v.z * m[14] + v.w * m[15]);
+}
+
+static void Transpose(float *m)
+{
+    std::swap(m[1], m[4]);
+    std::swap(m[2], m[8]);
+    std::swap(m[3], m[12]);
+    std::swap(m[6], m[9]);
+    std::swap(m[7], m[13]);
+    std::swap(m[11], m[14]);
+}
+
+static float Cofactor(float m0, float m1, float m2, float m3, float m4, float m5, float m6, float m7, float m8)
+{
+    return m0 * (m4 * m8 - m5 * m7) - m1 * (m3 * m8 - m5 * m6) + m2 * (m3 * m7 - m4 * m6);
+}
+
+static void InvertGeneral(float *m)
+{
+    float cofactor0 = Cofactor(m[5], m[6], m[7], m[9], m[10], m[11], m[13], m[14], m[15]);
+    float cofactor1 = Cofactor(m[4], m[6], m[7], m[8], m[10], m[11], m[12], m[14], m[15]);
+    float cofactor2 = Cofactor(m[4], m[5], m[7], m[8], m[9], m[11], m[12], m[13], m[15]);
+    float cofactor3 = Cofactor(m[4], m[5], m[6], m[8], m[9], m[10], m[12], m[13], m[14]);
+    float determinant = m[0] * cofactor0 - m[1] * cofactor1 + m[2] * cofactor2 - m[3] * cofactor3;
+    if (fabs(determinant) <= 0.00001f)
+    {
+        static const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        memcpy(m, identity, sizeof(identity));
+        return;
+    }
+    float cofactor4 = Cofactor(m[1], m[2], m[3], m[9], m[10], m[11], m[13], m[14], m[15]);
+    float cofactor5 = Cofactor(m[0], m[2], m[3], m[8], m[10], m[11], m[12], m[14], m[15]);
+    float cofactor6 = Cofactor(m[0], m[1], m[3], m[8], m[9], m[11], m[12], m[13], m[15]);
+    float cofactor7 = Cofactor(m[0], m[1], m[2], m[8], m[9], m[10], m[12], m[13], m[14]);
+    float cofactor8 = Cofactor(m[1], m[2], m[3], m[5], m[6], m[7], m[13], m[14], m[15]);
+    float cofactor9 = Cofactor(m[0], m[2], m[3], m[4], m[6], m[7], m[12], m[14], m[15]);
+    float cofactor10 = Cofactor(m[0], m[1], m[3], m[4], m[5], m[7], m[12], m[13], m[15]);
+    float cofactor11 = Cofactor(m[0], m[1], m[2], m[4], m[5], m[6], m[12], m[13], m[14]);
+    float cofactor12 = Cofactor(m[1], m[2], m[3], m[5], m[6], m[7], m[9], m[10], m[11]);
+    float cofactor13 = Cofactor(m[0], m[2], m[3], m[4], m[6], m[7], m[8], m[10], m[11]);
+    float cofactor14 = Cofactor(m[0], m[1], m[3], m[4], m[5], m[7], m[8], m[9], m[11]);
+    float cofactor15 = Cofactor(m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10]);
+    float invDeterminant = 1.0f / determinant;
+    const float result[16] = {invDeterminant * cofactor0,  -invDeterminant * cofactor4, invDeterminant * cofactor8,
+                              -invDeterminant * cofactor12, -invDeterminant * cofactor1, invDeterminant * cofactor5,
+                              -invDeterminant * cofactor9, invDeterminant * cofactor13,  invDeterminant * cofactor2,
+                              -invDeterminant * cofactor6, invDeterminant * cofactor10,  -invDeterminant * cofactor14,
+                              -invDeterminant * cofactor3, invDeterminant * cofactor7,   -invDeterminant * cofactor11,
+                              invDeterminant * cofactor15};
+    memcpy(m, result, sizeof(result));
+}
+
+} // namespace scalar
+
+static Matrix4 RandomMatrix(bench::Random &random, float fRange)
+{
+    float m[16];
+    for (float &f : m)
+    {
+        f = random.NextFloat(-fRange, fRange);
+    }
+    return Matrix4(m);
+}
+
+// What the scene builds: rotations, scales and translations, sometimes a projection on top
+static Matrix4 RandomTransform(bench::Random &random)
+{
+    Matrix4 mat;
+    mat.scale(random.NextFloat(0.25f, 4.0f), random.NextFloat(0.25f, 4.0f), random.NextFloat(0.25f, 4.0f));
+    mat.rotate(random.NextFloat(-180.0f, 180.0f), random.NextFloat(-1, 1), random.NextFloat(-1, 1), random.NextFloat(0.1f, 1));
+    mat.translate(random.NextFloat(-50, 50), random.NextFloat(-50, 50), random.NextFloat(-50, 50));
+    if (random.Next() & 1)
+    {
+        float fNear = random.NextFloat(0.05f, 1.0f), fFar = random.NextFloat(10.0f, 100.0f);
+        Matrix4 projection(1.2f, 0, 0, 0, 0, 1.5f, 0, 0, 0, 0, fFar / (fNear - fFar), -1, 0, 0, fNear * fFar / (fNear - fFar), 0);
+        mat = projection * mat;
+    }
+    return mat;
+}
+
+static bool Same(const float *a, const float *b, int nCount)
+{
+    return memcmp(a, b, nCount * sizeof(float)) == 0;
+}
+
+static bool SameVector(const Vector4 &a, const Vector4 &b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+static void PrintMatrices(const char *pchWhat, const float *a, const float *b)
+{
+    printf("FAIL: %s\n", pchWhat);
+    for (int i = 0; i < 16; i++)
+    {
+        printf("  [%2d] %.9g %.9g\n", i, a[i], b[i]);
+    }
+}
+
+// |M * M^-1 - I|, largest element
+static float IdentityError(const Matrix4 &mat, const Matrix4 &inverse)
+{
+    Matrix4 product = mat * inverse;
+    float fError = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        fError = fmaxf(fError, fabsf(product[i] - (i % 5 == 0 ? 1.0f : 0.0f)));
+    }
+    return fError;
+}
+
+// max over rows of the sum of |element|, for the condition number
+static float RowSumNorm(const Matrix4 &mat)
+{
+    float fNorm = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        fNorm = fmaxf(fNorm, fabsf(mat[i]) + fabsf(mat[4 + i]) + fabsf(mat[8 + i]) + fabsf(mat[12 + i]));
+    }
+    return fNorm;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: multiply, transforms and transpose match the scalar code bit for
+//          bit; the general inverse matches it to rounding, inverts as well,
+//          and still gives identity for singular matrices
+//-----------------------------------------------------------------------------
+static bool Verify()
+{
+    if (((size_t)&Matrix4()[0] & 15) != 0 || alignof(Matrix4) < 16 || alignof(Vector4) < 16 || sizeof(Vector4) != 16)
+    {
+        printf("FAIL: Matrix4 or Vector4 storage is not 16 byte aligned\n");
+        return false;
+    }
+
+    bench::Random random(17);
+    for (int i = 0; i < 200000; i++)
+    {
+        Matrix4 a = i & 1 ? RandomMatrix(random, 100.0f) : RandomTransform(random);
+        Matrix4 b = i & 2 ? RandomMatrix(random, 100.0f) : RandomTransform(random);
+        float expected[16];
+        scalar::Multiply(a.get(), b.get(), expected);
+        Matrix4 product = a * b;
+        if (!Same(product.get(), expected, 16))
+        {
+            PrintMatrices("multiply differs from scalar", product.get(), expected);
+            return false;
+        }
+        Matrix4 accumulated = a;
+        accumulated *= b;
+        if (accumulated != product)
+        {
+            printf("FAIL: *= differs from *\n");
+            return false;
+        }
+
+        Vector4 v(random.NextFloat(-100, 100), random.NextFloat(-100, 100), random.NextFloat(-100, 100), random.NextFloat(-2, 2));
+        if (!SameVector(a * v, scalar::Transform(a.get(), v)) || !SameVector(v * a, scalar::PreTransform(v, a.get())))
+        {
+            printf("FAIL: Vector4 transform differs from scalar\n");
+            return false;
+        }
+        Vector3 v3(v.x, v.y, v.z), r3 = a * v3, e3 = scalar::Transform(a.get(), v3);
+        if (r3.x != e3.x || r3.y != e3.y || r3.z != e3.z)
+        {
+            printf("FAIL: Vector3 transform differs from scalar\n");
+            return false;
+        }
+
+        memcpy(expected, a.get(), sizeof(expected));
+        scalar::Transpose(expected);
+        if (!Same(a.getTranspose(), expected, 16) || !Same(Matrix4(a).transpose().get(), expected, 16))
+        {
+            PrintMatrices("transpose differs from scalar", a.getTranspose(), expected);
+            return false;
+        }
+    }
+
+    // The inverse is computed a different way round, so compare to rounding
+    // scaled by the condition number of each matrix
+    int nChecked = 0;
+    for (int i = 0; i < 200000; i++)
+    {
+        Matrix4 mat = i & 1 ? RandomMatrix(random, 10.0f) : RandomTransform(random);
+        float expected[16];
+        memcpy(expected, mat.get(), sizeof(expected));
+        scalar::InvertGeneral(expected);
+        Matrix4 inverse = mat;
+        inverse.invertGeneral();
+
+        float fCondition = RowSumNorm(mat) * RowSumNorm(Matrix4(expected));
+        if (fCondition > 1e5f)
+            continue; // ill conditioned, neither answer means much
+        float fTolerance = 4 * FLT_EPSILON * fCondition;
+        float fLargest = 0;
+        for (float f : expected)
+        {
+            fLargest = fmaxf(fLargest, fabsf(f));
+        }
+        for (int j = 0; j < 16; j++)
+        {
+            if (fabsf(inverse[j] - expected[j]) > fTolerance * fLargest)
+            {
+                PrintMatrices("general inverse differs from scalar", inverse.get(), expected);
+                return false;
+            }
+        }
+        if (IdentityError(mat, inverse) > fTolerance)
+        {
+            printf("FAIL: M * invertGeneral(M) is not identity\n");
+            return false;
+        }
+        nChecked++;
+    }
+    if (nChecked < 100000)
+    {
+        printf("FAIL: only %d well conditioned inverses checked\n", nChecked);
+        return false;
+    }
+
+    // singular and near singular: identity back, as before. Small integers
+    // keep the arithmetic exact, so a repeated row gives a determinant of 0
+    for (int i = 0; i < 1000; i++)
+    {
+        Matrix4 mat;
+        for (int j = 0; j < 16; j++)
+        {
+            mat[j] = (float)((int)(random.Next() % 17) - 8);
+        }
+        int nRow = i % 4, nCopy = (i / 4) % 4 == nRow ? (nRow + 1) % 4 : (i / 4) % 4;
+        for (int j = 0; j < 4; j++)
+        {
+            mat[j * 4 + nRow] = mat[j * 4 + nCopy] * (i & 16 ? 2.0f : 1.0f);
+        }
+        if (i & 32)
+        {
+            mat = RandomMatrix(random, 0.02f); // |det| at most 24 * 0.02^4, under EPSILON
+        }
+        float expected[16];
+        memcpy(expected, mat.get(), sizeof(expected));
+        scalar::InvertGeneral(expected);
+        if (!Same(expected, Matrix4().get(), 16))
+        {
+            printf("FAIL: scalar inverse of singular matrix %d is not identity\n", i);
+            return false;
+        }
+        if (mat.invertGeneral() != Matrix4())
+        {
+            printf("FAIL: singular matrix %d did not invert to identity\n", i);
+            return false;
+        }
+    }
+    printf("multiply, transforms and transpose match scalar exactly, %d general inverses to rounding\n\n", nChecked);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const int nCount = argc > 1 ? atoi(argv[1]) : 4096;
+    if (!Verify())
+        return 1;
+
+#if MATRICES_AVX
+    const char *pchPath = "AVX";
+#elif MATRICES_SSE
+    const char *pchPath = "SSE";
+#else
+    const char *pchPath = "scalar";
+#endif
+    printf("%d matrices and vectors per pass, Matrix4 built for %s\n", nCount, pchPath);
+    printf("%-24s %12s %12s %8s\n", "operation", "scalar ns", "Matrix4 ns", "speedup");
+
+    bench::Random random(5);
+    std::vector<Matrix4> a(nCount), b(nCount), rotations(nCount), out(nCount);
+    std::vector<Vector4> vectors(nCount), transformed(nCount);
+    for (int i = 0; i < nCount; i++)
+    {
+        a[i] = RandomTransform(random);
+        b[i] = RandomTransform(random);
+        rotations[i].rotateX(random.NextFloat(-180.0f, 180.0f)).rotateY(random.NextFloat(-180.0f, 180.0f));
+        vectors[i] = Vector4(random.NextFloat(-10, 10), random.NextFloat(-10, 10), random.NextFloat(-10, 10), 1);
+    }
+
+    // the sum of the results keeps the compiler from dropping the work
+    float fSink = 0;
+    const int nPasses = 50;
+    auto report = [&](const char *pchName, auto &&scalarPass, auto &&simdPass) {
+        double scalarSeconds = bench::MeasureBest(nPasses, scalarPass);
+        double simdSeconds = bench::MeasureBest(nPasses, simdPass);
+        fSink += out[nCount / 2][0] + transformed[nCount / 2].x;
+        printf("%-24s %12.2f %12.2f %7.2fx\n", pchName, scalarSeconds * 1e9 / nCount, simdSeconds * 1e9 / nCount,
+               scalarSeconds / simdSeconds);
+    };
+
+    report(
+        "multiply",
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+                scalar::Multiply(a[i].get(), b[i].get(), &out[i][0]);
+        },
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+                out[i] = a[i] * b[i];
+        });
+    report(
+        "multiply chain",
+        [&]() {
+            float m[16];
+            memcpy(m, a[0].get(), sizeof(m));
+            for (int i = 0; i < nCount; i++)
+            {
+                float r[16];
+                scalar::Multiply(m, rotations[i].get(), r);
+                memcpy(m, r, sizeof(m));
+            }
+            out[nCount / 2] = Matrix4(m);
+        },
+        [&]() {
+            Matrix4 m = a[0];
+            for (int i = 0; i < nCount; i++)
+                m *= rotations[i];
+            out[nCount / 2] = m;
+        });
+    report(
+        "transform Vector4",
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+                transformed[i] = scalar::Transform(a[i & 15].get(), vectors[i]);
+        },
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+                transformed[i] = a[i & 15] * vectors[i];
+        });
+    report(
+        "Vector4 * matrix",
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+                transformed[i] = scalar::PreTransform(vectors[i], a[i & 15].get());
+        },
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+                transformed[i] = vectors[i] * a[i & 15];
+        });
+    report(
+        "transpose",
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+            {
+                out[i] = a[i];
+                scalar::Transpose(&out[i][0]);
+            }
+        },
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+                (out[i] = a[i]).transpose();
+        });
+    report(
+        "general inverse",
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+            {
+                out[i] = a[i];
+                scalar::InvertGeneral(&out[i][0]);
+            }
+        },
+        [&]() {
+            for (int i = 0; i < nCount; i++)
+                (out[i] = a[i]).invertGeneral();
+        });
+    printf("(checksum %g)\n", fSink);
+    return 0;
+}
@@ -0,0 +1,403 @@
+#include "bench.h"
+#include "GenMipMapRGBA.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+typedef unsigned char UINT8;
+
+static const MipKernel g_kernels[] = {MipKernel::Scalar, MipKernel::SSE2, MipKernel::AVX2, MipKernel::NEON};
+
+// a gradient plus noise, so every rounding case is hit
+static std::vector<UINT8> MakeImage(int nWidth, int nHeight)
+{
+    std::vector<UINT8> image((size_t)nWidth * nHeight * 4);
+    bench::Random rng;
+    for (int y = 0; y < nHeight; y++)
+    {
+        for (int x = 0; x < nWidth; x++)
+        {
+            UINT8 *p = &image[((size_t)y * nWidth + x) * 4];
+            uint32_t r = rng.Next();
+            p[0] = (UINT8)(x + (r & 7));
+            p[1] = (UINT8)(y + ((r >> 3) & 7));
+            p[2] = (UINT8)(r >> 8);
+            p[3] = (UINT8)(r >> 16);
+        }
+    }
+    return image;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: every kernel must match the scalar reference bit for bit,
+//          including odd sizes and the SIMD tail loops
+//-----------------------------------------------------------------------------
+static bool VerifyKernels()
+{
+    const int sizes[][2] = {{1, 1}, {1, 7}, {7, 1}, {2, 2}, {3, 5}, {17, 9}, {33, 31}, {130, 66}, {257, 129}};
+    for (auto &size : sizes)
+    {
+        int w = size[0], h = size[1];
+        auto src = MakeImage(w, h);
+        int dw = w / 2 > 0 ? w / 2 : 1;
+        int dh = h / 2 > 0 ? h / 2 : 1;
+        std::vector<UINT8> ref((size_t)dw * dh * 4);
+        DownsampleRGBA(src.data(), w, h, w * 4, ref.data(), dw * 4, MipKernel::Scalar);
+        for (auto kernel : g_kernels)
+        {
+            if (!IsMipKernelSupported(kernel))
+                continue;
+            std::vector<UINT8> dst(ref.size());
+            DownsampleRGBA(src.data(), w, h, w * 4, dst.data(), dw * 4, kernel);
+            if (dst != ref)
+            {
+                printf("FAIL: %s differs from scalar at %dx%d\n", GetMipKernelName(kernel), w, h);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: the same through the color tables, with fully transparent blocks
+//          so premultiplied alpha takes both of its paths
+//-----------------------------------------------------------------------------
+static bool VerifyLUTKernels()
+{
+    const int sizes[][2] = {{1, 1}, {1, 7}, {7, 1}, {2, 2}, {3, 5}, {17, 9}, {33, 31}, {130, 66}, {257, 129}};
+    for (auto &size : sizes)
+    {
+        int w = size[0], h = size[1];
+        auto src = MakeImage(w, h);
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                if (((x >> 1) + (y >> 1)) % 3 == 0)
+                {
+                    src[((size_t)y * w + x) * 4 + 3] = 0;
+                }
+            }
+        }
+        int dw = w / 2 > 0 ? w / 2 : 1;
+        int dh = h / 2 > 0 ? h / 2 : 1;
+        for (int nMode = 1; nMode < 4; nMode++)
+        {
+            MipFilterOptions options;
+            options.bSRGB = (nMode & 1) != 0;
+            options.bPremultipliedAlpha = (nMode & 2) != 0;
+            options.kernel = MipKernel::Scalar;
+            std::vector<UINT8> ref((size_t)dw * dh * 4);
+            DownsampleRGBAFiltered(src.data(), w, h, w * 4, ref.data(), dw * 4, options);
+            for (auto kernel : g_kernels)
+            {
+                if (!IsMipKernelSupported(kernel))
+                    continue;
+                options.kernel = kernel;
+                std::vector<UINT8> dst(ref.size());
+                DownsampleRGBAFiltered(src.data(), w, h, w * 4, dst.data(), dw * 4, options);
+                if (dst != ref)
+                {
+                    printf("FAIL: %s%s%s differs from scalar at %dx%d\n", GetMipKernelName(kernel),
+                           options.bSRGB ? " srgb" : "", options.bPremultipliedAlpha ? " premultiplied" : "", w, h);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: the single pass chain must match level by level downsampling
+//-----------------------------------------------------------------------------
+static bool VerifyChain()
+{
+    const int sizes[][2] = {{1, 1}, {5, 1}, {1, 6}, {64, 64}, {37, 23}, {300, 17}};
+    for (auto &size : sizes)
+    {
+        int w = size[0], h = size[1];
+        auto src = MakeImage(w, h);
+        std::vector<MipLevelLayout> levels(GetMipChainLevelCount(w, h));
+        std::vector<UINT8> arena(ComputeMipChainLayoutRGBA(w, h, levels.data()));
+        GenerateMipChainRGBA(src.data(), w * 4, arena.data(), levels.data(), (int)levels.size());
+
+        std::vector<UINT8> ref = src;
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            const MipLevelLayout &level = levels[i];
+            for (int y = 0; y < level.nHeight; y++)
+            {
+                if (memcmp(&arena[level.nOffset + y * level.nRowPitch], &ref[(size_t)y * level.nWidth * 4], level.nWidth * 4) != 0)
+                {
+                    printf("FAIL: chain level %d differs at %dx%d\n", (int)i, w, h);
+                    return false;
+                }
+            }
+            if (i + 1 < levels.size())
+            {
+                std::vector<UINT8> next((size_t)levels[i + 1].nWidth * levels[i + 1].nHeight * 4);
+                DownsampleRGBA(ref.data(), level.nWidth, level.nHeight, level.nWidth * 4, next.data(), levels[i + 1].nWidth * 4);
+                ref.swap(next);
+            }
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: banded chains must be byte identical whatever the thread count
+//-----------------------------------------------------------------------------
+static bool VerifyThreaded()
+{
+    const int sizes[][2] = {{1024, 1024}, {1000, 777}, {3, 700}, {700, 3}};
+    WorkerPool workers(4);
+    for (auto &size : sizes)
+    {
+        int w = size[0], h = size[1];
+        auto src = MakeImage(w, h);
+        std::vector<MipLevelLayout> levels(GetMipChainLevelCount(w, h));
+        size_t nArenaSize = ComputeMipChainLayoutRGBA(w, h, levels.data());
+        std::vector<UINT8> ref(nArenaSize), dst(nArenaSize);
+        GenerateMipChainRGBA(src.data(), w * 4, ref.data(), levels.data(), (int)levels.size());
+        GenerateMipChainRGBA(src.data(), w * 4, dst.data(), levels.data(), (int)levels.size(), MipFilterOptions(), &workers);
+        if (dst != ref)
+        {
+            printf("FAIL: threaded chain differs at %dx%d\n", w, h);
+            return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: flat colors must survive every filter, and windowed chains must
+//          not depend on the thread count either
+//-----------------------------------------------------------------------------
+static bool VerifyFilters()
+{
+    const MipFilter filters[] = {MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos3};
+    for (auto filter : filters)
+    {
+        for (int nSRGB = 0; nSRGB < 2; nSRGB++)
+        {
+            MipFilterOptions options;
+            options.filter = filter;
+            options.bSRGB = nSRGB != 0;
+            options.bPremultipliedAlpha = true;
+            for (int v = 0; v < 256; v++)
+            {
+                std::vector<UINT8> flat(16 * 16 * 4, (UINT8)v);
+                std::vector<UINT8> dst(8 * 8 * 4);
+                DownsampleRGBAFiltered(flat.data(), 16, 16, 16 * 4, dst.data(), 8 * 4, options);
+                for (UINT8 d : dst)
+                {
+                    if (d != v)
+                    {
+                        printf("FAIL: %s%s changes flat %d to %d\n", GetMipFilterName(filter), nSRGB ? " srgb" : "", v, d);
+                        return false;
+                    }
+                }
+            }
+
+            int w = 300, h = 211;
+            auto src = MakeImage(w, h);
+            WorkerPool workers(4);
+            std::vector<MipLevelLayout> levels(GetMipChainLevelCount(w, h));
+            size_t nArenaSize = ComputeMipChainLayoutRGBA(w, h, levels.data());
+            std::vector<UINT8> ref(nArenaSize), dst(nArenaSize);
+            GenerateMipChainRGBA(src.data(), w * 4, ref.data(), levels.data(), (int)levels.size(), options);
+            GenerateMipChainRGBA(src.data(), w * 4, dst.data(), levels.data(), (int)levels.size(), options, &workers);
+            if (dst != ref)
+            {
+                printf("FAIL: threaded %s chain differs\n", GetMipFilterName(filter));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// the original GenMipMapRGBA: float sum per channel, divided and truncated
+static void FloatBoxReference(const UINT8 *pSrc, UINT8 *pDst, int nSrcWidth, int nSrcHeight)
+{
+    int nDstWidth = nSrcWidth / 2;
+    int nDstHeight = nSrcHeight / 2;
+    for (int y = 0; y < nDstHeight; y++)
+    {
+        for (int x = 0; x < nDstWidth; x++)
+        {
+            int nSrcIndex[4];
+            nSrcIndex[0] = (((y * 2) * nSrcWidth) + (x * 2)) * 4;
+            nSrcIndex[1] = (((y * 2) * nSrcWidth) + (x * 2 + 1)) * 4;
+            nSrcIndex[2] = ((((y * 2) + 1) * nSrcWidth) + (x * 2)) * 4;
+            nSrcIndex[3] = ((((y * 2) + 1) * nSrcWidth) + (x * 2 + 1)) * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                float sum = 0.0f;
+                for (int nSample = 0; nSample < 4; nSample++)
+                {
+                    sum += pSrc[nSrcIndex[nSample] + c];
+                }
+                pDst[(y * nDstWidth + x) * 4 + c] = (UINT8)(sum / 4.0f);
+            }
+        }
+    }
+}
+
+// the pre-arena path: one new[] and one full pass per level
+static size_t LegacyMipChain(const UINT8 *pSrc, int nWidth, int nHeight)
+{
+    std::vector<UINT8 *> levels;
+    UINT8 *pBase = new UINT8[(size_t)nWidth * nHeight * 4];
+    memcpy(pBase, pSrc, (size_t)nWidth * nHeight * 4);
+    levels.push_back(pBase);
+    size_t nBytes = (size_t)nWidth * nHeight * 4;
+    while (nWidth > 1 || nHeight > 1)
+    {
+        UINT8 *pNew;
+        GenMipMapRGBA(levels.back(), &pNew, nWidth, nHeight, &nWidth, &nHeight);
+        levels.push_back(pNew);
+        nBytes += (size_t)nWidth * nHeight * 4;
+    }
+    for (UINT8 *p : levels)
+    {
+        delete[] p;
+    }
+    return nBytes;
+}
+
+int main(int argc, char *argv[])
+{
+    int nMaxSize = argc > 1 ? atoi(argv[1]) : 8192;
+
+    if (!VerifyKernels() || !VerifyLUTKernels() || !VerifyChain() || !VerifyThreaded() || !VerifyFilters())
+    {
+        return 1;
+    }
+    printf("best kernel: %s\n", GetMipKernelName(GetBestMipKernel()));
+
+    printf("%-6s %-8s %10s %12s\n", "size", "kernel", "ms", "Mpixel/s");
+    for (int nSize = 256; nSize <= nMaxSize; nSize *= 2)
+    {
+        auto src = MakeImage(nSize, nSize);
+        std::vector<UINT8> dst((size_t)nSize * nSize);
+        int nIterations = bench::IterationsFor(src.size());
+        for (auto kernel : g_kernels)
+        {
+            if (!IsMipKernelSupported(kernel))
+                continue;
+            double sec = bench::MeasureBest(nIterations, [&]() {
+                DownsampleRGBA(src.data(), nSize, nSize, nSize * 4, dst.data(), nSize * 2, kernel);
+            });
+            // throughput in source pixels
+            double mpix = (double)nSize * nSize / sec / 1e6;
+            printf("%-6d %-8s %10.3f %12.1f\n", nSize, GetMipKernelName(kernel), sec * 1000.0, mpix);
+        }
+    }
+
+    // filter modes against the integer box and the original float box. The
+    // table driven box filters must stay within 2x of the float box they replace,
+    // which only the AVX2 gathers do: elsewhere they run the scalar loop.
+    const bool bBudgeted = GetBestMipKernel() == MipKernel::AVX2;
+    struct FilterMode
+    {
+        const char *name;
+        MipFilter filter;
+        bool bSRGB;
+        bool bPremultiplied;
+    };
+    const FilterMode modes[] = {
+        {"box", MipFilter::Box, false, false},
+        {"box-srgb", MipFilter::Box, true, false},
+        {"box-srgb-pm", MipFilter::Box, true, true},
+        {"kaiser-srgb", MipFilter::Kaiser, true, true},
+        {"lanczos3-srgb", MipFilter::Lanczos3, true, true},
+    };
+    printf("\n%-6s %-14s %10s %12s %10s %10s\n", "size", "filter", "ms", "Mpixel/s", "x box", "x float");
+    if (!bBudgeted)
+    {
+        printf("no avx2, the 2x budget is not checked\n");
+    }
+    for (int nSize = 256; nSize <= std::min(nMaxSize, 4096); nSize *= 4)
+    {
+        auto src = MakeImage(nSize, nSize);
+        std::vector<UINT8> dst((size_t)nSize * nSize);
+        int nIterations = bench::IterationsFor(src.size());
+        double floatBox = bench::MeasureBest(nIterations, [&]() {
+            FloatBoxReference(src.data(), dst.data(), nSize, nSize);
+        });
+        double box = 0.0;
+        for (auto &mode : modes)
+        {
+            MipFilterOptions options;
+            options.filter = mode.filter;
+            options.bSRGB = mode.bSRGB;
+            options.bPremultipliedAlpha = mode.bPremultiplied;
+            double sec = bench::MeasureBest(nIterations, [&]() {
+                DownsampleRGBAFiltered(src.data(), nSize, nSize, nSize * 4, dst.data(), nSize * 2, options);
+            });
+            if (box == 0.0)
+            {
+                box = sec;
+            }
+            printf("%-6d %-14s %10.3f %12.1f %10.2f %10.2f\n", nSize, mode.name, sec * 1000.0,
+                   (double)nSize * nSize / sec / 1e6, sec / box, sec / floatBox);
+            if (bBudgeted && mode.filter == MipFilter::Box && sec > 2.0 * floatBox)
+            {
+                printf("FAIL: %s costs %.2fx the float box at %d, over the 2x budget\n", mode.name, sec / floatBox, nSize);
+                return 1;
+            }
+        }
+    }
+
+    // full chains: per level allocations vs one arena
+    printf("\n%-6s %-8s %10s %12s %10s\n", "size", "chain", "ms", "Mpixel/s", "MB");
+    for (int nSize = 256; nSize <= nMaxSize; nSize *= 2)
+    {
+        auto src = MakeImage(nSize, nSize);
+        int nIterations = bench::IterationsFor(src.size());
+
+        size_t nLegacyBytes = 0;
+        double legacy = bench::MeasureBest(nIterations, [&]() {
+            nLegacyBytes = LegacyMipChain(src.data(), nSize, nSize);
+        });
+
+        std::vector<MipLevelLayout> levels(GetMipChainLevelCount(nSize, nSize));
+        std::vector<UINT8> arena(ComputeMipChainLayoutRGBA(nSize, nSize, levels.data()));
+        double single = bench::MeasureBest(nIterations, [&]() {
+            GenerateMipChainRGBA(src.data(), nSize * 4, arena.data(), levels.data(), (int)levels.size());
+        });
+
+        double mpix = (double)nSize * nSize / 1e6;
+        printf("%-6d %-8s %10.3f %12.1f %10.1f\n", nSize, "legacy", legacy * 1000.0, mpix / legacy, nLegacyBytes / 1048576.0);
+        printf("%-6d %-8s %10.3f %12.1f %10.1f\n", nSize, "arena", single * 1000.0, mpix / single, arena.size() / 1048576.0);
+    }
+
+    // thread scaling of the banded chain
+    printf("\n%-6s %-8s %10s %12s %8s\n", "size", "threads", "ms", "Mpixel/s", "speedup");
+    for (int nSize = 1024; nSize <= nMaxSize; nSize *= 2)
+    {
+        auto src = MakeImage(nSize, nSize);
+        int nIterations = bench::IterationsFor(src.size());
+        std::vector<MipLevelLayout> levels(GetMipChainLevelCount(nSize, nSize));
+        std::vector<UINT8> arena(ComputeMipChainLayoutRGBA(nSize, nSize, levels.data()));
+        double base = 0.0;
+        for (int nThreads : {1, 2, 4, 8})
+        {
+            WorkerPool workers(nThreads);
+            double sec = bench::MeasureBest(nIterations, [&]() {
+                GenerateMipChainRGBA(src.data(), nSize * 4, arena.data(), levels.data(), (int)levels.size(), MipFilterOptions(), &workers);
+            });
+            if (nThreads == 1)
+            {
+                base = sec;
+            }
+            printf("%-6d %-8d %10.3f %12.1f %8.2f\n", nSize, nThreads, sec * 1000.0, (double)nSize * nSize / sec / 1e6, base / sec);
+        }
+    }
+    return 0;
+}
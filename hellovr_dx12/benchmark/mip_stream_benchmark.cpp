@@ -0,0 +1,307 @@
+#include "MipStreaming.h"
+#include "GenMipMapRGBA.h"
+#include "bench.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// Stands in for the D3D12 command list, keeps every call in order
+struct RecordingCommands : public IMipStreamCommands
+{
+    struct Call
+    {
+        bool bCopy; // CopyMip, otherwise SetMostDetailedMip
+        int nTexture;
+        int nMip;
+    };
+    std::vector<Call> calls;
+
+    void CopyMip(int nTexture, int nMip) override { calls.push_back({true, nTexture, nMip}); }
+    void SetMostDetailedMip(int nTexture, int nMip) override { calls.push_back({false, nTexture, nMip}); }
+};
+
+// upload bytes of every level of an RGBA8 chain, row pitch included
+struct StreamedTexture
+{
+    int nWidth;
+    int nHeight;
+    std::vector<size_t> levelBytes;
+    int nTailMip;
+};
+
+static StreamedTexture MakeTexture(int nWidth, int nHeight)
+{
+    StreamedTexture texture = {};
+    texture.nWidth = nWidth;
+    texture.nHeight = nHeight;
+    std::vector<MipLevelLayout> levels(GetMipChainLevelCount(nWidth, nHeight));
+    ComputeMipChainLayoutRGBA(nWidth, nHeight, &levels[0]);
+    for (auto &level : levels)
+    {
+        texture.levelBytes.push_back(level.nRowPitch * level.nHeight);
+    }
+    texture.nTailMip = GetMipStreamTailLevel(nWidth, nHeight, (int)levels.size());
+    return texture;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: replay one frame of recorded calls against the scheduler's rules.
+//          Copies come first and continue each texture's resident range one
+//          level finer; the clamp follows once per texture that moved; budget
+//          levels fit the budget unless a single one exceeds it on its own.
+//-----------------------------------------------------------------------------
+static bool CheckFrame(const RecordingCommands &frame, const std::vector<StreamedTexture> &textures,
+                       std::vector<int> &resident, size_t nBudget, size_t nSpent)
+{
+    std::vector<int> before = resident;
+    size_t nBudgetBytes = 0;
+    int nBudgetLevels = 0;
+    bool bClamps = false;
+    for (auto &call : frame.calls)
+    {
+        const StreamedTexture &texture = textures[call.nTexture];
+        if (call.bCopy)
+        {
+            if (bClamps || call.nMip != resident[call.nTexture] - 1)
+            {
+                printf("FAIL: texture %d copied mip %d with %d resident\n", call.nTexture, call.nMip, resident[call.nTexture]);
+                return false;
+            }
+            resident[call.nTexture] = call.nMip;
+            if (call.nMip < texture.nTailMip)
+            {
+                nBudgetBytes += texture.levelBytes[call.nMip];
+                nBudgetLevels++;
+            }
+        }
+        else
+        {
+            bClamps = true;
+            if (call.nMip != resident[call.nTexture] || before[call.nTexture] == resident[call.nTexture])
+            {
+                printf("FAIL: texture %d clamp %d with %d resident\n", call.nTexture, call.nMip, resident[call.nTexture]);
+                return false;
+            }
+            before[call.nTexture] = -1;
+        }
+    }
+    for (size_t i = 0; i < resident.size(); i++)
+    {
+        if (before[i] != -1 && before[i] != resident[i])
+        {
+            printf("FAIL: texture %d moved without a clamp\n", (int)i);
+            return false;
+        }
+    }
+    if (nBudgetBytes != nSpent || (nBudgetBytes > nBudget && nBudgetLevels > 1) || (nBudget == 0 && nBudgetLevels > 0))
+    {
+        printf("FAIL: spent %zu (reported %zu) over %d levels against budget %zu\n", nBudgetBytes, nSpent, nBudgetLevels, nBudget);
+        return false;
+    }
+    return true;
+}
+
+// Tails before the first frame, then frames until everything is resident; -1 on a failed check
+static int StreamAll(MipStreamScheduler &scheduler, const std::vector<StreamedTexture> &textures,
+                     std::vector<int> &resident, size_t nBudget, size_t *pInitBytes)
+{
+    RecordingCommands init;
+    scheduler.Update(init, 0);
+    *pInitBytes = 0;
+    for (auto &call : init.calls)
+    {
+        if (call.bCopy)
+            *pInitBytes += textures[call.nTexture].levelBytes[call.nMip];
+    }
+    if (!CheckFrame(init, textures, resident, 0, 0))
+        return -1;
+
+    int nFrames = 0;
+    while (!scheduler.IsComplete())
+    {
+        RecordingCommands frame;
+        size_t nSpent = scheduler.Update(frame, nBudget);
+        if (frame.calls.empty() || !CheckFrame(frame, textures, resident, nBudget, nSpent))
+        {
+            if (frame.calls.empty())
+                printf("FAIL: no progress with levels pending\n");
+            return -1;
+        }
+        nFrames++;
+    }
+    return nFrames;
+}
+
+static bool Verify()
+{
+    // Mixed sizes, all data ready up front
+    {
+        const int sizes[][2] = {{4096, 4096}, {1024, 256}, {64, 64}, {8, 2048}, {1, 1}, {300, 200}};
+        std::vector<StreamedTexture> textures;
+        MipStreamScheduler scheduler;
+        for (auto &size : sizes)
+        {
+            textures.push_back(MakeTexture(size[0], size[1]));
+            const StreamedTexture &texture = textures.back();
+            int nTexture = scheduler.AddTexture(&texture.levelBytes[0], (int)texture.levelBytes.size(), texture.nTailMip);
+            scheduler.SetLevelsReady(nTexture, 0);
+        }
+        std::vector<int> resident;
+        for (auto &texture : textures)
+        {
+            resident.push_back((int)texture.levelBytes.size());
+        }
+        size_t nInitBytes;
+        if (StreamAll(scheduler, textures, resident, 256 * 1024, &nInitBytes) < 0)
+            return false;
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            if (resident[i] != 0 || scheduler.MostDetailedMip((int)i) != 0)
+            {
+                printf("FAIL: texture %d incomplete\n", (int)i);
+                return false;
+            }
+        }
+    }
+
+    // Nothing moves before the data is ready, and a removed texture stops streaming
+    {
+        StreamedTexture texture = MakeTexture(2048, 2048);
+        const int nMipLevels = (int)texture.levelBytes.size();
+        MipStreamScheduler scheduler;
+        int nFirst = scheduler.AddTexture(&texture.levelBytes[0], nMipLevels, texture.nTailMip);
+        int nSecond = scheduler.AddTexture(&texture.levelBytes[0], nMipLevels, texture.nTailMip);
+
+        RecordingCommands frame;
+        scheduler.Update(frame, 1 << 30);
+        if (!frame.calls.empty() || scheduler.MostDetailedMip(nFirst) != nMipLevels)
+        {
+            printf("FAIL: streamed before ready\n");
+            return false;
+        }
+
+        // only part of the chain decoded so far
+        scheduler.SetLevelsReady(nFirst, 4);
+        scheduler.Update(frame, 1 << 30);
+        if (scheduler.MostDetailedMip(nFirst) != 4 || scheduler.MostDetailedMip(nSecond) != nMipLevels)
+        {
+            printf("FAIL: partial readiness, resident %d\n", scheduler.MostDetailedMip(nFirst));
+            return false;
+        }
+
+        scheduler.SetLevelsReady(nSecond, 0);
+        scheduler.RemoveTexture(nFirst);
+        scheduler.SetLevelsReady(nFirst, 0);
+        RecordingCommands after;
+        scheduler.Update(after, 1 << 30);
+        for (auto &call : after.calls)
+        {
+            if (call.nTexture == nFirst)
+            {
+                printf("FAIL: removed texture still streams\n");
+                return false;
+            }
+        }
+        if (!scheduler.IsComplete())
+        {
+            printf("FAIL: unlimited budget left levels pending\n");
+            return false;
+        }
+    }
+
+    // Readiness from another thread while the render thread keeps updating
+    {
+        std::vector<StreamedTexture> textures(8, MakeTexture(1024, 1024));
+        MipStreamScheduler scheduler;
+        for (auto &texture : textures)
+        {
+            scheduler.AddTexture(&texture.levelBytes[0], (int)texture.levelBytes.size(), texture.nTailMip);
+        }
+        std::thread decoder([&]() {
+            for (int i = 0; i < (int)textures.size(); i++)
+            {
+                scheduler.SetLevelsReady(i, 0);
+                std::this_thread::yield();
+            }
+        });
+        int nFrames = 0;
+        while (!scheduler.IsComplete() && nFrames < 100000)
+        {
+            RecordingCommands frame;
+            scheduler.Update(frame, 512 * 1024);
+            nFrames++;
+        }
+        decoder.join();
+        if (!scheduler.IsComplete())
+        {
+            printf("FAIL: threaded readiness never completed\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int nMaxSize = argc > 1 ? atoi(argv[1]) : 8192;
+
+    if (!Verify())
+        return 1;
+
+    // Bytes before the first frame must not grow with the texture, frames to full detail will
+    const size_t budgets[] = {256 * 1024, 1024 * 1024, 4096 * 1024};
+    printf("%-10s %12s %12s", "size", "chain KB", "init KB");
+    for (size_t nBudget : budgets)
+    {
+        printf(" %9zuKB/f", nBudget / 1024);
+    }
+    printf("\n");
+    for (int nSize = 256; nSize <= nMaxSize; nSize *= 2)
+    {
+        std::vector<StreamedTexture> textures(1, MakeTexture(nSize, nSize));
+        size_t nChain = 0;
+        for (size_t nBytes : textures[0].levelBytes)
+        {
+            nChain += nBytes;
+        }
+        size_t nInitBytes = 0;
+        printf("%-10d %12zu", nSize, nChain / 1024);
+        for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++)
+        {
+            MipStreamScheduler scheduler;
+            scheduler.AddTexture(&textures[0].levelBytes[0], (int)textures[0].levelBytes.size(), textures[0].nTailMip);
+            scheduler.SetLevelsReady(0, 0);
+            std::vector<int> resident(1, (int)textures[0].levelBytes.size());
+            int nFrames = StreamAll(scheduler, textures, resident, budgets[b], &nInitBytes);
+            if (nFrames < 0)
+                return 1;
+            if (b == 0)
+                printf(" %12zu", nInitBytes / 1024);
+            printf(" %13d", nFrames);
+        }
+        printf("\n");
+    }
+
+    // Scheduler cost per frame with many textures in flight
+    const int nTextures = 256;
+    std::vector<StreamedTexture> textures(nTextures, MakeTexture(2048, 2048));
+    RecordingCommands commands;
+    double sec = bench::MeasureBest(5, [&]() {
+        MipStreamScheduler scheduler;
+        for (auto &texture : textures)
+        {
+            int nTexture = scheduler.AddTexture(&texture.levelBytes[0], (int)texture.levelBytes.size(), texture.nTailMip);
+            scheduler.SetLevelsReady(nTexture, 0);
+        }
+        commands.calls.clear();
+        scheduler.Update(commands, 0);
+        for (int i = 0; i < 64; i++)
+        {
+            commands.calls.clear();
+            scheduler.Update(commands, 1024 * 1024);
+        }
+    });
+    printf("\n%d textures: %.2f us per Update\n", nTextures, sec * 1e6 / 65);
+    return 0;
+}
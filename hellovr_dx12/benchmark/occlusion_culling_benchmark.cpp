@@ -0,0 +1,336 @@
+#include "OcclusionCulling.h"
+#include "RigidTransform.h"
+#include "WorkerPool.h"
+#include "bench.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const float k_fNearClip = 0.1f;
+static const float k_fFarClip = 30.0f;
+// half the distance between the eyes, metres
+static const float k_fHalfIPD = 0.032f;
+
+//-----------------------------------------------------------------------------
+// Purpose: what IVRSystem::GetProjectionMatrix builds from the raw tangents,
+//          as HMD turns it into a Matrix4
+//-----------------------------------------------------------------------------
+static Matrix4 Projection(float fLeft, float fRight, float fTop, float fBottom)
+{
+    float idx = 1.0f / (fRight - fLeft);
+    float idy = 1.0f / (fBottom - fTop);
+    float idz = 1.0f / (k_fFarClip - k_fNearClip);
+    float m[4][4] = {
+        {2 * idx, 0, (fRight + fLeft) * idx, 0},
+        {0, 2 * idy, (fBottom + fTop) * idy, 0},
+        {0, 0, -k_fFarClip * idz, -k_fFarClip * k_fNearClip * idz},
+        {0, 0, -1.0f, 0},
+    };
+    return Matrix4(m[0][0], m[1][0], m[2][0], m[3][0], m[0][1], m[1][1], m[2][1], m[3][1],
+                   m[0][2], m[1][2], m[2][2], m[3][2], m[0][3], m[1][3], m[2][3], m[3][3]);
+}
+
+struct StereoView
+{
+    Matrix4 matEyes[2];
+};
+
+static StereoView RandomView(bench::Random &random, float fExtent)
+{
+    Vector3 position(random.NextFloat(-fExtent, fExtent), random.NextFloat(-fExtent, fExtent), random.NextFloat(-fExtent, fExtent));
+    Quaternion orientation = Quaternion::FromAxisAngle(Vector3(0, 1, 0), random.NextFloat(-3.14159f, 3.14159f)) *
+                             Quaternion::FromAxisAngle(Vector3(1, 0, 0), random.NextFloat(-1.2f, 1.2f));
+    RigidTransform head = RigidTransform(orientation, position).Inverse();
+    RigidTransform leftEye = RigidTransform(Quaternion(), Vector3(-k_fHalfIPD, 0, 0)).Inverse();
+    RigidTransform rightEye = RigidTransform(Quaternion(), Vector3(k_fHalfIPD, 0, 0)).Inverse();
+    StereoView view;
+    view.matEyes[0] = Projection(-1.39f, 1.24f, -1.47f, 1.47f) * (leftEye * head).ToMatrix4();
+    view.matEyes[1] = Projection(-1.24f, 1.39f, -1.47f, 1.47f) * (rightEye * head).ToMatrix4();
+    return view;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: every face of every cube in doubles, one pixel centre at a time,
+//          keeping the nearest depth and the chunk it came from
+//-----------------------------------------------------------------------------
+struct ReferenceBuffer
+{
+    static const int W = OcclusionBuffer::k_nWidth, H = OcclusionBuffer::k_nHeight;
+    std::vector<double> depth = std::vector<double>(W * H, DBL_MAX);
+    std::vector<int> owner = std::vector<int>(W * H, -1);
+
+    void DrawCube(const Matrix4 &mat, const Vector3 &corner, float fSize, int nOwner)
+    {
+        static const int s_faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 4, 6, 2}, {1, 3, 7, 5}, {0, 1, 5, 4}, {2, 6, 7, 3}};
+        double sx[8], sy[8], sz[8];
+        for (int nCorner = 0; nCorner < 8; nCorner++)
+        {
+            double p[4] = {corner.x + ((nCorner & 1) ? fSize : 0), corner.y + ((nCorner & 2) ? fSize : 0), corner.z + ((nCorner & 4) ? fSize : 0), 1};
+            double clip[4] = {0, 0, 0, 0};
+            for (int r = 0; r < 4; r++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    clip[r] += (double)mat[4 * c + r] * p[c];
+                }
+            }
+            // clipped by the near plane, the occluders leave these out too
+            if (clip[2] < 0 || clip[3] <= 0)
+                return;
+            sx[nCorner] = (clip[0] / clip[3] * 0.5 + 0.5) * W;
+            sy[nCorner] = (0.5 - clip[1] / clip[3] * 0.5) * H;
+            sz[nCorner] = clip[2] / clip[3];
+        }
+        for (const auto &face : s_faces)
+        {
+            // both windings, the nearest wins
+            double x[4], y[4], z[4];
+            for (int i = 0; i < 4; i++)
+            {
+                x[i] = sx[face[i]];
+                y[i] = sy[face[i]];
+                z[i] = sz[face[i]];
+            }
+            double fArea = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                fArea += x[i] * y[(i + 1) & 3] - x[(i + 1) & 3] * y[i];
+            }
+            if (fArea == 0)
+                continue;
+            double fDet = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            double fDzDx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / fDet;
+            double fDzDy = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / fDet;
+            double fMinX = fmin(fmin(x[0], x[1]), fmin(x[2], x[3])), fMaxX = fmax(fmax(x[0], x[1]), fmax(x[2], x[3]));
+            double fMinY = fmin(fmin(y[0], y[1]), fmin(y[2], y[3])), fMaxY = fmax(fmax(y[0], y[1]), fmax(y[2], y[3]));
+            int nX0 = (int)fmax(0, floor(fMinX) - 1), nX1 = (int)fmin(W - 1, ceil(fMaxX) + 1);
+            int nY0 = (int)fmax(0, floor(fMinY) - 1), nY1 = (int)fmin(H - 1, ceil(fMaxY) + 1);
+            for (int py = nY0; py <= nY1; py++)
+            {
+                for (int px = nX0; px <= nX1; px++)
+                {
+                    double fX = px + 0.5, fY = py + 0.5;
+                    bool bInside = true;
+                    for (int i = 0; i < 4 && bInside; i++)
+                    {
+                        double e = (y[(i + 1) & 3] - y[i]) * (fX - x[i]) + (x[i] - x[(i + 1) & 3]) * (fY - y[i]);
+                        bInside = fArea < 0 ? e >= 0 : e <= 0;
+                    }
+                    double fZ = z[0] + fDzDx * (fX - x[0]) + fDzDy * (fY - y[0]);
+                    if (bInside && fZ < depth[py * W + px])
+                    {
+                        depth[py * W + px] = fZ;
+                        owner[py * W + px] = nOwner;
+                    }
+                }
+            }
+        }
+    }
+};
+
+static int CountInstances(const std::vector<CubeChunkTree::DrawRange> &draws)
+{
+    int nCount = 0;
+    for (const CubeChunkTree::DrawRange &draw : draws)
+    {
+        nCount += draw.nInstanceCount;
+    }
+    return nCount;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: the occluder buffers match a reference rasterizer; no chunk is
+//          culled that owns a pixel once everything in view is drawn; and the
+//          walk down the tree culls exactly what testing every chunk would
+//-----------------------------------------------------------------------------
+static bool Verify(WorkerPool &workers)
+{
+    bench::Random random(24);
+    int nViews = 0, nOccludedViews = 0;
+    size_t nCovered = 0, nNearer = 0;
+    // the spacing of the app's volume, then ever denser
+    struct Case
+    {
+        int nSize;
+        float fSpacing;
+    };
+    for (Case test : {Case{9, 4.0f}, Case{16, 1.5f}, Case{24, 1.25f}, Case{24, 1.0f}})
+    {
+        const int nSize = test.nSize;
+        CubeVolume volume(nSize, nSize, nSize, 0.3f, test.fSpacing);
+        CubeChunkTree tree(volume);
+        const std::vector<CubeChunkTree::Node> &chunks = tree.Level(0);
+        std::vector<float> translations(CubeVolume::k_nFloatsPerInstance * 512);
+        StereoOcclusion occlusion;
+        std::vector<uint32_t> visible;
+        std::vector<CubeChunkTree::DrawRange> draws;
+        for (int nView = 0; nView < 12; nView++, nViews++)
+        {
+            StereoView view = RandomView(random, volume.Scale() * test.fSpacing * nSize * 0.5f);
+            Frustum frustum = Frustum::Enclosing(view.matEyes[0], view.matEyes[1]);
+            occlusion.Render(tree, frustum, view.matEyes[0], view.matEyes[1], nView & 1 ? &workers : nullptr);
+
+            // everything in view, in both eyes
+            tree.VisibleChunks(frustum, visible);
+            std::vector<bool> occluder(chunks.size(), false);
+            for (uint32_t nChunk : visible)
+            {
+                occluder[nChunk] = true;
+            }
+            for (int nEye = 0; nEye < 2; nEye++)
+            {
+                ReferenceBuffer occluders, scene;
+                for (uint32_t nChunk : visible)
+                {
+                    tree.ChunkTranslations(nChunk, translations.data());
+                    for (uint32_t i = 0; i < chunks[nChunk].nInstanceCount; i++)
+                    {
+                        Vector3 corner(translations[3 * i], translations[3 * i + 1], translations[3 * i + 2]);
+                        scene.DrawCube(view.matEyes[nEye], corner, volume.Scale(), (int)nChunk);
+                    }
+                }
+                // the buffer never holds anything nearer than the real occluders
+                const OcclusionBuffer &buffer = occlusion.Eye(nEye);
+                for (int y = 0; y < ReferenceBuffer::H; y++)
+                {
+                    for (int x = 0; x < ReferenceBuffer::W; x++)
+                    {
+                        float fDepth = buffer.Depth(x, y);
+                        if (fDepth == FLT_MAX)
+                            continue;
+                        nCovered++;
+                        // everything drawn is in view, so the scene is at least as near
+                        if (fDepth + 1e-5 < scene.depth[y * ReferenceBuffer::W + x] - 1e-6)
+                        {
+                            nNearer++;
+                        }
+                    }
+                }
+                for (uint32_t nChunk : visible)
+                {
+                    if (!occlusion.Eye(nEye).IsOccluded(chunks[nChunk].bounds))
+                        continue;
+                    for (int nOwner : scene.owner)
+                    {
+                        if (nOwner == (int)nChunk)
+                        {
+                            printf("FAIL: chunk %u is culled in eye %d but owns a pixel\n", nChunk, nEye);
+                            return false;
+                        }
+                    }
+                }
+            }
+
+            // the tree against each chunk on its own
+            CubeChunkTree::Stats stats;
+            tree.Cull(frustum, draws, stats, &occlusion);
+            std::vector<bool> drawn(volume.CubeCount(), false);
+            for (const CubeChunkTree::DrawRange &draw : draws)
+            {
+                for (uint32_t i = 0; i < draw.nInstanceCount; i++)
+                {
+                    drawn[draw.nFirstInstance + i] = true;
+                }
+            }
+            for (uint32_t nChunk = 0; nChunk < chunks.size(); nChunk++)
+            {
+                const CubeChunkTree::Node &chunk = chunks[nChunk];
+                bool bExpected = occluder[nChunk] && !occlusion.IsOccluded(chunk.bounds);
+                for (uint32_t i = 0; i < chunk.nInstanceCount; i++)
+                {
+                    if (drawn[chunk.nFirstInstance + i] != bExpected)
+                    {
+                        printf("FAIL: the tree %s chunk %u, testing it on its own does not\n", bExpected ? "culls" : "draws", nChunk);
+                        return false;
+                    }
+                }
+            }
+            uint32_t nInView = 0;
+            for (uint32_t nChunk : visible)
+            {
+                nInView += chunks[nChunk].nInstanceCount;
+            }
+            if ((uint32_t)CountInstances(draws) != stats.nCubesVisible || stats.nCubesVisible + stats.nCubesOccluded != nInView)
+            {
+                printf("FAIL: stats do not add up\n");
+                return false;
+            }
+            nOccludedViews += stats.nChunksOccluded > 0;
+        }
+    }
+    // pixel centres within rounding of an edge may go either way
+    if (nNearer * 1000 > nCovered)
+    {
+        printf("FAIL: %zu of %zu occluder pixels are nearer than the scene\n", nNearer, nCovered);
+        return false;
+    }
+    printf("nothing visible culled in %d views (%d with chunks occluded), the tree culls as each chunk would, %zu of %zu occluder pixels within rounding of an edge\n\n",
+           nViews, nOccludedViews, nNearer, nCovered);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const int nMaxSize = argc > 1 ? atoi(argv[1]) : 256;
+    WorkerPool workers(argc > 2 ? atoi(argv[2]) : 0);
+    if (!Verify(workers))
+        return 1;
+
+    printf("%d worker threads, %d occluder chunks, %dx%d per eye\n", workers.ThreadCount(), StereoOcclusion::k_nOccluderChunks,
+           OcclusionBuffer::k_nWidth, OcclusionBuffer::k_nHeight);
+    printf("%-14s %10s %10s %10s %8s %8s %10s %10s %10s %10s\n", "volume, spacing", "in view", "occluded", "drawn", "draws", "draws", "render ms",
+           "workers ms", "test ms", "frustum ms");
+    printf("%-14s %10s %10s %10s %8s %8s\n", "", "cubes", "of those", "cubes", "frustum", "occl.");
+    // the app's spacing, then cubes a fifth of their size apart
+    for (float fSpacing : {4.0f, 1.2f})
+    {
+        for (int nSize : {32, 64, 128, 256})
+        {
+            if (nSize > nMaxSize)
+                break;
+            CubeVolume volume(nSize, nSize, nSize, 0.3f, fSpacing);
+            CubeChunkTree tree(volume);
+
+            // standing inside the volume looking about
+            bench::Random random(7);
+            const int nViews = 64;
+            std::vector<StereoView> views;
+            std::vector<Frustum> frustums;
+            for (int i = 0; i < nViews; i++)
+            {
+                views.push_back(RandomView(random, volume.Scale() * fSpacing * nSize * 0.25f));
+                frustums.push_back(Frustum::Enclosing(views.back().matEyes[0], views.back().matEyes[1]));
+            }
+
+            StereoOcclusion occlusion;
+            std::vector<CubeChunkTree::DrawRange> draws;
+            CubeChunkTree::Stats stats;
+            double fFrustum = bench::MeasureBest(3, [&]() {
+                for (const Frustum &frustum : frustums)
+                {
+                    tree.Cull(frustum, draws, stats);
+                }
+            });
+            double fRender = 0, fWorkers = 0, fTest = 0;
+            double fInView = 0, fOccluded = 0, fDrawn = 0, fFrustumDraws = 0, fDraws = 0;
+            for (int i = 0; i < nViews; i++)
+            {
+                tree.Cull(frustums[i], draws, stats);
+                fFrustumDraws += stats.nDraws;
+                fRender += bench::MeasureBest(3, [&]() { occlusion.Render(tree, frustums[i], views[i].matEyes[0], views[i].matEyes[1]); });
+                fWorkers += bench::MeasureBest(3, [&]() { occlusion.Render(tree, frustums[i], views[i].matEyes[0], views[i].matEyes[1], &workers); });
+                fTest += bench::MeasureBest(3, [&]() { tree.Cull(frustums[i], draws, stats, &occlusion); });
+                fInView += stats.nCubesVisible + stats.nCubesOccluded;
+                fOccluded += stats.nCubesOccluded;
+                fDrawn += stats.nCubesVisible;
+                fDraws += stats.nDraws;
+            }
+            printf("%4d^3 sp %-4g%9.1f%% %9.1f%% %9.1f%% %8.0f %8.0f %10.3f %10.3f %10.3f %10.3f\n", nSize, fSpacing, 100.0 * fInView / nViews / volume.CubeCount(),
+                   100.0 * fOccluded / fInView, 100.0 * fDrawn / nViews / volume.CubeCount(), fFrustumDraws / nViews, fDraws / nViews, fRender * 1e3 / nViews,
+                   fWorkers * 1e3 / nViews, fTest * 1e3 / nViews, fFrustum * 1e3 / nViews);
+        }
+    }
+    return 0;
+}
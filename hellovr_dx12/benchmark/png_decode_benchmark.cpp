@@ -0,0 +1,164 @@
+#include "bench_png.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+typedef unsigned char UINT8;
+
+static const char *g_filterNames[] = {"None", "Sub", "Up", "Average", "Paeth"};
+
+//-----------------------------------------------------------------------------
+// Purpose: encode with every scanline using nFilter (-1 cycles through all
+//          five). bStored skips deflate so decoding is mostly unfiltering.
+//-----------------------------------------------------------------------------
+static std::vector<UINT8> EncodeFiltered(const std::vector<UINT8> &image, int nWidth, int nHeight, LodePNGColorType colorType,
+                                         unsigned nBitDepth, int nFilter, bool bStored, bool bInterlace = false)
+{
+    std::vector<UINT8> filters(nHeight * 2 + 8);
+    for (size_t y = 0; y < filters.size(); y++)
+    {
+        filters[y] = (UINT8)(nFilter < 0 ? y % 5 : nFilter);
+    }
+    return bench::Encode(image, nWidth, nHeight, colorType, nBitDepth, bStored ? 0 : 2, bInterlace, &filters[0]);
+}
+
+// Replays scanlines inflated once before, so the decode is left with little but the unfilter
+static unsigned ReplayZlib(unsigned char **ppOut, size_t *pOutSize, const unsigned char *pIn, size_t nInSize,
+                           const LodePNGDecompressSettings *pSettings)
+{
+    std::vector<UINT8> &inflated = *(std::vector<UINT8> *)pSettings->custom_context;
+    if (inflated.empty())
+    {
+        LodePNGDecompressSettings settings;
+        lodepng_decompress_settings_init(&settings);
+        unsigned char *pData = nullptr;
+        size_t nSize = 0;
+        unsigned nError = lodepng_zlib_decompress(&pData, &nSize, pIn, nInSize, &settings);
+        if (nError != 0)
+            return nError;
+        inflated.assign(pData, pData + nSize);
+        free(pData);
+    }
+    // lodepng passes in the buffer it reserved for the scanlines
+    *ppOut = (unsigned char *)realloc(*ppOut, inflated.size());
+    memcpy(*ppOut, &inflated[0], inflated.size());
+    *pOutSize = inflated.size();
+    return 0;
+}
+
+static unsigned Decode(const std::vector<UINT8> &png, LodePNGColorType colorType, unsigned nBitDepth, bool bSIMD,
+                       std::vector<UINT8> &image, std::vector<UINT8> *pInflated = nullptr)
+{
+    lodepng::State state;
+    state.info_raw.colortype = colorType;
+    state.info_raw.bitdepth = nBitDepth;
+    state.decoder.simd_unfilter = bSIMD ? 1 : 0;
+    if (pInflated)
+    {
+        state.decoder.ignore_crc = 1;
+        state.decoder.zlibsettings.custom_zlib = ReplayZlib;
+        state.decoder.zlibsettings.custom_context = pInflated;
+    }
+    unsigned nWidth, nHeight;
+    image.clear();
+    return lodepng::decode(image, nWidth, nHeight, state, png);
+}
+
+// The vectorized unfilter must reproduce the scalar output and the source image exactly
+static bool Verify()
+{
+    struct Format
+    {
+        LodePNGColorType colorType;
+        unsigned nBitDepth;
+        int nChannels; // bytes per pixel of the raw image
+    };
+    const Format formats[] = {
+        {LCT_RGBA, 8, 4}, {LCT_RGB, 8, 3}, {LCT_GREY_ALPHA, 8, 2}, {LCT_GREY, 8, 1}, {LCT_RGBA, 16, 8}, {LCT_RGB, 16, 6},
+    };
+    const int widths[] = {1, 2, 3, 5, 15, 16, 17, 33, 257};
+    int nCases = 0;
+    for (const Format &format : formats)
+    {
+        for (int nWidth : widths)
+        {
+            for (int nFilter = -1; nFilter < 5; nFilter++)
+            {
+                for (int nVariant = 0; nVariant < 4; nVariant++)
+                {
+                    const bool bNoise = (nVariant & 1) != 0;
+                    const bool bInterlace = (nVariant & 2) != 0;
+                    const int nHeight = 7;
+                    std::vector<UINT8> image = bench::MakeImage(nWidth, nHeight, format.nChannels, nWidth * 31 + nFilter + 7, bNoise ? 255 : 7);
+                    std::vector<UINT8> png = EncodeFiltered(image, nWidth, nHeight, format.colorType, format.nBitDepth, nFilter, bNoise, bInterlace);
+                    std::vector<UINT8> scalar, simd;
+                    if (png.empty() || Decode(png, format.colorType, format.nBitDepth, false, scalar) != 0 ||
+                        Decode(png, format.colorType, format.nBitDepth, true, simd) != 0)
+                    {
+                        printf("FAIL: %d bit %d channel %dx%d filter %d did not round trip\n", format.nBitDepth, format.nChannels, nWidth,
+                               nHeight, nFilter);
+                        return false;
+                    }
+                    if (scalar != image || simd != scalar)
+                    {
+                        printf("FAIL: %d bit %d channel %dx%d filter %d%s%s: SIMD output differs\n", format.nBitDepth, format.nChannels,
+                               nWidth, nHeight, nFilter, bNoise ? " noise" : "", bInterlace ? " interlaced" : "");
+                        return false;
+                    }
+                    nCases++;
+                }
+            }
+        }
+    }
+    printf("%d decodes identical with and without SIMD\n\n", nCases);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int nSize = argc > 1 ? atoi(argv[1]) : 2048;
+
+    if (!Verify())
+        return 1;
+
+    // MB/s of decoded pixels. "replay" skips inflate and CRCs to time the unfilter
+    // on its own, "stored" and "deflate" are whole decodes.
+    printf("%dx%d\n", nSize, nSize);
+    printf("%-6s %-8s %-9s %12s %12s %8s\n", "format", "zlib", "filter", "scalar MB/s", "SIMD MB/s", "speedup");
+    const char *modes[] = {"replay", "stored", "deflate"};
+    const struct
+    {
+        const char *pchName;
+        LodePNGColorType colorType;
+        int nChannels;
+    } formats[] = {{"RGBA", LCT_RGBA, 4}, {"RGB", LCT_RGB, 3}};
+    for (auto &format : formats)
+    {
+        std::vector<UINT8> image = bench::MakeImage(nSize, nSize, format.nChannels, 1);
+        const double mb = (double)image.size() / (1024.0 * 1024.0);
+        for (int nMode = 0; nMode < 3; nMode++)
+        {
+            for (int nFilter = 0; nFilter < 5; nFilter++)
+            {
+                std::vector<UINT8> png = EncodeFiltered(image, nSize, nSize, format.colorType, 8, nFilter, nMode < 2);
+                std::vector<UINT8> decoded, inflated;
+                double seconds[2];
+                for (int nSIMD = 0; nSIMD < 2; nSIMD++)
+                {
+                    unsigned nError = 0;
+                    seconds[nSIMD] = bench::MeasureBest(5, [&]() {
+                        nError |= Decode(png, format.colorType, 8, nSIMD != 0, decoded, nMode == 0 ? &inflated : nullptr);
+                    });
+                    if (nError != 0 || decoded != image)
+                    {
+                        printf("FAIL: %s %s decode\n", format.pchName, g_filterNames[nFilter]);
+                        return 1;
+                    }
+                }
+                printf("%-6s %-8s %-9s %12.1f %12.1f %7.2fx\n", format.pchName, modes[nMode], g_filterNames[nFilter],
+                       mb / seconds[0], mb / seconds[1], seconds[0] / seconds[1]);
+            }
+        }
+    }
+    return 0;
+}
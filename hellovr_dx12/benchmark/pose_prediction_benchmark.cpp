@@ -0,0 +1,291 @@
+#include "PosePrediction.h"
+#include "bench.h"
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const double k_fPi = 3.14159265358979323846;
+// SteamVR hands over one pose a frame
+static const double k_fFrameSeconds = 1.0 / 90.0;
+static const int k_nFrames = 270;
+// one, two and four frames ahead
+static const double k_rgHorizons[] = {k_fFrameSeconds, 2 * k_fFrameSeconds, 4 * k_fFrameSeconds};
+
+// A recorded device: where it was at time t
+typedef std::function<RigidTransform(double)> PoseStream;
+
+static Quaternion AboutAxis(float fx, float fy, float fz, double fRadians)
+{
+    return Quaternion::FromAxisAngle(Vector3(fx, fy, fz), (float)fRadians);
+}
+
+static float Sine(double fHz, double t)
+{
+    return (float)sin(2 * k_fPi * fHz * t);
+}
+
+// Looking around: yaw, a little pitch, the head bobbing and swaying with it
+static RigidTransform HeadTurn(double t)
+{
+    Quaternion q = AboutAxis(0, 1, 0, 0.8 * Sine(0.5, t)) * AboutAxis(1, 0, 0, 0.15 * Sine(0.9, t));
+    return RigidTransform(q, Vector3(0.05f * Sine(0.5, t), 1.7f + 0.01f * Sine(1.8, t), 0));
+}
+
+// A controller swung on an arc from the shoulder, rolling as it goes
+static RigidTransform ControllerSwing(double t)
+{
+    float fAngle = 1.2f * Sine(0.8, t);
+    Quaternion q = AboutAxis(0, 0, 1, fAngle) * AboutAxis(0, 1, 0, 0.5 * Sine(1.1, t));
+    return RigidTransform(q, Vector3(0.3f + 0.6f * sinf(fAngle), 1.3f - 0.6f * cosf(fAngle), -0.3f));
+}
+
+static const Quaternion k_qStart = AboutAxis(0.6f, 0.8f, 0, 0.4);
+static const Vector3 k_axisSpin = Vector3(0.36f, 0.48f, 0.8f);
+
+// Exactly what constant velocity assumes
+static RigidTransform ConstantVelocity(double t)
+{
+    Vector3 rotation = k_axisSpin * (float)(1.5 * t);
+    return RigidTransform(Quaternion::FromRotationVector(rotation) * k_qStart, Vector3(0.4f * (float)t, 1.5f, -0.2f * (float)t));
+}
+
+// Exactly what constant acceleration assumes; the angular acceleration is along
+// the spin axis so integrating the rotation vector is exact too
+static RigidTransform ConstantAcceleration(double t)
+{
+    float fAngle = (float)(0.5 * t + 0.5 * 2.0 * t * t);
+    float fHalfT2 = (float)(0.5 * t * t);
+    Vector3 position(0.2f * (float)t + 0.9f * fHalfT2, 1.5f - 0.6f * fHalfT2, 0.1f * (float)t);
+    return RigidTransform(Quaternion::FromRotationVector(k_axisSpin * fAngle) * k_qStart, position);
+}
+
+static float AngleBetween(const Quaternion &a, const Quaternion &b)
+{
+    // the rotation vector keeps its precision for tiny angles where acos does not
+    return (a * b.Conjugate()).ToRotationVector().length();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: what WaitGetPoses would have returned at t. The runtime velocities
+//          are central differences of the stream, plus noise when asked.
+//-----------------------------------------------------------------------------
+static PoseSample Record(const PoseStream &stream, double t, bool bVelocity, float fNoise, bench::Random &random)
+{
+    const double e = 1e-3;
+    PoseSample sample;
+    sample.fTime = t;
+    sample.pose = stream(t);
+    if (bVelocity)
+    {
+        RigidTransform before = stream(t - e), after = stream(t + e);
+        float fInv2e = (float)(0.5 / e);
+        sample.velocity = (after.Translation() - before.Translation()) * fInv2e;
+        sample.angularVelocity = (after.Orientation() * before.Orientation().Conjugate()).ToRotationVector() * fInv2e;
+        sample.bHasVelocity = true;
+    }
+    if (fNoise > 0)
+    {
+        // tracker jitter: fNoise metres and fNoise * 10 radians
+        Vector3 offset(random.NextFloat(-fNoise, fNoise), random.NextFloat(-fNoise, fNoise), random.NextFloat(-fNoise, fNoise));
+        Vector3 rotation = Vector3(random.NextFloat(-1, 1), random.NextFloat(-1, 1), random.NextFloat(-1, 1)) * (fNoise * 10);
+        sample.pose = RigidTransform(Quaternion::FromRotationVector(rotation) * sample.pose.Orientation(), sample.pose.Translation() + offset);
+        sample.velocity += Vector3(random.NextFloat(-1, 1), random.NextFloat(-1, 1), random.NextFloat(-1, 1)) * (fNoise * 10);
+        sample.angularVelocity += Vector3(random.NextFloat(-1, 1), random.NextFloat(-1, 1), random.NextFloat(-1, 1)) * (fNoise * 50);
+    }
+    return sample;
+}
+
+struct Errors
+{
+    std::vector<float> positions; // metres
+    std::vector<float> angles;    // radians
+
+    static float Mean(const std::vector<float> &v)
+    {
+        double fSum = 0;
+        for (float f : v)
+            fSum += f;
+        return v.empty() ? 0 : (float)(fSum / v.size());
+    }
+    static float Percentile(std::vector<float> v, float fFraction)
+    {
+        if (v.empty())
+            return 0;
+        std::sort(v.begin(), v.end());
+        return v[std::min(v.size() - 1, (size_t)(fFraction * v.size()))];
+    }
+    float MaxPosition() const { return Percentile(positions, 1.0f); }
+    float MaxAngle() const { return Percentile(angles, 1.0f); }
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: plays a stream into a history one frame at a time and predicts each
+//          horizon ahead of every frame once the history has filled
+//-----------------------------------------------------------------------------
+static Errors Replay(const PoseStream &stream, const PoseStream &truth, bool bVelocity, float fNoise, PoseModel model, double fHorizon)
+{
+    bench::Random random(20);
+    PoseHistory history;
+    Errors errors;
+    for (int nFrame = 0; nFrame < k_nFrames; nFrame++)
+    {
+        double t = 0.25 + nFrame * k_fFrameSeconds;
+        history.Add(Record(stream, t, bVelocity, fNoise, random));
+        if (history.Count() < PoseHistory::k_nCapacity)
+            continue;
+
+        RigidTransform predicted = history.Predict(t + fHorizon, model), actual = truth(t + fHorizon);
+        errors.positions.push_back((predicted.Translation() - actual.Translation()).length());
+        errors.angles.push_back(AngleBetween(predicted.Orientation(), actual.Orientation()));
+    }
+    return errors;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: the ring keeps the newest k_nCapacity in order and drops stale
+//          samples; each model is exact on the motion it assumes, with the
+//          runtime's velocities or with its own estimates
+//-----------------------------------------------------------------------------
+static bool Verify()
+{
+    PoseHistory history;
+    if (history.Count() != 0 || history.Predict(1.0, PoseModel::ConstantAcceleration).Translation() != Vector3())
+    {
+        printf("FAIL: an empty history does not predict identity\n");
+        return false;
+    }
+    for (int i = 0; i < 20; i++)
+    {
+        PoseSample sample;
+        sample.fTime = i;
+        history.Add(sample);
+    }
+    PoseSample stale;
+    stale.fTime = 19;
+    history.Add(stale);
+    if (history.Count() != PoseHistory::k_nCapacity)
+    {
+        printf("FAIL: history holds %d samples, capacity %d\n", history.Count(), PoseHistory::k_nCapacity);
+        return false;
+    }
+    for (int nAge = 0; nAge < history.Count(); nAge++)
+    {
+        if (history.Sample(nAge).fTime != 19 - nAge)
+        {
+            printf("FAIL: sample %d is from %g, wanted %d\n", nAge, history.Sample(nAge).fTime, 19 - nAge);
+            return false;
+        }
+    }
+
+    struct Exact
+    {
+        const char *pchName;
+        PoseStream stream;
+        PoseModel model;
+    };
+    const Exact rgExact[] = {
+        {"constant velocity", ConstantVelocity, PoseModel::ConstantVelocity},
+        {"constant velocity", ConstantVelocity, PoseModel::ConstantAcceleration},
+        {"constant acceleration", ConstantAcceleration, PoseModel::ConstantAcceleration},
+    };
+    for (const Exact &exact : rgExact)
+    {
+        for (bool bVelocity : {true, false})
+        {
+            Errors errors = Replay(exact.stream, exact.stream, bVelocity, 0, exact.model, k_rgHorizons[2]);
+            if (errors.MaxPosition() > 2e-4f || errors.MaxAngle() > 2e-4f)
+            {
+                printf("FAIL: %s %s on a %s stream is off by %g mm, %g deg\n", GetPoseModelName(exact.model),
+                       bVelocity ? "(runtime velocity)" : "(estimated velocity)", exact.pchName, errors.MaxPosition() * 1e3f,
+                       errors.MaxAngle() * 180 / k_fPi);
+                return false;
+            }
+        }
+    }
+
+    // anything that moves is better extrapolated than held
+    for (const PoseStream &stream : {PoseStream(HeadTurn), PoseStream(ControllerSwing)})
+    {
+        for (bool bVelocity : {true, false})
+        {
+            Errors hold = Replay(stream, stream, bVelocity, 0, PoseModel::Hold, k_rgHorizons[1]);
+            Errors velocity = Replay(stream, stream, bVelocity, 0, PoseModel::ConstantVelocity, k_rgHorizons[1]);
+            if (Errors::Mean(velocity.positions) >= Errors::Mean(hold.positions) || Errors::Mean(velocity.angles) >= Errors::Mean(hold.angles))
+            {
+                printf("FAIL: constant velocity is no better than holding the pose\n");
+                return false;
+            }
+        }
+    }
+    printf("ring ordered, each model within 0.2 mm / 0.01 deg on the motion it assumes, velocity beats hold\n\n");
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!Verify())
+        return 1;
+
+    struct Stream
+    {
+        const char *pchName;
+        PoseStream stream;
+        float fNoise;
+    };
+    const Stream rgStreams[] = {
+        {"head turn", HeadTurn, 0},
+        {"controller swing", ControllerSwing, 0},
+        {"static, jittered", [](double) { return RigidTransform(k_qStart, Vector3(0, 1.7f, 0)); }, 0.0002f},
+        {"constant velocity", ConstantVelocity, 0},
+        {"constant acceleration", ConstantAcceleration, 0},
+    };
+    const PoseModel rgModels[] = {PoseModel::Hold, PoseModel::ConstantVelocity, PoseModel::ConstantAcceleration};
+
+    printf("90 Hz streams, %d frames; error against the true pose, mean / p95\n", k_nFrames);
+    printf("%-22s %-10s %-22s %8s %17s %17s\n", "stream", "velocity", "model", "ahead", "position mm", "angle deg");
+    for (const Stream &stream : rgStreams)
+    {
+        // the jittered stream is measured against where the device really is
+        PoseStream truth = stream.fNoise > 0 ? [](double) { return RigidTransform(k_qStart, Vector3(0, 1.7f, 0)); } : stream.stream;
+        for (bool bVelocity : {true, false})
+        {
+            for (PoseModel model : rgModels)
+            {
+                for (double fHorizon : k_rgHorizons)
+                {
+                    Errors errors = Replay(stream.stream, truth, bVelocity, stream.fNoise, model, fHorizon);
+                    printf("%-22s %-10s %-22s %6.1fms %8.3f %8.3f %8.3f %8.3f\n", stream.pchName, bVelocity ? "runtime" : "estimated",
+                           GetPoseModelName(model), fHorizon * 1e3, Errors::Mean(errors.positions) * 1e3f,
+                           Errors::Percentile(errors.positions, 0.95f) * 1e3f, Errors::Mean(errors.angles) * 180 / k_fPi,
+                           Errors::Percentile(errors.angles, 0.95f) * 180 / k_fPi);
+                }
+            }
+        }
+    }
+
+    // cost of one prediction from a full history
+    const int nCount = argc > 1 ? atoi(argv[1]) : 4096;
+    bench::Random random(7);
+    for (bool bVelocity : {true, false})
+    {
+        PoseHistory history;
+        for (int nFrame = 0; nFrame < PoseHistory::k_nCapacity; nFrame++)
+        {
+            history.Add(Record(ControllerSwing, nFrame * k_fFrameSeconds, bVelocity, 0, random));
+        }
+        printf("\n%s velocity, ns per Predict\n", bVelocity ? "runtime" : "estimated");
+        for (PoseModel model : rgModels)
+        {
+            float fChecksum = 0;
+            double seconds = bench::MeasureBest(50, [&]() {
+                for (int i = 0; i < nCount; i++)
+                    fChecksum += history.Predict(0.1 + i * 1e-6, model).Translation().x;
+            });
+            printf("%-22s %8.2f (checksum %g)\n", GetPoseModelName(model), seconds * 1e9 / nCount, fChecksum);
+        }
+    }
+    return 0;
+}
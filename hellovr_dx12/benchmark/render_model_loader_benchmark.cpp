@@ -0,0 +1,393 @@
+#include "RenderModelLoader.h"
+#include "GenMipMapRGBA.h"
+#include "WorkerPool.h"
+#include "bench.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Purpose: Stands in for IVRRenderModels. Every model and texture answers
+//          Loading for nLatency polls before it is ready, or until frame
+//          nLatency when bPerFrame so requests for one name finish in the
+//          order they were made. Names listed in failing models or textures
+//          fail instead. Counts what was handed out and freed.
+//-----------------------------------------------------------------------------
+struct FakeRenderModelSource : public IRenderModelSource
+{
+    struct Model
+    {
+        std::vector<float> vertices;
+        std::vector<uint16_t> indices;
+    };
+    struct Texture
+    {
+        int32_t nTextureId;
+    };
+
+    int nLatency;
+    int nTextureSize;
+    std::set<std::string> failingModels;
+    std::set<int32_t> failingTextures;
+    std::map<std::string, int> modelPolls;
+    std::map<int32_t, int> texturePolls;
+    bool bPerFrame = false;
+    int nFrame = 0;
+    // the runtime hands out its own copy, all textures share one here
+    std::vector<unsigned char> rgba;
+    int nModelLoads = 0;
+    int nTextureLoads = 0;
+    int nModelFrees = 0;
+    int nTextureFrees = 0;
+
+    FakeRenderModelSource(int nLatencyPolls, int nSize)
+        : nLatency(nLatencyPolls), nTextureSize(nSize), rgba((size_t)nSize * nSize * 4)
+    {
+        for (size_t i = 0; i < rgba.size(); i++)
+        {
+            rgba[i] = (unsigned char)(i * 7);
+        }
+    }
+
+    // the runtime names textures per model, two names share one texture here
+    static int32_t TextureIdFor(const std::string &strName) { return (int32_t)(strName.size() % 2); }
+
+    RenderModelLoadStatus LoadModel(const char *pchName, RenderModelAsset *pModel) override
+    {
+        if ((bPerFrame ? nFrame : modelPolls[pchName]++) < nLatency)
+            return RenderModelLoadStatus::Loading;
+        if (failingModels.count(pchName))
+            return RenderModelLoadStatus::Failed;
+
+        Model *pFake = new Model;
+        pFake->vertices.resize(8 * 300);
+        pFake->indices.resize(3 * 100);
+        *pModel = {pFake, pFake->vertices.data(), 8 * sizeof(float), 300, pFake->indices.data(), 100, TextureIdFor(pchName)};
+        nModelLoads++;
+        return RenderModelLoadStatus::Ready;
+    }
+    RenderModelLoadStatus LoadTexture(int32_t nTextureId, RenderModelTextureAsset *pTexture) override
+    {
+        if ((bPerFrame ? nFrame : texturePolls[nTextureId]++) < nLatency)
+            return RenderModelLoadStatus::Loading;
+        if (failingTextures.count(nTextureId))
+            return RenderModelLoadStatus::Failed;
+
+        Texture *pFake = new Texture{nTextureId};
+        *pTexture = {pFake, rgba.data(), nTextureSize, nTextureSize};
+        nTextureLoads++;
+        return RenderModelLoadStatus::Ready;
+    }
+    void FreeModel(const RenderModelAsset &model) override
+    {
+        delete (const Model *)model.pHandle;
+        nModelFrees++;
+    }
+    void FreeTexture(const RenderModelTextureAsset &texture) override
+    {
+        delete (const Texture *)texture.pHandle;
+        nTextureFrees++;
+    }
+};
+
+// A mip chain in CPU memory, what the D3D12 model keeps in its upload heap
+struct FakeStaging : public RenderModelStaging
+{
+    std::vector<unsigned char> arena;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Builds a real mip chain so staging costs what it does in the app,
+//          and acts as the cache for whatever results it is given
+//-----------------------------------------------------------------------------
+struct FakeStager : public IRenderModelStager
+{
+    std::set<std::pair<std::string, int32_t>> loaded;
+    std::atomic<int> nStaged{0};
+    WorkerPool *pWorkers = nullptr;
+
+    bool IsLoaded(const std::string &strName, int32_t nTextureId) override { return loaded.count({strName, nTextureId}) != 0; }
+
+    std::unique_ptr<RenderModelStaging> Stage(const std::string &, const RenderModelAsset &, const RenderModelTextureAsset &texture) override
+    {
+        std::unique_ptr<FakeStaging> pStaging(new FakeStaging);
+        std::vector<MipLevelLayout> levels(GetMipChainLevelCount(texture.nWidth, texture.nHeight));
+        pStaging->arena.resize(ComputeMipChainLayoutRGBA(texture.nWidth, texture.nHeight, &levels[0]));
+        GenerateMipChainRGBA(texture.pRGBA, (size_t)texture.nWidth * 4, &pStaging->arena[0], &levels[0], (int)levels.size(),
+                             MipFilterOptions(), pWorkers);
+        nStaged++;
+        return pStaging;
+    }
+};
+
+// What Models::Update does with the results, minus D3D12
+struct Attached
+{
+    int nMisses = 0;
+    int nHits = 0;
+    int nFailed = 0;
+    std::map<uint32_t, std::string> devices;
+};
+
+static void Consume(std::vector<RenderModelLoadResult> results, FakeStager &stager, Attached &attached)
+{
+    for (auto &result : results)
+    {
+        if (result.bFailed)
+        {
+            attached.nFailed++;
+            continue;
+        }
+        if (result.pStaging)
+        {
+            attached.nMisses++;
+            stager.loaded.insert({result.strName, result.nTextureId});
+        }
+        else
+        {
+            attached.nHits++;
+        }
+        attached.devices[result.nDevice] = result.strName;
+    }
+}
+
+// Poll until idle, the longest single Poll in seconds; -1 if it never finishes
+static double PollUntilIdle(RenderModelLoader &loader, FakeStager &stager, Attached &attached, int *pFrames = nullptr)
+{
+    double worst = 0;
+    int nFrames = 0;
+    while (!loader.IsIdle())
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto results = loader.Poll();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        worst = std::max(worst, elapsed.count());
+        Consume(std::move(results), stager, attached);
+        if (++nFrames > 1000000)
+            return -1;
+        std::this_thread::yield();
+    }
+    if (pFrames)
+        *pFrames = nFrames;
+    return worst;
+}
+
+static bool CheckFreed(const FakeRenderModelSource &source, const char *pchCase)
+{
+    if (source.nModelLoads != source.nModelFrees || source.nTextureLoads != source.nTextureFrees)
+    {
+        printf("FAIL: %s: %d/%d models and %d/%d textures freed\n", pchCase, source.nModelFrees, source.nModelLoads,
+               source.nTextureFrees, source.nTextureLoads);
+        return false;
+    }
+    return true;
+}
+
+static bool Verify(WorkerPool *pWorkers)
+{
+    const char *pchWorkers = pWorkers ? "workers" : "inline";
+
+    // Two controllers with the same model stage it once, a third model on its own
+    {
+        FakeRenderModelSource source(3, 256);
+        FakeStager stager;
+        RenderModelLoader loader(&source, &stager, pWorkers);
+        loader.Request(1, "controller");
+        loader.Request(2, "controller");
+        loader.Request(3, "tracker");
+        Attached attached;
+        if (PollUntilIdle(loader, stager, attached) < 0)
+            return false;
+        if (stager.nStaged != 2 || attached.nMisses != 2 || attached.nHits != 1 || attached.devices.size() != 3 ||
+            attached.devices[2] != "controller" || source.nTextureLoads != 2)
+        {
+            printf("FAIL: %s: shared model staged %d times, %d misses %d hits %d textures\n", pchWorkers, (int)stager.nStaged,
+                   attached.nMisses, attached.nHits, source.nTextureLoads);
+            return false;
+        }
+        if (!CheckFreed(source, "shared"))
+            return false;
+
+        // activated again later, the cache answers without a texture load
+        loader.Request(1, "controller");
+        if (PollUntilIdle(loader, stager, attached) < 0 || attached.nHits != 2 || source.nTextureLoads != 2)
+        {
+            printf("FAIL: %s: cached model loaded again\n", pchWorkers);
+            return false;
+        }
+        if (!CheckFreed(source, "reactivated"))
+            return false;
+    }
+
+    // The same model answered on the same frame for both: the first request
+    // finishes and the second waits until its result is in the cache
+    {
+        FakeRenderModelSource source(3, 256);
+        source.bPerFrame = true;
+        FakeStager stager;
+        RenderModelLoader loader(&source, &stager, pWorkers);
+        loader.Request(1, "controller");
+        loader.Request(2, "controller");
+        Attached attached;
+        for (source.nFrame = 0; !loader.IsIdle() && source.nFrame < 1000000; source.nFrame++)
+        {
+            Consume(loader.Poll(), stager, attached);
+            std::this_thread::yield();
+        }
+        if (!loader.IsIdle() || stager.nStaged != 1 || source.nTextureLoads != 1 || attached.nMisses != 1 || attached.nHits != 1)
+        {
+            printf("FAIL: %s: in order requests staged %d times, %d misses %d hits %d textures\n", pchWorkers, (int)stager.nStaged,
+                   attached.nMisses, attached.nHits, source.nTextureLoads);
+            return false;
+        }
+        if (!CheckFreed(source, "in order"))
+            return false;
+    }
+
+    // A device detached while its model loads or stages gets nothing back
+    for (int nCancelAt = 0; nCancelAt < 8; nCancelAt++)
+    {
+        FakeRenderModelSource source(2, 512);
+        FakeStager stager;
+        Attached attached;
+        {
+            RenderModelLoader loader(&source, &stager, pWorkers);
+            loader.Request(1, "controller");
+            loader.Request(2, "tracker");
+            for (int i = 0; i < nCancelAt; i++)
+            {
+                Consume(loader.Poll(), stager, attached);
+            }
+            loader.Cancel(1);
+            // inline staging finishes device 1 on the fifth poll, before the cancel
+            if (PollUntilIdle(loader, stager, attached) < 0)
+                return false;
+            if (attached.devices.count(1) && nCancelAt < 5)
+            {
+                printf("FAIL: %s: cancelled device attached after %d polls\n", pchWorkers, nCancelAt);
+                return false;
+            }
+            if (!attached.devices.count(2))
+            {
+                printf("FAIL: %s: cancelling device 1 dropped device 2\n", pchWorkers);
+                return false;
+            }
+        }
+        if (!CheckFreed(source, "cancel"))
+            return false;
+    }
+
+    // A newer request replaces one still pending, and the loader can go while staging runs
+    {
+        FakeRenderModelSource source(1, 1024);
+        FakeStager stager;
+        Attached attached;
+        {
+            RenderModelLoader loader(&source, &stager, pWorkers);
+            loader.Request(1, "controller");
+            loader.Request(1, "tracker");
+            if (PollUntilIdle(loader, stager, attached) < 0 || attached.devices[1] != "tracker" || attached.nMisses != 1)
+            {
+                printf("FAIL: %s: replaced request still attached\n", pchWorkers);
+                return false;
+            }
+            loader.Request(2, "knuckles");
+            for (int i = 0; i < 4; i++)
+            {
+                Consume(loader.Poll(), stager, attached);
+            }
+        }
+        if (!CheckFreed(source, "destroyed"))
+            return false;
+    }
+
+    // Failures come back as failures and free what was loaded
+    {
+        FakeRenderModelSource source(2, 64);
+        source.failingModels.insert("broken");
+        source.failingTextures.insert(FakeRenderModelSource::TextureIdFor("tracker"));
+        FakeStager stager;
+        RenderModelLoader loader(&source, &stager, pWorkers);
+        loader.Request(1, "broken");
+        loader.Request(2, "tracker");
+        loader.Request(3, "controller");
+        Attached attached;
+        if (PollUntilIdle(loader, stager, attached) < 0)
+            return false;
+        if (attached.nFailed != 2 || attached.devices.size() != 1 || !attached.devices.count(3))
+        {
+            printf("FAIL: %s: %d failures reported\n", pchWorkers, attached.nFailed);
+            return false;
+        }
+        if (!CheckFreed(source, "failure"))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int nTextureSize = argc > 1 ? atoi(argv[1]) : 1024;
+    const int nLatencyPolls = 20;
+    const int nDevices = 6;
+
+    WorkerPool workers;
+    if (!Verify(nullptr) || !Verify(&workers))
+        return 1;
+
+    // The old loop slept 1 ms per Loading answer and staged on the render thread
+    printf("%d devices, %d distinct models, %dx%d textures, %d polls of latency\n", nDevices, nDevices / 2, nTextureSize, nTextureSize,
+           nLatencyPolls);
+    printf("%-10s %14s %14s %10s\n", "mode", "blocking ms", "worst Poll ms", "frames");
+    for (WorkerPool *pWorkers : {(WorkerPool *)nullptr, &workers})
+    {
+        FakeRenderModelSource source(nLatencyPolls, nTextureSize);
+        FakeStager stager;
+        stager.pWorkers = pWorkers;
+
+        // the blocking load: every Loading answer cost a 1 ms sleep, staging on top
+        auto start = std::chrono::steady_clock::now();
+        {
+            FakeStager blocking;
+            FakeRenderModelSource blockingSource(nLatencyPolls, nTextureSize);
+            for (int i = 0; i < nDevices / 2; i++)
+            {
+                RenderModelAsset model;
+                RenderModelTextureAsset texture;
+                std::string strName = "model" + std::to_string(i);
+                while (blockingSource.LoadModel(strName.c_str(), &model) == RenderModelLoadStatus::Loading)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                while (blockingSource.LoadTexture(model.nTextureId, &texture) == RenderModelLoadStatus::Loading)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                blocking.Stage(strName, model, texture);
+                blockingSource.FreeModel(model);
+                blockingSource.FreeTexture(texture);
+            }
+        }
+        std::chrono::duration<double> blocking = std::chrono::steady_clock::now() - start;
+
+        RenderModelLoader loader(&source, &stager, pWorkers);
+        for (int i = 0; i < nDevices; i++)
+        {
+            loader.Request(i + 1, "model" + std::to_string(i / 2));
+        }
+        Attached attached;
+        int nFrames = 0;
+        double worst = PollUntilIdle(loader, stager, attached, &nFrames);
+        if (worst < 0 || attached.devices.size() != nDevices)
+        {
+            printf("FAIL: benchmark load incomplete\n");
+            return 1;
+        }
+        printf("%-10s %14.2f %14.3f %10d\n", pWorkers ? "workers" : "inline", blocking.count() * 1e3, worst * 1e3, nFrames);
+    }
+    return 0;
+}
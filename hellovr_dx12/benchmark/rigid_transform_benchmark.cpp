@@ -0,0 +1,195 @@
+#include "RigidTransform.h"
+#include "bench.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// A tracked pose as SteamVR hands it over: row major 3x4, rotation then translation
+struct HmdMatrix34
+{
+    float m[3][4];
+};
+
+static Quaternion RandomRotation(bench::Random &random)
+{
+    Quaternion q(random.NextFloat(-1, 1), random.NextFloat(-1, 1), random.NextFloat(-1, 1), random.NextFloat(-1, 1));
+    return q.Normalized();
+}
+
+static HmdMatrix34 RandomPose(bench::Random &random)
+{
+    float r[9];
+    RandomRotation(random).ToRotation(r);
+    HmdMatrix34 pose;
+    for (int nRow = 0; nRow < 3; nRow++)
+    {
+        for (int nCol = 0; nCol < 3; nCol++)
+        {
+            pose.m[nRow][nCol] = r[nCol * 3 + nRow];
+        }
+        pose.m[nRow][3] = random.NextFloat(-3, 3);
+    }
+    return pose;
+}
+
+// What HMD did with every pose before
+static Matrix4 ConvertSteamVRMatrixToMatrix4(const HmdMatrix34 &matPose)
+{
+    return Matrix4(matPose.m[0][0], matPose.m[1][0], matPose.m[2][0], 0.0, matPose.m[0][1], matPose.m[1][1], matPose.m[2][1], 0.0,
+                   matPose.m[0][2], matPose.m[1][2], matPose.m[2][2], 0.0, matPose.m[0][3], matPose.m[1][3], matPose.m[2][3], 1.0f);
+}
+
+static float MaxDifference(const Matrix4 &a, const Matrix4 &b)
+{
+    float fMax = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        fMax = fmaxf(fMax, fabsf(a[i] - b[i]));
+    }
+    return fMax;
+}
+
+static float Distance(const Vector3 &a, const Vector3 &b)
+{
+    return (a - b).length();
+}
+
+// Angle between two rotations, radians
+static float AngleBetween(const Quaternion &a, const Quaternion &b)
+{
+    return 2 * acosf(fminf(1.0f, fabsf(a.Dot(b))));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: conversions are exact; compose, inverse and transforms agree with
+//          the Matrix4 path; quaternions round trip; slerp and nlerp hit
+//          their ends and slerp moves at constant angular speed
+//-----------------------------------------------------------------------------
+static bool Verify()
+{
+    bench::Random random(19);
+    for (int i = 0; i < 100000; i++)
+    {
+        HmdMatrix34 poseA = RandomPose(random), poseB = RandomPose(random);
+        RigidTransform a = RigidTransform::FromHmdMatrix34(poseA.m), b = RigidTransform::FromHmdMatrix34(poseB.m);
+        Matrix4 matA = ConvertSteamVRMatrixToMatrix4(poseA), matB = ConvertSteamVRMatrixToMatrix4(poseB);
+        if (a.ToMatrix4() != matA || RigidTransform::FromMatrix4(matA).ToMatrix4() != matA)
+        {
+            printf("FAIL: HmdMatrix34 -> RigidTransform -> Matrix4 is not exact\n");
+            return false;
+        }
+
+        Vector3 p(random.NextFloat(-5, 5), random.NextFloat(-5, 5), random.NextFloat(-5, 5));
+        Vector4 expected = matA * Vector4(p.x, p.y, p.z, 1);
+        Vector3 q = a.TransformPoint(p);
+        if (q.x != expected.x || q.y != expected.y || q.z != expected.z)
+        {
+            printf("FAIL: TransformPoint differs from Matrix4 * Vector4\n");
+            return false;
+        }
+
+        float fCompose = MaxDifference((a * b).ToMatrix4(), matA * matB);
+        float fInverse = MaxDifference(a.Inverse().ToMatrix4(), Matrix4(matA).invert());
+        float fIdentity = MaxDifference((a * a.Inverse()).ToMatrix4(), Matrix4());
+        if (fCompose > 1e-5f || fInverse > 1e-5f || fIdentity > 1e-5f)
+        {
+            printf("FAIL: compose %g, inverse %g, a * a^-1 %g off the Matrix4 path\n", fCompose, fInverse, fIdentity);
+            return false;
+        }
+
+        Quaternion orientation = a.Orientation();
+        RigidTransform roundTrip(orientation, a.Translation());
+        float fRoundTrip = MaxDifference(roundTrip.ToMatrix4(), matA);
+        Vector3 rotated = orientation.Rotate(p), expectedRotated = a.TransformVector(p);
+        if (fRoundTrip > 2e-6f || Distance(rotated, expectedRotated) > 1e-5f)
+        {
+            printf("FAIL: quaternion round trip %g off\n", fRoundTrip);
+            return false;
+        }
+
+        for (int nEnd = 0; nEnd < 2; nEnd++)
+        {
+            const RigidTransform &target = nEnd ? b : a;
+            for (const RigidTransform &t : {RigidTransform::Slerp(a, b, (float)nEnd), RigidTransform::Lerp(a, b, (float)nEnd)})
+            {
+                if (MaxDifference(t.ToMatrix4(), target.ToMatrix4()) > 1e-5f)
+                {
+                    printf("FAIL: interpolating at t = %d does not land on the end pose\n", nEnd);
+                    return false;
+                }
+            }
+        }
+
+        // slerp's angle from a grows linearly with t, nlerp only roughly
+        Quaternion qa = a.Orientation(), qb = b.Orientation();
+        float fTotal = AngleBetween(qa, qb);
+        for (float t : {0.25f, 0.5f, 0.75f})
+        {
+            float fAngle = AngleBetween(qa, RigidTransform::Slerp(a, b, t).Orientation());
+            if (fabsf(fAngle - fTotal * t) > 2e-3f)
+            {
+                printf("FAIL: slerp at %g is %g rad from a, wanted %g\n", t, fAngle, fTotal * t);
+                return false;
+            }
+        }
+    }
+    printf("conversions exact, compose and inverse within 1e-5 of Matrix4, slerp at constant speed\n\n");
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const int nCount = argc > 1 ? atoi(argv[1]) : 4096;
+    if (!Verify())
+        return 1;
+
+    bench::Random random(7);
+    std::vector<HmdMatrix34> poses(nCount);
+    std::vector<Matrix4> matrices(nCount), matrixResults(nCount);
+    std::vector<RigidTransform> rigid(nCount), rigidResults(nCount);
+    for (int i = 0; i < nCount; i++)
+    {
+        poses[i] = RandomPose(random);
+        matrices[i] = ConvertSteamVRMatrixToMatrix4(poses[i]);
+        rigid[i] = RigidTransform::FromHmdMatrix34(poses[i].m);
+    }
+
+    printf("%d poses per pass\n", nCount);
+    printf("%-36s %12s\n", "operation", "ns per pose");
+    auto report = [&](const char *pchName, auto &&pass) {
+        double seconds = bench::MeasureBest(50, pass);
+        printf("%-36s %12.2f\n", pchName, seconds * 1e9 / nCount);
+    };
+    report("Matrix4 invert() (affine)", [&]() {
+        for (int i = 0; i < nCount; i++)
+            (matrixResults[i] = matrices[i]).invert();
+    });
+    report("Matrix4 invertGeneral()", [&]() {
+        for (int i = 0; i < nCount; i++)
+            (matrixResults[i] = matrices[i]).invertGeneral();
+    });
+    report("RigidTransform Inverse()", [&]() {
+        for (int i = 0; i < nCount; i++)
+            rigidResults[i] = rigid[i].Inverse();
+    });
+    report("Matrix4 multiply", [&]() {
+        for (int i = 0; i < nCount; i++)
+            matrixResults[i] = matrices[i] * matrices[(i + 1) % nCount];
+    });
+    report("RigidTransform compose", [&]() {
+        for (int i = 0; i < nCount; i++)
+            rigidResults[i] = rigid[i] * rigid[(i + 1) % nCount];
+    });
+    report("RigidTransform Slerp", [&]() {
+        for (int i = 0; i < nCount; i++)
+            rigidResults[i] = RigidTransform::Slerp(rigid[i], rigid[(i + 1) % nCount], 0.3f);
+    });
+    report("RigidTransform Lerp", [&]() {
+        for (int i = 0; i < nCount; i++)
+            rigidResults[i] = RigidTransform::Lerp(rigid[i], rigid[(i + 1) % nCount], 0.3f);
+    });
+    printf("(checksum %g %g)\n", matrixResults[nCount / 2][12], rigidResults[nCount / 2].Translation().x);
+    return 0;
+}
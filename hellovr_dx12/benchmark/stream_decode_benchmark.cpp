@@ -0,0 +1,236 @@
+#include "bench_png.h"
+#include "GenMipMapRGBA.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+typedef unsigned char UINT8;
+
+struct StreamResult
+{
+    std::vector<UINT8> rows; // packed one after the other
+    size_t nRowBytes = 0;
+    unsigned nRows = 0;
+    unsigned nStopAt = ~0u;
+};
+
+static unsigned CollectRow(void *pUser, const unsigned char *pRow, unsigned y, unsigned, unsigned)
+{
+    StreamResult &result = *(StreamResult *)pUser;
+    if (y != result.nRows || y == result.nStopAt)
+        return 1;
+    result.nRows++;
+    result.rows.insert(result.rows.end(), pRow, pRow + result.nRowBytes);
+    return 0;
+}
+
+static unsigned StreamDecode(const std::vector<UINT8> &png, size_t nPiece, lodepng::State &state, StreamResult &result,
+                             size_t nRowBytes)
+{
+    result.rows.clear();
+    result.nRowBytes = nRowBytes;
+    result.nRows = 0;
+    LodePNGStreamDecoder *pDecoder = lodepng_stream_decoder_new(&state, CollectRow, &result);
+    unsigned nError = 0;
+    for (size_t i = 0; i < png.size() && nError == 0; i += nPiece)
+    {
+        nError = lodepng_stream_decoder_push(pDecoder, &png[i], std::min(nPiece, png.size() - i));
+    }
+    if (nError == 0)
+        nError = lodepng_stream_decoder_finish(pDecoder);
+    lodepng_stream_decoder_delete(pDecoder);
+    return nError;
+}
+
+static bool VerifyDecoder()
+{
+    struct Case
+    {
+        LodePNGColorType pngType;
+        unsigned nPngDepth;
+        int nChannels;
+        LodePNGColorType rawType;
+        unsigned nRawDepth;
+        bool bSwap;
+    };
+    const Case cases[] = {
+        {LCT_RGBA, 8, 4, LCT_RGBA, 8, false}, {LCT_RGB, 8, 3, LCT_RGBA, 8, true},     {LCT_RGB, 8, 3, LCT_RGB, 8, false},
+        {LCT_GREY, 8, 1, LCT_RGBA, 8, false}, {LCT_RGBA, 16, 8, LCT_RGBA, 8, false}, {LCT_GREY_ALPHA, 8, 2, LCT_RGBA, 8, true},
+    };
+    const int widths[] = {1, 3, 13, 65, 300};
+    const size_t pieces[] = {1, 7, 333, 4096, (size_t)1 << 30};
+    int nChecks = 0;
+    for (const Case &c : cases)
+    {
+        for (int nWidth : widths)
+        {
+            for (unsigned nBType = 0; nBType < 3; nBType++)
+            {
+                // tall enough at 300 wide that the output passes through the window several times
+                const int nHeight = nWidth == 300 ? 97 : 9;
+                std::vector<UINT8> png = bench::Encode(bench::MakeImage(nWidth, nHeight, c.nChannels, nWidth + nBType, nBType ? 7 : 255),
+                                                nWidth, nHeight, c.pngType, c.nPngDepth, nBType);
+                if (nWidth == 65)
+                    png = bench::SplitIDAT(png, 100);
+
+                // lodepng_decode_into with a pitch of one row is the reference
+                lodepng::State reference;
+                reference.info_raw.colortype = c.rawType;
+                reference.info_raw.bitdepth = c.nRawDepth;
+                reference.decoder.swap_red_blue = c.bSwap ? 1 : 0;
+                const size_t nRowBytes = lodepng_get_raw_size(nWidth, 1, &reference.info_raw);
+                std::vector<UINT8> expected(nRowBytes * nHeight);
+                unsigned w, h;
+                if (png.empty() ||
+                    lodepng_decode_into(&expected[0], nRowBytes, expected.size(), &w, &h, &reference, &png[0], png.size()) != 0)
+                {
+                    printf("FAIL: reference decode of type %d width %d\n", c.pngType, nWidth);
+                    return false;
+                }
+
+                for (size_t nPiece : pieces)
+                {
+                    lodepng::State state;
+                    state.info_raw.colortype = c.rawType;
+                    state.info_raw.bitdepth = c.nRawDepth;
+                    state.decoder.swap_red_blue = c.bSwap ? 1 : 0;
+                    StreamResult result;
+                    unsigned nError = StreamDecode(png, nPiece, state, result, nRowBytes);
+                    if (nError != 0 || result.nRows != (unsigned)nHeight || result.rows != expected)
+                    {
+                        printf("FAIL: %d bit type %d, width %d, btype %u in %zu byte pieces: error %u, %u rows\n",
+                               c.nPngDepth, c.pngType, nWidth, nBType, nPiece, nError, result.nRows);
+                        return false;
+                    }
+                    nChecks++;
+                }
+            }
+        }
+    }
+
+    // errors: interlaced, truncated, a bad CRC, a callback that stops
+    std::vector<UINT8> png = bench::Encode(bench::MakeImage(40, 30, 4, 3), 40, 30, LCT_RGBA, 8);
+    std::vector<UINT8> interlaced = bench::Encode(bench::MakeImage(40, 30, 4, 3), 40, 30, LCT_RGBA, 8, 2, true);
+    std::vector<UINT8> truncated(png.begin(), png.end() - 20);
+    std::vector<UINT8> corrupt = png;
+    corrupt[png.size() - 14] ^= 4; // the IDAT's CRC, just in front of IEND; flipped data may trip inflate first
+    struct
+    {
+        const std::vector<UINT8> *pPNG;
+        unsigned nStopAt;
+        unsigned nExpected;
+    } failures[] = {{&interlaced, ~0u, 94}, {&truncated, ~0u, 30}, {&corrupt, ~0u, 57}, {&png, 12, 95}};
+    for (auto &failure : failures)
+    {
+        lodepng::State state;
+        StreamResult result;
+        result.nStopAt = failure.nStopAt;
+        unsigned nError = StreamDecode(*failure.pPNG, 64, state, result, 40 * 4);
+        if (nError != failure.nExpected)
+        {
+            printf("FAIL: expected error %u, got %u\n", failure.nExpected, nError);
+            return false;
+        }
+    }
+    printf("%d streamed decodes match lodepng_decode_into\n", nChecks);
+    return true;
+}
+
+// The builder must produce GenerateMipChainRGBA's arena, padding included
+static bool VerifyBuilder()
+{
+    const int sizes[][2] = {{1, 1}, {7, 5}, {64, 33}, {129, 70}, {3, 200}};
+    const MipFilter filters[] = {MipFilter::Box, MipFilter::Kaiser};
+    int nChecks = 0;
+    for (auto &size : sizes)
+    {
+        for (MipFilter filter : filters)
+        {
+            for (int nSRGB = 0; nSRGB < 2; nSRGB++)
+            {
+                MipFilterOptions options;
+                options.filter = filter;
+                options.bSRGB = nSRGB != 0;
+                std::vector<UINT8> image = bench::MakeImage(size[0], size[1], 4, size[0] * size[1], 255);
+                std::vector<MipLevelLayout> levels(GetMipChainLevelCount(size[0], size[1]));
+                const size_t nArenaSize = ComputeMipChainLayoutRGBA(size[0], size[1], &levels[0]);
+                std::vector<UINT8> expected(nArenaSize, 0), actual(nArenaSize, 0);
+                GenerateMipChainRGBA(&image[0], (size_t)size[0] * 4, &expected[0], &levels[0], (int)levels.size(), options);
+
+                MipChainBuilder builder(&actual[0], &levels[0], (int)levels.size(), options);
+                for (int y = 0; y < size[1]; y++)
+                {
+                    builder.AddRow(&image[(size_t)y * size[0] * 4]);
+                }
+                builder.Finish();
+                if (actual != expected)
+                {
+                    printf("FAIL: %dx%d %s%s chain differs\n", size[0], size[1], GetMipFilterName(filter), nSRGB ? " sRGB" : "");
+                    return false;
+                }
+                nChecks++;
+            }
+        }
+    }
+    printf("%d row by row mip chains match GenerateMipChainRGBA\n\n", nChecks);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const int nSize = argc > 1 ? atoi(argv[1]) : 4096;
+    if (!VerifyDecoder() || !VerifyBuilder())
+        return 1;
+
+    // An RGBA texture into a full mip chain in an "upload heap", the way Texture loads it
+    std::vector<UINT8> png = bench::Encode(bench::MakeImage(nSize, nSize, 4, 9), nSize, nSize, LCT_RGBA, 8);
+    std::vector<MipLevelLayout> levels(GetMipChainLevelCount(nSize, nSize));
+    std::vector<UINT8> expected(ComputeMipChainLayoutRGBA(nSize, nSize, &levels[0]), 0);
+    std::vector<UINT8> arena(expected.size(), 0);
+    const size_t nPiece = 64 * 1024;
+
+    printf("%dx%d RGBA, %.1f MB image, %.1f MB PNG, %.1f MB mip chain\n", nSize, nSize, nSize * (double)nSize * 4 / 1048576.0,
+           png.size() / 1048576.0, arena.size() / 1048576.0);
+    // peak heap is what the decode allocates on top of the PNG and the arena
+    printf("%-34s %10s %16s\n", "path", "ms", "peak heap MB");
+    for (int nStream = 0; nStream < 2; nStream++)
+    {
+        unsigned nError = 0;
+        const size_t nBaseline = g_nLiveBytes;
+        g_nPeakBytes = nBaseline;
+        double seconds = bench::MeasureBest(5, [&]() {
+            if (nStream)
+            {
+                MipChainBuilder builder(&arena[0], &levels[0], (int)levels.size());
+                auto AddRow = [](void *pUser, const unsigned char *pRow, unsigned, unsigned, unsigned) -> unsigned {
+                    static_cast<MipChainBuilder *>(pUser)->AddRow(pRow);
+                    return 0;
+                };
+                lodepng::State state;
+                LodePNGStreamDecoder *pDecoder = lodepng_stream_decoder_new(&state, AddRow, &builder);
+                for (size_t i = 0; i < png.size() && nError == 0; i += nPiece)
+                {
+                    nError |= lodepng_stream_decoder_push(pDecoder, &png[i], std::min(nPiece, png.size() - i));
+                }
+                nError |= lodepng_stream_decoder_finish(pDecoder);
+                lodepng_stream_decoder_delete(pDecoder);
+                builder.Finish();
+            }
+            else
+            {
+                std::vector<UINT8> image;
+                unsigned w, h;
+                nError |= lodepng::decode(image, w, h, png);
+                GenerateMipChainRGBA(&image[0], (size_t)w * 4, &expected[0], &levels[0], (int)levels.size());
+            }
+        });
+        if (nError != 0 || (nStream && arena != expected))
+        {
+            printf("FAIL: %s\n", nStream ? "streamed chain differs" : "decode");
+            return 1;
+        }
+        printf("%-34s %10.2f %16.2f\n", nStream ? "stream 64 KB pieces + row builder" : "decode + GenerateMipChainRGBA",
+               seconds * 1000.0, (g_nPeakBytes - nBaseline) / 1048576.0);
+    }
+    return 0;
+}
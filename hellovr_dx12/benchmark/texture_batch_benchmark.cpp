@@ -0,0 +1,248 @@
+#include "TextureBatch.h"
+#include "GenMipMapRGBA.h"
+#include "WorkerPool.h"
+#include "lodepng.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+typedef unsigned char UINT8;
+
+static std::vector<UINT8> MakePNG(int nWidth, int nHeight, uint32_t nSeed, bool bInterlace = false)
+{
+    bench::Random random(nSeed);
+    std::vector<UINT8> image((size_t)nWidth * nHeight * 4);
+    for (size_t i = 0; i < image.size(); i++)
+    {
+        image[i] = (UINT8)((i / 4) % nWidth + (i / 4 / nWidth) * 3 + (random.Next() & 7));
+    }
+    lodepng::State state;
+    state.info_png.interlace_method = bInterlace ? 1 : 0;
+    std::vector<UINT8> png;
+    lodepng::encode(png, image, nWidth, nHeight, state);
+    return png;
+}
+
+// What the main thread did before: whole decode, then the chain
+static bool LoadReference(const std::vector<UINT8> &png, const MipFilterOptions &options, std::vector<MipLevelLayout> &levels,
+                          std::vector<UINT8> &arena)
+{
+    std::vector<UINT8> image;
+    unsigned nWidth, nHeight;
+    if (lodepng::decode(image, nWidth, nHeight, png) != 0)
+        return false;
+    levels.resize(GetMipChainLevelCount(nWidth, nHeight));
+    arena.assign(ComputeMipChainLayoutRGBA(nWidth, nHeight, &levels[0]), 0);
+    GenerateMipChainRGBA(&image[0], (size_t)nWidth * 4, &arena[0], &levels[0], (int)levels.size(), options);
+    return true;
+}
+
+static bool SameLevels(const std::vector<MipLevelLayout> &a, const std::vector<MipLevelLayout> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].nOffset != b[i].nOffset || a[i].nWidth != b[i].nWidth || a[i].nHeight != b[i].nHeight ||
+            a[i].nRowPitch != b[i].nRowPitch)
+            return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: every texture comes back once with the reference chain, files and
+//          blobs alike; bad sources fail; cancelling drops the rest of a
+//          batch without losing any of it; destroying a busy loader is safe
+//          and stops the texture it is decoding
+//-----------------------------------------------------------------------------
+static bool Verify()
+{
+    WorkerPool workers(4);
+    std::vector<std::vector<UINT8>> pngs;
+    for (int i = 0; i < 24; i++)
+    {
+        pngs.push_back(MakePNG(1 + i * 13 % 97, 1 + i * 29 % 83, i + 1, i % 5 == 4));
+    }
+
+    const char *pchFile = "texture_batch_benchmark.png";
+    if (lodepng_save_file(&pngs[3][0], pngs[3].size(), pchFile) != 0)
+    {
+        printf("FAIL: could not write %s\n", pchFile);
+        return false;
+    }
+
+    std::vector<UINT8> corrupt = pngs[5];
+    corrupt[corrupt.size() - 20] ^= 0xFF;
+    for (int nFilter = 0; nFilter < 2; nFilter++)
+    {
+        MipFilterOptions options;
+        options.filter = nFilter ? MipFilter::Kaiser : MipFilter::Box;
+        options.bSRGB = nFilter != 0;
+        TextureBatchLoader loader(&workers, options);
+
+        std::vector<TextureSource> sources;
+        for (auto &png : pngs)
+        {
+            sources.push_back(TextureSource::Memory(&png[0], png.size()));
+        }
+        sources.push_back(TextureSource::File(pchFile));
+        sources.push_back(TextureSource::File("missing_texture_batch_benchmark.png"));
+        sources.push_back(TextureSource::Memory(&corrupt[0], corrupt.size()));
+        int nBatch = loader.Submit(sources);
+
+        std::vector<int> seen(sources.size(), 0);
+        LoadedTexture texture;
+        while (loader.WaitNext(texture))
+        {
+            if (texture.nBatch != nBatch || texture.nIndex < 0 || texture.nIndex >= (int)sources.size() || seen[texture.nIndex]++)
+            {
+                printf("FAIL: texture %d of batch %d came back twice or was never asked for\n", texture.nIndex, texture.nBatch);
+                return false;
+            }
+            bool bShouldFail = texture.nIndex >= (int)pngs.size() + 1;
+            if (texture.bCancelled || texture.bFailed != bShouldFail)
+            {
+                printf("FAIL: source %d %s\n", texture.nIndex, texture.bFailed ? "failed" : "loaded");
+                return false;
+            }
+            if (bShouldFail)
+                continue;
+
+            std::vector<MipLevelLayout> levels;
+            std::vector<UINT8> arena;
+            const std::vector<UINT8> &png = texture.nIndex < (int)pngs.size() ? pngs[texture.nIndex] : pngs[3];
+            if (!LoadReference(png, options, levels, arena) || !SameLevels(levels, texture.mipLevels) || arena != texture.mipChain)
+            {
+                printf("FAIL: source %d (%dx%d %s) chain differs\n", texture.nIndex, texture.nWidth, texture.nHeight,
+                       GetMipFilterName(options.filter));
+                return false;
+            }
+        }
+        if (loader.Pending() != 0)
+        {
+            printf("FAIL: %d textures never came back\n", loader.Pending());
+            return false;
+        }
+    }
+    remove(pchFile);
+
+    // one texture at a time, so cancelling after the first leaves most of the batch unstarted
+    WorkerPool single(1);
+    std::vector<UINT8> big = MakePNG(512, 512, 7);
+    {
+        TextureBatchLoader loader(&single);
+        CancellationToken cancel, before;
+        before.Cancel();
+        loader.Submit(std::vector<TextureSource>(32, TextureSource::Memory(&big[0], big.size())), cancel);
+        loader.Submit(std::vector<TextureSource>(8, TextureSource::Memory(&big[0], big.size())), before);
+        int nLoaded = 0, nCancelled = 0;
+        LoadedTexture texture;
+        while (loader.WaitNext(texture))
+        {
+            cancel.Cancel();
+            nLoaded += !texture.bCancelled && !texture.bFailed;
+            nCancelled += texture.bCancelled;
+            if (texture.bCancelled && !texture.mipChain.empty())
+            {
+                printf("FAIL: a cancelled texture kept its chain\n");
+                return false;
+            }
+        }
+        if (nLoaded + nCancelled != 40 || nLoaded < 1 || nCancelled < 38)
+        {
+            printf("FAIL: %d loaded and %d cancelled of 40\n", nLoaded, nCancelled);
+            return false;
+        }
+    }
+    {
+        // gone with most of its work still queued
+        TextureBatchLoader loader(&single);
+        loader.Submit(std::vector<TextureSource>(16, TextureSource::Memory(&big[0], big.size())));
+    }
+
+    // gone part way through a large texture: it stops at the next row, not after the whole chain
+    std::vector<UINT8> huge = MakePNG(2048, 2048, 11);
+    double decode = bench::MeasureBest(1, [&]() {
+        std::vector<MipLevelLayout> levels;
+        std::vector<UINT8> arena;
+        LoadReference(huge, MipFilterOptions(), levels, arena);
+    });
+    double shutdown;
+    {
+        auto pLoader = std::make_unique<TextureBatchLoader>(&single);
+        pLoader->Submit({TextureSource::Memory(&huge[0], huge.size())});
+        std::this_thread::sleep_for(std::chrono::duration<double>(decode / 4));
+        shutdown = bench::MeasureBest(1, [&]() { pLoader.reset(); });
+    }
+    if (shutdown > decode / 4)
+    {
+        printf("FAIL: shutdown took %.1f ms against %.1f ms for the whole texture\n", shutdown * 1000.0, decode * 1000.0);
+        return false;
+    }
+    printf("batches match the single threaded decode, cancel and shutdown drain cleanly\n\n");
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const int nCount = argc > 1 ? atoi(argv[1]) : 64;
+    const int nSize = argc > 2 ? atoi(argv[2]) : 512;
+    if (!Verify())
+        return 1;
+
+    // a spread of sizes, like a scene's worth of textures
+    std::vector<std::vector<UINT8>> pngs;
+    std::vector<TextureSource> sources;
+    size_t nPixels = 0;
+    for (int i = 0; i < nCount; i++)
+    {
+        int nWidth = nSize >> (i % 3), nHeight = nSize >> ((i + 1) % 3);
+        pngs.push_back(MakePNG(nWidth, nHeight, i + 1));
+        nPixels += (size_t)nWidth * nHeight;
+    }
+    for (auto &png : pngs)
+    {
+        sources.push_back(TextureSource::Memory(&png[0], png.size()));
+    }
+
+    printf("%d textures up to %dx%d, %.1f MB of RGBA, %u hardware threads\n", nCount, nSize, nSize, nPixels * 4 / 1048576.0,
+           std::thread::hardware_concurrency());
+    printf("%-26s %8s %10s %8s\n", "path", "threads", "wall ms", "speedup");
+    double serial = bench::MeasureBest(3, [&]() {
+        for (auto &png : pngs)
+        {
+            std::vector<MipLevelLayout> levels;
+            std::vector<UINT8> arena;
+            LoadReference(png, MipFilterOptions(), levels, arena);
+        }
+    });
+    printf("%-26s %8d %10.1f %7.2fx\n", "decode + mips, one by one", 1, serial * 1000.0, 1.0);
+
+    const int threads[] = {1, 2, 4, 8, 16};
+    for (int nThreads : threads)
+    {
+        WorkerPool workers(nThreads);
+        int nLoaded = 0;
+        double seconds = bench::MeasureBest(3, [&]() {
+            TextureBatchLoader loader(&workers);
+            loader.Submit(sources);
+            LoadedTexture texture;
+            nLoaded = 0;
+            while (loader.WaitNext(texture))
+            {
+                nLoaded += !texture.bFailed && !texture.bCancelled;
+            }
+        });
+        if (nLoaded != nCount)
+        {
+            printf("FAIL: %d of %d textures loaded\n", nLoaded, nCount);
+            return 1;
+        }
+        printf("%-26s %8d %10.1f %7.2fx\n", "TextureBatchLoader", nThreads, seconds * 1000.0, serial / seconds);
+    }
+    return 0;
+}
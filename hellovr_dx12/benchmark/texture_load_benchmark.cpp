@@ -0,0 +1,198 @@
+#include "CookedTexture.h"
+#include "GenMipMapRGBA.h"
+#include "lodepng.h"
+#include "bench.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+typedef unsigned char UINT8;
+
+// smooth gradients with a little noise, so the PNG compresses like a real texture
+static std::vector<UINT8> MakeImage(int nWidth, int nHeight)
+{
+    bench::Random random;
+    std::vector<UINT8> image((size_t)nWidth * nHeight * 4);
+    for (int y = 0; y < nHeight; y++)
+    {
+        for (int x = 0; x < nWidth; x++)
+        {
+            UINT8 *p = &image[((size_t)y * nWidth + x) * 4];
+            UINT8 noise = (UINT8)(random.Next() & 7);
+            p[0] = (UINT8)(x * 255 / nWidth + noise);
+            p[1] = (UINT8)(y * 255 / nHeight + noise);
+            p[2] = (UINT8)(((x / 64) ^ (y / 64)) & 1 ? 200 : 40);
+            p[3] = 255;
+        }
+    }
+    return image;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: evict a file from the OS cache so the next load pays for the disk.
+//          Only possible on Linux; elsewhere cold numbers are not reported.
+//-----------------------------------------------------------------------------
+static bool DropFileCache(const std::string &strPath)
+{
+#ifdef __linux__
+    int fd = open(strPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    fdatasync(fd);
+    bool bDropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return bDropped;
+#else
+    (void)strPath;
+    return false;
+#endif
+}
+
+// startup with a PNG: decode, then build the chain into the upload heap
+static bool LoadPNG(const std::string &strPath, std::vector<UINT8> &upload)
+{
+    std::vector<UINT8> imageRGBA;
+    unsigned nWidth, nHeight;
+    if (lodepng::decode(imageRGBA, nWidth, nHeight, strPath) != 0)
+        return false;
+    std::vector<MipLevelLayout> levels(GetMipChainLevelCount(nWidth, nHeight));
+    ComputeMipChainLayoutRGBA(nWidth, nHeight, levels.data());
+    GenerateMipChainRGBA(imageRGBA.data(), nWidth * 4, upload.data(), levels.data(), (int)levels.size());
+    return true;
+}
+
+// startup with a cooked file: map it and copy rows the way UpdateSubresources does
+static bool LoadCooked(const std::string &strCookedPath, const std::string &strSourcePath, std::vector<UINT8> &upload)
+{
+    CookedTexture cooked;
+    if (!cooked.Open(strCookedPath, strSourcePath, MipFilterOptions()))
+        return false;
+    for (int nMip = 0; nMip < cooked.MipLevels(); nMip++)
+    {
+        const CookedSubresource &sub = cooked.Subresource(nMip);
+        const UINT8 *pSrc = cooked.SubresourceData(nMip);
+        UINT8 *pDst = upload.data() + sub.nOffset;
+        for (int y = 0; y < cooked.SubresourceRows(nMip); y++)
+        {
+            memcpy(pDst + (size_t)y * sub.nRowPitch, pSrc + (size_t)y * sub.nRowPitch, cooked.SubresourceRowBytes(nMip));
+        }
+    }
+    return true;
+}
+
+static bool VerifyCooked(const std::string &strCookedPath, const std::string &strSourcePath,
+                         const std::vector<UINT8> &image, int nSize)
+{
+    std::vector<MipLevelLayout> levels(GetMipChainLevelCount(nSize, nSize));
+    size_t nArenaSize = ComputeMipChainLayoutRGBA(nSize, nSize, levels.data());
+    std::vector<UINT8> expected(nArenaSize), loaded(nArenaSize);
+    GenerateMipChainRGBA(image.data(), nSize * 4, expected.data(), levels.data(), (int)levels.size());
+    if (!LoadCooked(strCookedPath, strSourcePath, loaded) || loaded != expected)
+    {
+        printf("FAIL: cooked payload differs from a generated chain\n");
+        return false;
+    }
+
+    CookedTexture cooked;
+    MipFilterOptions other;
+    other.bSRGB = true;
+    if (cooked.Open(strCookedPath, strSourcePath, other))
+    {
+        printf("FAIL: cooked file accepted for other filter options\n");
+        return false;
+    }
+    if (cooked.Open(strCookedPath + ".missing", strSourcePath, MipFilterOptions()))
+    {
+        printf("FAIL: missing cooked file opened\n");
+        return false;
+    }
+
+    // the top level footprint halved: every offset and pitch still fits the payload
+    std::ifstream in(strCookedPath, std::ios::binary);
+    std::vector<char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CookedSubresource *pTop = reinterpret_cast<CookedSubresource *>(&file[sizeof(CookedTextureHeader)]);
+    pTop->nWidth /= 2;
+    pTop->nHeight /= 2;
+    std::string strCorruptPath = strCookedPath + ".corrupt";
+    std::ofstream(strCorruptPath, std::ios::binary).write(file.data(), (std::streamsize)file.size());
+    bool bOpened = cooked.Open(strCorruptPath, strSourcePath, MipFilterOptions());
+    cooked.Close();
+    remove(strCorruptPath.c_str());
+    if (bOpened)
+    {
+        printf("FAIL: cooked file with a wrong subresource size opened\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int nSize = argc > 1 ? atoi(argv[1]) : 2048;
+    std::string strSourcePath = "texture_load_benchmark.png";
+    std::string strCookedPath = GetCookedTexturePath(strSourcePath);
+    std::string strBC1Path = "texture_load_benchmark_bc1.hvrtex";
+
+    auto image = MakeImage(nSize, nSize);
+    if (lodepng::encode(strSourcePath, image, nSize, nSize) != 0 ||
+        !CookTexture(strSourcePath, strCookedPath, MipFilterOptions()) ||
+        !CookTexture(strSourcePath, strBC1Path, MipFilterOptions(), CookedFormat::BC1))
+    {
+        printf("FAIL: could not write %s / %s\n", strSourcePath.c_str(), strCookedPath.c_str());
+        return 1;
+    }
+    if (!VerifyCooked(strCookedPath, strSourcePath, image, nSize))
+        return 1;
+
+    std::vector<MipLevelLayout> levels(GetMipChainLevelCount(nSize, nSize));
+    std::vector<UINT8> upload(ComputeMipChainLayoutRGBA(nSize, nSize, levels.data()), 0);
+
+    printf("%dx%d texture, png %.1f MB decoded, cooked payload %.1f MB\n", nSize, nSize,
+           image.size() / 1e6, upload.size() / 1e6);
+    printf("%-10s %-6s %10s\n", "path", "cache", "ms");
+
+    const int nIterations = 5;
+    double warmPNG = bench::MeasureBest(nIterations, [&]() { LoadPNG(strSourcePath, upload); });
+    double warmCooked = bench::MeasureBest(nIterations, [&]() { LoadCooked(strCookedPath, strSourcePath, upload); });
+    double warmBC1 = bench::MeasureBest(nIterations, [&]() { LoadCooked(strBC1Path, strSourcePath, upload); });
+    printf("%-10s %-6s %10.2f\n", "png", "warm", warmPNG * 1000.0);
+    printf("%-10s %-6s %10.2f   %.1fx faster\n", "cooked", "warm", warmCooked * 1000.0, warmPNG / warmCooked);
+    printf("%-10s %-6s %10.2f   %.1fx faster\n", "cooked-bc1", "warm", warmBC1 * 1000.0, warmPNG / warmBC1);
+
+    if (DropFileCache(strSourcePath) && DropFileCache(strCookedPath) && DropFileCache(strBC1Path))
+    {
+        // drop the cache before every run, outside the timed region
+        auto MeasureCold = [&](const std::string &strDrop, auto &&load) {
+            double best = 1e30;
+            for (int i = 0; i < nIterations; i++)
+            {
+                DropFileCache(strDrop);
+                best = std::min(best, bench::MeasureBest(1, load));
+            }
+            return best;
+        };
+        double coldPNG = MeasureCold(strSourcePath, [&]() { LoadPNG(strSourcePath, upload); });
+        double coldCooked = MeasureCold(strCookedPath, [&]() { LoadCooked(strCookedPath, strSourcePath, upload); });
+        double coldBC1 = MeasureCold(strBC1Path, [&]() { LoadCooked(strBC1Path, strSourcePath, upload); });
+        printf("%-10s %-6s %10.2f\n", "png", "cold", coldPNG * 1000.0);
+        printf("%-10s %-6s %10.2f   %.1fx faster\n", "cooked", "cold", coldCooked * 1000.0, coldPNG / coldCooked);
+        printf("%-10s %-6s %10.2f   %.1fx faster\n", "cooked-bc1", "cold", coldBC1 * 1000.0, coldPNG / coldBC1);
+    }
+    else
+    {
+        printf("cold cache timings need posix_fadvise, skipped\n");
+    }
+
+    remove(strSourcePath.c_str());
+    remove(strCookedPath.c_str());
+    remove(strBC1Path.c_str());
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "Matrices.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// The scene's vertex: position then texture coordinate
+struct Vertex
+{
+    float position[3];
+    float texCoord[2];
+};
+
+static Matrix4 MakeMatrix(bench::Random &random)
+{
+    Matrix4 mat;
+    mat.scale(random.NextFloat(0.1f, 2.0f));
+    mat.rotate(random.NextFloat(-180.0f, 180.0f), random.NextFloat(-1, 1), random.NextFloat(-1, 1), 1);
+    mat.translate(random.NextFloat(-40, 40), random.NextFloat(-40, 40), random.NextFloat(-40, 40));
+    return mat;
+}
+
+// What the geometry builders did: a Vector4 product per point
+static void TransformOneByOne(const Matrix4 &mat, const Vector3 *pPoints, Vertex *pVertices, size_t nCount)
+{
+    for (size_t i = 0; i < nCount; i++)
+    {
+        Vector4 v = mat * Vector4(pPoints[i].x, pPoints[i].y, pPoints[i].z, 1);
+        pVertices[i].position[0] = v.x;
+        pVertices[i].position[1] = v.y;
+        pVertices[i].position[2] = v.z;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: batches give exactly the per-point results for every count and
+//          stride, and touch nothing but x,y,z of each vertex
+//-----------------------------------------------------------------------------
+static bool Verify()
+{
+    bench::Random random(23);
+    const size_t dstStrides[] = {12, 16, 20, 24};
+    for (size_t nCount = 0; nCount < 70; nCount++)
+    {
+        for (size_t nDstStride : dstStrides)
+        {
+            Matrix4 mat = MakeMatrix(random);
+            // sized exactly, so a read or write past the end shows up under ASan
+            std::vector<float> xs(nCount), ys(nCount), zs(nCount);
+            for (size_t i = 0; i < nCount; i++)
+            {
+                xs[i] = random.NextFloat(-100, 100);
+                ys[i] = random.NextFloat(-100, 100);
+                zs[i] = random.NextFloat(-100, 100);
+            }
+
+            std::vector<float> expected(nCount * nDstStride / 4, -7.0f), batch = expected;
+            for (size_t i = 0; i < nCount; i++)
+            {
+                Vector4 v = mat * Vector4(xs[i], ys[i], zs[i], 1);
+                float *p = &expected[i * nDstStride / 4];
+                p[0] = v.x;
+                p[1] = v.y;
+                p[2] = v.z;
+            }
+            transformPoints(mat, xs.data(), ys.data(), zs.data(), batch.data(), nDstStride, nCount);
+            if (nCount && memcmp(batch.data(), expected.data(), expected.size() * 4) != 0)
+            {
+                printf("FAIL: %zu points, stride %zu differ from mat * Vector4\n", nCount, nDstStride);
+                return false;
+            }
+        }
+    }
+    printf("batches match mat * Vector4 exactly for 0-69 points and every stride\n\n");
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!Verify())
+        return 1;
+
+    size_t counts[] = {1000, 100000, 10000000};
+    if (argc > 1)
+    {
+        counts[2] = (size_t)atoll(argv[1]);
+    }
+#if MATRICES_AVX
+    printf("points into a 20 byte vertex stream, 8 wide (AVX)\n");
+#elif MATRICES_SSE
+    printf("points into a 20 byte vertex stream, 4 wide (SSE)\n");
+#else
+    printf("points into a 20 byte vertex stream, scalar\n");
+#endif
+    printf("%10s %14s %12s %9s\n", "points", "one by one ns", "batch ns", "batch");
+
+    bench::Random random(3);
+    Matrix4 mat = MakeMatrix(random);
+    for (size_t nCount : counts)
+    {
+        std::vector<Vector3> points(nCount);
+        std::vector<float> xs(nCount), ys(nCount), zs(nCount);
+        for (size_t i = 0; i < nCount; i++)
+        {
+            points[i] = Vector3(random.NextFloat(-10, 10), random.NextFloat(-10, 10), random.NextFloat(-10, 10));
+            xs[i] = points[i].x;
+            ys[i] = points[i].y;
+            zs[i] = points[i].z;
+        }
+        std::vector<Vertex> vertices(nCount);
+
+        const int nIterations = bench::IterationsFor(nCount * (sizeof(Vector3) + sizeof(Vertex)));
+        double one = bench::MeasureBest(nIterations, [&]() { TransformOneByOne(mat, points.data(), vertices.data(), nCount); });
+        double batch = bench::MeasureBest(nIterations, [&]() {
+            transformPoints(mat, xs.data(), ys.data(), zs.data(), vertices[0].position, sizeof(Vertex), nCount);
+        });
+        printf("%10zu %14.2f %12.2f %8.2fx\n", nCount, one * 1e9 / nCount, batch * 1e9 / nCount, one / batch);
+    }
+    return 0;
+}
@@ -0,0 +1,308 @@
+#include "VoxelMesh.h"
+#include "WorkerPool.h"
+#include "bench.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const int N = VoxelVolume::k_nChunkSize;
+
+// outward normal of each face, -x +x -y +y -z +z
+static const int s_normals[6][3] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+static bool FaceVisible(const VoxelVolume &voxels, int x, int y, int z, int nFace)
+{
+    return voxels.Get(x, y, z) && !voxels.Get(x + s_normals[nFace][0], y + s_normals[nFace][1], z + s_normals[nFace][2]);
+}
+
+// Unit faces of every solid voxel facing an empty one, what the mesh has to cover
+static uint64_t CountVisibleFaces(const VoxelVolume &voxels)
+{
+    uint64_t nFaces = 0;
+    for (int z = 0; z < voxels.Depth(); z++)
+        for (int y = 0; y < voxels.Height(); y++)
+            for (int x = 0; x < voxels.Width(); x++)
+                for (int nFace = 0; nFace < 6; nFace++)
+                    nFaces += FaceVisible(voxels, x, y, z, nFace);
+    return nFaces;
+}
+
+static uint64_t VertexCount(const std::vector<std::vector<uint32_t>> &chunkVertices)
+{
+    uint64_t nVertices = 0;
+    for (const std::vector<uint32_t> &vertices : chunkVertices)
+    {
+        nVertices += vertices.size();
+    }
+    return nVertices;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: every quad is two anticlockwise triangles of one face, and split
+//          back into unit faces the quads cover each visible face exactly once
+//          and nothing else
+//-----------------------------------------------------------------------------
+static bool VerifyMesh(const VoxelVolume &voxels, const char *pName)
+{
+    std::vector<std::vector<uint32_t>> chunkVertices;
+    voxels.MeshChunks(chunkVertices);
+    std::vector<uint8_t> covered((size_t)voxels.Width() * voxels.Height() * voxels.Depth(), 0);
+    uint64_t nCovered = 0;
+    for (int nChunk = 0; nChunk < voxels.ChunkCount(); nChunk++)
+    {
+        const std::vector<uint32_t> &vertices = chunkVertices[nChunk];
+        if (vertices.size() % VoxelVolume::k_nVerticesPerQuad)
+        {
+            printf("FAIL %s: %zu vertices is not whole quads\n", pName, vertices.size());
+            return false;
+        }
+        const int cx = nChunk % voxels.ChunksX();
+        const int cy = nChunk / voxels.ChunksX() % voxels.ChunksY();
+        const int cz = nChunk / (voxels.ChunksX() * voxels.ChunksY());
+        for (size_t i = 0; i < vertices.size(); i += VoxelVolume::k_nVerticesPerQuad)
+        {
+            const uint32_t *pQuad = &vertices[i];
+            const int nFace = VoxelVolume::VertexFace(pQuad[0]);
+            int p[6][3];
+            for (int j = 0; j < 6; j++)
+            {
+                p[j][0] = VoxelVolume::VertexX(pQuad[j]);
+                p[j][1] = VoxelVolume::VertexY(pQuad[j]);
+                p[j][2] = VoxelVolume::VertexZ(pQuad[j]);
+                if (VoxelVolume::VertexFace(pQuad[j]) != nFace || p[j][0] > N || p[j][1] > N || p[j][2] > N)
+                {
+                    printf("FAIL %s: a quad's vertices are not of one face in the chunk\n", pName);
+                    return false;
+                }
+            }
+            if (nFace > 5 || pQuad[2] != pQuad[3] || pQuad[5] != pQuad[0])
+            {
+                printf("FAIL %s: not a quad of two triangles\n", pName);
+                return false;
+            }
+            int e1[3], e2[3], lo[3], hi[3];
+            for (int k = 0; k < 3; k++)
+            {
+                e1[k] = p[1][k] - p[0][k];
+                e2[k] = p[2][k] - p[0][k];
+                lo[k] = std::min(std::min(p[0][k], p[1][k]), std::min(p[2][k], p[4][k]));
+                hi[k] = std::max(std::max(p[0][k], p[1][k]), std::max(p[2][k], p[4][k]));
+            }
+            const int normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            const int nAxis = nFace / 2;
+            const bool bOutward = normal[nAxis] * s_normals[nFace][nAxis] > 0 && normal[(nAxis + 1) % 3] == 0 && normal[(nAxis + 2) % 3] == 0;
+            if (!bOutward || lo[nAxis] != hi[nAxis])
+            {
+                printf("FAIL %s: a quad of face %d is flat the wrong way or wound inwards\n", pName, nFace);
+                return false;
+            }
+
+            // the voxel behind each unit face of the quad
+            const int nBehind = nFace & 1 ? -1 : 0;
+            for (int z = lo[2]; z < std::max(hi[2], lo[2] + 1); z++)
+            {
+                for (int y = lo[1]; y < std::max(hi[1], lo[1] + 1); y++)
+                {
+                    for (int x = lo[0]; x < std::max(hi[0], lo[0] + 1); x++)
+                    {
+                        int v[3] = {cx * N + x, cy * N + y, cz * N + z};
+                        v[nAxis] += nBehind;
+                        if (!FaceVisible(voxels, v[0], v[1], v[2], nFace))
+                        {
+                            printf("FAIL %s: face %d of (%d, %d, %d) is meshed but hidden\n", pName, nFace, v[0], v[1], v[2]);
+                            return false;
+                        }
+                        uint8_t &bits = covered[((size_t)v[2] * voxels.Height() + v[1]) * voxels.Width() + v[0]];
+                        if (bits & (1 << nFace))
+                        {
+                            printf("FAIL %s: face %d of (%d, %d, %d) is meshed twice\n", pName, nFace, v[0], v[1], v[2]);
+                            return false;
+                        }
+                        bits |= 1 << nFace;
+                        nCovered++;
+                    }
+                }
+            }
+        }
+    }
+    uint64_t nVisible = CountVisibleFaces(voxels);
+    if (nCovered != nVisible)
+    {
+        printf("FAIL %s: %llu of %llu visible faces meshed\n", pName, (unsigned long long)nCovered, (unsigned long long)nVisible);
+        return false;
+    }
+    return true;
+}
+
+static bool Verify()
+{
+    // volumes that do not fill their last chunks, every kind of neighbour across chunk edges
+    bench::Random random(11);
+    for (int nDensity : {10, 50, 90})
+    {
+        VoxelVolume voxels(70, 45, 97, Vector3(0, 0, 0), 1.0f);
+        for (int z = 0; z < voxels.Depth(); z++)
+            for (int y = 0; y < voxels.Height(); y++)
+                for (int x = 0; x < voxels.Width(); x++)
+                    voxels.Set(x, y, z, (int)(random.Next() % 100) < nDensity);
+        char name[32];
+        snprintf(name, sizeof(name), "noise %d%%", nDensity);
+        if (!VerifyMesh(voxels, name))
+            return false;
+    }
+    // boxes, which merge into big quads that cross rows and chunk boundaries
+    {
+        VoxelVolume voxels(100, 100, 100, Vector3(0, 0, 0), 1.0f);
+        for (int nBox = 0; nBox < 40; nBox++)
+        {
+            int x0 = random.Next() % 100, y0 = random.Next() % 100, z0 = random.Next() % 100;
+            int x1 = x0 + random.Next() % 40, y1 = y0 + random.Next() % 40, z1 = z0 + random.Next() % 40;
+            bool bSolid = nBox % 4 != 3;
+            for (int z = z0; z < z1; z++)
+                for (int y = y0; y < y1; y++)
+                    for (int x = x0; x < x1; x++)
+                        voxels.Set(x, y, z, bSolid);
+        }
+        if (!VerifyMesh(voxels, "boxes"))
+            return false;
+    }
+
+    // cubes sit on their voxels, and an empty chunk has no vertices
+    for (float fSpacing : {1.0f, 2.0f, 3.0f, 4.0f, 1.4f})
+    {
+        for (int nSize : {1, 10, 33})
+        {
+            CubeVolume volume(nSize, nSize + 1, nSize + 2, 0.3f, fSpacing);
+            VoxelVolume voxels = VoxelVolume::FromCubes(volume);
+            const int nPitch = std::max(1, (int)lroundf(fSpacing));
+            int nSolid = 0;
+            for (int z = 0; z < voxels.Depth(); z++)
+                for (int y = 0; y < voxels.Height(); y++)
+                    for (int x = 0; x < voxels.Width(); x++)
+                    {
+                        bool bCube = x % nPitch == 0 && y % nPitch == 0 && z % nPitch == 0;
+                        if (voxels.Get(x, y, z) != bCube)
+                        {
+                            printf("FAIL: voxel (%d, %d, %d) of spacing %g\n", x, y, z, fSpacing);
+                            return false;
+                        }
+                        nSolid += bCube;
+                    }
+            if (nSolid != volume.CubeCount())
+            {
+                printf("FAIL: %d voxels for %d cubes\n", nSolid, volume.CubeCount());
+                return false;
+            }
+            if (fSpacing == nPitch)
+            {
+                int nLast = voxels.ChunkCount() - 1;
+                VoxelVolume::ChunkPlacement placement = voxels.Placement(nLast);
+                Vector3 corner = volume.CubeCorner((voxels.ChunksX() - 1) * N / nPitch, (voxels.ChunksY() - 1) * N / nPitch, (voxels.ChunksZ() - 1) * N / nPitch);
+                float fOffset[3] = {(float)((voxels.ChunksX() - 1) * N % nPitch), (float)((voxels.ChunksY() - 1) * N % nPitch), (float)((voxels.ChunksZ() - 1) * N % nPitch)};
+                if (fabsf(placement.x - (corner.x + fOffset[0] * placement.fVoxelSize)) > 1e-3f ||
+                    fabsf(placement.y - (corner.y + fOffset[1] * placement.fVoxelSize)) > 1e-3f ||
+                    fabsf(placement.z - (corner.z + fOffset[2] * placement.fVoxelSize)) > 1e-3f || placement.fVoxelSize != volume.Scale())
+                {
+                    printf("FAIL: chunks are not placed on the cubes at spacing %g\n", fSpacing);
+                    return false;
+                }
+            }
+            if (!VerifyMesh(voxels, "cubes"))
+                return false;
+            std::vector<uint32_t> vertices;
+            for (int nChunk = 0; nChunk < voxels.ChunkCount(); nChunk++)
+            {
+                voxels.MeshChunk(nChunk, vertices);
+                if (voxels.ChunkEmpty(nChunk) && !vertices.empty())
+                {
+                    printf("FAIL: an empty chunk has vertices\n");
+                    return false;
+                }
+            }
+        }
+    }
+    printf("every visible face meshed exactly once, nothing hidden, all quads wound outwards, cubes on their voxels\n\n");
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: triangles against baking every cube and against only dropping
+//          hidden faces, and how fast chunks mesh on one thread and on all
+//-----------------------------------------------------------------------------
+static void Measure(const char *pName, const VoxelVolume &voxels, uint64_t nCubes, WorkerPool &workers)
+{
+    int nMeshed = 0;
+    for (int nChunk = 0; nChunk < voxels.ChunkCount(); nChunk++)
+    {
+        nMeshed += !voxels.ChunkEmpty(nChunk);
+    }
+    std::vector<std::vector<uint32_t>> chunkVertices;
+    double fSerial = bench::MeasureBest(3, [&]() { voxels.MeshChunks(chunkVertices); });
+    double fParallel = bench::MeasureBest(3, [&]() { voxels.MeshChunks(chunkVertices, &workers); });
+
+    const uint64_t nBaked = nCubes * 12;
+    const uint64_t nCulled = CountVisibleFaces(voxels) * 2;
+    const uint64_t nGreedy = VertexCount(chunkVertices) / 3;
+    const double fBakedKB = nCubes * CubeVolume::k_nVerticesPerCube * CubeVolume::k_nFloatsPerVertex * sizeof(float) / 1024.0;
+    const double fMeshedKB = (nGreedy * 3 * sizeof(uint32_t) + voxels.ChunkCount() * sizeof(VoxelVolume::ChunkPlacement)) / 1024.0;
+    printf("%-18s %7d %12llu %11llu %11llu %8.0fx %10.0f %9.0f %8.1f %10.0f %10.0f\n", pName, nMeshed, (unsigned long long)nBaked,
+           (unsigned long long)nCulled, (unsigned long long)nGreedy, (double)nBaked / std::max<uint64_t>(nGreedy, 1), fBakedKB, fMeshedKB,
+           fSerial * 1e3, nMeshed / fSerial, nMeshed / fParallel);
+}
+
+int main(int argc, char *argv[])
+{
+    const int nMaxSize = argc > 1 ? atoi(argv[1]) : 256;
+    if (!Verify())
+        return 1;
+
+    WorkerPool workers;
+    printf("%d worker threads, triangles and chunks/s over chunks with voxels\n", workers.ThreadCount());
+    printf("%-18s %7s %12s %11s %11s %9s %10s %9s %8s %10s %10s\n", "volume", "chunks", "baked tris", "culled", "greedy", "vs baked",
+           "baked KB", "mesh KB", "mesh ms", "chunk/s", "chunk/s mt");
+    for (int nSize : {64, 128, 256})
+    {
+        if (nSize > nMaxSize)
+            break;
+        char name[32];
+        CubeVolume solid(nSize, nSize, nSize, 0.3f, 1.0f);
+        snprintf(name, sizeof(name), "%d^3 spacing 1", nSize);
+        Measure(name, VoxelVolume::FromCubes(solid), solid.CubeCount(), workers);
+
+        CubeVolume sparse(nSize / 2, nSize / 2, nSize / 2, 0.3f, 4.0f);
+        snprintf(name, sizeof(name), "%d^3 spacing 4", nSize / 2);
+        Measure(name, VoxelVolume::FromCubes(sparse), sparse.CubeCount(), workers);
+    }
+
+    // rolling hills and random noise, what a general voxel scene looks like and the worst case
+    const int nSize = std::min(nMaxSize, 256);
+    VoxelVolume terrain(nSize, nSize / 4, nSize, Vector3(0, 0, 0), 1.0f);
+    uint64_t nTerrain = 0;
+    for (int z = 0; z < terrain.Depth(); z++)
+        for (int x = 0; x < terrain.Width(); x++)
+        {
+            int nHeight = (int)(terrain.Height() * (0.5f + 0.25f * sinf(x * 0.05f) * cosf(z * 0.07f) + 0.1f * sinf((x + z) * 0.21f)));
+            for (int y = 0; y < nHeight; y++)
+            {
+                terrain.Set(x, y, z, true);
+                nTerrain++;
+            }
+        }
+    Measure("terrain", terrain, nTerrain, workers);
+
+    bench::Random random(5);
+    VoxelVolume noise(nSize / 2, nSize / 2, nSize / 2, Vector3(0, 0, 0), 1.0f);
+    uint64_t nNoise = 0;
+    for (int z = 0; z < noise.Depth(); z++)
+        for (int y = 0; y < noise.Height(); y++)
+            for (int x = 0; x < noise.Width(); x++)
+            {
+                bool bSolid = random.Next() & 1;
+                noise.Set(x, y, z, bSolid);
+                nNoise += bSolid;
+            }
+    Measure("noise 50%", noise, nNoise, workers);
+    return 0;
+}
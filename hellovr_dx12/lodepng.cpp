@@ -30,8 +30,10 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 
 #include "lodepng.h"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef LODEPNG_COMPILE_CPP
 #include <fstream>
@@ -83,6 +85,154 @@ void* lodepng_realloc(void* ptr, size_t new_size);
 void lodepng_free(void* ptr);
 #endif /*LODEPNG_COMPILE_ALLOCATORS*/
 
+#ifdef LODEPNG_COMPILE_DECODER
+/*
+Scratch arena. While a decode has it open, lodepng_malloc and lodepng_realloc are served
+from one block per thread, sized from the IHDR and the file before the IDAT data is read.
+Allocations stack up: lodepng_free of the newest one gives its memory back, others wait
+for the end of the decode, and the newest one grows in place. Only memory freed before
+the decode returns may come from it: the output image and what readChunk puts in
+LodePNGInfo are allocated with the arena paused. At the end the block is reset for the
+next image on the thread. Images needing more than LODEPNG_SCRATCH_KEEP bytes of scratch
+use the heap as before, a block that size would not be kept anyway.
+*/
+#ifndef LODEPNG_SCRATCH_KEEP
+#define LODEPNG_SCRATCH_KEEP (16u << 20)
+#endif
+#define SCRATCH_ALIGN 16u /*every allocation starts with its size and the previous one's offset in a header this big*/
+#define SCRATCH_NONE ((size_t)(-1))
+#define SCRATCH_SLACK 65536u /*for the headers and the inflater's state*/
+
+typedef struct ScratchArena
+{
+  unsigned char* data;
+  size_t capacity;
+  size_t used;
+  size_t last; /*offset of the newest allocation's header, the one that can grow or be freed*/
+  unsigned active;
+} ScratchArena;
+
+static thread_local ScratchArena scratch_arena = {0, 0, 0, 0, 0};
+
+static unsigned scratch_owns(const void* ptr)
+{
+  const ScratchArena* a = &scratch_arena;
+  return a->data && (const unsigned char*)ptr >= a->data && (const unsigned char*)ptr < a->data + a->capacity;
+}
+
+static void* scratch_malloc(size_t size)
+{
+  ScratchArena* a = &scratch_arena;
+  size_t need = SCRATCH_ALIGN + ((size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1));
+  if(a->active && need > size && a->capacity - a->used >= need)
+  {
+    unsigned char* header = a->data + a->used;
+    ((size_t*)header)[0] = size;
+    ((size_t*)header)[1] = a->last;
+    a->last = a->used;
+    a->used += need;
+    return header + SCRATCH_ALIGN;
+  }
+  return lodepng_malloc(size);
+}
+
+static void scratch_free(void* ptr)
+{
+  ScratchArena* a = &scratch_arena;
+  if(!scratch_owns(ptr))
+  {
+    lodepng_free(ptr);
+    return;
+  }
+  if((size_t)((unsigned char*)ptr - a->data) - SCRATCH_ALIGN == a->last)
+  {
+    a->used = a->last;
+    a->last = ((size_t*)(a->data + a->last))[1];
+  }
+}
+
+static void* scratch_realloc(void* ptr, size_t new_size)
+{
+  ScratchArena* a = &scratch_arena;
+  unsigned char* header;
+  size_t offset, oldsize, need;
+  void* data;
+  if(!ptr) return scratch_malloc(new_size);
+  if(!scratch_owns(ptr)) return lodepng_realloc(ptr, new_size);
+
+  header = (unsigned char*)ptr - SCRATCH_ALIGN;
+  offset = (size_t)(header - a->data);
+  oldsize = ((size_t*)header)[0];
+  need = SCRATCH_ALIGN + ((new_size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1));
+  if(offset == a->last && need > new_size && a->capacity - offset >= need)
+  {
+    /*the newest allocation, grow or shrink it where it is*/
+    ((size_t*)header)[0] = new_size;
+    a->used = offset + need;
+    return ptr;
+  }
+  if(new_size <= oldsize) return ptr;
+
+  data = scratch_malloc(new_size);
+  if(!data) return 0;
+  memcpy(data, ptr, oldsize);
+  scratch_free(ptr);
+  return data;
+}
+
+/*returns 1 when this call opened the arena, for scratch_end. Nested decodes share the outer one*/
+static unsigned scratch_begin(size_t reserve)
+{
+  ScratchArena* a = &scratch_arena;
+  if(a->active || reserve > LODEPNG_SCRATCH_KEEP - SCRATCH_SLACK) return 0;
+  reserve += SCRATCH_SLACK;
+  if(a->capacity < reserve)
+  {
+    lodepng_free(a->data);
+    a->data = (unsigned char*)lodepng_malloc(reserve);
+    a->capacity = a->data ? reserve : 0;
+  }
+  a->used = 0;
+  a->last = SCRATCH_NONE;
+  a->active = a->data != 0;
+  return a->active;
+}
+
+static void scratch_end(unsigned opened)
+{
+  if(!opened) return;
+  scratch_arena.active = 0;
+  scratch_arena.used = 0;
+}
+
+/*allocations between these two go to the heap, for memory that outlives the decode*/
+static unsigned scratch_pause(void)
+{
+  unsigned active = scratch_arena.active;
+  scratch_arena.active = 0;
+  return active;
+}
+
+static void scratch_resume(unsigned active)
+{
+  scratch_arena.active = active;
+}
+
+void lodepng_scratch_release(void)
+{
+  ScratchArena* a = &scratch_arena;
+  if(a->active) return;
+  lodepng_free(a->data);
+  a->data = 0;
+  a->capacity = 0;
+}
+
+/*everything below allocates through the arena when one is open*/
+#define lodepng_malloc scratch_malloc
+#define lodepng_realloc scratch_realloc
+#define lodepng_free scratch_free
+#endif /*LODEPNG_COMPILE_DECODER*/
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* ////////////////////////////////////////////////////////////////////////// */
 /* // Tools for C, and common code for PNG and Zlib.                       // */
@@ -119,6 +269,96 @@ Example: if(!uivector_resizev(&frequencies_ll, 286, 0)) ERROR_BREAK(83);
   if(error) return error;\
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / CPU features                                                           / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+#ifdef LODEPNG_COMPILE_SIMD
+#if defined(_M_X64) || defined(__x86_64__)
+#define LODEPNG_SIMD_SSE2
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define LODEPNG_SIMD_NEON
+#include <arm_neon.h>
+#if defined(_M_ARM64) || defined(__ARM_FEATURE_CRC32)
+/*Windows on ARM requires the CRC32 instructions, as does anything built with +crc*/
+#define LODEPNG_ARM_CRC32_ALWAYS
+#elif defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define LODEPNG_ARM_CRC32
+#ifndef _MSC_VER
+#include <arm_acle.h>
+#endif
+#endif
+#endif
+#endif /*LODEPNG_COMPILE_SIMD*/
+
+/*functions using instructions past the compile target are only called after checking lodepng_cpu_features*/
+#if (defined(__GNUC__) || defined(__clang__)) && defined(LODEPNG_SIMD_SSE2)
+#define LODEPNG_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define LODEPNG_TARGET_AVX2 __attribute__((target("avx2")))
+#define LODEPNG_TARGET_PCLMUL __attribute__((target("pclmul")))
+#else
+#define LODEPNG_TARGET_SSSE3
+#define LODEPNG_TARGET_AVX2
+#define LODEPNG_TARGET_PCLMUL
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && defined(LODEPNG_ARM_CRC32) && !defined(LODEPNG_ARM_CRC32_ALWAYS)
+#define LODEPNG_TARGET_ARM_CRC32 __attribute__((target("+crc")))
+#else
+#define LODEPNG_TARGET_ARM_CRC32
+#endif
+
+static unsigned detectCpuFeatures(void)
+{
+  unsigned features = 0;
+#if defined(LODEPNG_SIMD_SSE2) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  if(info[2] & (1 << 9)) features |= LODEPNG_CPU_SSSE3;
+  if(info[2] & (1 << 1)) features |= LODEPNG_CPU_PCLMUL;
+  /*AVX2 also needs the OS to save the ymm registers*/
+  if((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6)
+  {
+    __cpuidex(info, 7, 0);
+    if(info[1] & (1 << 5)) features |= LODEPNG_CPU_AVX2;
+  }
+#elif defined(LODEPNG_SIMD_SSE2)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("ssse3")) features |= LODEPNG_CPU_SSSE3;
+  if(__builtin_cpu_supports("pclmul")) features |= LODEPNG_CPU_PCLMUL;
+  if(__builtin_cpu_supports("avx2")) features |= LODEPNG_CPU_AVX2;
+#elif defined(LODEPNG_ARM_CRC32_ALWAYS)
+  features |= LODEPNG_CPU_ARM_CRC32;
+#elif defined(LODEPNG_ARM_CRC32) && defined(__linux__)
+  if(getauxval(AT_HWCAP) & HWCAP_CRC32) features |= LODEPNG_CPU_ARM_CRC32;
+#endif
+  return features;
+}
+
+/*every thread that races here stores the same answer*/
+static int lodepng_cpu_detected = -1;
+static unsigned lodepng_cpu_mask = ~0u;
+
+unsigned lodepng_cpu_features(void)
+{
+  if(lodepng_cpu_detected < 0) lodepng_cpu_detected = (int)detectCpuFeatures();
+  return (unsigned)lodepng_cpu_detected & lodepng_cpu_mask;
+}
+
+void lodepng_set_cpu_features(unsigned features)
+{
+  lodepng_cpu_mask = features;
+}
+
 /*
 About uivector, ucvector and string:
 -All of them wrap dynamic arrays or text strings in a similar way.
@@ -1277,6 +1517,560 @@ static unsigned inflate(unsigned char** out, size_t* outsize,
   }
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / Fast Inflator                                                          / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+/*
+Table driven inflate, the default custom_inflate. The input goes through a 64-bit
+bit buffer refilled a word at a time, so one refill covers a whole length and
+distance pair. Huffman codes decode with a single probe of a lookup table indexed
+by the next FAST_LITLEN_BITS (or FAST_DIST_BITS) input bits; the few longer codes
+continue in a subtable. Literal/length entries whose code leaves room hold a
+second literal, so runs of literals decode two per probe. Matches copy 8 bytes at
+a time, the output buffer always has room for the overshoot.
+Each table entry is one word:
+bits 0-4: input bits the entry consumes
+bits 5-7: one of the FAST_ kinds
+literals: first literal in bits 8-15, second one in bits 16-23 for FAST_LITERAL2
+FAST_BASE: extra bits in bits 8-11, base length or distance in bits 16-31
+FAST_SUBTABLE: subtable index bits in bits 8-11, subtable offset in bits 16-31
+*/
+#define FAST_LITERAL 0u
+#define FAST_LITERAL2 1u
+#define FAST_BASE 2u
+#define FAST_END 3u
+#define FAST_SUBTABLE 4u
+#define FAST_INVALID 5u
+#define FAST_KIND(entry) (((entry) >> 5) & 7u)
+#define FAST_LITLEN_BITS 11
+#define FAST_DIST_BITS 8
+#define FAST_CODELEN_BITS 7
+/*every subtable is at most 2^(15 - table bits) entries and belongs to a symbol longer than the table bits*/
+#define FAST_LITLEN_SIZE ((1u << FAST_LITLEN_BITS) + NUM_DEFLATE_CODE_SYMBOLS * (1u << (15 - FAST_LITLEN_BITS)))
+#define FAST_DIST_SIZE ((1u << FAST_DIST_BITS) + NUM_DISTANCE_SYMBOLS * (1u << (15 - FAST_DIST_BITS)))
+/*longest match plus the bytes a word copy may write past it*/
+#define FAST_OUT_SLACK (258 + 16)
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define FAST_BIG_ENDIAN
+#endif
+
+/*the bit reader must stay in registers in the decode loop, which it only does inlined*/
+#if defined(_MSC_VER)
+#define FAST_INLINE __forceinline
+#elif defined(__GNUC__)
+#define FAST_INLINE inline __attribute__((always_inline))
+#else
+#define FAST_INLINE inline
+#endif
+
+/*the hot loop keeps a copy in locals, stores to the output could alias it in the inflator*/
+typedef struct FastBitReader
+{
+  const unsigned char* in;
+  size_t insize;
+  size_t inpos; /*next byte to load into the bit buffer*/
+  size_t overrun; /*zero bytes loaded after the end of the input*/
+  uint64_t bitbuf; /*next input bit is the lowest*/
+  unsigned bitcount;
+} FastBitReader;
+
+typedef struct FastInflator
+{
+  FastBitReader br;
+
+  unsigned char* out;
+  size_t outpos;
+  size_t outalloc;
+
+  unsigned litlen[FAST_LITLEN_SIZE];
+  unsigned dist[FAST_DIST_SIZE];
+  unsigned codelen[1u << FAST_CODELEN_BITS];
+  unsigned singles[1u << FAST_LITLEN_BITS]; /*litlen table before literals are paired up*/
+  unsigned fixed; /*the tables hold the fixed codes*/
+
+  /*streaming: out is a fixed window that is never grown, and symbols are only decoded
+  while br.inpos is below inend; the block loop returns early with suspended set*/
+  size_t inend;
+  unsigned streaming;
+  unsigned suspended;
+} FastInflator;
+
+/*top up the bit buffer to at least 56 bits*/
+static FAST_INLINE void fastRefill(FastBitReader* br)
+{
+#ifndef FAST_BIG_ENDIAN
+  if(br->inpos + 8 <= br->insize)
+  {
+    /*load a whole word, keep as many of its bytes as fit and advance by those*/
+    uint64_t word;
+    memcpy(&word, &br->in[br->inpos], 8);
+    br->bitbuf |= word << br->bitcount;
+    br->inpos += (63 - br->bitcount) >> 3;
+    br->bitcount |= 56;
+    return;
+  }
+#endif
+  while(br->bitcount <= 56)
+  {
+    uint64_t byte = 0;
+    if(br->inpos < br->insize) byte = br->in[br->inpos++];
+    else br->overrun++;
+    br->bitbuf |= byte << br->bitcount;
+    br->bitcount += 8;
+  }
+}
+
+/*more bits were consumed than the input has*/
+static FAST_INLINE int fastOverread(const FastBitReader* br)
+{
+  return br->overrun * 8 > br->bitcount;
+}
+
+static FAST_INLINE unsigned fastBits(const FastBitReader* br, unsigned nbits)
+{
+  return (unsigned)(br->bitbuf & ((1u << nbits) - 1u));
+}
+
+static FAST_INLINE void fastConsume(FastBitReader* br, unsigned nbits)
+{
+  br->bitbuf >>= nbits;
+  br->bitcount -= nbits;
+}
+
+static unsigned fastReverse(unsigned code, unsigned nbits)
+{
+  unsigned result = 0, i;
+  for(i = 0; i < nbits; i++)
+  {
+    result = (result << 1) | (code & 1u);
+    code >>= 1;
+  }
+  return result;
+}
+
+/*
+Build a lookup table from deflate code lengths. leaves[s] is the entry of symbol s
+without its bit count. Codes that do not exist decode as FAST_INVALID, an
+incomplete set of lengths is allowed. Returns 55 for an oversubscribed one.
+*/
+static unsigned fastBuildTable(unsigned* table, unsigned tablebits, const unsigned* lengths, unsigned numcodes,
+                               const unsigned* leaves)
+{
+  unsigned count[16] = {0}, nextcode[16] = {0}, submax[1u << FAST_LITLEN_BITS];
+  unsigned tablesize = 1u << tablebits, offset = tablesize;
+  unsigned s, i, len;
+  int left = 1;
+
+  for(s = 0; s < numcodes; s++) count[lengths[s]]++;
+  count[0] = 0;
+  for(len = 1; len <= 15; len++)
+  {
+    left = (left << 1) - (int)count[len];
+    if(left < 0) return 55; /*oversubscribed, see comment in lodepng_error_text*/
+    nextcode[len] = (nextcode[len - 1] + count[len - 1]) << 1;
+  }
+
+  for(i = 0; i < tablesize; i++)
+  {
+    table[i] = FAST_INVALID << 5;
+    submax[i] = 0;
+  }
+
+  /*codes longer than the table continue in a subtable sized for the longest code with that prefix*/
+  for(len = tablebits + 1; len <= 15; len++)
+  {
+    unsigned code = nextcode[len];
+    for(s = 0; s < count[len]; s++, code++)
+    {
+      submax[fastReverse(code, len) & (tablesize - 1)] = len;
+    }
+  }
+  for(i = 0; i < tablesize; i++)
+  {
+    if(submax[i])
+    {
+      unsigned subbits = submax[i] - tablebits, j;
+      table[i] = tablebits | (FAST_SUBTABLE << 5) | (subbits << 8) | (offset << 16);
+      for(j = 0; j < (1u << subbits); j++) table[offset + j] = FAST_INVALID << 5;
+      offset += 1u << subbits;
+    }
+  }
+
+  for(s = 0; s < numcodes; s++)
+  {
+    unsigned code, reversed;
+    len = lengths[s];
+    if(!len) continue;
+    code = nextcode[len]++;
+    reversed = fastReverse(code, len);
+    if(len <= tablebits)
+    {
+      for(i = reversed; i < tablesize; i += 1u << len) table[i] = leaves[s] | len;
+    }
+    else
+    {
+      unsigned link = table[reversed & (tablesize - 1)];
+      unsigned subbits = (link >> 8) & 15u, sublen = len - tablebits;
+      unsigned* sub = &table[link >> 16];
+      for(i = reversed >> tablebits; i < (1u << subbits); i += 1u << sublen) sub[i] = leaves[s] | sublen;
+    }
+  }
+  return 0;
+}
+
+/*Let literal entries that leave room for another literal code decode that one too*/
+static void fastPairLiterals(FastInflator* f)
+{
+  unsigned i;
+  memcpy(f->singles, f->litlen, sizeof(f->singles));
+  for(i = 0; i < (1u << FAST_LITLEN_BITS); i++)
+  {
+    unsigned first = f->singles[i], firstbits = first & 31u, second, secondbits;
+    if(FAST_KIND(first) != FAST_LITERAL || firstbits >= FAST_LITLEN_BITS) continue;
+    /*the second code starts right after the first, its entry is valid if it fits in the bits left*/
+    second = f->singles[i >> firstbits];
+    secondbits = second & 31u;
+    if(FAST_KIND(second) != FAST_LITERAL || firstbits + secondbits > FAST_LITLEN_BITS) continue;
+    f->litlen[i] = (firstbits + secondbits) | (FAST_LITERAL2 << 5) | (first & 0xFF00u) | ((second & 0xFF00u) << 8);
+  }
+}
+
+static unsigned fastBuildLitLen(FastInflator* f, const unsigned* lengths)
+{
+  unsigned leaves[NUM_DEFLATE_CODE_SYMBOLS];
+  unsigned s, error;
+  for(s = 0; s < 256; s++) leaves[s] = (FAST_LITERAL << 5) | (s << 8);
+  leaves[256] = FAST_END << 5;
+  for(s = FIRST_LENGTH_CODE_INDEX; s <= LAST_LENGTH_CODE_INDEX; s++)
+  {
+    leaves[s] = (FAST_BASE << 5) | (LENGTHEXTRA[s - FIRST_LENGTH_CODE_INDEX] << 8)
+              | (LENGTHBASE[s - FIRST_LENGTH_CODE_INDEX] << 16);
+  }
+  for(; s < NUM_DEFLATE_CODE_SYMBOLS; s++) leaves[s] = FAST_INVALID << 5;
+  error = fastBuildTable(f->litlen, FAST_LITLEN_BITS, lengths, NUM_DEFLATE_CODE_SYMBOLS, leaves);
+  if(!error) fastPairLiterals(f);
+  return error;
+}
+
+static unsigned fastBuildDist(FastInflator* f, const unsigned* lengths)
+{
+  unsigned leaves[NUM_DISTANCE_SYMBOLS];
+  unsigned s;
+  for(s = 0; s < 30; s++) leaves[s] = (FAST_BASE << 5) | (DISTANCEEXTRA[s] << 8) | (DISTANCEBASE[s] << 16);
+  for(; s < NUM_DISTANCE_SYMBOLS; s++) leaves[s] = FAST_INVALID << 5;
+  return fastBuildTable(f->dist, FAST_DIST_BITS, lengths, NUM_DISTANCE_SYMBOLS, leaves);
+}
+
+static unsigned fastBuildFixed(FastInflator* f)
+{
+  unsigned lengths[NUM_DEFLATE_CODE_SYMBOLS], i, error;
+  for(i =   0; i <= 143; i++) lengths[i] = 8;
+  for(i = 144; i <= 255; i++) lengths[i] = 9;
+  for(i = 256; i <= 279; i++) lengths[i] = 7;
+  for(i = 280; i <= 287; i++) lengths[i] = 8;
+  error = fastBuildLitLen(f, lengths);
+  for(i = 0; i < NUM_DISTANCE_SYMBOLS; i++) lengths[i] = 5;
+  if(!error) error = fastBuildDist(f, lengths);
+  return error;
+}
+
+/*read the code lengths of a dynamic block and build its tables, error codes as in getTreeInflateDynamic*/
+static unsigned fastBuildDynamic(FastInflator* f)
+{
+  unsigned lengths[NUM_DEFLATE_CODE_SYMBOLS + NUM_DISTANCE_SYMBOLS];
+  unsigned bitlen_cl[NUM_CODE_LENGTH_CODES];
+  unsigned leaves[NUM_CODE_LENGTH_CODES];
+  unsigned HLIT, HDIST, HCLEN, i, error;
+
+  fastRefill(&f->br);
+  HLIT = fastBits(&f->br, 5) + 257; fastConsume(&f->br, 5);
+  HDIST = fastBits(&f->br, 5) + 1; fastConsume(&f->br, 5);
+  HCLEN = fastBits(&f->br, 4) + 4; fastConsume(&f->br, 4);
+
+  for(i = 0; i < NUM_CODE_LENGTH_CODES; i++)
+  {
+    fastRefill(&f->br);
+    bitlen_cl[CLCL_ORDER[i]] = i < HCLEN ? fastBits(&f->br, 3) : 0;
+    if(i < HCLEN) fastConsume(&f->br, 3);
+    leaves[i] = (FAST_LITERAL << 5) | (i << 8);
+  }
+  if(fastOverread(&f->br)) return 50;
+  error = fastBuildTable(f->codelen, FAST_CODELEN_BITS, bitlen_cl, NUM_CODE_LENGTH_CODES, leaves);
+  if(error) return error;
+
+  /*literal/length and distance lengths are one sequence, repeats may cross from one to the other*/
+  memset(lengths, 0, sizeof(lengths));
+  i = 0;
+  while(i < HLIT + HDIST)
+  {
+    unsigned entry, code, replength, value = 0;
+    fastRefill(&f->br);
+    if(fastOverread(&f->br)) return 50;
+    entry = f->codelen[fastBits(&f->br, FAST_CODELEN_BITS)];
+    if(FAST_KIND(entry) != FAST_LITERAL) return 11; /*error: no such code*/
+    fastConsume(&f->br, entry & 31u);
+    code = (entry >> 8) & 0xFFu;
+    if(code <= 15)
+    {
+      lengths[i < HLIT ? i : NUM_DEFLATE_CODE_SYMBOLS + i - HLIT] = code;
+      i++;
+      continue;
+    }
+    if(code == 16)
+    {
+      if(i == 0) return 54; /*can't repeat previous if i is 0*/
+      value = lengths[i - 1 < HLIT ? i - 1 : NUM_DEFLATE_CODE_SYMBOLS + i - 1 - HLIT];
+      replength = 3 + fastBits(&f->br, 2); fastConsume(&f->br, 2);
+    }
+    else if(code == 17)
+    {
+      replength = 3 + fastBits(&f->br, 3); fastConsume(&f->br, 3);
+    }
+    else
+    {
+      replength = 11 + fastBits(&f->br, 7); fastConsume(&f->br, 7);
+    }
+    if(i + replength > HLIT + HDIST) return code == 16 ? 13 : code == 17 ? 14 : 15;
+    for(; replength > 0; replength--, i++) lengths[i < HLIT ? i : NUM_DEFLATE_CODE_SYMBOLS + i - HLIT] = value;
+  }
+  if(fastOverread(&f->br)) return 50;
+  if(lengths[256] == 0) return 64; /*the length of the end code 256 must be larger than 0*/
+
+  error = fastBuildLitLen(f, lengths);
+  if(!error) error = fastBuildDist(f, &lengths[NUM_DEFLATE_CODE_SYMBOLS]);
+  return error;
+}
+
+static unsigned fastGrow(FastInflator* f, size_t needed)
+{
+  size_t newalloc = f->outalloc * 2;
+  unsigned char* data;
+  if(newalloc < needed) newalloc = needed;
+  data = (unsigned char*)lodepng_realloc(f->out, newalloc);
+  if(!data) return 83; /*alloc fail*/
+  f->out = data;
+  f->outalloc = newalloc;
+  return 0;
+}
+
+static unsigned fastInflateHuffmanBlock(FastInflator* f)
+{
+  const uint64_t litlenmask = (1u << FAST_LITLEN_BITS) - 1u;
+  const uint64_t distmask = (1u << FAST_DIST_BITS) - 1u;
+  const unsigned* litlen = f->litlen;
+  const unsigned* dist = f->dist;
+  FastBitReader br = f->br;
+  unsigned char* out = f->out;
+  size_t outpos = f->outpos;
+  size_t outlimit = f->outalloc - FAST_OUT_SLACK;
+  size_t inend = f->inend;
+  unsigned error = 0;
+  for(;;)
+  {
+    unsigned entry, length, distance;
+    unsigned char* dst;
+    const unsigned char* src;
+
+    if(outpos > outlimit)
+    {
+      f->outpos = outpos;
+      if(f->streaming)
+      {
+        f->suspended = 1; /*the window is full*/
+        break;
+      }
+      error = fastGrow(f, outpos + FAST_OUT_SLACK);
+      if(error) break;
+      out = f->out;
+      outlimit = f->outalloc - FAST_OUT_SLACK;
+    }
+    /*at least 56 bits: up to 15 + 5 for the length and 15 + 13 for the distance*/
+    fastRefill(&br);
+    if(br.inpos >= inend)
+    {
+      if(inend < br.insize)
+      {
+        f->suspended = 1; /*the rest of the input could end mid symbol*/
+        break;
+      }
+      if(br.overrun && fastOverread(&br))
+      {
+        error = 10; /*error: end of input memory reached without endcode*/
+        break;
+      }
+    }
+
+    entry = litlen[br.bitbuf & litlenmask];
+    if(FAST_KIND(entry) == FAST_SUBTABLE)
+    {
+      fastConsume(&br, FAST_LITLEN_BITS);
+      entry = litlen[(entry >> 16) + fastBits(&br, (entry >> 8) & 15u)];
+    }
+    fastConsume(&br, entry & 31u);
+
+    if(FAST_KIND(entry) == FAST_LITERAL2)
+    {
+      out[outpos] = (unsigned char)(entry >> 8);
+      out[outpos + 1] = (unsigned char)(entry >> 16);
+      outpos += 2;
+      continue;
+    }
+    if(FAST_KIND(entry) == FAST_LITERAL)
+    {
+      out[outpos++] = (unsigned char)(entry >> 8);
+      continue;
+    }
+    if(FAST_KIND(entry) == FAST_END)
+    {
+      if(br.overrun && fastOverread(&br)) error = 10;
+      break;
+    }
+    if(FAST_KIND(entry) != FAST_BASE)
+    {
+      error = 11; /*error: code that does not exist*/
+      break;
+    }
+
+    length = (entry >> 16) + fastBits(&br, (entry >> 8) & 15u);
+    fastConsume(&br, (entry >> 8) & 15u);
+
+    entry = dist[br.bitbuf & distmask];
+    if(FAST_KIND(entry) == FAST_SUBTABLE)
+    {
+      fastConsume(&br, FAST_DIST_BITS);
+      entry = dist[(entry >> 16) + fastBits(&br, (entry >> 8) & 15u)];
+    }
+    if(FAST_KIND(entry) != FAST_BASE)
+    {
+      error = 18; /*error: invalid distance code*/
+      break;
+    }
+    fastConsume(&br, entry & 31u);
+    distance = (entry >> 16) + fastBits(&br, (entry >> 8) & 15u);
+    fastConsume(&br, (entry >> 8) & 15u);
+    if(distance > outpos)
+    {
+      error = 52; /*too long backward distance*/
+      break;
+    }
+
+    dst = &out[outpos];
+    src = dst - distance;
+    outpos += length;
+    if(distance >= 8)
+    {
+      /*each word only reads bytes written before it, overshoot lands in the slack*/
+      unsigned n;
+      for(n = 0; n < length; n += 8) memcpy(dst + n, src + n, 8);
+    }
+    else if(distance == 1)
+    {
+      memset(dst, src[0], length);
+    }
+    else
+    {
+      unsigned n;
+      for(n = 0; n < length; n++) dst[n] = src[n];
+    }
+  }
+  f->br = br;
+  f->outpos = outpos;
+  return error;
+}
+
+/*go to the byte boundary, then give back the whole bytes still in the bit buffer*/
+static unsigned fastAlignToByte(FastBitReader* br)
+{
+  fastConsume(br, br->bitcount & 7u);
+  if(br->overrun * 8 > br->bitcount) return 52; /*error, bit pointer will jump past memory*/
+  br->inpos -= br->bitcount / 8 - br->overrun;
+  br->overrun = 0;
+  br->bitbuf = 0;
+  br->bitcount = 0;
+  return 0;
+}
+
+/*the LEN and NLEN fields that start a stored block*/
+static unsigned fastStoredLength(FastBitReader* br, unsigned* LEN)
+{
+  unsigned NLEN, error = fastAlignToByte(br);
+  if(error) return error;
+  if(br->inpos + 4 > br->insize) return 52; /*error, bit pointer will jump past memory*/
+  *LEN = br->in[br->inpos] + 256u * br->in[br->inpos + 1];
+  NLEN = br->in[br->inpos + 2] + 256u * br->in[br->inpos + 3];
+  br->inpos += 4;
+  if(*LEN + NLEN != 65535) return 21; /*error: NLEN is not one's complement of LEN*/
+  return 0;
+}
+
+static unsigned fastInflateNoCompression(FastInflator* f)
+{
+  unsigned LEN, error = fastStoredLength(&f->br, &LEN);
+  if(error) return error;
+  if(f->br.inpos + LEN > f->br.insize) return 23; /*error: reading outside of in buffer*/
+
+  if(f->outpos + LEN + FAST_OUT_SLACK > f->outalloc)
+  {
+    error = fastGrow(f, f->outpos + LEN + FAST_OUT_SLACK);
+    if(error) return error;
+  }
+  memcpy(&f->out[f->outpos], &f->br.in[f->br.inpos], LEN);
+  f->outpos += LEN;
+  f->br.inpos += LEN;
+  return 0;
+}
+
+unsigned lodepng_inflate_fast(unsigned char** out, size_t* outsize,
+                              const unsigned char* in, size_t insize,
+                              const LodePNGDecompressSettings* settings)
+{
+  unsigned BFINAL = 0, error = 0;
+  FastInflator* f = (FastInflator*)lodepng_malloc(sizeof(FastInflator));
+  if(!f) return 83; /*alloc fail*/
+
+  f->br.in = in;
+  f->br.insize = insize;
+  f->br.inpos = 0;
+  f->br.overrun = 0;
+  f->br.bitbuf = 0;
+  f->br.bitcount = 0;
+  f->fixed = 0;
+  f->inend = insize;
+  f->streaming = 0;
+  f->suspended = 0;
+  /*like lodepng_inflate, *out is reused and the data starts at its beginning*/
+  f->out = *out;
+  f->outpos = 0;
+  f->outalloc = 0;
+  error = fastGrow(f, (settings->expected_size ? settings->expected_size : insize * 4) + FAST_OUT_SLACK);
+
+  while(!error && !BFINAL)
+  {
+    unsigned BTYPE;
+    fastRefill(&f->br);
+    BFINAL = fastBits(&f->br, 1);
+    BTYPE = (unsigned)(f->br.bitbuf >> 1) & 3u;
+    fastConsume(&f->br, 3);
+    if(fastOverread(&f->br)) error = 52; /*error, bit pointer will jump past memory*/
+    else if(BTYPE == 3) error = 20; /*error: invalid BTYPE*/
+    else if(BTYPE == 0) error = fastInflateNoCompression(f);
+    else
+    {
+      if(BTYPE == 1 && !f->fixed) error = fastBuildFixed(f);
+      else if(BTYPE == 2) error = fastBuildDynamic(f);
+      f->fixed = BTYPE == 1;
+      if(!error) error = fastInflateHuffmanBlock(f);
+    }
+  }
+
+  *out = f->out;
+  *outsize = f->outpos;
+  lodepng_free(f);
+  return error;
+}
+
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -2057,13 +2851,107 @@ static unsigned deflate(unsigned char** out, size_t* outsize,
 /* / Adler32                                                                  */
 /* ////////////////////////////////////////////////////////////////////////// */
 
-static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len)
-{
-   unsigned s1 = adler & 0xffff;
-   unsigned s2 = (adler >> 16) & 0xffff;
+/*largest n such that 255n(n+1)/2 + (n+1)(65521-1) fits in 32 bits, the sums are reduced after this many bytes*/
+#define ADLER_NMAX 5552
 
-  while(len > 0)
-  {
+#ifdef LODEPNG_SIMD_SSE2
+/*
+32 bytes per step. s1 gains the byte sum, s2 gains s1 once per byte plus each byte
+weighted by how many of the step's bytes come at or after it (32 down to 1).
+The s1 added for every step is collected in ps and applied at the end of a block.
+Returns the sums of the whole 32-byte steps and leaves the tail to the caller.
+*/
+static LODEPNG_TARGET_SSSE3 unsigned adler32SSSE3(unsigned adler, const unsigned char* data, size_t len)
+{
+  const __m128i taps1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+  const __m128i taps2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i zero = _mm_setzero_si128();
+  unsigned s1 = adler & 0xffff;
+  unsigned s2 = (adler >> 16) & 0xffff;
+  size_t blocks = len / 32;
+  while(blocks > 0)
+  {
+    size_t n = blocks < ADLER_NMAX / 32 ? blocks : ADLER_NMAX / 32;
+    __m128i vs1 = zero, vs2 = zero, vps = _mm_cvtsi32_si128((int)(s1 * n));
+    blocks -= n;
+    for(; n > 0; n--, data += 32)
+    {
+      __m128i b1 = _mm_loadu_si128((const __m128i*)data);
+      __m128i b2 = _mm_loadu_si128((const __m128i*)(data + 16));
+      vps = _mm_add_epi32(vps, vs1);
+      vs1 = _mm_add_epi32(vs1, _mm_add_epi32(_mm_sad_epu8(b1, zero), _mm_sad_epu8(b2, zero)));
+      vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_maddubs_epi16(b1, taps1), ones));
+      vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_maddubs_epi16(b2, taps2), ones));
+    }
+    vs2 = _mm_add_epi32(vs2, _mm_slli_epi32(vps, 5));
+    /*horizontal sums, the byte sums sit in lanes 0 and 2*/
+    vs1 = _mm_add_epi32(vs1, _mm_shuffle_epi32(vs1, _MM_SHUFFLE(1, 0, 3, 2)));
+    vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(1, 0, 3, 2)));
+    vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(2, 3, 0, 1)));
+    s1 = (s1 + (unsigned)_mm_cvtsi128_si32(vs1)) % 65521;
+    s2 = (s2 + (unsigned)_mm_cvtsi128_si32(vs2)) % 65521;
+  }
+  return (s2 << 16) | s1;
+}
+
+/*the same as adler32SSSE3 with one 32-byte register per step*/
+static LODEPNG_TARGET_AVX2 unsigned adler32AVX2(unsigned adler, const unsigned char* data, size_t len)
+{
+  const __m256i taps = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                        16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m256i ones = _mm256_set1_epi16(1);
+  const __m256i zero = _mm256_setzero_si256();
+  unsigned s1 = adler & 0xffff;
+  unsigned s2 = (adler >> 16) & 0xffff;
+  size_t blocks = len / 32;
+  while(blocks > 0)
+  {
+    size_t n = blocks < ADLER_NMAX / 32 ? blocks : ADLER_NMAX / 32;
+    __m256i vs1 = zero, vs2 = zero, vps = _mm256_setr_epi32((int)(s1 * n), 0, 0, 0, 0, 0, 0, 0);
+    __m128i s1sum, s2sum;
+    blocks -= n;
+    for(; n > 0; n--, data += 32)
+    {
+      __m256i b = _mm256_loadu_si256((const __m256i*)data);
+      vps = _mm256_add_epi32(vps, vs1);
+      vs1 = _mm256_add_epi32(vs1, _mm256_sad_epu8(b, zero));
+      vs2 = _mm256_add_epi32(vs2, _mm256_madd_epi16(_mm256_maddubs_epi16(b, taps), ones));
+    }
+    vs2 = _mm256_add_epi32(vs2, _mm256_slli_epi32(vps, 5));
+    s1sum = _mm_add_epi32(_mm256_castsi256_si128(vs1), _mm256_extracti128_si256(vs1, 1));
+    s2sum = _mm_add_epi32(_mm256_castsi256_si128(vs2), _mm256_extracti128_si256(vs2, 1));
+    s1sum = _mm_add_epi32(s1sum, _mm_shuffle_epi32(s1sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    s2sum = _mm_add_epi32(s2sum, _mm_shuffle_epi32(s2sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    s2sum = _mm_add_epi32(s2sum, _mm_shuffle_epi32(s2sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    s1 = (s1 + (unsigned)_mm_cvtsi128_si32(s1sum)) % 65521;
+    s2 = (s2 + (unsigned)_mm_cvtsi128_si32(s2sum)) % 65521;
+  }
+  return (s2 << 16) | s1;
+}
+#endif /*LODEPNG_SIMD_SSE2*/
+
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len)
+{
+   unsigned s1;
+   unsigned s2;
+
+#ifdef LODEPNG_SIMD_SSE2
+  unsigned features = lodepng_cpu_features();
+  if(len >= 64 && (features & (LODEPNG_CPU_AVX2 | LODEPNG_CPU_SSSE3)))
+  {
+    unsigned whole = len & ~31u;
+    if(features & LODEPNG_CPU_AVX2) adler = adler32AVX2(adler, data, whole);
+    else adler = adler32SSSE3(adler, data, whole);
+    data += whole;
+    len -= whole;
+  }
+#endif /*LODEPNG_SIMD_SSE2*/
+
+  s1 = adler & 0xffff;
+  s2 = (adler >> 16) & 0xffff;
+  while(len > 0)
+  {
     /*at least 5550 sums can be done before the sums overflow, saving a lot of module divisions*/
     unsigned amount = len > 5550 ? 5550 : len;
     len -= amount;
@@ -2086,6 +2974,11 @@ static unsigned adler32(const unsigned char* data, unsigned len)
   return update_adler32(1L, data, len);
 }
 
+unsigned lodepng_adler32(const unsigned char* buf, unsigned len)
+{
+  return adler32(buf, len);
+}
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Zlib                                                                   / */
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -2150,6 +3043,195 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, const unsi
   }
 }
 
+/*
+Zlib decompression of data that arrives in pieces, for the streaming PNG decoder.
+The fast inflator decodes into a window of twice the 32K deflate distance: new bytes
+go to the sink as they are decoded, and once the window is full its last 32K move to
+the front. A block header or a symbol is only started with ZLIB_STREAM_MARGIN bytes
+of input in hand, more than the longest one (a dynamic block header) takes, so the
+decoder never has to stop halfway through one. The last piece is decoded to its end.
+Custom inflate and zlib functions in the settings are not used.
+*/
+#define ZLIB_STREAM_WINDOW 32768u
+#define ZLIB_STREAM_MARGIN 512u
+
+#define ZLIB_STREAM_HEADER 0u
+#define ZLIB_STREAM_BLOCK 1u
+#define ZLIB_STREAM_HUFFMAN 2u
+#define ZLIB_STREAM_STORED 3u
+#define ZLIB_STREAM_ADLER 4u
+#define ZLIB_STREAM_DONE 5u
+
+/*receives the decompressed bytes in order, a nonzero return is an error that stops the decoding*/
+typedef unsigned (*ZlibStreamSink)(void* context, const unsigned char* data, size_t size);
+
+typedef struct ZlibStream
+{
+  FastInflator* f;
+  ucvector in; /*input not decoded yet, after the last 8 decoded bytes which the bit buffer may give back*/
+  unsigned stage;
+  unsigned bfinal;
+  size_t storedleft; /*bytes of the current stored block still to copy*/
+  size_t flushed; /*bytes of the window given to the sink*/
+  unsigned adler;
+  unsigned ignore_adler32;
+  ZlibStreamSink sink;
+  void* context;
+} ZlibStream;
+
+static void zlibStreamCleanup(ZlibStream* s)
+{
+  if(s->f) lodepng_free(s->f->out);
+  lodepng_free(s->f);
+  s->f = 0;
+  ucvector_cleanup(&s->in);
+}
+
+static unsigned zlibStreamInit(ZlibStream* s, const LodePNGDecompressSettings* settings,
+                               ZlibStreamSink sink, void* context)
+{
+  ucvector_init(&s->in);
+  s->stage = ZLIB_STREAM_HEADER;
+  s->bfinal = 0;
+  s->storedleft = 0;
+  s->flushed = 0;
+  s->adler = 1;
+  s->ignore_adler32 = settings->ignore_adler32;
+  s->sink = sink;
+  s->context = context;
+  s->f = (FastInflator*)lodepng_malloc(sizeof(FastInflator));
+  if(!s->f) return 83; /*alloc fail*/
+
+  memset(&s->f->br, 0, sizeof(s->f->br));
+  s->f->fixed = 0;
+  s->f->inend = 0;
+  s->f->streaming = 1;
+  s->f->suspended = 0;
+  s->f->outpos = 0;
+  s->f->outalloc = 2 * ZLIB_STREAM_WINDOW + FAST_OUT_SLACK;
+  s->f->out = (unsigned char*)lodepng_malloc(s->f->outalloc);
+  if(!s->f->out)
+  {
+    zlibStreamCleanup(s);
+    return 83; /*alloc fail*/
+  }
+  return 0;
+}
+
+/*give the new bytes to the sink, and once the window is full keep only its last 32K*/
+static unsigned zlibStreamFlush(ZlibStream* s)
+{
+  FastInflator* f = s->f;
+  if(f->outpos > s->flushed)
+  {
+    unsigned error = s->sink(s->context, &f->out[s->flushed], f->outpos - s->flushed);
+    if(error) return error;
+    if(!s->ignore_adler32) s->adler = update_adler32(s->adler, &f->out[s->flushed], (unsigned)(f->outpos - s->flushed));
+    s->flushed = f->outpos;
+  }
+  if(f->outpos >= 2 * ZLIB_STREAM_WINDOW)
+  {
+    memmove(f->out, &f->out[f->outpos - ZLIB_STREAM_WINDOW], ZLIB_STREAM_WINDOW);
+    f->outpos = s->flushed = ZLIB_STREAM_WINDOW;
+  }
+  return 0;
+}
+
+/*append in and decode as far as it allows. final: in ends the zlib data, decode it all*/
+static unsigned zlibStreamWrite(ZlibStream* s, const unsigned char* in, size_t insize, unsigned final)
+{
+  FastInflator* f = s->f;
+  size_t keep = f->br.inpos < 8 ? f->br.inpos : 8;
+  size_t left = s->in.size - f->br.inpos;
+  unsigned error = 0;
+
+  /*drop what was decoded, the window holds all that is still needed of it*/
+  if(s->in.size) memmove(s->in.data, &s->in.data[f->br.inpos - keep], keep + left);
+  if(!ucvector_resize(&s->in, keep + left + insize)) return 83; /*alloc fail*/
+  if(insize) memcpy(&s->in.data[keep + left], in, insize);
+  f->br.in = s->in.data;
+  f->br.insize = s->in.size;
+  f->br.inpos = keep;
+
+  while(!error && s->stage != ZLIB_STREAM_DONE)
+  {
+    size_t avail = f->br.insize - f->br.inpos;
+    if(!final && avail <= ZLIB_STREAM_MARGIN && s->stage != ZLIB_STREAM_STORED) break; /*wait for more input*/
+
+    if(s->stage == ZLIB_STREAM_HEADER)
+    {
+      const unsigned char* header = &f->br.in[f->br.inpos];
+      if(avail < 2) error = 53; /*error, size of zlib data too small*/
+      else if((header[0] * 256 + header[1]) % 31 != 0) error = 24; /*error: FCHECK*/
+      else if((header[0] & 15) != 8 || ((header[0] >> 4) & 15) > 7) error = 25; /*error: only deflate*/
+      else if((header[1] >> 5) & 1) error = 26; /*error: preset dictionary*/
+      f->br.inpos += 2;
+      s->stage = ZLIB_STREAM_BLOCK;
+    }
+    else if(s->stage == ZLIB_STREAM_BLOCK)
+    {
+      unsigned BTYPE, LEN;
+      fastRefill(&f->br);
+      s->bfinal = fastBits(&f->br, 1);
+      BTYPE = (unsigned)(f->br.bitbuf >> 1) & 3u;
+      fastConsume(&f->br, 3);
+      if(fastOverread(&f->br)) error = 52; /*error, bit pointer will jump past memory*/
+      else if(BTYPE == 3) error = 20; /*error: invalid BTYPE*/
+      else if(BTYPE == 0)
+      {
+        error = fastStoredLength(&f->br, &LEN);
+        s->storedleft = LEN;
+        s->stage = ZLIB_STREAM_STORED;
+      }
+      else
+      {
+        if(BTYPE == 1 && !f->fixed) error = fastBuildFixed(f);
+        else if(BTYPE == 2) error = fastBuildDynamic(f);
+        f->fixed = BTYPE == 1;
+        s->stage = ZLIB_STREAM_HUFFMAN;
+      }
+    }
+    else if(s->stage == ZLIB_STREAM_HUFFMAN)
+    {
+      f->inend = final ? f->br.insize : f->br.insize - ZLIB_STREAM_MARGIN;
+      f->suspended = 0;
+      error = fastInflateHuffmanBlock(f);
+      if(!error && !f->suspended) s->stage = s->bfinal ? ZLIB_STREAM_ADLER : ZLIB_STREAM_BLOCK;
+      if(!error) error = zlibStreamFlush(s);
+      if(!final && f->suspended && f->br.inpos >= f->inend) break; /*wait for more input*/
+    }
+    else if(s->stage == ZLIB_STREAM_STORED)
+    {
+      size_t n = s->storedleft;
+      if(n && !avail)
+      {
+        if(final) error = 23; /*error: reading outside of in buffer*/
+        break;
+      }
+      if(n > avail) n = avail;
+      if(n > 2 * ZLIB_STREAM_WINDOW - f->outpos) n = 2 * ZLIB_STREAM_WINDOW - f->outpos;
+      memcpy(&f->out[f->outpos], &f->br.in[f->br.inpos], n);
+      f->outpos += n;
+      f->br.inpos += n;
+      s->storedleft -= n;
+      if(!s->storedleft) s->stage = s->bfinal ? ZLIB_STREAM_ADLER : ZLIB_STREAM_BLOCK;
+      error = zlibStreamFlush(s);
+    }
+    else /*ZLIB_STREAM_ADLER*/
+    {
+      error = fastAlignToByte(&f->br);
+      if(!error && f->br.inpos + 4 > f->br.insize) error = 52; /*error, bit pointer will jump past memory*/
+      if(!error && !s->ignore_adler32 && lodepng_read32bitInt(&f->br.in[f->br.inpos]) != s->adler)
+      {
+        error = 58; /*error, adler checksum not correct, data must be corrupted*/
+      }
+      f->br.inpos += 4;
+      s->stage = ZLIB_STREAM_DONE;
+    }
+  }
+  return error;
+}
+
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -2267,11 +3349,12 @@ void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings)
   settings->ignore_adler32 = 0;
 
   settings->custom_zlib = 0;
-  settings->custom_inflate = 0;
+  settings->custom_inflate = lodepng_inflate_fast;
+  settings->expected_size = 0;
   settings->custom_context = 0;
 }
 
-const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0};
+const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, lodepng_inflate_fast, 0, 0};
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -2287,53 +3370,409 @@ const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0,
 /* / CRC32                                                                  / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
-/* CRC polynomial: 0xedb88320 */
-static unsigned lodepng_crc32_table[256] = {
-           0u, 1996959894u, 3993919788u, 2567524794u,  124634137u, 1886057615u, 3915621685u, 2657392035u,
-   249268274u, 2044508324u, 3772115230u, 2547177864u,  162941995u, 2125561021u, 3887607047u, 2428444049u,
-   498536548u, 1789927666u, 4089016648u, 2227061214u,  450548861u, 1843258603u, 4107580753u, 2211677639u,
-   325883990u, 1684777152u, 4251122042u, 2321926636u,  335633487u, 1661365465u, 4195302755u, 2366115317u,
-   997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
-   901097722u, 1119000684u, 3686517206u, 2898065728u,  853044451u, 1172266101u, 3705015759u, 2882616665u,
-   651767980u, 1373503546u, 3369554304u, 3218104598u,  565507253u, 1454621731u, 3485111705u, 3099436303u,
-   671266974u, 1594198024u, 3322730930u, 2970347812u,  795835527u, 1483230225u, 3244367275u, 3060149565u,
-  1994146192u,   31158534u, 2563907772u, 4023717930u, 1907459465u,  112637215u, 2680153253u, 3904427059u,
-  2013776290u,  251722036u, 2517215374u, 3775830040u, 2137656763u,  141376813u, 2439277719u, 3865271297u,
-  1802195444u,  476864866u, 2238001368u, 4066508878u, 1812370925u,  453092731u, 2181625025u, 4111451223u,
-  1706088902u,  314042704u, 2344532202u, 4240017532u, 1658658271u,  366619977u, 2362670323u, 4224994405u,
-  1303535960u,  984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
-  1131014506u,  879679996u, 2909243462u, 3663771856u, 1141124467u,  855842277u, 2852801631u, 3708648649u,
-  1342533948u,  654459306u, 3188396048u, 3373015174u, 1466479909u,  544179635u, 3110523913u, 3462522015u,
-  1591671054u,  702138776u, 2966460450u, 3352799412u, 1504918807u,  783551873u, 3082640443u, 3233442989u,
-  3988292384u, 2596254646u,   62317068u, 1957810842u, 3939845945u, 2647816111u,   81470997u, 1943803523u,
-  3814918930u, 2489596804u,  225274430u, 2053790376u, 3826175755u, 2466906013u,  167816743u, 2097651377u,
-  4027552580u, 2265490386u,  503444072u, 1762050814u, 4150417245u, 2154129355u,  426522225u, 1852507879u,
-  4275313526u, 2312317920u,  282753626u, 1742555852u, 4189708143u, 2394877945u,  397917763u, 1622183637u,
-  3604390888u, 2714866558u,  953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
-  3624741850u, 2936675148u,  906185462u, 1090812512u, 3747672003u, 2825379669u,  829329135u, 1181335161u,
-  3412177804u, 3160834842u,  628085408u, 1382605366u, 3423369109u, 3138078467u,  570562233u, 1426400815u,
-  3317316542u, 2998733608u,  733239954u, 1555261956u, 3268935591u, 3050360625u,  752459403u, 1541320221u,
-  2607071920u, 3965973030u, 1969922972u,   40735498u, 2617837225u, 3943577151u, 1913087877u,   83908371u,
-  2512341634u, 3803740692u, 2075208622u,  213261112u, 2463272603u, 3855990285u, 2094854071u,  198958881u,
-  2262029012u, 4057260610u, 1759359992u,  534414190u, 2176718541u, 4139329115u, 1873836001u,  414664567u,
-  2282248934u, 4279200368u, 1711684554u,  285281116u, 2405801727u, 4167216745u, 1634467795u,  376229701u,
-  2685067896u, 3608007406u, 1308918612u,  956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
-  2932959818u, 3654703836u, 1088359270u,  936918000u, 2847714899u, 3736837829u, 1202900863u,  817233897u,
-  3183342108u, 3401237130u, 1404277552u,  615818150u, 3134207493u, 3453421203u, 1423857449u,  601450431u,
-  3009837614u, 3294710456u, 1567103746u,  711928724u, 3020668471u, 3272380065u, 1510334235u,  755167117u
+/*
+CRC polynomial: 0xedb88320. Table 0 is the byte-at-a-time table, table k advances
+a byte through k more zero bytes, so slice-by-8 handles 8 bytes with 8 lookups.
+*/
+static const unsigned lodepng_crc32_table[8][256] = {
+  {
+             0u, 1996959894u, 3993919788u, 2567524794u,  124634137u, 1886057615u, 3915621685u, 2657392035u,
+     249268274u, 2044508324u, 3772115230u, 2547177864u,  162941995u, 2125561021u, 3887607047u, 2428444049u,
+     498536548u, 1789927666u, 4089016648u, 2227061214u,  450548861u, 1843258603u, 4107580753u, 2211677639u,
+     325883990u, 1684777152u, 4251122042u, 2321926636u,  335633487u, 1661365465u, 4195302755u, 2366115317u,
+     997073096u, 1281953886u, 3579855332u, 2724688242u, 1006888145u, 1258607687u, 3524101629u, 2768942443u,
+     901097722u, 1119000684u, 3686517206u, 2898065728u,  853044451u, 1172266101u, 3705015759u, 2882616665u,
+     651767980u, 1373503546u, 3369554304u, 3218104598u,  565507253u, 1454621731u, 3485111705u, 3099436303u,
+     671266974u, 1594198024u, 3322730930u, 2970347812u,  795835527u, 1483230225u, 3244367275u, 3060149565u,
+    1994146192u,   31158534u, 2563907772u, 4023717930u, 1907459465u,  112637215u, 2680153253u, 3904427059u,
+    2013776290u,  251722036u, 2517215374u, 3775830040u, 2137656763u,  141376813u, 2439277719u, 3865271297u,
+    1802195444u,  476864866u, 2238001368u, 4066508878u, 1812370925u,  453092731u, 2181625025u, 4111451223u,
+    1706088902u,  314042704u, 2344532202u, 4240017532u, 1658658271u,  366619977u, 2362670323u, 4224994405u,
+    1303535960u,  984961486u, 2747007092u, 3569037538u, 1256170817u, 1037604311u, 2765210733u, 3554079995u,
+    1131014506u,  879679996u, 2909243462u, 3663771856u, 1141124467u,  855842277u, 2852801631u, 3708648649u,
+    1342533948u,  654459306u, 3188396048u, 3373015174u, 1466479909u,  544179635u, 3110523913u, 3462522015u,
+    1591671054u,  702138776u, 2966460450u, 3352799412u, 1504918807u,  783551873u, 3082640443u, 3233442989u,
+    3988292384u, 2596254646u,   62317068u, 1957810842u, 3939845945u, 2647816111u,   81470997u, 1943803523u,
+    3814918930u, 2489596804u,  225274430u, 2053790376u, 3826175755u, 2466906013u,  167816743u, 2097651377u,
+    4027552580u, 2265490386u,  503444072u, 1762050814u, 4150417245u, 2154129355u,  426522225u, 1852507879u,
+    4275313526u, 2312317920u,  282753626u, 1742555852u, 4189708143u, 2394877945u,  397917763u, 1622183637u,
+    3604390888u, 2714866558u,  953729732u, 1340076626u, 3518719985u, 2797360999u, 1068828381u, 1219638859u,
+    3624741850u, 2936675148u,  906185462u, 1090812512u, 3747672003u, 2825379669u,  829329135u, 1181335161u,
+    3412177804u, 3160834842u,  628085408u, 1382605366u, 3423369109u, 3138078467u,  570562233u, 1426400815u,
+    3317316542u, 2998733608u,  733239954u, 1555261956u, 3268935591u, 3050360625u,  752459403u, 1541320221u,
+    2607071920u, 3965973030u, 1969922972u,   40735498u, 2617837225u, 3943577151u, 1913087877u,   83908371u,
+    2512341634u, 3803740692u, 2075208622u,  213261112u, 2463272603u, 3855990285u, 2094854071u,  198958881u,
+    2262029012u, 4057260610u, 1759359992u,  534414190u, 2176718541u, 4139329115u, 1873836001u,  414664567u,
+    2282248934u, 4279200368u, 1711684554u,  285281116u, 2405801727u, 4167216745u, 1634467795u,  376229701u,
+    2685067896u, 3608007406u, 1308918612u,  956543938u, 2808555105u, 3495958263u, 1231636301u, 1047427035u,
+    2932959818u, 3654703836u, 1088359270u,  936918000u, 2847714899u, 3736837829u, 1202900863u,  817233897u,
+    3183342108u, 3401237130u, 1404277552u,  615818150u, 3134207493u, 3453421203u, 1423857449u,  601450431u,
+    3009837614u, 3294710456u, 1567103746u,  711928724u, 3020668471u, 3272380065u, 1510334235u,  755167117u
+  },
+  {
+             0u,  421212481u,  842424962u,  724390851u, 1684849924u, 2105013317u, 1448781702u, 1329698503u,
+    3369699848u, 3519200073u, 4210026634u, 3824474571u, 2897563404u, 3048111693u, 2659397006u, 2274893007u,
+    1254232657u, 1406739216u, 2029285587u, 1643069842u,  783210325u,  934667796u,  479770071u,   92505238u,
+    2182846553u, 2600511768u, 2955803355u, 2838940570u, 3866582365u, 4285295644u, 3561045983u, 3445231262u,
+    2508465314u, 2359236067u, 2813478432u, 3198777185u, 4058571174u, 3908292839u, 3286139684u, 3670389349u,
+    1566420650u, 1145479147u, 1869335592u, 1987116393u,  959540142u,  539646703u,  185010476u,  303839341u,
+    3745920755u, 3327985586u, 3983561841u, 4100678960u, 3140154359u, 2721170102u, 2300350837u, 2416418868u,
+     396344571u,  243568058u,  631889529u, 1018359608u, 1945336319u, 1793607870u, 1103436669u, 1490954812u,
+    4034481925u, 3915546180u, 3259968903u, 3679722694u, 2484439553u, 2366552896u, 2787371139u, 3208174018u,
+     950060301u,  565965900u,  177645455u,  328046286u, 1556873225u, 1171730760u, 1861902987u, 2011255754u,
+    3132841300u, 2745199637u, 2290958294u, 2442530455u, 3738671184u, 3352078609u, 3974232786u, 4126854035u,
+    1919080284u, 1803150877u, 1079293406u, 1498383519u,  370020952u,  253043481u,  607678682u, 1025720731u,
+    1711106983u, 2095471334u, 1472923941u, 1322268772u,   26324643u,  411738082u,  866634785u,  717028704u,
+    2904875439u, 3024081134u, 2668790573u, 2248782444u, 3376948395u, 3495106026u, 4219356713u, 3798300520u,
+     792689142u,  908347575u,  487136116u,   68299317u, 1263779058u, 1380486579u, 2036719216u, 1618931505u,
+    3890672638u, 4278043327u, 3587215740u, 3435896893u, 2206873338u, 2593195963u, 2981909624u, 2829542713u,
+     998479947u,  580430090u,  162921161u,  279890824u, 1609522511u, 1190423566u, 1842954189u, 1958874764u,
+    4082766403u, 3930137346u, 3245109441u, 3631694208u, 2536953671u, 2385372678u, 2768287173u, 3155920004u,
+    1900120602u, 1750776667u, 1131931800u, 1517083097u,  355290910u,  204897887u,  656092572u, 1040194781u,
+    3113746450u, 2692952403u, 2343461520u, 2461357009u, 3723805974u, 3304059991u, 4022511508u, 4141455061u,
+    2919742697u, 3072101800u, 2620513899u, 2234183466u, 3396041197u, 3547351212u, 4166851439u, 3779471918u,
+    1725839073u, 2143618976u, 1424512099u, 1307796770u,   45282277u,  464110244u,  813994343u,  698327078u,
+    3838160568u, 4259225593u, 3606301754u, 3488152955u, 2158586812u, 2578602749u, 2996767038u, 2877569151u,
+     740041904u,  889656817u,  506086962u,  120682355u, 1215357364u, 1366020341u, 2051441462u, 1667084919u,
+    3422213966u, 3538019855u, 4190942668u, 3772220557u, 2945847882u, 3062702859u, 2644537544u, 2226864521u,
+      52649286u,  439905287u,  823476164u,  672009861u, 1733269570u, 2119477507u, 1434057408u, 1281543041u,
+    2167981343u, 2552493150u, 3004082077u, 2853541596u, 3847487515u, 4233048410u, 3613549209u, 3464057816u,
+    1239502615u, 1358593622u, 2077699477u, 1657543892u,  764250643u,  882293586u,  532408465u,  111204816u,
+    1585378284u, 1197851309u, 1816695150u, 1968414767u,  974272232u,  587794345u,  136598634u,  289367339u,
+    2527558116u, 2411481253u, 2760973158u, 3179948583u, 4073438432u, 3956313505u, 3237863010u, 3655790371u,
+     347922877u,  229101820u,  646611775u, 1066513022u, 1892689081u, 1774917112u, 1122387515u, 1543337850u,
+    3697634229u, 3313392372u, 3998419255u, 4148705398u, 3087642289u, 2702352368u, 2319436851u, 2468674930u
+  },
+  {
+             0u,   29518391u,   59036782u,   38190681u,  118073564u,  114017003u,   76381362u,   89069189u,
+     236147128u,  265370511u,  228034006u,  206958561u,  152762724u,  148411219u,  178138378u,  190596925u,
+     472294256u,  501532999u,  530741022u,  509615401u,  456068012u,  451764635u,  413917122u,  426358261u,
+     305525448u,  334993663u,  296822438u,  275991697u,  356276756u,  352202787u,  381193850u,  393929805u,
+     944588512u,  965684439u, 1003065998u,  973863097u, 1061482044u, 1049003019u, 1019230802u, 1023561829u,
+     912136024u,  933002607u,  903529270u,  874031361u,  827834244u,  815125939u,  852716522u,  856752605u,
+     611050896u,  631869351u,  669987326u,  640506825u,  593644876u,  580921211u,  551983394u,  556069653u,
+     712553512u,  733666847u,  704405574u,  675154545u,  762387700u,  749958851u,  787859610u,  792175277u,
+    1889177024u, 1901651959u, 1931368878u, 1927033753u, 2006131996u, 1985040171u, 1947726194u, 1976933189u,
+    2122964088u, 2135668303u, 2098006038u, 2093965857u, 2038461604u, 2017599123u, 2047123658u, 2076625661u,
+    1824272048u, 1836991623u, 1866005214u, 1861914857u, 1807058540u, 1786244187u, 1748062722u, 1777547317u,
+    1655668488u, 1668093247u, 1630251878u, 1625932113u, 1705433044u, 1684323811u, 1713505210u, 1742760333u,
+    1222101792u, 1226154263u, 1263738702u, 1251046777u, 1339974652u, 1310460363u, 1281013650u, 1301863845u,
+    1187289752u, 1191637167u, 1161842422u, 1149379777u, 1103966788u, 1074747507u, 1112139306u, 1133218845u,
+    1425107024u, 1429406311u, 1467333694u, 1454888457u, 1408811148u, 1379576507u, 1350309090u, 1371438805u,
+    1524775400u, 1528845279u, 1499917702u, 1487177649u, 1575719220u, 1546255107u, 1584350554u, 1605185389u,
+    3778354048u, 3774312887u, 3803303918u, 3816007129u, 3862737756u, 3892238699u, 3854067506u, 3833203973u,
+    4012263992u, 4007927823u, 3970080342u, 3982554209u, 3895452388u, 3924658387u, 3953866378u, 3932773565u,
+    4245928176u, 4241609415u, 4271336606u, 4283762345u, 4196012076u, 4225268251u, 4187931714u, 4166823541u,
+    4076923208u, 4072833919u, 4035198246u, 4047918865u, 4094247316u, 4123732899u, 4153251322u, 4132437965u,
+    3648544096u, 3636082519u, 3673983246u, 3678331705u, 3732010428u, 3753090955u, 3723829714u, 3694611429u,
+    3614117080u, 3601426159u, 3572488374u, 3576541825u, 3496125444u, 3516976691u, 3555094634u, 3525581405u,
+    3311336976u, 3298595879u, 3336186494u, 3340255305u, 3260503756u, 3281337595u, 3251864226u, 3222399125u,
+    3410866088u, 3398419871u, 3368647622u, 3372945905u, 3427010420u, 3448139075u, 3485520666u, 3456284973u,
+    2444203584u, 2423127159u, 2452308526u, 2481530905u, 2527477404u, 2539934891u, 2502093554u, 2497740997u,
+    2679949304u, 2659102159u, 2620920726u, 2650438049u, 2562027300u, 2574714131u, 2603727690u, 2599670141u,
+    2374579504u, 2353749767u, 2383274334u, 2412743529u, 2323684844u, 2336421851u, 2298759554u, 2294686645u,
+    2207933576u, 2186809023u, 2149495014u, 2178734801u, 2224278612u, 2236720739u, 2266437690u, 2262135309u,
+    2850214048u, 2820717207u, 2858812622u, 2879680249u, 2934667388u, 2938704459u, 2909776914u, 2897069605u,
+    2817622296u, 2788420399u, 2759153014u, 2780249921u, 2700618180u, 2704950259u, 2742877610u, 2730399645u,
+    3049550800u, 3020298727u, 3057690558u, 3078802825u, 2999835404u, 3004150075u, 2974355298u, 2961925461u,
+    3151438440u, 3121956959u, 3092510214u, 3113327665u, 3168701108u, 3172786307u, 3210370778u, 3197646061u
+  },
+  {
+             0u, 3099354981u, 2852767883u,  313896942u, 2405603159u,  937357362u,  627793884u, 2648127673u,
+    3316918511u, 2097696650u, 1874714724u, 3607201537u, 1255587768u, 4067088605u, 3772741427u, 1482887254u,
+    1343838111u, 3903140090u, 4195393300u, 1118632049u, 3749429448u, 1741137837u, 1970407491u, 3452858150u,
+    2511175536u,  756094997u, 1067759611u, 2266550430u,  449832999u, 2725482306u, 2965774508u,  142231497u,
+    2687676222u,  412010587u,  171665333u, 2995192016u,  793786473u, 2548850444u, 2237264098u, 1038456711u,
+    1703315409u, 3711623348u, 3482275674u, 1999841343u, 3940814982u, 1381529571u, 1089329165u, 4166106984u,
+    4029413537u, 1217896388u, 1512189994u, 3802027855u, 2135519222u, 3354724499u, 3577784189u, 1845280792u,
+     899665998u, 2367928107u, 2677414085u,  657096608u, 3137160985u,   37822588u,  284462994u, 2823350519u,
+    2601801789u,  598228824u,  824021174u, 2309093331u,  343330666u, 2898962447u, 3195996129u,  113467524u,
+    1587572946u, 3860600759u, 4104763481u, 1276501820u, 3519211397u, 1769898208u, 2076913422u, 3279374443u,
+    3406630818u, 1941006535u, 1627703081u, 3652755532u, 1148164341u, 4241751952u, 3999682686u, 1457141531u,
+     247015245u, 3053797416u, 2763059142u,  470583459u, 2178658330u,  963106687u,  735213713u, 2473467892u,
+     992409347u, 2207944806u, 2435792776u,  697522413u, 3024379988u,  217581361u,  508405983u, 2800865210u,
+    4271038444u, 1177467017u, 1419450215u, 3962007554u, 1911572667u, 3377213406u, 3690561584u, 1665525589u,
+    1799331996u, 3548628985u, 3241568279u, 2039091058u, 3831314379u, 1558270126u, 1314193216u, 4142438437u,
+    2928380019u,  372764438u,   75645176u, 3158189981u,  568925988u, 2572515393u, 2346768303u,  861712586u,
+    3982079547u, 1441124702u, 1196457648u, 4293663189u, 1648042348u, 3666298377u, 3358779879u, 1888390786u,
+     686661332u, 2421291441u, 2196002399u,  978858298u, 2811169155u,  523464422u,  226935048u, 3040519789u,
+    3175145892u,  100435649u,  390670639u, 2952089162u,  841119475u, 2325614998u, 2553003640u,  546822429u,
+    2029308235u, 3225988654u, 3539796416u, 1782671013u, 4153826844u, 1328167289u, 1570739863u, 3844338162u,
+    1298864389u, 4124540512u, 3882013070u, 1608431339u, 3255406162u, 2058742071u, 1744848601u, 3501990332u,
+    2296328682u,  811816591u,  584513889u, 2590678532u,  129869501u, 3204563416u, 2914283062u,  352848211u,
+     494030490u, 2781751807u, 3078325777u,  264757620u, 2450577869u,  715964072u,  941166918u, 2158327331u,
+    3636881013u, 1618608400u, 1926213374u, 3396585883u, 1470427426u, 4011365959u, 4255988137u, 1158766284u,
+    1984818694u, 3471935843u, 3695453837u, 1693991400u, 4180638033u, 1100160564u, 1395044826u, 3952793279u,
+    3019491049u,  189112716u,  435162722u, 2706139399u, 1016811966u, 2217162459u, 2526189877u,  774831696u,
+     643086745u, 2666061564u, 2354934034u,  887166583u, 2838900430u,  294275499u,   54519365u, 3145957664u,
+    3823145334u, 1532818963u, 1240029693u, 4048895640u, 1820460577u, 3560857924u, 3331051178u, 2117577167u,
+    3598663992u, 1858283101u, 2088143283u, 3301633750u, 1495127663u, 3785470218u, 4078182116u, 1269332353u,
+     332098007u, 2876706482u, 3116540252u,   25085497u, 2628386432u,  605395429u,  916469259u, 2384220526u,
+    2254837415u, 1054503362u,  745528876u, 2496903497u,  151290352u, 2981684885u, 2735556987u,  464596510u,
+    1137851976u, 4218313005u, 3923506883u, 1365741990u, 3434129695u, 1946996346u, 1723425172u, 3724871409u
+  },
+  {
+             0u, 1029712304u, 2059424608u, 1201699536u, 4118849216u, 3370159984u, 2403399072u, 2988497936u,
+     812665793u,  219177585u, 1253054625u, 2010132753u, 3320900865u, 4170237105u, 3207642721u, 2186319825u,
+    1625331586u, 1568718386u,  438355170u,  658566482u, 2506109250u, 2818578674u, 4020265506u, 3535817618u,
+    1351670851u, 1844508147u,  709922595u,  389064339u, 2769320579u, 2557498163u, 3754961379u, 3803185235u,
+    3250663172u, 4238411444u, 3137436772u, 2254525908u,  876710340u,  153198708u, 1317132964u, 1944187668u,
+    4054934725u, 3436268917u, 2339452837u, 3054575125u,   70369797u,  961670069u, 2129760613u, 1133623509u,
+    2703341702u, 2621542710u, 3689016294u, 3867263574u, 1419845190u, 1774270454u,  778128678u,  318858390u,
+    2438067015u, 2888948471u, 3952189479u, 3606153623u, 1691440519u, 1504803895u,  504432359u,  594620247u,
+    1492342857u, 1704161785u,  573770537u,  525542041u, 2910060169u, 2417219385u, 3618876905u, 3939730521u,
+    1753420680u, 1440954936u,  306397416u,  790849880u, 2634265928u, 2690882808u, 3888375336u, 3668168600u,
+     940822475u,   91481723u, 1121164459u, 2142483739u, 3448989963u, 4042473659u, 3075684971u, 2318603227u,
+     140739594u,  889433530u, 1923340138u, 1338244826u, 4259521226u, 3229813626u, 2267247018u, 3124975642u,
+    2570221389u, 2756861693u, 3824297005u, 3734113693u, 1823658381u, 1372780605u,  376603373u,  722643805u,
+    2839690380u, 2485261628u, 3548540908u, 4007806556u, 1556257356u, 1638052860u,  637716780u,  459464860u,
+    4191346895u, 3300051327u, 2199040943u, 3195181599u,  206718479u,  825388991u, 1989285231u, 1274166495u,
+    3382881038u, 4106388158u, 3009607790u, 2382549470u, 1008864718u,   21111934u, 1189240494u, 2072147742u,
+    2984685714u, 2357631266u, 3408323570u, 4131834434u, 1147541074u, 2030452706u, 1051084082u,   63335554u,
+    2174155603u, 3170292451u, 4216760371u, 3325460867u, 1947622803u, 1232499747u,  248909555u,  867575619u,
+    3506841360u, 3966111392u, 2881909872u, 2527485376u,  612794832u,  434546784u, 1581699760u, 1663499008u,
+    3782634705u, 3692447073u, 2612412337u, 2799048193u,  351717905u,  697754529u, 1849071985u, 1398190273u,
+    1881644950u, 1296545318u,  182963446u,  931652934u, 2242328918u, 3100053734u, 4284967478u, 3255255942u,
+    1079497815u, 2100821479u,  983009079u,  133672583u, 3050795671u, 2293717799u, 3474399735u, 4067887175u,
+     281479188u,  765927844u, 1778867060u, 1466397380u, 3846680276u, 3626469220u, 2676489652u, 2733102084u,
+     548881365u,  500656741u, 1517752501u, 1729575173u, 3577210133u, 3898068133u, 2952246901u, 2459410373u,
+    3910527195u, 3564487019u, 2480257979u, 2931134987u,  479546907u,  569730987u, 1716854139u, 1530213579u,
+    3647316762u, 3825568426u, 2745561210u, 2663766474u,  753206746u,  293940330u, 1445287610u, 1799716618u,
+    2314567513u, 3029685993u, 4080348217u, 3461678473u, 2088098201u, 1091956777u,  112560889u, 1003856713u,
+    3112514712u, 2229607720u, 3276105720u, 4263857736u, 1275433560u, 1902492648u,  918929720u,  195422344u,
+     685033439u,  364179055u, 1377080511u, 1869921551u, 3713294623u, 3761522863u, 2811507327u, 2599689167u,
+     413436958u,  633644462u, 1650777982u, 1594160846u, 3978570462u, 3494118254u, 2548332990u, 2860797966u,
+    1211387997u, 1968470509u,  854852413u,  261368461u, 3182753437u, 2161434413u, 3346310653u, 4195650637u,
+    2017729436u, 1160000044u,   42223868u, 1071931724u, 2378480988u, 2963576044u, 4144295484u, 3395602316u
+  },
+  {
+             0u, 3411858341u, 1304994059u, 2257875630u, 2609988118u, 1355649459u, 3596215069u,  486879416u,
+    3964895853u,  655315400u, 2711298918u, 1791488195u, 2009251963u, 3164476382u,  973758832u, 4048990933u,
+      64357019u, 3364540734u, 1310630800u, 2235723829u, 2554806413u, 1394316072u, 3582976390u,  517157411u,
+    4018503926u,  618222419u, 2722963965u, 1762783832u, 1947517664u, 3209171269u,  970744811u, 4068520014u,
+     128714038u, 3438335635u, 1248109629u, 2167961496u, 2621261600u, 1466012805u, 3522553387u,  447296910u,
+    3959392091u,  547575038u, 2788632144u, 1835791861u, 1886307661u, 3140622056u, 1034314822u, 4143626211u,
+      75106221u, 3475428360u, 1236444838u, 2196665603u, 2682996155u, 1421317662u, 3525567664u,  427767573u,
+    3895035328u,  594892389u, 2782995659u, 1857943406u, 1941489622u, 3101955187u, 1047553757u, 4113347960u,
+     257428076u, 3288652233u, 1116777319u, 2311878850u, 2496219258u, 1603640287u, 3640781169u,  308099796u,
+    3809183745u,  676813732u, 2932025610u, 1704983215u, 2023410199u, 3016104370u,  894593820u, 4262377657u,
+     210634999u, 3352484690u, 1095150076u, 2316991065u, 2535410401u, 1547934020u, 3671583722u,  294336591u,
+    3772615322u,  729897279u, 2903845777u, 1716123700u, 2068629644u, 2953845545u,  914647431u, 4258839074u,
+     150212442u, 3282623743u, 1161604689u, 2388688372u, 2472889676u, 1480171241u, 3735940167u,  368132066u,
+    3836185911u,  805002898u, 2842635324u, 1647574937u, 2134298401u, 3026852996u,  855535146u, 4188192143u,
+     186781121u, 3229539940u, 1189784778u, 2377547631u, 2427670487u, 1542429810u, 3715886812u,  371670393u,
+    3882979244u,  741170185u, 2864262823u, 1642462466u, 2095107514u, 3082559007u,  824732849u, 4201955092u,
+     514856152u, 3589064573u, 1400419795u, 2552522358u, 2233554638u, 1316849003u, 3370776517u,   62202976u,
+    4075001525u,  968836368u, 3207280574u, 1954014235u, 1769133219u, 2720925446u,  616199592u, 4024870413u,
+     493229635u, 3594175974u, 1353627464u, 2616354029u, 2264355925u, 1303087088u, 3409966430u,    6498043u,
+    4046820398u,  979978123u, 3170710821u, 2007099008u, 1789187640u, 2717386141u,  661419827u, 3962610838u,
+     421269998u, 3527459403u, 1423225061u, 2676515648u, 2190300152u, 1238466653u, 3477467891u,   68755798u,
+    4115633027u, 1041448998u, 3095868040u, 1943789869u, 1860096405u, 2776760880u,  588673182u, 3897205563u,
+     449450869u, 3516317904u, 1459794558u, 2623431131u, 2170245475u, 1242006214u, 3432247400u,  131015629u,
+    4137259288u, 1036337853u, 3142660115u, 1879958454u, 1829294862u, 2790523051u,  549483013u, 3952910752u,
+     300424884u, 3669282065u, 1545650111u, 2541513754u, 2323209378u, 1092980487u, 3350330793u,  216870412u,
+    4256931033u,  921128828u, 2960342482u, 2066738807u, 1714085583u, 2910195050u,  736264132u, 3770592353u,
+     306060335u, 3647131530u, 1610005796u, 2494197377u, 2309971513u, 1123257756u, 3295149874u,  255536279u,
+    4268596802u,  892423655u, 3013951305u, 2029645036u, 1711070292u, 2929725425u,  674528607u, 3815288570u,
+     373562242u, 3709388839u, 1535949449u, 2429577516u, 2379569556u, 1183418929u, 3223189663u,  188820282u,
+    4195850735u,  827017802u, 3084859620u, 2089020225u, 1636228089u, 2866415708u,  743340786u, 3876759895u,
+     361896217u, 3738094268u, 1482340370u, 2466671543u, 2382584591u, 1163888810u, 3284924932u,  144124321u,
+    4190215028u,  849168593u, 3020503679u, 2136336858u, 1649465698u, 2836138695u,  798521449u, 3838094284u
+  },
+  {
+             0u, 2792819636u, 2543784233u,  837294749u, 4098827283u, 1379413927u, 1674589498u, 3316072078u,
+     871321191u, 2509784531u, 2758827854u,   34034938u, 3349178996u, 1641505216u, 1346337629u, 4131942633u,
+    1742642382u, 3249117050u, 4030828007u, 1446413907u, 2475800797u,  904311657u,   68069876u, 2725880384u,
+    1412551337u, 4064729373u, 3283010432u, 1708771380u, 2692675258u,  101317902u,  937551763u, 2442587175u,
+    3485284764u, 1774858792u, 1478633653u, 4266992385u, 1005723023u, 2642744891u, 2892827814u,  169477906u,
+    4233263099u, 1512406095u, 1808623314u, 3451546982u,  136139752u, 2926205020u, 2676114113u,  972376437u,
+    2825102674u,  236236518u, 1073525883u, 2576072655u, 1546420545u, 4200303349u, 3417542760u, 1841601500u,
+    2609703733u, 1039917185u,  202635804u, 2858742184u, 1875103526u, 3384067218u, 4166835727u, 1579931067u,
+    1141601657u, 3799809741u, 3549717584u, 1977839588u, 2957267306u,  372464350u,  668680259u, 2175552503u,
+    2011446046u, 3516084394u, 3766168119u, 1175200131u, 2209029901u,  635180217u,  338955812u, 2990736784u,
+     601221559u, 2242044419u, 3024812190u,  306049834u, 3617246628u, 1911408144u, 1074125965u, 3866285881u,
+     272279504u, 3058543716u, 2275784441u,  567459149u, 3832906691u, 1107462263u, 1944752874u, 3583875422u,
+    2343980261u,  767641425u,  472473036u, 3126744696u, 2147051766u, 3649987394u, 3899029983u, 1309766251u,
+    3092841090u,  506333494u,  801510315u, 2310084639u, 1276520081u, 3932237093u, 3683203000u, 2113813516u,
+    3966292011u, 1243601823u, 2079834370u, 3716205238u,  405271608u, 3192979340u, 2411259153u,  701492901u,
+    3750207052u, 2045810168u, 1209569125u, 4000285905u,  734575199u, 2378150379u, 3159862134u,  438345922u,
+    2283203314u,  778166598u,  529136603u, 3120492655u, 2086260449u, 3660498261u, 3955679176u, 1303499900u,
+    3153699989u,  495890209u,  744928700u, 2316418568u, 1337360518u, 3921775410u, 3626602927u, 2120129051u,
+    4022892092u, 1237286280u, 2018993941u, 3726666913u,  461853231u, 3186645403u, 2350400262u,  711936178u,
+    3693557851u, 2052076527u, 1270360434u, 3989775046u,  677911624u, 2384402428u, 3220639073u,  427820757u,
+    1202443118u, 3789347034u, 3493118535u, 1984154099u, 3018127229u,  362020041u,  612099668u, 2181885408u,
+    1950653705u, 3526596285u, 3822816288u, 1168934804u, 2148251930u,  645706414u,  395618355u, 2984485767u,
+     544559008u, 2248295444u, 3085590153u,  295523645u, 3560598451u, 1917673479u, 1134918298u, 3855773998u,
+     328860103u, 3052210803u, 2214924526u,  577903450u, 3889505748u, 1101147744u, 1883911421u, 3594338121u,
+    3424493451u, 1785369663u, 1535282850u, 4260726038u,  944946072u, 2653270060u, 2949491377u,  163225861u,
+    4294103532u, 1501944408u, 1752023237u, 3457862513u,  196998655u, 2915761739u, 2619532502u,  978710370u,
+    2881684293u,  229902577u, 1012666988u, 2586515928u, 1603020630u, 4193987810u, 3356702335u, 1852063179u,
+    2553040162u, 1046169238u,  263412747u, 2848217023u, 1818454321u, 3390333573u, 4227627032u, 1569420204u,
+      60859927u, 2782375331u, 2487203646u,  843627658u, 4159668740u, 1368951216u, 1617990445u, 3322386585u,
+     810543216u, 2520310724u, 2815490393u,   27783917u, 3288386659u, 1652017111u, 1402985802u, 4125677310u,
+    1685994201u, 3255382381u, 4091620336u, 1435902020u, 2419138250u,  910562686u,  128847843u, 2715354199u,
+    1469150398u, 4058414858u, 3222168983u, 1719234083u, 2749255853u,   94984985u,  876691844u, 2453031472u
+  },
+  {
+             0u, 3433693342u, 1109723005u, 2391738339u, 2219446010u, 1222643300u, 3329165703u,  180685081u,
+    3555007413u,  525277995u, 2445286600u, 1567235158u, 1471092047u, 2600801745u,  361370162u, 3642757804u,
+    2092642603u, 2953916853u, 1050555990u, 4063508168u, 4176560081u,  878395215u, 3134470316u, 1987983410u,
+    2942184094u, 1676945920u, 3984272867u,  567356797u,  722740324u, 3887998202u, 1764827929u, 2778407815u,
+    4185285206u,  903635656u, 3142804779u, 2012833205u, 2101111980u, 2979425330u, 1058630609u, 4088621903u,
+     714308067u, 3862526333u, 1756790430u, 2753330688u, 2933487385u, 1651734407u, 3975966820u,  542535930u,
+    2244825981u, 1231508451u, 3353891840u,  188896414u,   25648519u, 3442302233u, 1134713594u, 2399689316u,
+    1445480648u, 2592229462u,  336416693u, 3634843435u, 3529655858u,  516441772u, 2420588879u, 1559052753u,
+     698204909u, 3845636723u, 1807271312u, 2803025166u, 2916600855u, 1635634313u, 4025666410u,  593021940u,
+    4202223960u,  919787974u, 3093159461u, 1962401467u, 2117261218u, 2996361020u, 1008193759u, 4038971457u,
+    1428616134u, 2576151384u,  386135227u, 3685348389u, 3513580860u,  499580322u, 2471098945u, 1608776415u,
+    2260985971u, 1248454893u, 3303468814u,  139259792u,   42591881u, 3458459159u, 1085071860u, 2349261162u,
+    3505103035u,  474062885u, 2463016902u, 1583654744u, 1419882049u, 2550902495u,  377792828u, 3660491170u,
+      51297038u, 3483679632u, 1093385331u, 2374089965u, 2269427188u, 1273935210u, 3311514249u,  164344343u,
+    2890961296u, 1627033870u, 4000683757u,  585078387u,  672833386u, 3836780532u, 1782552599u, 2794821769u,
+    2142603813u, 3005188795u, 1032883544u, 4047146438u, 4227826911u,  928351297u, 3118105506u, 1970307900u,
+    1396409818u, 2677114180u,  287212199u, 3719594553u, 3614542624u,  467372990u, 2505346141u, 1509854403u,
+    2162073199u, 1282711281u, 3271268626u,  240228748u,   76845205u, 3359543307u, 1186043880u, 2317064054u,
+     796964081u, 3811226735u, 1839575948u, 2702160658u, 2882189835u, 1734392469u, 3924802934u,  625327592u,
+    4234522436u,  818917338u, 3191908409u, 1927981223u, 2016387518u, 3028656416u,  973776579u, 4137723485u,
+    2857232268u, 1726474002u, 3899187441u,  616751215u,  772270454u, 3803048424u, 1814228491u, 2693328533u,
+    2041117753u, 3036871847u,  999160644u, 4146592730u, 4259508931u,  826864221u, 3217552830u, 1936586016u,
+    3606501031u,  442291769u, 2496909786u, 1484378436u, 1388107869u, 2652297411u,  278519584u, 3694387134u,
+      85183762u, 3384397196u, 1194773103u, 2342308593u, 2170143720u, 1307820918u, 3279733909u,  265733131u,
+    2057717559u, 3054258089u,  948125770u, 4096344276u, 4276898253u,  843467091u, 3167309488u, 1885556270u,
+    2839764098u, 1709792284u, 3949353983u,  667704161u,  755585656u, 3785577190u, 1865176325u, 2743489947u,
+     102594076u, 3401021058u, 1144549729u, 2291298815u, 2186770662u, 1325234296u, 3228729243u,  215514885u,
+    3589828009u,  424832311u, 2547870420u, 1534552650u, 1370645331u, 2635621325u,  328688686u, 3745342640u,
+    2211456353u, 1333405183u, 3254067740u,  224338562u,  127544219u, 3408931589u, 1170156774u, 2299866232u,
+    1345666772u, 2627681866u,  303053225u, 3736746295u, 3565105198u,  416624816u, 2522494803u, 1525692365u,
+    4285207626u,  868291796u, 3176010551u, 1910772649u, 2065767088u, 3079346734u,  956571085u, 4121828691u,
+     747507711u, 3760459617u, 1856702594u, 2717976604u, 2831417605u, 1684930971u, 3940615800u,  642451174u
+  }
 };
 
-/*Return the CRC of the bytes buf[0..len-1].*/
-unsigned lodepng_crc32(const unsigned char* buf, size_t len)
+#ifdef LODEPNG_SIMD_SSE2
+/*
+Folds 64 bytes at a time with carry-less multiplies by x^(512+-32) and x^(512+32)
+mod P, then 16 at a time, then reduces the last 128 bits with Barrett reduction.
+The constants are those of Intel's "Fast CRC Computation for Generic Polynomials
+Using PCLMULQDQ Instruction", bit reflected. len must be a multiple of 16 and at
+least 64, c is the CRC register, without the final inversion.
+*/
+static LODEPNG_TARGET_PCLMUL unsigned crc32PCLMUL(unsigned c, const unsigned char* buf, size_t len)
+{
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596ll, 0x0154442bd4ll);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009ell, 0x01751997d0ll);
+  const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124ll);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641ll, 0x01db710641ll);
+  const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)buf), _mm_cvtsi32_si128((int)c));
+  x2 = _mm_loadu_si128((const __m128i*)(buf + 16));
+  x3 = _mm_loadu_si128((const __m128i*)(buf + 32));
+  x4 = _mm_loadu_si128((const __m128i*)(buf + 48));
+  buf += 64;
+  len -= 64;
+
+  while(len >= 64)
+  {
+    x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)buf));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(buf + 16)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(buf + 32)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(buf + 48)));
+    buf += 64;
+    len -= 64;
+  }
+
+  /*fold the four lanes into one*/
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+
+  while(len >= 16)
+  {
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i*)buf)), x5);
+    buf += 16;
+    len -= 16;
+  }
+
+  /*128 to 64 bits*/
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5k0, 0x00), x2);
+
+  /*Barrett reduction to 32 bits*/
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, low32), poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  x0 = _mm_srli_si128(x1, 4);
+  return (unsigned)_mm_cvtsi128_si32(x0);
+}
+#endif /*LODEPNG_SIMD_SSE2*/
+
+#ifdef LODEPNG_ARM_CRC32
+/*the ARMv8 CRC32 instructions use the same polynomial*/
+static LODEPNG_TARGET_ARM_CRC32 unsigned crc32ARM(unsigned c, const unsigned char* buf, size_t len)
 {
-  unsigned c = 0xffffffffL;
-  size_t n;
+  for(; len >= 8; len -= 8, buf += 8)
+  {
+    uint64_t v;
+    memcpy(&v, buf, 8);
+    c = __crc32d(c, v);
+  }
+  for(; len > 0; len--) c = __crc32b(c, *buf++);
+  return c;
+}
+#endif /*LODEPNG_ARM_CRC32*/
+
+/*c is the CRC register, without the initial and final inversion*/
+static unsigned update_crc32(unsigned c, const unsigned char* buf, size_t len)
+{
+#ifdef LODEPNG_SIMD_SSE2
+  if(len >= 64 && (lodepng_cpu_features() & LODEPNG_CPU_PCLMUL))
+  {
+    size_t whole = len & ~(size_t)15;
+    c = crc32PCLMUL(c, buf, whole);
+    buf += whole;
+    len -= whole;
+  }
+#elif defined(LODEPNG_ARM_CRC32)
+  if(lodepng_cpu_features() & LODEPNG_CPU_ARM_CRC32) return crc32ARM(c, buf, len);
+#endif
 
-  for(n = 0; n < len; n++)
+  /*slice-by-8, the bytes are combined explicitly so the order does not depend on the machine*/
+  for(; len >= 8; len -= 8, buf += 8)
   {
-    c = lodepng_crc32_table[(c ^ buf[n]) & 0xff] ^ (c >> 8);
+    unsigned one = c ^ (buf[0] | ((unsigned)buf[1] << 8) | ((unsigned)buf[2] << 16) | ((unsigned)buf[3] << 24));
+    unsigned two = buf[4] | ((unsigned)buf[5] << 8) | ((unsigned)buf[6] << 16) | ((unsigned)buf[7] << 24);
+    c = lodepng_crc32_table[7][one & 0xff] ^ lodepng_crc32_table[6][(one >> 8) & 0xff]
+      ^ lodepng_crc32_table[5][(one >> 16) & 0xff] ^ lodepng_crc32_table[4][one >> 24]
+      ^ lodepng_crc32_table[3][two & 0xff] ^ lodepng_crc32_table[2][(two >> 8) & 0xff]
+      ^ lodepng_crc32_table[1][(two >> 16) & 0xff] ^ lodepng_crc32_table[0][two >> 24];
   }
-  return c ^ 0xffffffffL;
+  for(; len > 0; len--, buf++)
+  {
+    c = lodepng_crc32_table[0][(c ^ *buf) & 0xff] ^ (c >> 8);
+  }
+  return c;
+}
+
+/*Return the CRC of the bytes buf[0..len-1].*/
+unsigned lodepng_crc32(const unsigned char* buf, size_t len)
+{
+  return update_crc32(0xffffffffL, buf, len) ^ 0xffffffffL;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -3859,8 +5298,291 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
   return state->error;
 }
 
+/*
+Vectorized unfiltering for 8-bit RGB and RGBA, the bulk of what the textures use.
+Sub, Average and Paeth depend on the pixel to the left, so those run one pixel
+per register; Up has no such dependency and runs 16 bytes at a time. Paeth uses
+the branchless formulation: with pa = |b - c|, pb = |a - c| and pc = |a + b - 2c|,
+the predictor is the first of a, b, c whose distance equals the smallest of the
+three. The results are identical to the scalar code.
+Pixels move as 4 bytes. For RGB the fourth byte is the next pixel's first: its
+predictor lane is masked to zero so it is written back unchanged, which keeps
+in-place unfiltering correct. Only the last pixel of an RGB row moves as 3 bytes.
+*/
+
+#if defined(LODEPNG_SIMD_SSE2) || defined(LODEPNG_SIMD_NEON)
+
+/*remaining is the number of bytes left in the scanline from p*/
+static unsigned loadPixel(const unsigned char* p, size_t remaining)
+{
+  unsigned v = 0;
+  if(remaining >= 4) memcpy(&v, p, 4);
+  else memcpy(&v, p, 3);
+  return v;
+}
+
+static void storePixel(unsigned char* p, unsigned v, size_t remaining)
+{
+  if(remaining >= 4) memcpy(p, &v, 4);
+  else memcpy(p, &v, 3);
+}
+
+/*which bytes of a 4 byte pixel belong to it*/
+static unsigned pixelMask(size_t bytewidth)
+{
+  return bytewidth == 4 ? 0xFFFFFFFFu : 0x00FFFFFFu;
+}
+
+#endif
+
+#ifdef LODEPNG_SIMD_SSE2
+
+static __m128i loadPixelSSE2(const unsigned char* p, size_t remaining)
+{
+  return _mm_cvtsi32_si128((int)loadPixel(p, remaining));
+}
+
+static void storePixelSSE2(unsigned char* p, __m128i v, size_t remaining)
+{
+  storePixel(p, (unsigned)_mm_cvtsi128_si32(v), remaining);
+}
+
+static void unfilterUpSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t length)
+{
+  size_t i = 0;
+  for(; i + 16 <= length; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+    __m128i b = _mm_loadu_si128((const __m128i*)&precon[i]);
+    _mm_storeu_si128((__m128i*)&recon[i], _mm_add_epi8(x, b));
+  }
+  for(; i < length; i++) recon[i] = scanline[i] + precon[i];
+}
+
+static void unfilterSubSSE2(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length)
+{
+  const __m128i mask = _mm_cvtsi32_si128((int)pixelMask(bytewidth));
+  __m128i a = _mm_setzero_si128();
+  size_t i;
+  for(i = 0; i < length; i += bytewidth)
+  {
+    a = _mm_add_epi8(_mm_and_si128(a, mask), loadPixelSSE2(&scanline[i], length - i));
+    storePixelSSE2(&recon[i], a, length - i);
+  }
+}
+
+static void unfilterAverageSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                size_t bytewidth, size_t length)
+{
+  /*_mm_avg_epu8 rounds up, the filter rounds down: take the low bit of a ^ b back off*/
+  const __m128i mask = _mm_cvtsi32_si128((int)pixelMask(bytewidth));
+  const __m128i one = _mm_set1_epi8(1);
+  __m128i a = _mm_setzero_si128();
+  size_t i;
+  for(i = 0; i < length; i += bytewidth)
+  {
+    __m128i b = loadPixelSSE2(&precon[i], length - i);
+    __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+    a = _mm_add_epi8(loadPixelSSE2(&scanline[i], length - i), _mm_and_si128(avg, mask));
+    storePixelSSE2(&recon[i], a, length - i);
+  }
+}
+
+/*
+One Paeth pixel. a, b and c are widened to 16 bits, pa, pb and pc are the
+distances; the predictor is added to the filtered bytes in x.
+*/
+static __m128i paethPixelSSE2(__m128i a, __m128i b, __m128i c, __m128i pa, __m128i pb, __m128i pc,
+                              __m128i x, __m128i mask)
+{
+  __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+  __m128i use_a = _mm_cmpeq_epi16(smallest, pa);
+  __m128i use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(smallest, pb));
+  __m128i use_c = _mm_andnot_si128(_mm_or_si128(use_a, use_b), _mm_set1_epi16(-1));
+  __m128i predictor = _mm_or_si128(_mm_or_si128(_mm_and_si128(use_a, a), _mm_and_si128(use_b, b)), _mm_and_si128(use_c, c));
+  return _mm_add_epi8(_mm_and_si128(_mm_packus_epi16(predictor, predictor), mask), x);
+}
+
+static void unfilterPaethSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                              size_t bytewidth, size_t length)
+{
+  const __m128i mask = _mm_cvtsi32_si128((int)pixelMask(bytewidth));
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero, c = zero;
+  size_t i;
+  for(i = 0; i < length; i += bytewidth)
+  {
+    __m128i b = _mm_unpacklo_epi8(loadPixelSSE2(&precon[i], length - i), zero);
+    __m128i pa = _mm_sub_epi16(b, c);
+    __m128i pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_add_epi16(pa, pb);
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+    __m128i x = paethPixelSSE2(a, b, c, pa, pb, pc, loadPixelSSE2(&scanline[i], length - i), mask);
+    storePixelSSE2(&recon[i], x, length - i);
+    a = _mm_unpacklo_epi8(x, zero);
+    c = b;
+  }
+}
+
+/*SSSE3 has a single instruction absolute value, the rest is the SSE2 code*/
+LODEPNG_TARGET_SSSE3
+static void unfilterPaethSSSE3(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                               size_t bytewidth, size_t length)
+{
+  const __m128i mask = _mm_cvtsi32_si128((int)pixelMask(bytewidth));
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero, c = zero;
+  size_t i;
+  for(i = 0; i < length; i += bytewidth)
+  {
+    __m128i b = _mm_unpacklo_epi8(loadPixelSSE2(&precon[i], length - i), zero);
+    __m128i pa = _mm_sub_epi16(b, c);
+    __m128i pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_abs_epi16(_mm_add_epi16(pa, pb));
+    __m128i x = paethPixelSSE2(a, b, c, _mm_abs_epi16(pa), _mm_abs_epi16(pb), pc, loadPixelSSE2(&scanline[i], length - i), mask);
+    storePixelSSE2(&recon[i], x, length - i);
+    a = _mm_unpacklo_epi8(x, zero);
+    c = b;
+  }
+}
+
+#endif /*LODEPNG_SIMD_SSE2*/
+
+#ifdef LODEPNG_SIMD_NEON
+
+static uint8x8_t loadPixelNEON(const unsigned char* p, size_t remaining)
+{
+  return vreinterpret_u8_u32(vdup_n_u32(loadPixel(p, remaining)));
+}
+
+static void storePixelNEON(unsigned char* p, uint8x8_t v, size_t remaining)
+{
+  storePixel(p, vget_lane_u32(vreinterpret_u32_u8(v), 0), remaining);
+}
+
+static uint8x8_t pixelMaskNEON(size_t bytewidth)
+{
+  return vreinterpret_u8_u32(vdup_n_u32(pixelMask(bytewidth)));
+}
+
+static void unfilterUpNEON(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t length)
+{
+  size_t i = 0;
+  for(; i + 16 <= length; i += 16)
+  {
+    vst1q_u8(&recon[i], vaddq_u8(vld1q_u8(&scanline[i]), vld1q_u8(&precon[i])));
+  }
+  for(; i < length; i++) recon[i] = scanline[i] + precon[i];
+}
+
+static void unfilterSubNEON(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length)
+{
+  const uint8x8_t mask = pixelMaskNEON(bytewidth);
+  uint8x8_t a = vdup_n_u8(0);
+  size_t i;
+  for(i = 0; i < length; i += bytewidth)
+  {
+    a = vadd_u8(vand_u8(a, mask), loadPixelNEON(&scanline[i], length - i));
+    storePixelNEON(&recon[i], a, length - i);
+  }
+}
+
+static void unfilterAverageNEON(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                size_t bytewidth, size_t length)
+{
+  /*vhadd_u8 truncates like the filter does*/
+  const uint8x8_t mask = pixelMaskNEON(bytewidth);
+  uint8x8_t a = vdup_n_u8(0);
+  size_t i;
+  for(i = 0; i < length; i += bytewidth)
+  {
+    uint8x8_t avg = vand_u8(vhadd_u8(a, loadPixelNEON(&precon[i], length - i)), mask);
+    a = vadd_u8(loadPixelNEON(&scanline[i], length - i), avg);
+    storePixelNEON(&recon[i], a, length - i);
+  }
+}
+
+static void unfilterPaethNEON(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                              size_t bytewidth, size_t length)
+{
+  const uint8x8_t mask = pixelMaskNEON(bytewidth);
+  int16x8_t a = vdupq_n_s16(0), c = vdupq_n_s16(0);
+  size_t i;
+  for(i = 0; i < length; i += bytewidth)
+  {
+    int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(loadPixelNEON(&precon[i], length - i)));
+    int16x8_t pa = vsubq_s16(b, c);
+    int16x8_t pb = vsubq_s16(a, c);
+    int16x8_t pc = vabsq_s16(vaddq_s16(pa, pb));
+    pa = vabsq_s16(pa);
+    pb = vabsq_s16(pb);
+    int16x8_t smallest = vminq_s16(pc, vminq_s16(pa, pb));
+    int16x8_t predictor = vbslq_s16(vceqq_s16(smallest, pa), a, vbslq_s16(vceqq_s16(smallest, pb), b, c));
+    uint8x8_t predictor8 = vand_u8(vmovn_u16(vreinterpretq_u16_s16(predictor)), mask);
+    uint8x8_t x = vadd_u8(predictor8, loadPixelNEON(&scanline[i], length - i));
+    storePixelNEON(&recon[i], x, length - i);
+    a = vreinterpretq_s16_u16(vmovl_u8(x));
+    c = b;
+  }
+}
+
+#endif /*LODEPNG_SIMD_NEON*/
+
+/*
+Unfilters the scanline with SIMD if this CPU, pixel size and filter have a
+vectorized version. Returns 0 if it did nothing and the scalar code must run.
+The first scanline has no precon, it is left to the scalar code.
+*/
+static unsigned unfilterScanlineSIMD(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                     size_t bytewidth, unsigned char filterType, size_t length)
+{
+#if defined(LODEPNG_SIMD_SSE2)
+  unsigned has_ssse3 = lodepng_cpu_features() & LODEPNG_CPU_SSSE3;
+  if(bytewidth != 3 && bytewidth != 4)
+  {
+    /*Up works on bytes, the pixel size does not matter*/
+    if(filterType != 2 || !precon) return 0;
+    unfilterUpSSE2(recon, scanline, precon, length);
+    return 1;
+  }
+  switch(filterType)
+  {
+    case 1: unfilterSubSSE2(recon, scanline, bytewidth, length); return 1;
+    case 2: if(!precon) return 0; unfilterUpSSE2(recon, scanline, precon, length); return 1;
+    case 3: if(!precon) return 0; unfilterAverageSSE2(recon, scanline, precon, bytewidth, length); return 1;
+    case 4:
+      if(!precon) return 0;
+      if(has_ssse3) unfilterPaethSSSE3(recon, scanline, precon, bytewidth, length);
+      else unfilterPaethSSE2(recon, scanline, precon, bytewidth, length);
+      return 1;
+    default: return 0;
+  }
+#elif defined(LODEPNG_SIMD_NEON)
+  if(bytewidth != 3 && bytewidth != 4)
+  {
+    /*Up works on bytes, the pixel size does not matter*/
+    if(filterType != 2 || !precon) return 0;
+    unfilterUpNEON(recon, scanline, precon, length);
+    return 1;
+  }
+  switch(filterType)
+  {
+    case 1: unfilterSubNEON(recon, scanline, bytewidth, length); return 1;
+    case 2: if(!precon) return 0; unfilterUpNEON(recon, scanline, precon, length); return 1;
+    case 3: if(!precon) return 0; unfilterAverageNEON(recon, scanline, precon, bytewidth, length); return 1;
+    case 4: if(!precon) return 0; unfilterPaethNEON(recon, scanline, precon, bytewidth, length); return 1;
+    default: return 0;
+  }
+#else
+  (void)recon; (void)scanline; (void)precon; (void)bytewidth; (void)filterType; (void)length;
+  return 0;
+#endif
+}
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
-                                 size_t bytewidth, unsigned char filterType, size_t length)
+                                 size_t bytewidth, unsigned char filterType, size_t length, unsigned simd)
 {
   /*
   For PNG filter method 0
@@ -3872,6 +5594,7 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   */
 
   size_t i;
+  if(simd && unfilterScanlineSIMD(recon, scanline, precon, bytewidth, filterType, length)) return 0;
   switch(filterType)
   {
     case 0:
@@ -3933,7 +5656,7 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   return 0;
 }
 
-static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp)
+static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h, unsigned bpp, unsigned simd)
 {
   /*
   For PNG filter method 0
@@ -3956,7 +5679,7 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
     size_t inindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
     unsigned char filterType = in[inindex];
 
-    CERROR_TRY_RETURN(unfilterScanline(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes));
+    CERROR_TRY_RETURN(unfilterScanline(&out[outindex], &in[inindex + 1], prevline, bytewidth, filterType, linebytes, simd));
 
     prevline = &out[outindex];
   }
@@ -4056,7 +5779,7 @@ static void removePaddingBits(unsigned char* out, const unsigned char* in,
 the IDAT chunks (with filter index bytes and possible padding bits)
 return value is error*/
 static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
-                                     unsigned w, unsigned h, const LodePNGInfo* info_png)
+                                     unsigned w, unsigned h, const LodePNGInfo* info_png, unsigned simd)
 {
   /*
   This function converts the filtered-padded-interlaced data into pure 2D image buffer with the PNG's colortype.
@@ -4072,11 +5795,11 @@ static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
   {
     if(bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8)
     {
-      CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp));
+      CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp, simd));
       removePaddingBits(out, in, w * bpp, ((w * bpp + 7) / 8) * 8, h);
     }
     /*we can immediatly filter into the out buffer, no other steps needed*/
-    else CERROR_TRY_RETURN(unfilter(out, in, w, h, bpp));
+    else CERROR_TRY_RETURN(unfilter(out, in, w, h, bpp, simd));
   }
   else /*interlace_method is 1 (Adam7)*/
   {
@@ -4087,7 +5810,7 @@ static unsigned postProcessScanlines(unsigned char* out, unsigned char* in,
 
     for(i = 0; i < 7; i++)
     {
-      CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp));
+      CERROR_TRY_RETURN(unfilter(&in[padded_passstart[i]], &in[filter_passstart[i]], passw[i], passh[i], bpp, simd));
       /*TODO: possible efficiency improvement: if in this reduced image the bits fit nicely in 1 scanline,
       move bytes instead of bits or move not at all*/
       if(bpp < 8)
@@ -4411,31 +6134,148 @@ static unsigned readChunk_pHYs(LodePNGInfo* info, const unsigned char* data, siz
 }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
+/*
+Reads a chunk other than IHDR and IDAT into state->info_png and checks its CRC.
+critical_pos is where unknown chunks go, 1 = after IHDR, 2 = after PLTE, 3 = after
+IDAT. Once a chunk was unknown no more CRCs are checked. Sets *iend for IEND.
+*/
+static unsigned readChunk(LodePNGState* state, const unsigned char* chunk,
+                          unsigned* critical_pos, unsigned* unknown, unsigned char* iend)
+{
+  unsigned chunkLength = lodepng_chunk_length(chunk);
+  const unsigned char* data = lodepng_chunk_data_const(chunk);
+
+  /*IEND chunk*/
+  if(lodepng_chunk_type_equals(chunk, "IEND"))
+  {
+    *iend = 1;
+  }
+  /*palette chunk (PLTE)*/
+  else if(lodepng_chunk_type_equals(chunk, "PLTE"))
+  {
+    CERROR_TRY_RETURN(readChunk_PLTE(&state->info_png.color, data, chunkLength));
+    *critical_pos = 2;
+  }
+  /*palette transparency chunk (tRNS)*/
+  else if(lodepng_chunk_type_equals(chunk, "tRNS"))
+  {
+    CERROR_TRY_RETURN(readChunk_tRNS(&state->info_png.color, data, chunkLength));
+  }
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+  /*background color chunk (bKGD)*/
+  else if(lodepng_chunk_type_equals(chunk, "bKGD"))
+  {
+    CERROR_TRY_RETURN(readChunk_bKGD(&state->info_png, data, chunkLength));
+  }
+  /*text chunk (tEXt)*/
+  else if(lodepng_chunk_type_equals(chunk, "tEXt"))
+  {
+    if(state->decoder.read_text_chunks)
+    {
+      CERROR_TRY_RETURN(readChunk_tEXt(&state->info_png, data, chunkLength));
+    }
+  }
+  /*compressed text chunk (zTXt)*/
+  else if(lodepng_chunk_type_equals(chunk, "zTXt"))
+  {
+    if(state->decoder.read_text_chunks)
+    {
+      CERROR_TRY_RETURN(readChunk_zTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength));
+    }
+  }
+  /*international text chunk (iTXt)*/
+  else if(lodepng_chunk_type_equals(chunk, "iTXt"))
+  {
+    if(state->decoder.read_text_chunks)
+    {
+      CERROR_TRY_RETURN(readChunk_iTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength));
+    }
+  }
+  else if(lodepng_chunk_type_equals(chunk, "tIME"))
+  {
+    CERROR_TRY_RETURN(readChunk_tIME(&state->info_png, data, chunkLength));
+  }
+  else if(lodepng_chunk_type_equals(chunk, "pHYs"))
+  {
+    CERROR_TRY_RETURN(readChunk_pHYs(&state->info_png, data, chunkLength));
+  }
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  else /*it's not an implemented chunk type, so ignore it: skip over the data*/
+  {
+    /*error: unknown critical chunk (5th bit of first byte of chunk type is 0)*/
+    if(!lodepng_chunk_ancillary(chunk)) return 69;
+
+    *unknown = 1;
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+    if(state->decoder.remember_unknown_chunks)
+    {
+      CERROR_TRY_RETURN(lodepng_chunk_append(&state->info_png.unknown_chunks_data[*critical_pos - 1],
+                                             &state->info_png.unknown_chunks_size[*critical_pos - 1], chunk));
+    }
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  }
+
+  if(!state->decoder.ignore_crc && !*unknown) /*check CRC if wanted, only on known chunk types*/
+  {
+    if(lodepng_chunk_check_crc(chunk)) return 57; /*invalid CRC*/
+  }
+  return 0;
+}
+
+/*total size of the IDAT chunks, stops at the first chunk that does not fit in the file*/
+static size_t getIdatSize(const unsigned char* in, size_t insize)
+{
+  size_t pos = 33, total = 0;
+  while(pos + 12 <= insize)
+  {
+    const unsigned char* chunk = &in[pos];
+    size_t length = lodepng_chunk_length(chunk);
+    if(length > insize - pos - 12) break;
+    if(lodepng_chunk_type_equals(chunk, "IDAT")) total += length;
+    else if(lodepng_chunk_type_equals(chunk, "IEND")) break;
+    pos += length + 12;
+  }
+  return total;
+}
+
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-                          LodePNGState* state,
-                          const unsigned char* in, size_t insize)
+/*reads the chunks and inflates the IDAT data into scanlines, still filtered and possibly interlaced.
+With decoder.scratch_arena this opens the scratch arena, *scratch tells the caller to close it
+once the scanlines are freed.*/
+static void decodeScanlines(ucvector* scanlines, unsigned* w, unsigned* h,
+                            LodePNGState* state,
+                            const unsigned char* in, size_t insize, unsigned* scratch)
 {
   unsigned char IEND = 0;
   const unsigned char* chunk;
   size_t i;
   ucvector idat; /*the data from idat chunks*/
-  ucvector scanlines;
   size_t predict;
+  LodePNGDecompressSettings zlibsettings;
 
   /*for unknown chunk order*/
   unsigned unknown = 0;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-
-  /*provide some proper output values if error will happen*/
-  *out = 0;
 
+  *scratch = 0;
   state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
   if(state->error) return;
 
+  /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
+  The prediction is currently not correct for interlaced PNG images.*/
+  predict = lodepng_get_raw_size_idat(*w, *h, &state->info_png.color) + *h;
+
+  /*the IDAT data is gathered into one buffer of its final size, no growing it chunk by chunk*/
   ucvector_init(&idat);
+  i = getIdatSize(in, insize);
+  /*a custom zlib or inflate may realloc the output with its own allocator, only lodepng's take the arena*/
+  if(state->decoder.scratch_arena && !state->decoder.zlibsettings.custom_zlib
+     && (!state->decoder.zlibsettings.custom_inflate || state->decoder.zlibsettings.custom_inflate == lodepng_inflate_fast))
+  {
+    *scratch = scratch_begin(i + predict);
+  }
+  /*scanlines first, so the IDAT buffer and the inflater above them go back to the arena when freed*/
+  if(!ucvector_reserve(scanlines, predict) || !ucvector_reserve(&idat, i)) state->error = 83; /*alloc fail*/
   chunk = &in[33]; /*first byte of the first chunk after the header*/
 
   /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
@@ -4466,121 +6306,79 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
       size_t oldsize = idat.size;
       if(!ucvector_resize(&idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
       for(i = 0; i < chunkLength; i++) idat.data[oldsize + i] = data[i];
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
       critical_pos = 3;
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    }
-    /*IEND chunk*/
-    else if(lodepng_chunk_type_equals(chunk, "IEND"))
-    {
-      IEND = 1;
-    }
-    /*palette chunk (PLTE)*/
-    else if(lodepng_chunk_type_equals(chunk, "PLTE"))
-    {
-      state->error = readChunk_PLTE(&state->info_png.color, data, chunkLength);
-      if(state->error) break;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-      critical_pos = 2;
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    }
-    /*palette transparency chunk (tRNS)*/
-    else if(lodepng_chunk_type_equals(chunk, "tRNS"))
-    {
-      state->error = readChunk_tRNS(&state->info_png.color, data, chunkLength);
-      if(state->error) break;
-    }
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-    /*background color chunk (bKGD)*/
-    else if(lodepng_chunk_type_equals(chunk, "bKGD"))
-    {
-      state->error = readChunk_bKGD(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    }
-    /*text chunk (tEXt)*/
-    else if(lodepng_chunk_type_equals(chunk, "tEXt"))
-    {
-      if(state->decoder.read_text_chunks)
+      if(!state->decoder.ignore_crc && !unknown && lodepng_chunk_check_crc(chunk))
       {
-        state->error = readChunk_tEXt(&state->info_png, data, chunkLength);
-        if(state->error) break;
+        CERROR_BREAK(state->error, 57); /*invalid CRC*/
       }
     }
-    /*compressed text chunk (zTXt)*/
-    else if(lodepng_chunk_type_equals(chunk, "zTXt"))
-    {
-      if(state->decoder.read_text_chunks)
-      {
-        state->error = readChunk_zTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength);
-        if(state->error) break;
-      }
-    }
-    /*international text chunk (iTXt)*/
-    else if(lodepng_chunk_type_equals(chunk, "iTXt"))
-    {
-      if(state->decoder.read_text_chunks)
-      {
-        state->error = readChunk_iTXt(&state->info_png, &state->decoder.zlibsettings, data, chunkLength);
-        if(state->error) break;
-      }
-    }
-    else if(lodepng_chunk_type_equals(chunk, "tIME"))
-    {
-      state->error = readChunk_tIME(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    }
-    else if(lodepng_chunk_type_equals(chunk, "pHYs"))
+    else
     {
-      state->error = readChunk_pHYs(&state->info_png, data, chunkLength);
+      /*what readChunk keeps goes to the caller in info_png*/
+      unsigned active = scratch_pause();
+      state->error = readChunk(state, chunk, &critical_pos, &unknown, &IEND);
+      scratch_resume(active);
       if(state->error) break;
     }
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    else /*it's not an implemented chunk type, so ignore it: skip over the data*/
-    {
-      /*error: unknown critical chunk (5th bit of first byte of chunk type is 0)*/
-      if(!lodepng_chunk_ancillary(chunk)) CERROR_BREAK(state->error, 69);
-
-      unknown = 1;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-      if(state->decoder.remember_unknown_chunks)
-      {
-        state->error = lodepng_chunk_append(&state->info_png.unknown_chunks_data[critical_pos - 1],
-                                            &state->info_png.unknown_chunks_size[critical_pos - 1], chunk);
-        if(state->error) break;
-      }
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    }
-
-    if(!state->decoder.ignore_crc && !unknown) /*check CRC if wanted, only on known chunk types*/
-    {
-      if(lodepng_chunk_check_crc(chunk)) CERROR_BREAK(state->error, 57); /*invalid CRC*/
-    }
 
     if(!IEND) chunk = lodepng_chunk_next_const(chunk);
   }
 
-  ucvector_init(&scanlines);
-  /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
-  The prediction is currently not correct for interlaced PNG images.*/
-  predict = lodepng_get_raw_size_idat(*w, *h, &state->info_png.color) + *h;
-  if(!state->error && !ucvector_reserve(&scanlines, predict)) state->error = 83; /*alloc fail*/
   if(!state->error)
   {
-    state->error = zlib_decompress(&scanlines.data, &scanlines.size, idat.data,
-                                   idat.size, &state->decoder.zlibsettings);
+    zlibsettings = state->decoder.zlibsettings;
+    zlibsettings.expected_size = predict;
+    state->error = zlib_decompress(&scanlines->data, &scanlines->size, idat.data,
+                                   idat.size, &zlibsettings);
   }
   ucvector_cleanup(&idat);
+}
+
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                          LodePNGState* state,
+                          const unsigned char* in, size_t insize)
+{
+  ucvector scanlines;
+  unsigned scratch;
+
+  /*provide some proper output values if error will happen*/
+  *out = 0;
+
+  ucvector_init(&scanlines);
+  decodeScanlines(&scanlines, w, h, state, in, insize, &scratch);
 
   if(!state->error)
   {
     ucvector outv;
+    unsigned active = scratch_pause(); /*the image goes to the caller*/
     ucvector_init(&outv);
     if(!ucvector_resizev(&outv,
         lodepng_get_raw_size(*w, *h, &state->info_png.color), 0)) state->error = 83; /*alloc fail*/
-    if(!state->error) state->error = postProcessScanlines(outv.data, scanlines.data, *w, *h, &state->info_png);
+    scratch_resume(active);
+    if(!state->error) state->error = postProcessScanlines(outv.data, scanlines.data, *w, *h, &state->info_png,
+                                                              state->decoder.simd_unfilter);
     *out = outv.data;
   }
   ucvector_cleanup(&scanlines);
+  scratch_end(scratch);
+}
+
+static unsigned checkSwapRedBlue(const LodePNGColorMode* mode)
+{
+  if(mode->bitdepth != 8 || (mode->colortype != LCT_RGB && mode->colortype != LCT_RGBA)) return 92;
+  return 0;
+}
+
+/*exchange the first and third byte of each pixel*/
+static void swapRedBlue(unsigned char* pixels, size_t numpixels, size_t bytewidth)
+{
+  size_t i;
+  for(i = 0; i < numpixels; i++, pixels += bytewidth)
+  {
+    unsigned char r = pixels[0];
+    pixels[0] = pixels[2];
+    pixels[2] = r;
+  }
 }
 
 unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
@@ -4625,9 +6423,369 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                                         &state->info_png.color, *w, *h);
     lodepng_free(data);
   }
+  if(!state->error && state->decoder.swap_red_blue)
+  {
+    state->error = checkSwapRedBlue(&state->info_raw);
+    if(!state->error) swapRedBlue(*out, (size_t)(*w) * (*h), lodepng_get_bpp(&state->info_raw) / 8);
+  }
   return state->error;
 }
 
+/*
+Points *row at one row of the output image. *row holds the row in the PNG's color
+type, or in the raw one already when converted is set. rowbuf is scratch of a raw
+row for when conversion or swizzling is needed.
+*/
+static unsigned getRawRow(const unsigned char** row, unsigned w, unsigned converted,
+                          unsigned char* rowbuf, LodePNGState* state)
+{
+  if(!converted && !lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
+  {
+    CERROR_TRY_RETURN(lodepng_convert(rowbuf, *row, &state->info_raw, &state->info_png.color, w, 1));
+    *row = rowbuf;
+  }
+  if(state->decoder.swap_red_blue)
+  {
+    if(*row != rowbuf) memcpy(rowbuf, *row, lodepng_get_raw_size(w, 1, &state->info_raw));
+    swapRedBlue(rowbuf, w, lodepng_get_bpp(&state->info_raw) / 8);
+    *row = rowbuf;
+  }
+  return 0;
+}
+
+/*
+Writes one row of the output image to dst, which is only written, never read: it
+may be write-combined memory such as a mapped upload heap.
+*/
+static unsigned writeRawRow(unsigned char* dst, const unsigned char* row, unsigned w, unsigned converted,
+                            unsigned char* rowbuf, LodePNGState* state)
+{
+  CERROR_TRY_RETURN(getRawRow(&row, w, converted, rowbuf, state));
+  memcpy(dst, row, lodepng_get_raw_size(w, 1, &state->info_raw));
+  return 0;
+}
+
+/*the raw color type must be one lodepng_convert can produce, and fit swap_red_blue*/
+static unsigned checkRawColor(LodePNGState* state)
+{
+  if(!state->decoder.color_convert)
+  {
+    CERROR_TRY_RETURN(lodepng_color_mode_copy(&state->info_raw, &state->info_png.color));
+  }
+  if(!lodepng_color_mode_equal(&state->info_raw, &state->info_png.color)
+     && !(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+     && !(state->info_raw.bitdepth == 8))
+  {
+    return 56; /*unsupported color mode conversion*/
+  }
+  if(state->decoder.swap_red_blue) return checkSwapRedBlue(&state->info_raw);
+  return 0;
+}
+
+unsigned lodepng_decode_into(unsigned char* out, size_t pitch, size_t outsize,
+                             unsigned* w, unsigned* h, LodePNGState* state,
+                             const unsigned char* in, size_t insize)
+{
+  ucvector scanlines;
+  unsigned char* rowbuf = 0;
+  unsigned char* image = 0;
+  size_t rowbytes, y;
+  unsigned scratch;
+
+  ucvector_init(&scanlines);
+  decodeScanlines(&scanlines, w, h, state, in, insize, &scratch);
+  if(!state->error) state->error = checkRawColor(state);
+
+  rowbytes = state->error ? 0 : lodepng_get_raw_size(*w, 1, &state->info_raw);
+  if(!state->error && (pitch < rowbytes || (size_t)(*h - 1) * pitch + rowbytes > outsize))
+  {
+    state->error = 91; /*the output rows do not fit*/
+  }
+  if(!state->error)
+  {
+    rowbuf = (unsigned char*)lodepng_malloc(rowbytes);
+    if(!rowbuf) state->error = 83; /*alloc fail*/
+  }
+
+  if(!state->error && state->info_png.interlace_method == 0)
+  {
+    /*unfilter in place, the scanlines stay in cached memory, then convert a row at a time into out.
+    With bpp < 8 every row ends with its padding bits, so a row is a 1 pixel high image on its own.*/
+    unsigned bpp = lodepng_get_bpp(&state->info_png.color);
+    size_t linebytes = (*w * bpp + 7) / 8;
+    state->error = unfilter(scanlines.data, scanlines.data, *w, *h, bpp, state->decoder.simd_unfilter);
+    for(y = 0; y < *h && !state->error; y++)
+    {
+      state->error = writeRawRow(&out[y * pitch], &scanlines.data[y * linebytes], *w, 0, rowbuf, state);
+    }
+  }
+  else if(!state->error)
+  {
+    /*Adam7 puts every row together from all passes, go through a whole image in the raw color type*/
+    size_t rawsize = lodepng_get_raw_size(*w, *h, &state->info_raw);
+    unsigned rawbpp = lodepng_get_bpp(&state->info_raw);
+    image = (unsigned char*)lodepng_malloc(lodepng_get_raw_size(*w, *h, &state->info_png.color) + rawsize);
+    if(!image) state->error = 83; /*alloc fail*/
+    else
+    {
+      unsigned char* raw = image + lodepng_get_raw_size(*w, *h, &state->info_png.color);
+      memset(image, 0, lodepng_get_raw_size(*w, *h, &state->info_png.color));
+      state->error = postProcessScanlines(image, scanlines.data, *w, *h, &state->info_png, state->decoder.simd_unfilter);
+      if(!state->error) state->error = lodepng_convert(raw, image, &state->info_raw, &state->info_png.color, *w, *h);
+      for(y = 0; y < *h && !state->error; y++)
+      {
+        const unsigned char* row = &raw[y * rowbytes];
+        if((*w * rawbpp) % 8 != 0)
+        {
+          /*rows of a packed image start mid byte, realign this one*/
+          size_t ibp = y * (size_t)(*w) * rawbpp, obp = 0, x;
+          memset(rowbuf, 0, rowbytes);
+          for(x = 0; x < (size_t)(*w) * rawbpp; x++)
+          {
+            setBitOfReversedStream0(&obp, rowbuf, readBitFromReversedStream(&ibp, raw));
+          }
+          row = rowbuf;
+        }
+        state->error = writeRawRow(&out[y * pitch], row, *w, 1, rowbuf, state);
+      }
+    }
+  }
+
+  lodepng_free(image);
+  lodepng_free(rowbuf);
+  ucvector_cleanup(&scanlines);
+  scratch_end(scratch);
+  return state->error;
+}
+
+#ifdef LODEPNG_COMPILE_ZLIB
+
+/*
+The streaming decoder gathers the header, chunk headers and chunks other than IDAT
+until they are whole. IDAT data goes through the zlib stream in pieces of at most
+STREAM_IDAT_PIECE bytes, which bounds its input buffer, and the scanlines it inflates
+are put together one at a time next to the previous one, unfiltered against it and
+handed to the callback.
+*/
+#define STREAM_IDAT_PIECE 16384u
+
+#define STREAM_HEADER 0u /*signature and IHDR*/
+#define STREAM_CHUNK_HEADER 1u
+#define STREAM_CHUNK 2u
+#define STREAM_IDAT 3u
+#define STREAM_IDAT_CRC 4u
+#define STREAM_END 5u
+
+struct LodePNGStreamDecoder
+{
+  LodePNGState* state;
+  LodePNGRowCallback callback;
+  void* user;
+  unsigned w, h;
+
+  unsigned stage;
+  ucvector chunk; /*bytes of the part being gathered*/
+  size_t chunkneed; /*size of that part*/
+  size_t idatleft; /*data bytes of the current IDAT chunk still to come*/
+  unsigned idatcrc; /*CRC register of the current IDAT chunk*/
+  unsigned critical_pos, unknown;
+  ZlibStream zlib;
+
+  unsigned char* lines; /*two scanlines with their filter byte: row y at y & 1, row y - 1 unfiltered*/
+  unsigned char* rowbuf; /*one row in the raw color type*/
+  size_t linebytes;
+  size_t linepos; /*bytes of row y received*/
+  unsigned bytewidth;
+  unsigned y;
+};
+
+/*sink of the zlib stream: the inflated scanlines*/
+static unsigned streamScanlines(void* context, const unsigned char* data, size_t size)
+{
+  LodePNGStreamDecoder* decoder = (LodePNGStreamDecoder*)context;
+  LodePNGState* state = decoder->state;
+  size_t linesize = decoder->linebytes + 1;
+  /*bytes after the last row are ignored, like the whole image decode does*/
+  while(size > 0 && decoder->y < decoder->h)
+  {
+    unsigned char* line = &decoder->lines[(decoder->y & 1) * linesize];
+    size_t n = linesize - decoder->linepos;
+    if(n > size) n = size;
+    memcpy(&line[decoder->linepos], data, n);
+    decoder->linepos += n;
+    data += n;
+    size -= n;
+    if(decoder->linepos == linesize)
+    {
+      const unsigned char* precon = decoder->y ? &decoder->lines[((decoder->y + 1) & 1) * linesize + 1] : 0;
+      const unsigned char* row = &line[1];
+      CERROR_TRY_RETURN(unfilterScanline(&line[1], &line[1], precon, decoder->bytewidth, line[0],
+                                         decoder->linebytes, state->decoder.simd_unfilter));
+      CERROR_TRY_RETURN(getRawRow(&row, decoder->w, 0, decoder->rowbuf, state));
+      if(decoder->callback(decoder->user, row, decoder->y, decoder->w, decoder->h)) return 95;
+      decoder->y++;
+      decoder->linepos = 0;
+    }
+  }
+  return 0;
+}
+
+/*the IHDR is in, set up the row buffers*/
+static unsigned streamHeader(LodePNGStreamDecoder* decoder)
+{
+  LodePNGState* state = decoder->state;
+  unsigned bpp;
+  CERROR_TRY_RETURN(lodepng_inspect(&decoder->w, &decoder->h, state, decoder->chunk.data, decoder->chunk.size));
+  /*Adam7 completes rows only in its last pass, so they can't come out one by one*/
+  if(state->info_png.interlace_method != 0) return 94;
+  CERROR_TRY_RETURN(checkRawColor(state));
+
+  bpp = lodepng_get_bpp(&state->info_png.color);
+  decoder->bytewidth = (bpp + 7) / 8;
+  decoder->linebytes = ((size_t)decoder->w * bpp + 7) / 8;
+  decoder->lines = (unsigned char*)lodepng_malloc(2 * (decoder->linebytes + 1));
+  decoder->rowbuf = (unsigned char*)lodepng_malloc(lodepng_get_raw_size(decoder->w, 1, &state->info_raw) + 1);
+  if(!decoder->lines || !decoder->rowbuf) return 83; /*alloc fail*/
+  return 0;
+}
+
+/*the part in decoder->chunk is complete, read it and set up the next one*/
+static unsigned streamChunk(LodePNGStreamDecoder* decoder)
+{
+  LodePNGState* state = decoder->state;
+  unsigned char iend = 0;
+  unsigned chunkLength;
+
+  if(decoder->stage == STREAM_HEADER)
+  {
+    CERROR_TRY_RETURN(streamHeader(decoder));
+  }
+  else if(decoder->stage == STREAM_CHUNK_HEADER)
+  {
+    chunkLength = lodepng_chunk_length(decoder->chunk.data);
+    /*error: chunk length larger than the max PNG chunk size*/
+    if(chunkLength > 2147483647) return 63;
+    if(lodepng_chunk_type_equals(decoder->chunk.data, "IDAT"))
+    {
+      decoder->critical_pos = 3;
+      decoder->idatcrc = update_crc32(0xffffffffL, &decoder->chunk.data[4], 4);
+      decoder->idatleft = chunkLength;
+      decoder->stage = chunkLength ? STREAM_IDAT : STREAM_IDAT_CRC;
+      decoder->chunk.size = 0;
+      decoder->chunkneed = 4;
+      return 0;
+    }
+    /*keep the chunk header, the whole chunk is read at once*/
+    decoder->stage = STREAM_CHUNK;
+    decoder->chunkneed = (size_t)chunkLength + 12;
+    return 0;
+  }
+  else if(decoder->stage == STREAM_CHUNK)
+  {
+    CERROR_TRY_RETURN(readChunk(state, decoder->chunk.data, &decoder->critical_pos, &decoder->unknown, &iend));
+    if(iend)
+    {
+      /*the zlib data is complete: decode its last bytes, which waited for more input*/
+      CERROR_TRY_RETURN(zlibStreamWrite(&decoder->zlib, 0, 0, 1));
+      if(decoder->y < decoder->h) return 93;
+      decoder->stage = STREAM_END;
+      return 0;
+    }
+  }
+  else /*STREAM_IDAT_CRC*/
+  {
+    if(!state->decoder.ignore_crc && !decoder->unknown
+       && lodepng_read32bitInt(decoder->chunk.data) != (decoder->idatcrc ^ 0xffffffffL))
+    {
+      return 57; /*invalid CRC*/
+    }
+  }
+  decoder->stage = STREAM_CHUNK_HEADER;
+  decoder->chunk.size = 0;
+  decoder->chunkneed = 8;
+  return 0;
+}
+
+LodePNGStreamDecoder* lodepng_stream_decoder_new(LodePNGState* state, LodePNGRowCallback callback, void* user)
+{
+  LodePNGStreamDecoder* decoder = (LodePNGStreamDecoder*)lodepng_malloc(sizeof(LodePNGStreamDecoder));
+  if(!decoder) return 0;
+  decoder->state = state;
+  decoder->callback = callback;
+  decoder->user = user;
+  decoder->w = decoder->h = 0;
+  decoder->stage = STREAM_HEADER;
+  ucvector_init(&decoder->chunk);
+  decoder->chunkneed = 33; /*signature and IHDR chunk*/
+  decoder->idatleft = 0;
+  decoder->idatcrc = 0;
+  decoder->critical_pos = 1;
+  decoder->unknown = 0;
+  decoder->lines = 0;
+  decoder->rowbuf = 0;
+  decoder->linebytes = decoder->linepos = 0;
+  decoder->bytewidth = 0;
+  decoder->y = 0;
+  state->error = zlibStreamInit(&decoder->zlib, &state->decoder.zlibsettings, streamScanlines, decoder);
+  if(state->error)
+  {
+    lodepng_free(decoder);
+    return 0;
+  }
+  return decoder;
+}
+
+void lodepng_stream_decoder_delete(LodePNGStreamDecoder* decoder)
+{
+  if(!decoder) return;
+  zlibStreamCleanup(&decoder->zlib);
+  ucvector_cleanup(&decoder->chunk);
+  lodepng_free(decoder->lines);
+  lodepng_free(decoder->rowbuf);
+  lodepng_free(decoder);
+}
+
+unsigned lodepng_stream_decoder_push(LodePNGStreamDecoder* decoder, const unsigned char* in, size_t insize)
+{
+  LodePNGState* state = decoder->state;
+  while(insize > 0 && !state->error && decoder->stage != STREAM_END)
+  {
+    size_t n;
+    if(decoder->stage == STREAM_IDAT)
+    {
+      /*straight from in, without gathering the chunk*/
+      n = decoder->idatleft < insize ? decoder->idatleft : insize;
+      if(n > STREAM_IDAT_PIECE) n = STREAM_IDAT_PIECE;
+      if(!state->decoder.ignore_crc) decoder->idatcrc = update_crc32(decoder->idatcrc, in, n);
+      state->error = zlibStreamWrite(&decoder->zlib, in, n, 0);
+      decoder->idatleft -= n;
+      if(!decoder->idatleft) decoder->stage = STREAM_IDAT_CRC;
+    }
+    else
+    {
+      size_t oldsize = decoder->chunk.size;
+      n = decoder->chunkneed - oldsize;
+      if(n > insize) n = insize;
+      if(!ucvector_resize(&decoder->chunk, oldsize + n)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+      memcpy(&decoder->chunk.data[oldsize], in, n);
+      if(decoder->chunk.size == decoder->chunkneed) state->error = streamChunk(decoder);
+    }
+    in += n;
+    insize -= n;
+  }
+  return state->error;
+}
+
+unsigned lodepng_stream_decoder_finish(LodePNGStreamDecoder* decoder)
+{
+  LodePNGState* state = decoder->state;
+  /*error: the PNG ended before its IEND chunk*/
+  if(!state->error && decoder->stage != STREAM_END) state->error = 30;
+  return state->error;
+}
+
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
 unsigned lodepng_decode_memory(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in,
                                size_t insize, LodePNGColorType colortype, unsigned bitdepth)
 {
@@ -4683,6 +6841,9 @@ void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings)
   settings->remember_unknown_chunks = 0;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
   settings->ignore_crc = 0;
+  settings->simd_unfilter = 1;
+  settings->swap_red_blue = 0;
+  settings->scratch_arena = 1;
   lodepng_decompress_settings_init(&settings->zlibsettings);
 }
 
@@ -5866,6 +8027,11 @@ const char* lodepng_error_text(unsigned code)
     case 89: return "text chunk keyword too short or long: must have size 1-79";
     /*the windowsize in the LodePNGCompressSettings. Requiring POT(==> & instead of %) makes encoding 12% faster.*/
     case 90: return "windowsize must be a power of two";
+    case 91: return "the output buffer or its row pitch is too small for the image";
+    case 92: return "swap_red_blue needs 8-bit RGB or RGBA output";
+    case 93: return "the image data ended before the last row";
+    case 94: return "interlaced PNGs can't be decoded a row at a time";
+    case 95: return "the row callback stopped the decoding";
   }
   return "unknown error code";
 }
@@ -69,6 +69,12 @@ the custom_zlib field of the compress and decompress settings*/
 #ifndef LODEPNG_NO_COMPILE_ERROR_TEXT
 #define LODEPNG_COMPILE_ERROR_TEXT
 #endif
+/*SSE2/SSSE3/NEON scanline unfiltering for 8-bit RGB and RGBA, the scalar code stays for
+everything else. Also PCLMULQDQ/ARMv8 CRC32 and SSSE3/AVX2 Adler-32, picked at runtime.
+Disable with -DLODEPNG_NO_COMPILE_SIMD*/
+#ifndef LODEPNG_NO_COMPILE_SIMD
+#define LODEPNG_COMPILE_SIMD
+#endif
 /*Compile the default allocators (C's free, malloc and realloc). If you disable this,
 you can define the functions lodepng_free, lodepng_malloc and lodepng_realloc in your
 source files with custom allocators.*/
@@ -257,7 +263,7 @@ struct LodePNGDecompressSettings
   unsigned (*custom_zlib)(unsigned char**, size_t*,
                           const unsigned char*, size_t,
                           const LodePNGDecompressSettings*);
-  /*use custom deflate decoder instead of built in one (default: null)
+  /*use custom deflate decoder instead of built in one (default: lodepng_inflate_fast, null for lodepng_inflate)
   if custom_zlib is used, custom_deflate is ignored since only the built in
   zlib function will call custom_deflate*/
   unsigned (*custom_inflate)(unsigned char**, size_t*,
@@ -265,6 +271,10 @@ struct LodePNGDecompressSettings
                              const LodePNGDecompressSettings*);
 
   const void* custom_context; /*optional custom settings for custom functions*/
+
+  /*inflated size if known, lodepng_inflate_fast allocates that much up front instead of
+  guessing from the compressed size. The PNG decoder sets it. Default: 0*/
+  size_t expected_size;
 };
 
 extern const LodePNGDecompressSettings lodepng_default_decompress_settings;
@@ -520,6 +530,20 @@ typedef struct LodePNGDecoderSettings
 
   unsigned color_convert; /*whether to convert the PNG to the color type you want. Default: yes*/
 
+  /*use the vectorized unfilter where the CPU has one, the output is the same either way. Default: yes*/
+  unsigned simd_unfilter;
+
+  /*exchange red and blue of 8-bit RGB or RGBA output, giving BGR or BGRA such as
+  DXGI_FORMAT_B8G8R8A8_UNORM. Default: no*/
+  unsigned swap_red_blue;
+
+  /*take the decode's scratch memory (IDAT data, inflate output, unfilter buffers) from a
+  per-thread arena sized from the IHDR, instead of one heap allocation and realloc at a
+  time. The arena is kept for the thread's next image, see lodepng_scratch_release; images
+  needing more than LODEPNG_SCRATCH_KEEP bytes (16 MB) of it use the heap. The output image
+  is always on the heap. Default: yes*/
+  unsigned scratch_arena;
+
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   unsigned read_text_chunks; /*if false but remember_unknown_chunks is true, they're stored in the unknown chunks*/
   /*store all bytes from unknown chunks in the LodePNGInfo (off by default, useful for a png editor)*/
@@ -528,6 +552,9 @@ typedef struct LodePNGDecoderSettings
 } LodePNGDecoderSettings;
 
 void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings);
+
+/*frees the calling thread's scratch arena, e.g. before a loading thread goes idle*/
+void lodepng_scratch_release(void);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -647,6 +674,18 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                         LodePNGState* state,
                         const unsigned char* in, size_t insize);
 
+/*
+Same as lodepng_decode, but into memory the caller owns: row y of the raw image
+starts at out + y * pitch, pitch may be larger than a row (e.g. 256 byte aligned
+for a D3D12 upload heap). outsize is the size of out, the last row only needs its
+own bytes. out is only written, never read, so it may be write-combined memory.
+Get the size to allocate from lodepng_inspect first. Without interlacing no image
+sized buffer is allocated besides the inflated scanlines.
+*/
+unsigned lodepng_decode_into(unsigned char* out, size_t pitch, size_t outsize,
+                             unsigned* w, unsigned* h, LodePNGState* state,
+                             const unsigned char* in, size_t insize);
+
 /*
 Read the PNG header, but not the actual data. This returns only the information
 that is in the header chunk of the PNG, such as width, height and color type. The
@@ -655,6 +694,33 @@ information is placed in the info_png field of the LodePNGState.
 unsigned lodepng_inspect(unsigned* w, unsigned* h,
                          LodePNGState* state,
                          const unsigned char* in, size_t insize);
+
+#ifdef LODEPNG_COMPILE_ZLIB
+/*
+Receives row y of a streaming decode in the color type of state->info_raw, with the
+image size. The row is only valid during the call. Returning nonzero stops the
+decoding with error 95.
+*/
+typedef unsigned (*LodePNGRowCallback)(void* user, const unsigned char* row, unsigned y, unsigned w, unsigned h);
+
+/*
+Decodes a PNG handed over in pieces of any size, such as reads of a file, and gives
+each row to the callback as soon as it is inflated and unfiltered. Neither the file,
+the inflated scanlines nor the image are ever held whole: working memory is two
+scanlines, a converted row and about 150 KB of inflate state (the 32 KB deflate window
+twice, Huffman tables and at most 16 KB of compressed input), plus any metadata chunk
+while it is read. Settings and results are in state like for lodepng_decode, which
+must outlive the decoder; the built-in inflater is always used. Interlaced PNGs give
+error 94, Adam7 completes rows only in its last pass.
+new returns 0 when out of memory. push returns the error so far, once the IEND chunk
+is in the rest of the input is ignored. finish returns error 30 if IEND never came.
+*/
+typedef struct LodePNGStreamDecoder LodePNGStreamDecoder;
+LodePNGStreamDecoder* lodepng_stream_decoder_new(LodePNGState* state, LodePNGRowCallback callback, void* user);
+unsigned lodepng_stream_decoder_push(LodePNGStreamDecoder* decoder, const unsigned char* in, size_t insize);
+unsigned lodepng_stream_decoder_finish(LodePNGStreamDecoder* decoder);
+void lodepng_stream_decoder_delete(LodePNGStreamDecoder* decoder);
+#endif /*LODEPNG_COMPILE_ZLIB*/
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 
@@ -730,6 +796,19 @@ unsigned lodepng_chunk_create(unsigned char** out, size_t* outlength, unsigned l
 unsigned lodepng_crc32(const unsigned char* buf, size_t len);
 #endif /*LODEPNG_COMPILE_PNG*/
 
+/*
+Instruction set extensions the SIMD code uses when the CPU has them, detected on
+first use. lodepng_set_cpu_features masks that to the given bits, so tests and
+benchmarks can run the portable code or one particular path. Not meant to be
+changed while other threads decode or encode.
+*/
+#define LODEPNG_CPU_SSSE3 1u
+#define LODEPNG_CPU_AVX2 2u
+#define LODEPNG_CPU_PCLMUL 4u
+#define LODEPNG_CPU_ARM_CRC32 8u
+unsigned lodepng_cpu_features(void);
+void lodepng_set_cpu_features(unsigned features);
+
 
 #ifdef LODEPNG_COMPILE_ZLIB
 /*
@@ -744,6 +823,16 @@ unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGDecompressSettings* settings);
 
+/*
+Same as lodepng_inflate, but decodes through lookup tables a machine word of input
+at a time. This is the default custom_inflate of LodePNGDecompressSettings, set
+custom_inflate to 0 to use lodepng_inflate instead. Codes that do not exist in a
+block's Huffman tree are an error here, lodepng_inflate decodes them as symbol 0.
+*/
+unsigned lodepng_inflate_fast(unsigned char** out, size_t* outsize,
+                              const unsigned char* in, size_t insize,
+                              const LodePNGDecompressSettings* settings);
+
 /*
 Decompresses Zlib data. Reallocates the out buffer and appends the data. The
 data must be according to the zlib specification.
@@ -780,6 +869,9 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const LodePNGCompressSettings* settings);
 
 #endif /*LODEPNG_COMPILE_ENCODER*/
+
+/*Adler-32 of buf[0..len-1], the zlib checksum. In the public interface only for tests.*/
+unsigned lodepng_adler32(const unsigned char* buf, unsigned len);
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
 #ifdef LODEPNG_COMPILE_DISK
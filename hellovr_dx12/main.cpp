@@ -1,11 +1,21 @@
 #include "CMainApplication.h"
 #include "Commandline.h"
+#include "Texture.h"
+#include "WorkerPool.h"
 
 int main(int argc, char *argv[])
 {
     CommandLine cmdline(argc, argv);
 
-    CMainApplication pMainApplication(cmdline.m_nMSAASampleCount, cmdline.m_flSuperSampleScale, cmdline.m_iSceneVolumeInit);
+    if (cmdline.m_bCookTextures)
+    {
+        WorkerPool workers(cmdline.m_nWorkerThreads);
+        return Texture::CookTexturemaps(cmdline.m_mipFilter, cmdline.m_cookFormat, cmdline.m_cookQuality, &workers) ? 0 : 1;
+    }
+
+    CMainApplication pMainApplication(cmdline.m_nMSAASampleCount, cmdline.m_flSuperSampleScale, cmdline.m_iSceneVolumeInit, cmdline.m_nWorkerThreads, cmdline.m_mipFilter,
+                                      cmdline.m_nTextureStreamBudget, cmdline.m_posePrediction,
+                                      cmdline.m_cubeMode, cmdline.m_flCubeSpacing, cmdline.m_bCullCubes, cmdline.m_bOcclusionCulling);
 
     if (!pMainApplication.Initialize(cmdline.m_bDebugD3D12))
     {
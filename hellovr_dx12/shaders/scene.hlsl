@@ -6,6 +6,22 @@ struct VS_INPUT
 	float2 vUVCoords: TEXCOORD0;
 };
 
+// Instanced: the shared cube plus this instance's corner
+struct VS_INSTANCED_INPUT
+{
+	float3 vPosition : POSITION0;
+	float2 vUVCoords: TEXCOORD0;
+	float3 vInstancePosition : POSITION1;
+};
+
+// Meshed: a packed corner of a chunk's merged face, x y z in 6 bits each then
+// the face, plus the chunk's origin and voxel size
+struct VS_MESHED_INPUT
+{
+	uint nPackedCorner : POSITION0;
+	float4 vChunk : POSITION1;
+};
+
 struct PS_INPUT
 {
 	float4 vPosition : SV_POSITION;
@@ -32,9 +48,44 @@ PS_INPUT VSMain( VS_INPUT i )
 	return o;
 }
 
+PS_INPUT VSInstanced( VS_INSTANCED_INPUT i )
+{
+	PS_INPUT o;
+	o.vPosition = mul( g_MVPMatrix, float4( i.vPosition + i.vInstancePosition, 1.0 ) );
+#ifdef VULKAN
+	o.vPosition.y = -o.vPosition.y;
+#endif
+	o.vUVCoords = i.vUVCoords;
+	return o;
+}
+
+PS_INPUT VSMeshed( VS_MESHED_INPUT i )
+{
+	float3 vCorner = float3( i.nPackedCorner & 63, ( i.nPackedCorner >> 6 ) & 63, ( i.nPackedCorner >> 12 ) & 63 );
+	uint nFace = ( i.nPackedCorner >> 18 ) & 7;
+	PS_INPUT o;
+	o.vPosition = mul( g_MVPMatrix, float4( i.vChunk.xyz + vCorner * i.vChunk.w, 1.0 ) );
+#ifdef VULKAN
+	o.vPosition.y = -o.vPosition.y;
+#endif
+	// the face's in plane axes, -x +x -y +y -z +z, one texture per voxel
+	float2 vFacePlanes[6] = { vCorner.zy, vCorner.yz, vCorner.xz, vCorner.zx, vCorner.yx, vCorner.xy };
+	float2 vPlane = vFacePlanes[nFace];
+	o.vUVCoords = float2( vPlane.x, -vPlane.y );
+	return o;
+}
+
 float4 PSMain( PS_INPUT i ) : SV_TARGET
 {
 	float4 vColor = g_Texture.Sample( g_SamplerState, i.vUVCoords );
 	return vColor;
 }
-)""
\ No newline at end of file
+
+// The texture repeats across a merged face, the sampler clamps. Gradients of
+// the unwrapped coordinates keep the mip level steady where it wraps.
+float4 PSMeshed( PS_INPUT i ) : SV_TARGET
+{
+	float4 vColor = g_Texture.SampleGrad( g_SamplerState, frac( i.vUVCoords ), ddx( i.vUVCoords ), ddy( i.vUVCoords ) );
+	return vColor;
+}
+)""
\ No newline at end of file